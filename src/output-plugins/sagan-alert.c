@@ -38,6 +38,7 @@
 #include "sagan-alert.h"
 #include "sagan-references.h"
 #include "sagan-config.h"
+#include "sagan-counters.h"
 
 struct _Rule_Struct *rulestruct;
 struct _SaganConfig *config;
@@ -48,7 +49,7 @@ void Sagan_Alert_File( _Sagan_Event *Event )
 
     char *tmpref = NULL;
 
-    counters->alert_total++;
+    Sagan_Thread_Counters()->alert_total++;
 
     fprintf(config->sagan_alert_stream, "\n[**] [%lu:%s] %s [**]\n", Event->generatorid, Event->sid, Event->f_msg);
     fprintf(config->sagan_alert_stream, "[Classification: %s] [Priority: %d] [%s]\n", Event->class, Event->pri, Event->host );
@@ -0,0 +1,311 @@
+/*
+** Copyright (C) 2009-2017 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2017 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* parse-features.c
+ *
+ * Per message cache of what the parsers pull out of a message: the IP
+ * addresses (in order),  ports,  protocol and hashes.  Each one is only
+ * worked out the first time a rule or processor asks for it,  and then
+ * shared by every other rule that matches the same message.
+ *
+ * Results are per thread.  Sagan_Engine() calls Sagan_Features_Reset()
+ * for each new message.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "sagan.h"
+#include "sagan-defs.h"
+#include "parsers/parsers.h"
+
+typedef struct _Sagan_Features _Sagan_Features;
+struct _Sagan_Features {
+
+    const char *message;
+    const char *program;
+
+    sbool ip_done;				/* ip[] holds every IP there is (up to MAX_PARSE_IP) */
+    int ip_count;
+    char ip[MAX_PARSE_IP][MAXIP];
+    uint32_t ip_u32[MAX_PARSE_IP];
+
+    sbool src_port_set;
+    int src_port;
+
+    sbool dst_port_set;
+    int dst_port;
+
+    sbool proto_set;
+    int proto;
+
+    sbool proto_program_set;
+    int proto_program;
+
+    sbool hash_set[PARSE_HASH_ALL+1];
+    char hash[PARSE_HASH_ALL+1][SHA256_HASH_SIZE+1];
+
+};
+
+static __thread struct _Sagan_Features features;
+
+/****************************************************************************
+ * Sagan_Features_Reset - Forget the last message.  Cheap,  only the flags
+ * are cleared.
+ ****************************************************************************/
+
+void Sagan_Features_Reset( void )
+{
+
+    features.message = NULL;
+    features.program = NULL;
+
+}
+
+/****************************************************************************
+ * Sagan_Features_Message - Starts over if asked about a different message
+ ****************************************************************************/
+
+static void Sagan_Features_Message( const char *message )
+{
+
+    int i;
+
+    if ( features.message == message ) {
+        return;
+    }
+
+    features.message = message;
+
+    features.ip_done = false;
+    features.ip_count = 0;
+    features.src_port_set = false;
+    features.dst_port_set = false;
+    features.proto_set = false;
+
+    for ( i = 0; i <= PARSE_HASH_ALL; i++ ) {
+        features.hash_set[i] = false;
+    }
+
+}
+
+/****************************************************************************
+ * Sagan_Features_IP_Fill - Makes sure the message's first "want" IPv4
+ * addresses are in ip[].  The scan stops once it has found that many,  so
+ * a rule asking for parse_ip: 1 doesn't pay for the rest of the message.
+ ****************************************************************************/
+
+static void Sagan_Features_IP_Fill( char *message, int want )
+{
+
+    struct _Sagan_IP ips[MAX_PARSE_IP];
+    const char *ip;
+    int count;
+    int i;
+
+    Sagan_Features_Message(message);
+
+    if ( features.ip_done == true || want <= features.ip_count ) {
+        return;
+    }
+
+    if ( want > MAX_PARSE_IP ) {
+        want = MAX_PARSE_IP;
+    }
+
+    /* Addresses already in ip[] are found again,  only the new ones are
+       formatted */
+
+    count = Sagan_Parse_IP_Scan(message, strlen(message), ips, want, false);
+
+    for ( i = features.ip_count; i < count; i++ ) {
+
+        ip = Sagan_Parse_IP_Format(&ips[i], features.ip[i], sizeof(features.ip[i]));
+
+        /* 127.0.0.1 is reported as sagan_host */
+
+        if ( ip != features.ip[i] ) {
+            strlcpy(features.ip[i], ip, sizeof(features.ip[i]));
+            features.ip_u32[i] = IP2Bit(features.ip[i]);
+        } else {
+            features.ip_u32[i] = ips[i].u32;
+        }
+    }
+
+    features.ip_count = count;
+
+    /* Fewer than asked for means the message has no more */
+
+    if ( count < want || count == MAX_PARSE_IP ) {
+        features.ip_done = true;
+    }
+
+}
+
+/****************************************************************************
+ * Sagan_Features_IP - Same as Sagan_Parse_IP(),  "0" if there is no IP at
+ * that position
+ ****************************************************************************/
+
+const char *Sagan_Features_IP( char *message, int pos )
+{
+
+    /* Past what is cached,  don't bother */
+
+    if ( pos > MAX_PARSE_IP ) {
+        return(Sagan_Parse_IP(message, pos));
+    }
+
+    if ( pos < 1 ) {
+        return("0");
+    }
+
+    Sagan_Features_IP_Fill(message, pos);
+
+    if ( pos > features.ip_count ) {
+        return("0");
+    }
+
+    return(features.ip[pos - 1]);
+
+}
+
+/****************************************************************************
+ * Sagan_Features_IPs - Every IP in the message (up to MAX_PARSE_IP - 1,
+ * like the old *_IPADDR_All() loops) as strings and in host order
+ ****************************************************************************/
+
+int Sagan_Features_IPs( char *message, const char (**ip)[MAXIP], const uint32_t **ip_u32 )
+{
+
+    Sagan_Features_IP_Fill(message, MAX_PARSE_IP);
+
+    if ( ip != NULL ) {
+        *ip = (const char (*)[MAXIP])features.ip;
+    }
+
+    if ( ip_u32 != NULL ) {
+        *ip_u32 = features.ip_u32;
+    }
+
+    return( features.ip_count < MAX_PARSE_IP - 1 ? features.ip_count : MAX_PARSE_IP - 1 );
+
+}
+
+/****************************************************************************
+ * Sagan_Features_Src_Port / Sagan_Features_Dst_Port
+ ****************************************************************************/
+
+int Sagan_Features_Src_Port( char *message )
+{
+
+    Sagan_Features_Message(message);
+
+    if ( features.src_port_set == false ) {
+        features.src_port = Sagan_Parse_Src_Port(message);
+        features.src_port_set = true;
+    }
+
+    return(features.src_port);
+
+}
+
+int Sagan_Features_Dst_Port( char *message )
+{
+
+    Sagan_Features_Message(message);
+
+    if ( features.dst_port_set == false ) {
+        features.dst_port = Sagan_Parse_Dst_Port(message);
+        features.dst_port_set = true;
+    }
+
+    return(features.dst_port);
+
+}
+
+/****************************************************************************
+ * Sagan_Features_Proto - Protocol guessed from the message
+ ****************************************************************************/
+
+int Sagan_Features_Proto( char *message )
+{
+
+    Sagan_Features_Message(message);
+
+    if ( features.proto_set == false ) {
+        features.proto = Sagan_Parse_Proto(message);
+        features.proto_set = true;
+    }
+
+    return(features.proto);
+
+}
+
+/****************************************************************************
+ * Sagan_Features_Proto_Program - Protocol guessed from the program
+ ****************************************************************************/
+
+int Sagan_Features_Proto_Program( char *program )
+{
+
+    if ( features.program != program ) {
+        features.program = program;
+        features.proto_program_set = false;
+    }
+
+    if ( features.proto_program_set == false ) {
+        features.proto_program = Sagan_Parse_Proto_Program(program);
+        features.proto_program_set = true;
+    }
+
+    return(features.proto_program);
+
+}
+
+/****************************************************************************
+ * Sagan_Features_Hash - First hash of the type (PARSE_HASH_*) in the
+ * message,  or ""
+ ****************************************************************************/
+
+const char *Sagan_Features_Hash( char *message, int type )
+{
+
+    if ( type < PARSE_HASH_MD5 || type > PARSE_HASH_ALL ) {
+        return("");
+    }
+
+    Sagan_Features_Message(message);
+
+    if ( features.hash_set[type] == false ) {
+        strlcpy(features.hash[type], Sagan_Parse_Hash(message, type), sizeof(features.hash[type]));
+        features.hash_set[type] = true;
+    }
+
+    return(features.hash[type]);
+
+}
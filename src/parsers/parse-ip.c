@@ -25,6 +25,12 @@
  * "Invalid login from 12.145.241.50".  This will pull the 12.145.241.50.  This
  * is part of the "parse_ip" Sagan rules flag.
  *
+ * Sagan_Parse_IP_Scan() finds every address in one left to right pass.
+ * Only the bytes around a "." (or ":" for IPv6) are ever looked at one by
+ * one,  and those are found 16 bytes at a time with SSE2.  A run of hex
+ * digits,  dots and colons around one is then checked for a dotted quad
+ * (or handed to inet_pton() as IPv6).
+ *
  */
 
 
@@ -34,10 +40,12 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <sys/socket.h>
 #include <string.h>
+#include <stdbool.h>
 
 #include "sagan.h"
 #include "sagan-defs.h"
@@ -46,98 +54,277 @@
 #include "version.h"
 #include "parsers/parsers.h"
 
+#if defined(HAVE_SSE2) && defined(__x86_64__)
+#define PARSE_IP_SSE2
+#include <emmintrin.h>
+#endif
+
+#define IP_LOOPBACK	0x7f000001	/* 127.0.0.1 */
+
 struct _SaganConfig *config;
 
-char *Sagan_Parse_IP( char *syslogmessage, int pos )
+/****************************************************************************
+ * IP_Run_Char - Can the byte be part of an address?
+ ****************************************************************************/
+
+static inline sbool IP_Run_Char( unsigned char c )
 {
 
-    int result_space, result_nonspace, i, b;
+    return( ( c >= '0' && c <= '9' ) || ( (c | 0x20) >= 'a' && (c | 0x20) <= 'f' ) || c == '.' || c == ':' );
 
-    int flag=0;
-    int current_pos=0;
-    int notfound=0;
+}
 
-    char ctmp[2] = { 0 };
+/****************************************************************************
+ * IP_Next_Separator - Next "." (or ":") at or after p,  or end
+ ****************************************************************************/
 
-    static __thread char lastgood[16] = { 0 };
+static const char *IP_Next_Separator( const char *p, const char *end, sbool ipv6 )
+{
 
-    char msg[MAX_SYSLOGMSG] = { 0 };
-    char tmpmsg[MAX_SYSLOGMSG] = { 0 };
+#ifdef PARSE_IP_SSE2
 
-    char *retbuf=(char*)malloc(16);
-    char *tok=NULL;
-    char *ptmp=NULL;
+    __m128i dot = _mm_set1_epi8('.');
+    __m128i colon = _mm_set1_epi8(ipv6 ? ':' : '.');
+    __m128i block;
+    int mask;
 
-    struct sockaddr_in sa;
+    for ( ; p + 16 <= end; p += 16 ) {
 
-    snprintf(tmpmsg, sizeof(tmpmsg), "%s", syslogmessage);
+        block = _mm_loadu_si128((const __m128i *)p);
+        mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(block, dot), _mm_cmpeq_epi8(block, colon)));
 
-    ptmp = strtok_r(tmpmsg, " ", &tok);
+        if ( mask != 0 ) {
+            return( p + __builtin_ctz(mask) );
+        }
+    }
 
-    while (ptmp != NULL ) {
+#endif
 
-        if (Sagan_strstr(ptmp, ".")) {
+    for ( ; p < end; p++ ) {
+        if ( *p == '.' || ( ipv6 && *p == ':' ) ) {
+            return(p);
+        }
+    }
+
+    return(end);
+}
+
+/****************************************************************************
+ * IP_Dotted_Quad - Parses a dotted quad at p (inet_pton() rules,  so no
+ * leading zeros).  Returns its length,  or 0.
+ ****************************************************************************/
+
+static size_t IP_Dotted_Quad( const char *p, const char *end, uint32_t *u32 )
+{
 
-            result_space = inet_pton(AF_INET, ptmp,  &(sa.sin_addr));
+    const char *start = p;
+    uint32_t ip = 0;
+    unsigned int octet;
+    int digits;
+    int i;
 
-            /* If we already have a good IP,  return it.  We can sometimes skips
-             * the next steps */
+    for ( i = 0; i < 4; i++ ) {
+
+        if ( i > 0 ) {
+
+            if ( p >= end || *p != '.' ) {
+                return(0);
+            }
+
+            p++;
+        }
 
-            if ( result_space != 0 && strcmp(ptmp, "127.0.0.1")) {
+        octet = 0;
 
-                current_pos++;
+        for ( digits = 0; p < end && *p >= '0' && *p <= '9' && digits < 3; digits++, p++ ) {
 
-                if ( current_pos == pos ) {
-                    return(ptmp);
-                }
-            } else {
-                notfound = 1;
+            if ( digits == 1 && octet == 0 ) {
+                return(0);
             }
 
-            /* Start tearing apart the substring */
+            octet = octet * 10 + ( *p - '0' );
+        }
+
+        if ( digits == 0 || octet > 255 ) {
+            return(0);
+        }
+
+        ip = ( ip << 8 ) | octet;
+    }
+
+    /* "1.2.3.4567" isn't an address */
+
+    if ( p < end && *p >= '0' && *p <= '9' ) {
+        return(0);
+    }
+
+    *u32 = ip;
+    return( p - start );
+}
+
+/****************************************************************************
+ * IP_Run_IPv6 - Is the run (less any trailing "." or ":") an IPv6 address?
+ ****************************************************************************/
+
+static size_t IP_Run_IPv6( const char *run, size_t len, unsigned char *ipv6 )
+{
+
+    char buf[INET6_ADDRSTRLEN];
+    int colons = 0;
+    int hex = 0;
+    size_t i;
+
+    while ( len > 0 && run[len - 1] == '.' ) {
+        len--;
+    }
+
+    if ( len > 2 && run[len - 1] == ':' && run[len - 2] != ':' ) {
+        len--;
+    }
+
+    if ( len < 2 || len >= sizeof(buf) ) {
+        return(0);
+    }
+
+    for ( i = 0; i < len; i++ ) {
+        colons += run[i] == ':';
+        hex += run[i] != ':' && run[i] != '.';
+    }
+
+    if ( colons < 2 || hex == 0 ) {
+        return(0);
+    }
+
+    memcpy(buf, run, len);
+    buf[len] = '\0';
+
+    return( inet_pton(AF_INET6, buf, ipv6) == 1 ? len : 0 );
+}
+
+/****************************************************************************
+ * Sagan_Parse_IP_Scan - Finds up to "max" addresses in a message,  in the
+ * order they appear.  IPv6 addresses are only reported if "ipv6" is set.
+ ****************************************************************************/
 
-            if ( notfound == 1 ) {
+int Sagan_Parse_IP_Scan( const char *message, size_t len, struct _Sagan_IP *ips, int max, sbool ipv6 )
+{
 
-                for (b=0; b < strlen(ptmp); b++) {
-                    for (i = b; i < strlen(ptmp); i++) {
+    const char *end = message + len;
+    const char *done = message;		/* Everything before this has been looked at */
+    const char *sep;
+    const char *run;
+    const char *run_end;
+    const char *p;
 
-                        snprintf(ctmp, sizeof(ctmp), "%c", ptmp[i]);
-                        strlcat(msg, ctmp, sizeof(msg));
+    size_t found;
+    uint32_t u32;
+    int count = 0;
 
-                        result_nonspace = inet_pton(AF_INET, msg,  &(sa.sin_addr));
+    while ( count < max && ( sep = IP_Next_Separator(done, end, ipv6) ) < end ) {
 
-                        if ( result_nonspace != 0 ) {
-                            strlcpy(lastgood, msg, sizeof(lastgood));
-                            flag=1;
-                        }
+        /* Widen to the whole run of address characters around it */
 
-                        if ( flag == 1 && result_nonspace == 0 ) {
+        for ( run = sep; run > done && IP_Run_Char(run[-1]); run-- );
+        for ( run_end = sep; run_end < end && IP_Run_Char(*run_end); run_end++ );
 
-                            current_pos++;
+        done = run_end;
 
-                            if ( current_pos == pos ) {
-                                if (!strcmp(lastgood, "127.0.0.1")) {
-                                    return(config->sagan_host);
-                                }
+        if ( ipv6 && memchr(run, ':', run_end - run) != NULL ) {
 
-                                retbuf = (char*)&lastgood;
-                                return(retbuf);
-                            }
+            found = IP_Run_IPv6(run, run_end - run, ips[count].ipv6);
 
-                            flag = 0;
-                            i=i+strlen(lastgood);
-                            b=b+strlen(lastgood);
-                            break;
-                        }
-                    }
-                    strlcpy(msg, "", sizeof(msg));
-                }
+            if ( found != 0 ) {
+                ips[count].family = AF_INET6;
+                ips[count].offset = run - message;
+                ips[count].len = found;
+                ips[count].u32 = 0;
+                count++;
+                continue;
+            }
+        }
+
+        /* Dotted quads start on a digit that doesn't follow one */
+
+        for ( p = run; p < run_end && count < max; p++ ) {
+
+            if ( *p < '0' || *p > '9' || ( p > message && p[-1] >= '0' && p[-1] <= '9' ) ) {
+                continue;
+            }
+
+            found = IP_Dotted_Quad(p, run_end, &u32);
+
+            if ( found != 0 ) {
+                ips[count].family = AF_INET;
+                ips[count].offset = p - message;
+                ips[count].len = found;
+                ips[count].u32 = u32;
+                count++;
+                p += found - 1;
             }
-            notfound = 0;
         }
-        ptmp = strtok_r(NULL, " ", &tok);
     }
 
-    return("0");
+    return(count);
+}
+
+/****************************************************************************
+ * Sagan_Parse_IP_Format - An IPv4 address found by Sagan_Parse_IP_Scan()
+ * as a string.  127.0.0.1 is not useful,  so it becomes config->sagan_host.
+ ****************************************************************************/
+
+const char *Sagan_Parse_IP_Format( const struct _Sagan_IP *ip, char *buf, size_t size )
+{
+
+    if ( ip->u32 == IP_LOOPBACK ) {
+        return(config->sagan_host);
+    }
+
+    snprintf(buf, size, "%u.%u.%u.%u", ip->u32 >> 24, ( ip->u32 >> 16 ) & 0xff, ( ip->u32 >> 8 ) & 0xff, ip->u32 & 0xff);
+
+    return(buf);
 }
 
+/****************************************************************************
+ * Sagan_Parse_IP - The "pos"'th IPv4 address in the message,  or "0"
+ ****************************************************************************/
+
+char *Sagan_Parse_IP( char *syslogmessage, int pos )
+{
+
+    static __thread char ret[MAXIP];
+
+    struct _Sagan_IP found[MAX_PARSE_IP];
+    struct _Sagan_IP *ips = found;
+
+    const char *ip = "0";
+    int count;
+
+    if ( pos < 1 ) {
+        return("0");
+    }
+
+    if ( pos > MAX_PARSE_IP ) {
+
+        ips = malloc(pos * sizeof(struct _Sagan_IP));
+
+        if ( ips == NULL ) {
+            Sagan_Log(S_ERROR, "[%s, line %d] Failed to allocate memory for parse_ip. Abort!", __FILE__, __LINE__);
+        }
+    }
+
+    count = Sagan_Parse_IP_Scan(syslogmessage, strlen(syslogmessage), ips, pos, false);
+
+    if ( count == pos ) {
+        ip = Sagan_Parse_IP_Format(&ips[pos - 1], ret, sizeof(ret));
+    }
+
+    if ( ip != ret ) {
+        strlcpy(ret, ip, sizeof(ret));
+    }
+
+    if ( ips != found ) {
+        free(ips);
+    }
+
+    return(ret);
+}
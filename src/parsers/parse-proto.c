@@ -56,7 +56,7 @@ int Sagan_Parse_Proto( char *msg )
     for (i = 0; i < counters->mapcount_message; i++) {
 
         if ( map_message[i].nocase == 1 ) {
-            if (Sagan_stristr(msg, map_message[i].search, true)) {
+            if (Sagan_stristr(msg, map_message[i].search, false)) {
                 return(map_message[i].proto);
             }
         } else {
@@ -81,7 +81,7 @@ int Sagan_Parse_Proto_Program( char *program )
     for (i = 0; i < counters->mapcount_program; i++) {
 
         if ( map_program[i].nocase == 1 ) {
-            if (Sagan_stristr(program, map_program[i].program, true)) {
+            if (Sagan_stristr(program, map_program[i].program, false)) {
                 return(map_program[i].proto);
             }
         } else {
@@ -0,0 +1,271 @@
+/*
+** Copyright (C) 2009-2017 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2017 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* parse-syslog.c
+ *
+ * Parses a raw RFC3164 ("BSD") or RFC5424 syslog message,  as received by
+ * the native UDP/TCP inputs,  into the same fields rsyslog would normally
+ * write to the Sagan FIFO with the "sagan" template.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <stdbool.h>
+
+#include "sagan.h"
+#include "sagan-defs.h"
+#include "sagan-message.h"
+#include "parsers/parsers.h"
+
+/* Names match rsyslog's %syslogfacility-text% and %syslogseverity-text% */
+
+static const char *syslog_facility_names[24] = {
+    "kern", "user", "mail", "daemon", "auth", "syslog", "lpr", "news",
+    "uucp", "cron", "authpriv", "ftp", "ntp", "audit", "alert", "clock",
+    "local0", "local1", "local2", "local3", "local4", "local5", "local6", "local7"
+};
+
+static const char *syslog_severity_names[8] = {
+    "emerg", "alert", "crit", "err", "warning", "notice", "info", "debug"
+};
+
+/****************************************************************************
+ * Sagan_Parse_Syslog_Token - Copy the next space delimited token into "dst"
+ * and return a pointer past it (and the following space).
+ ****************************************************************************/
+
+static char *Sagan_Parse_Syslog_Token( char *p, char *end, char *dst, size_t size )
+{
+
+    size_t i = 0;
+
+    while ( p < end && *p != ' ' ) {
+
+        if ( i < size - 1 ) {
+            dst[i++] = *p;
+        }
+
+        p++;
+    }
+
+    dst[i] = '\0';
+
+    if ( p < end ) {
+        p++;
+    }
+
+    return(p);
+}
+
+/****************************************************************************
+ * Sagan_Parse_Syslog - The message buffer holds one syslog message of "len"
+ * bytes received from "host".  The caller supplies the receive date/time
+ * (%Y-%m-%d and %H:%M:%S) since those are normally cached per batch.  The
+ * message is left in place and the fields that aren't part of it are
+ * appended to the buffer.
+ ****************************************************************************/
+
+void Sagan_Parse_Syslog( struct _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, size_t len, const char *host, const char *date, const char *time )
+{
+
+    char *p = SaganProcSyslog_LOCAL->buf;
+    char *end = p + len;
+    char *tag_start = NULL;
+
+    char appname[50] = { 0 };
+    char procid[50] = { 0 };
+    char tmp[50] = { 0 };
+
+    int pri = 13;		/* RFC3164 4.3.3 - user.notice if no PRI */
+    size_t i = 0;
+    size_t field_len = 0;
+
+    /* Trailing newline,  CR and NULL padding some senders add */
+
+    while ( end > p && ( end[-1] == '\n' || end[-1] == '\r' || end[-1] == '\0' ) ) {
+        end--;
+    }
+
+    /* <PRI> */
+
+    if ( p < end && *p == '<' ) {
+
+        for ( i = 1; i <= 4 && p + i < end && isdigit((unsigned char)p[i]); i++ );
+
+        if ( i > 1 && p + i < end && p[i] == '>' ) {
+
+            pri = atoi(p + 1);
+
+            if ( pri > 191 ) {
+                pri = 13;
+            }
+
+            p = p + i + 1;
+        }
+    }
+
+    /* Anything appended goes after the received message */
+
+    SaganProcSyslog_LOCAL->buf_len = len + 1;
+
+    SaganProcSyslog_LOCAL->syslog_host = Sagan_Message_Append(SaganProcSyslog_LOCAL, host, strlen(host));
+    SaganProcSyslog_LOCAL->syslog_facility = (char *)syslog_facility_names[pri >> 3];
+    SaganProcSyslog_LOCAL->syslog_priority = (char *)syslog_severity_names[pri & 7];
+    SaganProcSyslog_LOCAL->syslog_level = (char *)syslog_severity_names[pri & 7];
+    SaganProcSyslog_LOCAL->syslog_date = Sagan_Message_Append(SaganProcSyslog_LOCAL, date, strlen(date));
+    SaganProcSyslog_LOCAL->syslog_time = Sagan_Message_Append(SaganProcSyslog_LOCAL, time, strlen(time));
+
+    SaganProcSyslog_LOCAL->syslog_tag = "";
+    SaganProcSyslog_LOCAL->syslog_program = "";
+    SaganProcSyslog_LOCAL->syslog_raw = false;
+
+    if ( end - p >= 2 && p[0] == '1' && p[1] == ' ' ) {
+
+        /* RFC5424: VERSION SP TIMESTAMP SP HOSTNAME SP APP-NAME SP PROCID SP MSGID SP SD [SP MSG] */
+
+        p += 2;
+        p = Sagan_Parse_Syslog_Token(p, end, tmp, sizeof(tmp));		/* TIMESTAMP */
+        p = Sagan_Parse_Syslog_Token(p, end, tmp, sizeof(tmp));		/* HOSTNAME */
+        p = Sagan_Parse_Syslog_Token(p, end, appname, sizeof(appname));
+        p = Sagan_Parse_Syslog_Token(p, end, procid, sizeof(procid));
+        p = Sagan_Parse_Syslog_Token(p, end, tmp, sizeof(tmp));		/* MSGID */
+
+        /* STRUCTURED-DATA is either "-" or one or more [...] elements.
+         * "]" can be escaped inside PARAM-VALUE */
+
+        if ( p < end && *p == '-' ) {
+
+            p++;
+
+        } else {
+
+            while ( p < end && *p == '[' ) {
+
+                p++;
+
+                while ( p < end && *p != ']' ) {
+
+                    if ( *p == '\\' && p + 1 < end ) {
+                        p++;
+                    }
+
+                    p++;
+                }
+
+                if ( p < end ) {
+                    p++;
+                }
+            }
+        }
+
+        if ( p < end && *p == ' ' ) {
+            p++;
+        }
+
+        /* UTF-8 BOM */
+
+        if ( end - p >= 3 && (unsigned char)p[0] == 0xEF && (unsigned char)p[1] == 0xBB && (unsigned char)p[2] == 0xBF ) {
+            p += 3;
+        }
+
+        if ( strcmp(appname, "-") ) {
+
+            SaganProcSyslog_LOCAL->syslog_program = Sagan_Message_Append(SaganProcSyslog_LOCAL, appname, strlen(appname));
+
+            if ( strcmp(procid, "-") ) {
+                snprintf(tmp, sizeof(tmp), "%s[%s]:", appname, procid);
+            } else {
+                snprintf(tmp, sizeof(tmp), "%s:", appname);
+            }
+
+            SaganProcSyslog_LOCAL->syslog_tag = Sagan_Message_Append(SaganProcSyslog_LOCAL, tmp, strlen(tmp));
+        }
+
+    } else {
+
+        /* RFC3164: TIMESTAMP ("Mmm dd hh:mm:ss") SP HOSTNAME SP TAG MSG.
+         * Many senders leave out the timestamp and hostname,  so we only
+         * skip the hostname if a timestamp was present */
+
+        if ( end - p >= 16 && p[3] == ' ' && p[6] == ' ' && p[9] == ':' && p[12] == ':' && p[15] == ' ' ) {
+
+            p += 16;
+
+            for ( i = 0; p + i < end && p[i] != ' '; i++ ) {
+                if ( p[i] == ':' || p[i] == '[' ) {
+                    break;
+                }
+            }
+
+            if ( p + i < end && p[i] == ' ' ) {
+                p = p + i + 1;
+            }
+        }
+
+        /* TAG - normally "program[pid]:".  The program name ends at the
+         * first '[', ':' or space */
+
+        tag_start = p;
+
+        for ( i = 0; p + i < end && p[i] != ' ' && p[i] != ':' && p[i] != '['; i++ );
+
+        field_len = i < sizeof(tmp) - 1 ? i : sizeof(tmp) - 1;
+        SaganProcSyslog_LOCAL->syslog_program = Sagan_Message_Append(SaganProcSyslog_LOCAL, tag_start, field_len);
+
+        p += i;
+
+        if ( p < end && *p == '[' ) {
+
+            while ( p < end && *p != ']' && *p != ' ' ) {
+                p++;
+            }
+
+            if ( p < end && *p == ']' ) {
+                p++;
+            }
+        }
+
+        if ( p < end && *p == ':' ) {
+            p++;
+        }
+
+        field_len = p - tag_start < sizeof(tmp) - 1 ? p - tag_start : sizeof(tmp) - 1;
+        SaganProcSyslog_LOCAL->syslog_tag = Sagan_Message_Append(SaganProcSyslog_LOCAL, tag_start, field_len);
+
+        if ( p < end && *p == ' ' ) {
+            p++;
+        }
+    }
+
+    /* The message is a view of what's left */
+
+    *end = '\0';
+
+    SaganProcSyslog_LOCAL->syslog_message = p;
+    SaganProcSyslog_LOCAL->syslog_message_len = end - p;
+
+}
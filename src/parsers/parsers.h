@@ -24,6 +24,19 @@
 
 #include "parsers/sagan-strstr/sagan-strstr-hook.h"
 
+/* An address found by Sagan_Parse_IP_Scan() */
+
+typedef struct _Sagan_IP _Sagan_IP;
+struct _Sagan_IP {
+    int family;				/* AF_INET or AF_INET6 */
+    size_t offset;			/* Where it is in the message */
+    size_t len;
+    uint32_t u32;			/* IPv4,  host order */
+    unsigned char ipv6[16];
+};
+
+int   Sagan_Parse_IP_Scan( const char *, size_t, struct _Sagan_IP *, int, sbool );
+const char *Sagan_Parse_IP_Format( const struct _Sagan_IP *, char *, size_t );
 char *Sagan_Parse_IP( char *, int );
 int   Sagan_Parse_Src_Port( char * );
 int   Sagan_Parse_Dst_Port( char * );
@@ -31,6 +44,16 @@ int   Sagan_Parse_Proto( char * );
 int   Sagan_Parse_Proto_Program( char * );
 char *Sagan_Parse_Hash(char *, int );
 char *Sagan_Parse_Hash_Cleanup(char *);
+void  Sagan_Parse_Syslog( struct _Sagan_Proc_Syslog *, size_t, const char *, const char *, const char * );
+
+void        Sagan_Features_Reset( void );
+const char *Sagan_Features_IP( char *, int );
+int         Sagan_Features_IPs( char *, const char (**)[MAXIP], const uint32_t ** );
+int         Sagan_Features_Src_Port( char * );
+int         Sagan_Features_Dst_Port( char * );
+int         Sagan_Features_Proto( char * );
+int         Sagan_Features_Proto_Program( char * );
+const char *Sagan_Features_Hash( char *, int );
 
 
 
@@ -35,24 +35,104 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <ctype.h>
 
 #include "sagan.h"
 #include "sagan-defs.h"
 #include "sagan-strstr-hook.h"
+#include "sagan-strstr-simd.h"
 
 
 
+#if defined(HAVE_SSE2) && defined(__x86_64__)
+#define FOLD_SSE2
+#include <emmintrin.h>
+#endif
+
+/* Lowercase copy of the message the calling thread is working on.  See
+ * Sagan_Fold_Set() */
+
+static __thread char fold_buf[MAX_SYSLOGMSG];
+static __thread const char *fold_src = NULL;
+static __thread size_t fold_len = 0;
+
+#ifdef FOLD_SSE2
+
+/* 'A' - 'Z' to lowercase,  16 bytes at a time.  Bytes over 0x7f are
+ * negative as signed chars,  so are left alone like tolower() in the "C"
+ * locale. */
+
+static inline __m128i Sagan_Fold_16( __m128i x )
+{
+    __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(x, _mm_set1_epi8('A' - 1)),
+                                  _mm_cmplt_epi8(x, _mm_set1_epi8('Z' + 1)));
+
+    return ( _mm_or_si128(x, _mm_and_si128(upper, _mm_set1_epi8(0x20))) );
+}
+
+#endif
+
+/****************************************************************************
+ * Sagan_Fold_Set - Lowercases a message once into a per thread buffer.
+ * Sagan_stristr() calls on the message (or any part of it) then search the
+ * copy rather than folding the message again.  Returns the copy.
+ ****************************************************************************/
+
+const char *Sagan_Fold_Set( const char *message, size_t len )
+{
+
+    size_t i = 0;
+
+    if ( len > sizeof(fold_buf) - 1 ) {
+        len = sizeof(fold_buf) - 1;
+    }
+
+#ifdef FOLD_SSE2
+
+    for ( ; i + 16 <= len; i += 16 ) {
+        _mm_storeu_si128((__m128i *)(fold_buf + i), Sagan_Fold_16(_mm_loadu_si128((const __m128i *)(message + i))));
+    }
+
+#endif
+
+    for ( ; i < len; i++ ) {
+        fold_buf[i] = tolower((unsigned char)message[i]);
+    }
+
+    fold_buf[len] = '\0';
+
+    fold_src = message;
+    fold_len = len;
+
+    return(fold_buf);
+}
+
+/* Done with the message,  it's buffer will be reused */
+
+void Sagan_Fold_Clear( void )
+{
+    fold_src = NULL;
+    fold_len = 0;
+}
+
 #ifndef WITH_SYSSTRSTR 		/* If NOT using system built in strstr */
 
 #if defined(HAVE_SSE2) && SIZEOF_SIZE_T == 8  	/* And our CPU supports SSE2 & is the CPU 64 bit */
 
-/* This function takes advantage of CPUs with SSE2 */
+/* This function takes advantage of CPUs with SSE2.  If Sagan_Find_Init()
+ * found AVX2 or better,  the wider length based kernel is used instead. */
 
 char *Sagan_strstr(const char *_x,const char *_y)
 {
     char *x= (char*) _x, *y=(char*)_y;
     char* (*fn)(char *,char *) = function_func[0];
-    char * p=fn(x,y);
+    char * p;
+
+    if ( Sagan_Find_Wide() ) {
+        return (Sagan_memmem(_x, strlen(_x), _y, strlen(_y)));
+    }
+
+    p=fn(x,y);
     return p;
 }
 
@@ -85,27 +165,35 @@ char *Sagan_strstr(const char *_x, const char *_y)
  *
  * 0/FALSE == Don't convert needle
  * 1/TRUE  == Convert needle
+ *
+ * If the haystack is part of the message set with Sagan_Fold_Set(),  the
+ * lowercase copy made there is searched.  Otherwise the haystack is
+ * folded as it is searched.  Either way the haystack is not copied and the
+ * pointer returned is into the haystack.
  */
 
 char *Sagan_stristr(const char *_x, const char *_y, sbool needle_lower )
 {
 
-    char *p = NULL;
-    char haystack_string[MAX_SYSLOGMSG] = { 0 };
     char needle_string[512] = { 0 };
-
-    strlcpy(haystack_string, _x, sizeof(haystack_string));
-    To_LowerC(haystack_string);
-
-    strlcpy(needle_string, _y, sizeof(needle_string));
+    const char *folded = NULL;
+    char *p = NULL;
 
     if ( needle_lower ) {
+        strlcpy(needle_string, _y, sizeof(needle_string));
         To_LowerC(needle_string);
+        _y = needle_string;
     }
 
-    p = Sagan_strstr( haystack_string, needle_string);
+    if ( fold_src != NULL && _x >= fold_src && _x <= fold_src + fold_len ) {
 
-    return p;
+        folded = fold_buf + ( _x - fold_src );
+        p = Sagan_strstr(folded, _y);
+
+        return ( p == NULL ? NULL : (char *)_x + ( p - folded ) );
+    }
+
+    return ( Sagan_memimem(_x, strlen(_x), _y, strlen(_y)) );
 
 }
 
@@ -125,3 +213,101 @@ char *Sagan_stristr(const char *_x, const char *_y, sbool needle_lower )
     return (strcasestr(_x, _y));
 }
 #endif
+
+/****************************************************************************
+ * Bounded searches.  These look in a (pointer, length) window of a string
+ * rather than up to the '\0',  and return a pointer into the haystack.
+ ****************************************************************************/
+
+char *Sagan_memmem(const char *_x, size_t x_len, const char *_y, size_t y_len)
+{
+
+    _Sagan_Needle needle;
+
+    Sagan_Needle_Compile(&needle, _y, y_len);
+
+    return (Sagan_Find(_x, x_len, _y, &needle));
+}
+
+/* The needle (_y) must already be lowercase.  The haystack is folded as
+ * it is searched.  With SSE2 the first and last bytes of the needle are
+ * checked for 16 positions at once,  and only those positions are compared
+ * in full. */
+
+char *Sagan_memimem(const char *_x, size_t x_len, const char *_y, size_t y_len)
+{
+
+    const unsigned char *x = (const unsigned char *)_x;
+    const unsigned char *y = (const unsigned char *)_y;
+    const unsigned char *end;
+
+    unsigned char first;
+    unsigned char first_upper;
+    size_t i;
+
+#ifdef FOLD_SSE2
+    __m128i first_v;
+    __m128i last_v;
+    __m128i block_first;
+    __m128i block_last;
+    unsigned int mask;
+    size_t bit;
+#endif
+
+    if ( y_len == 0 ) {
+        return (char *)_x;
+    }
+
+    if ( y_len > x_len ) {
+        return NULL;
+    }
+
+    end = x + x_len - y_len;
+
+#ifdef FOLD_SSE2
+
+    first_v = _mm_set1_epi8(y[0]);
+    last_v = _mm_set1_epi8(y[y_len - 1]);
+
+    for ( ; x + 16 <= end + 1; x += 16 ) {
+
+        block_first = Sagan_Fold_16(_mm_loadu_si128((const __m128i *)x));
+        block_last = Sagan_Fold_16(_mm_loadu_si128((const __m128i *)(x + y_len - 1)));
+
+        mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(block_first, first_v),
+                                               _mm_cmpeq_epi8(block_last, last_v)));
+
+        while ( mask != 0 ) {
+
+            bit = __builtin_ctz(mask);
+
+            for ( i = 1; i < y_len - 1 && tolower(x[bit + i]) == y[i]; i++ );
+
+            if ( i >= y_len - 1 ) {
+                return (char *)(x + bit);
+            }
+
+            mask &= mask - 1;
+        }
+    }
+
+#endif
+
+    first = y[0];
+    first_upper = toupper(first);
+
+    for ( ; x <= end; x++ ) {
+
+        if ( *x != first && *x != first_upper ) {
+            continue;
+        }
+
+        for ( i = 1; i < y_len && tolower(x[i]) == y[i]; i++ );
+
+        if ( i == y_len ) {
+            return (char *)x;
+        }
+    }
+
+    return NULL;
+}
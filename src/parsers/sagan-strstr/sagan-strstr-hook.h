@@ -45,4 +45,8 @@ static void* function_func[]= {  __strstr_sse2_unaligned, __strstr_sse42, NULL};
 
 char *Sagan_strstr(const char *, const char *);
 char *Sagan_stristr(const char *, const char *, sbool);
+char *Sagan_memmem(const char *, size_t, const char *, size_t);
+char *Sagan_memimem(const char *, size_t, const char *, size_t);
+const char *Sagan_Fold_Set(const char *, size_t);
+void Sagan_Fold_Clear(void);
 
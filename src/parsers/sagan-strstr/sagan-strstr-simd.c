@@ -0,0 +1,354 @@
+/*
+** Copyright (C) 2009-2017 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2017 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* sagan-strstr-simd.c
+ *
+ * Substring search over a haystack of known length.  The vector kernels
+ * compare two bytes of the needle (see _Sagan_Needle) against 16,  32 or
+ * 64 haystack positions at once and only compare the full needle where
+ * both bytes line up.  The kernel is picked at start up by
+ * Sagan_Find_Init() from what the CPU supports.
+ *
+ * This file only depends on its own header so that tools/ can build the
+ * benchmark without the rest of Sagan.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdint.h>
+#include <string.h>
+
+#include "sagan-strstr-simd.h"
+
+#if defined(HAVE_SSE2) && defined(__x86_64__)
+#define FIND_SSE2
+#include <emmintrin.h>
+#if defined(__GNUC__) && __GNUC__ >= 5
+#define FIND_AVX2
+#include <immintrin.h>
+#endif
+#if defined(__GNUC__) && __GNUC__ >= 6
+#define FIND_AVX512
+#endif
+#endif
+
+/*****************************************************************************
+ * Sagan_Needle_Compile - Fills in the needle's length and probe bytes
+ *****************************************************************************/
+
+void Sagan_Needle_Compile( _Sagan_Needle *needle, const char *s, size_t len )
+{
+
+    size_t i;
+
+    needle->len = len;
+    needle->first = 0;
+    needle->last = len > 0 ? len - 1 : 0;
+
+    for ( i = needle->last; i > 0; i-- ) {
+        if ( s[i] != s[0] ) {
+            needle->last = i;
+            break;
+        }
+    }
+}
+
+/*****************************************************************************
+ * Find_Scalar - memchr() for the first byte,  then the rest
+ *****************************************************************************/
+
+static char *Find_Scalar( const char *x, size_t x_len, const char *y, const _Sagan_Needle *needle )
+{
+
+    const char *end;
+    const char *p = x;
+
+    if ( needle->len == 0 ) {
+        return((char *)x);
+    }
+
+    if ( needle->len > x_len ) {
+        return(NULL);
+    }
+
+    end = x + x_len - needle->len;
+
+    while ( p <= end && ( p = memchr(p, y[0], end - p + 1) ) != NULL ) {
+
+        if ( !memcmp(p + 1, y + 1, needle->len - 1) ) {
+            return((char *)p);
+        }
+
+        p++;
+    }
+
+    return(NULL);
+}
+
+#ifdef FIND_SSE2
+
+static char *Find_SSE2( const char *x, size_t x_len, const char *y, const _Sagan_Needle *needle )
+{
+
+    const __m128i first = _mm_set1_epi8(y[needle->first]);
+    const __m128i last = _mm_set1_epi8(y[needle->last]);
+
+    __m128i block_first;
+    __m128i block_last;
+    uint32_t mask;
+    size_t bit;
+    size_t i = 0;
+
+    if ( needle->len == 0 ) {
+        return((char *)x);
+    }
+
+    if ( needle->len > x_len ) {
+        return(NULL);
+    }
+
+    for ( ; i + 16 <= x_len - needle->len + 1; i += 16 ) {
+
+        block_first = _mm_loadu_si128((const __m128i *)(x + i + needle->first));
+        block_last = _mm_loadu_si128((const __m128i *)(x + i + needle->last));
+
+        mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(block_first, first), _mm_cmpeq_epi8(block_last, last)));
+
+        while ( mask != 0 ) {
+
+            bit = __builtin_ctz(mask);
+
+            if ( !memcmp(x + i + bit, y, needle->len) ) {
+                return((char *)(x + i + bit));
+            }
+
+            mask &= mask - 1;
+        }
+    }
+
+    return(Find_Scalar(x + i, x_len - i, y, needle));
+}
+
+#endif
+
+#ifdef FIND_AVX2
+
+__attribute__((target("avx2")))
+static char *Find_AVX2( const char *x, size_t x_len, const char *y, const _Sagan_Needle *needle )
+{
+
+    const __m256i first = _mm256_set1_epi8(y[needle->first]);
+    const __m256i last = _mm256_set1_epi8(y[needle->last]);
+
+    __m256i block_first;
+    __m256i block_last;
+    uint32_t mask;
+    size_t bit;
+    size_t i = 0;
+
+    if ( needle->len == 0 ) {
+        return((char *)x);
+    }
+
+    if ( needle->len > x_len ) {
+        return(NULL);
+    }
+
+    for ( ; i + 32 <= x_len - needle->len + 1; i += 32 ) {
+
+        block_first = _mm256_loadu_si256((const __m256i *)(x + i + needle->first));
+        block_last = _mm256_loadu_si256((const __m256i *)(x + i + needle->last));
+
+        mask = (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(block_first, first), _mm256_cmpeq_epi8(block_last, last)));
+
+        while ( mask != 0 ) {
+
+            bit = __builtin_ctz(mask);
+
+            if ( !memcmp(x + i + bit, y, needle->len) ) {
+                return((char *)(x + i + bit));
+            }
+
+            mask &= mask - 1;
+        }
+    }
+
+    return(Find_SSE2(x + i, x_len - i, y, needle));
+}
+
+#endif
+
+#ifdef FIND_AVX512
+
+__attribute__((target("avx512f,avx512bw")))
+static char *Find_AVX512( const char *x, size_t x_len, const char *y, const _Sagan_Needle *needle )
+{
+
+    const __m512i first = _mm512_set1_epi8(y[needle->first]);
+    const __m512i last = _mm512_set1_epi8(y[needle->last]);
+
+    uint64_t mask;
+    size_t bit;
+    size_t i = 0;
+
+    if ( needle->len == 0 ) {
+        return((char *)x);
+    }
+
+    if ( needle->len > x_len ) {
+        return(NULL);
+    }
+
+    for ( ; i + 64 <= x_len - needle->len + 1; i += 64 ) {
+
+        mask = _mm512_cmpeq_epi8_mask(_mm512_loadu_si512((const void *)(x + i + needle->first)), first) &
+               _mm512_cmpeq_epi8_mask(_mm512_loadu_si512((const void *)(x + i + needle->last)), last);
+
+        while ( mask != 0 ) {
+
+            bit = __builtin_ctzll(mask);
+
+            if ( !memcmp(x + i + bit, y, needle->len) ) {
+                return((char *)(x + i + bit));
+            }
+
+            mask &= mask - 1;
+        }
+    }
+
+    return(Find_AVX2(x + i, x_len - i, y, needle));
+}
+
+#endif
+
+static const _Sagan_Find_Kernel Find_Kernels[] = {
+    { "scalar", Find_Scalar },
+#ifdef FIND_SSE2
+    { "SSE2", Find_SSE2 },
+#endif
+#ifdef FIND_AVX2
+    { "AVX2", Find_AVX2 },
+#endif
+#ifdef FIND_AVX512
+    { "AVX-512", Find_AVX512 },
+#endif
+};
+
+#ifdef FIND_SSE2
+static _Sagan_Find_Func Find_Func = Find_SSE2;
+#else
+static _Sagan_Find_Func Find_Func = Find_Scalar;
+#endif
+
+static int Find_Wide = 0;
+
+/*****************************************************************************
+ * Sagan_Find_Init - Picks the widest kernel this CPU supports.  Called once
+ * at start up,  before any processor threads exist.  Returns the name of
+ * the kernel in use.
+ *****************************************************************************/
+
+const char *Sagan_Find_Init( void )
+{
+
+#ifdef FIND_AVX2
+
+    __builtin_cpu_init();
+
+#ifdef FIND_AVX512
+
+    if ( __builtin_cpu_supports("avx512bw") ) {
+        Find_Func = Find_AVX512;
+        Find_Wide = 1;
+        return("AVX-512");
+    }
+
+#endif
+
+    if ( __builtin_cpu_supports("avx2") ) {
+        Find_Func = Find_AVX2;
+        Find_Wide = 1;
+        return("AVX2");
+    }
+
+#endif
+
+#ifdef FIND_SSE2
+    return("SSE2");
+#else
+    return("scalar");
+#endif
+
+}
+
+/* Is an AVX2 or wider kernel in use? */
+
+int Sagan_Find_Wide( void )
+{
+    return(Find_Wide);
+}
+
+/*****************************************************************************
+ * Sagan_Find - Finds a compiled needle in "x_len" bytes of "x".  Returns
+ * a pointer into "x" or NULL.
+ *****************************************************************************/
+
+char *Sagan_Find( const char *x, size_t x_len, const char *y, const _Sagan_Needle *needle )
+{
+    return(Find_Func(x, x_len, y, needle));
+}
+
+/*****************************************************************************
+ * Sagan_Find_Kernels - The kernels this CPU can run.  For benchmarking.
+ *****************************************************************************/
+
+const _Sagan_Find_Kernel *Sagan_Find_Kernels( int *count )
+{
+
+    int i;
+
+    *count = 0;
+
+#ifdef FIND_AVX2
+    __builtin_cpu_init();
+#endif
+
+    for ( i = 0; i < (int)( sizeof(Find_Kernels) / sizeof(Find_Kernels[0]) ); i++ ) {
+
+#ifdef FIND_AVX2
+        if ( !strcmp(Find_Kernels[i].name, "AVX2") && !__builtin_cpu_supports("avx2") ) {
+            break;
+        }
+#endif
+
+#ifdef FIND_AVX512
+        if ( !strcmp(Find_Kernels[i].name, "AVX-512") && !__builtin_cpu_supports("avx512bw") ) {
+            break;
+        }
+#endif
+
+        (*count)++;
+    }
+
+    return(Find_Kernels);
+}
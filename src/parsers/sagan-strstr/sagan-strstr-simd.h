@@ -0,0 +1,56 @@
+/*
+** Copyright (C) 2009-2017 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2017 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* sagan-strstr-simd.h
+ *
+ * Length bounded substring search kernels with run time CPU dispatch
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stddef.h>
+
+/* Worked out once per needle (i.e. at rule load).  "first" and "last" are
+ * the two needle bytes the vector kernels test at every position.  They
+ * are picked to differ where possible,  so "aaab" isn't tested as a/a. */
+
+typedef struct _Sagan_Needle _Sagan_Needle;
+struct _Sagan_Needle {
+    size_t len;
+    size_t first;
+    size_t last;
+};
+
+typedef char *(*_Sagan_Find_Func)( const char *, size_t, const char *, const _Sagan_Needle * );
+
+typedef struct _Sagan_Find_Kernel _Sagan_Find_Kernel;
+struct _Sagan_Find_Kernel {
+    const char *name;
+    _Sagan_Find_Func find;
+};
+
+void Sagan_Needle_Compile( _Sagan_Needle *, const char *, size_t );
+const char *Sagan_Find_Init( void );
+int Sagan_Find_Wide( void );
+char *Sagan_Find( const char *, size_t, const char *, const _Sagan_Needle * );
+const _Sagan_Find_Kernel *Sagan_Find_Kernels( int * );
@@ -42,6 +42,7 @@
 #include "sagan-defs.h"
 #include "sagan-blacklist.h"
 #include "sagan-config.h"
+#include "sagan-counters.h"
 
 #include "parsers/parsers.h"
 
@@ -225,16 +226,14 @@ sbool Sagan_Blacklist_IPADDR ( uint32_t u32_ipaddr )
 
     int i;
 
-    counters->blacklist_lookup_count++;
+    Sagan_Thread_Counters()->blacklist_lookup_count++;
 
 
     for ( i = 0; i < counters->blacklist_count; i++) {
 
         if ( ( u32_ipaddr > SaganBlacklist[i].u32_lower && u32_ipaddr < SaganBlacklist[i].u32_higher ) || ( u32_ipaddr == SaganBlacklist[i].u32_lower ) ) {
 
-            pthread_mutex_lock(&SaganProcBlacklistWorkMutex);
-            counters->blacklist_hit_count++;
-            pthread_mutex_unlock(&SaganProcBlacklistWorkMutex);
+            Sagan_Thread_Counters()->blacklist_hit_count++;
 
             return(true);
         }
@@ -254,33 +253,26 @@ sbool Sagan_Blacklist_IPADDR_All ( char *syslog_message )
 
     int i;
     int b;
+    int count;
 
     uint32_t ip;
 
-    char *results = NULL;
+    const uint32_t *ip_u32 = NULL;
 
-    for (i = 1; i < MAX_PARSE_IP; i++) {
+    count = Sagan_Features_IPs(syslog_message, NULL, &ip_u32);
 
-        results = Sagan_Parse_IP(syslog_message, i);
+    for (i = 0; i < count; i++) {
 
-        /* Failed to find next IP,  short circuit the process */
+        ip = ip_u32[i];
 
-        if (!strcmp(results, "0")) {
-            return(false);
-        }
-
-        ip = IP2Bit(results);
-
-        counters->blacklist_lookup_count++;
+        Sagan_Thread_Counters()->blacklist_lookup_count++;
 
         for ( b = 0; b < counters->blacklist_count; b++ ) {
             if ( ( ip > SaganBlacklist[b].u32_lower && ip < SaganBlacklist[b].u32_higher ) || ( ip == SaganBlacklist[b].u32_lower ) )
 
             {
 
-                pthread_mutex_lock(&SaganProcBlacklistWorkMutex);
-                counters->blacklist_hit_count++;
-                pthread_mutex_unlock(&SaganProcBlacklistWorkMutex);
+                Sagan_Thread_Counters()->blacklist_hit_count++;
 
                 return(true);
             }
@@ -47,6 +47,8 @@
 #include "sagan-config.h"
 #include "sagan-rules.h"
 #include "sagan-bluedot.h"
+#include "sagan-counters.h"
+#include "sagan-clock.h"
 
 #include "parsers/parsers.h"
 
@@ -90,14 +92,10 @@ int bluedot_filename_queue=0;
 void Sagan_Bluedot_Init(void)
 {
 
-    char  timet[20] = { 0 };
+    uint64_t utime = 0;
 
-    time_t t;
-    struct tm *now = NULL;
 
-    t = time(NULL);
-    now=localtime(&t);
-    strftime(timet, sizeof(timet), "%s",  now);
+    utime = Sagan_Clock_Now();
 
     /* Bluedot IP Cache */
 
@@ -189,7 +187,7 @@ void Sagan_Bluedot_Init(void)
         Sagan_Log(S_ERROR, "[%s, line %d] Failed to allocate memory for SaganBluedotFilenameQueue. Abort!", __FILE__, __LINE__);
     }
 
-    config->bluedot_last_time = atol(timet);
+    config->bluedot_last_time = utime;
 
 }
 
@@ -486,16 +484,12 @@ void Sagan_Bluedot_Check_Cache_Time (void)
 {
 
 
-    time_t t;
-    struct tm *now = NULL;
 
-    char  timet[20] = { 0 };
+    uint64_t utime = 0;
 
-    t = time(NULL);
-    now=localtime(&t);
-    strftime(timet, sizeof(timet), "%s",  now);
+    utime = Sagan_Clock_Now();
 
-    if (atol(timet) > config->bluedot_last_time + config->bluedot_timeout) {
+    if (utime > config->bluedot_last_time + config->bluedot_timeout) {
         Sagan_Log(S_NORMAL, "Bluedot cache timeout reached %d minutes.  Cleaning up.", config->bluedot_timeout / 60);
         if ( bluedot_cache_clean_lock == 0 ) {
             Sagan_Bluedot_Clean_Cache();
@@ -520,13 +514,9 @@ void Sagan_Bluedot_Clean_Cache ( void )
     int timeout_count=0;
     int deleted_count=0;
 
-    char  timet[20] = { 0 };
-    time_t t;
-    struct tm *now=NULL;
+    uint64_t utime = 0;
 
-    t = time(NULL);
-    now=localtime(&t);
-    strftime(timet, sizeof(timet), "%s",  now);
+    utime = Sagan_Clock_Now();
 
     struct _Sagan_Bluedot_IP_Cache *TmpSaganBluedotIPCache = NULL;
     struct _Sagan_Bluedot_Hash_Cache *TmpSaganBluedotHashCache = NULL;
@@ -542,11 +532,11 @@ void Sagan_Bluedot_Clean_Cache ( void )
             Sagan_Log(S_DEBUG, "[%s, line %d] ----------------------------------------------------------------------", __FILE__, __LINE__);
         }
 
-        config->bluedot_last_time = atol(timet);
+        config->bluedot_last_time = utime;
 
         for (i=0; i<counters->bluedot_ip_cache_count; i++) {
 
-            if ( atol(timet) - SaganBluedotIPCache[i].cache_utime > config->bluedot_timeout ) {
+            if ( utime - SaganBluedotIPCache[i].cache_utime > config->bluedot_timeout ) {
 
                 if (debug->debugbluedot) {
                     Sagan_Log(S_DEBUG, "[%s, line %d] == Deleting IP address from cache -> %u",  __FILE__, __LINE__, SaganBluedotIPCache[i].host);
@@ -589,7 +579,7 @@ void Sagan_Bluedot_Clean_Cache ( void )
 
         for (i=0; i<counters->bluedot_hash_cache_count; i++) {
 
-            if ( atol(timet) - SaganBluedotHashCache[i].cache_utime > config->bluedot_timeout ) {
+            if ( utime - SaganBluedotHashCache[i].cache_utime > config->bluedot_timeout ) {
                 if (debug->debugbluedot) {
                     Sagan_Log(S_DEBUG, "[%s, line %d] == Deleting hash from cache -> %s",  __FILE__, __LINE__, SaganBluedotHashCache[i].hash);
                 }
@@ -626,7 +616,7 @@ void Sagan_Bluedot_Clean_Cache ( void )
 
         for (i=0; i<counters->bluedot_url_cache_count; i++) {
 
-            if ( atol(timet) - SaganBluedotURLCache[i].cache_utime > config->bluedot_timeout ) {
+            if ( utime - SaganBluedotURLCache[i].cache_utime > config->bluedot_timeout ) {
                 if (debug->debugbluedot) {
                     Sagan_Log(S_DEBUG, "[%s, line %d] == Deleting URL from cache -> %s",  __FILE__, __LINE__, SaganBluedotURLCache[i].url);
                 }
@@ -661,7 +651,7 @@ void Sagan_Bluedot_Clean_Cache ( void )
         timeout_count = 0;
 
         for (i=0; i<counters->bluedot_filename_cache_count; i++) {
-            if ( atol(timet) - SaganBluedotFilenameCache[i].cache_utime > config->bluedot_timeout ) {
+            if ( utime - SaganBluedotFilenameCache[i].cache_utime > config->bluedot_timeout ) {
 
                 if (debug->debugbluedot) {
                     Sagan_Log(S_DEBUG, "[%s, line %d] == Deleting Filename from cache -> %s",  __FILE__, __LINE__, SaganBluedotFilenameCache[i].filename);
@@ -746,15 +736,11 @@ unsigned char Sagan_Bluedot_Lookup(char *data,  unsigned char type, int rule_pos
     char tmp[64] = { 0 };
     const char ptrtmp;
 
-    char  timet[20] = { 0 };
-    time_t t;
-    struct tm *now=NULL;
+    uint64_t utime = 0;
 
     uintmax_t ip = 0;
 
-    t = time(NULL);
-    now=localtime(&t);
-    strftime(timet, sizeof(timet), "%s",  now);
+    utime = Sagan_Clock_Now();
 
     /************************************************************************/
     /* Lookup types                                                         */
@@ -787,15 +773,13 @@ unsigned char Sagan_Bluedot_Lookup(char *data,  unsigned char type, int rule_pos
 
                 if ( bluedot_alertid != 0 && rulestruct[rule_position].bluedot_mdate_effective_period != 0 ) {
 
-                    if ( ( atol(timet) - SaganBluedotIPCache[i].mdate_utime ) > rulestruct[rule_position].bluedot_mdate_effective_period ) {
+                    if ( ( utime - SaganBluedotIPCache[i].mdate_utime ) > rulestruct[rule_position].bluedot_mdate_effective_period ) {
 
                         if ( debug->debugbluedot ) {
                             Sagan_Log(S_DEBUG, "[%s, line %d] From Bluedot Cache - qmdate for %s is over %d seconds.  Not alerting.", __FILE__, __LINE__, data, rulestruct[rule_position].bluedot_mdate_effective_period);
                         }
 
-                        pthread_mutex_lock(&SaganProcBluedotWorkMutex);
-                        counters->bluedot_mdate_cache++;
-                        pthread_mutex_unlock(&SaganProcBluedotWorkMutex);
+                        Sagan_Thread_Counters()->bluedot_mdate_cache++;
 
                         bluedot_alertid = 0;
                     }
@@ -803,24 +787,20 @@ unsigned char Sagan_Bluedot_Lookup(char *data,  unsigned char type, int rule_pos
 
                 else if ( bluedot_alertid != 0 && rulestruct[rule_position].bluedot_cdate_effective_period != 0 ) {
 
-                    if ( ( atol(timet) - SaganBluedotIPCache[i].cdate_utime ) > rulestruct[rule_position].bluedot_cdate_effective_period ) {
+                    if ( ( utime - SaganBluedotIPCache[i].cdate_utime ) > rulestruct[rule_position].bluedot_cdate_effective_period ) {
 
                         if ( debug->debugbluedot ) {
                             Sagan_Log(S_DEBUG, "[%s, line %d] qcdate for %s is over %d seconds.  Not alerting.", __FILE__, __LINE__, data, rulestruct[rule_position].bluedot_cdate_effective_period);
                         }
 
-                        pthread_mutex_lock(&SaganProcBluedotWorkMutex);
-                        counters->bluedot_cdate_cache++;
-                        pthread_mutex_unlock(&SaganProcBluedotWorkMutex);
+                        Sagan_Thread_Counters()->bluedot_cdate_cache++;
 
                         bluedot_alertid = 0;
                     }
                 }
 
 
-                pthread_mutex_lock(&SaganProcBluedotWorkMutex);
-                counters->bluedot_ip_cache_hit++;
-                pthread_mutex_unlock(&SaganProcBluedotWorkMutex);
+                Sagan_Thread_Counters()->bluedot_ip_cache_hit++;
 
                 return(bluedot_alertid);
 
@@ -872,9 +852,7 @@ unsigned char Sagan_Bluedot_Lookup(char *data,  unsigned char type, int rule_pos
                     Sagan_Log(S_DEBUG, "[%s, line %d] Pulled file hash '%s' from Bluedot hash cache with category of \"%d\".", __FILE__, __LINE__, data, SaganBluedotHashCache[i].alertid);
                 }
 
-                pthread_mutex_lock(&SaganProcBluedotWorkMutex);
-                counters->bluedot_hash_cache_hit++;
-                pthread_mutex_unlock(&SaganProcBluedotWorkMutex);
+                Sagan_Thread_Counters()->bluedot_hash_cache_hit++;
 
                 return(SaganBluedotHashCache[i].alertid);
 
@@ -895,9 +873,7 @@ unsigned char Sagan_Bluedot_Lookup(char *data,  unsigned char type, int rule_pos
                 if (debug->debugbluedot) {
                     Sagan_Log(S_DEBUG, "[%s, line %d] Pulled file URL '%s' from Bluedot URL cache with category of \"%d\".", __FILE__, __LINE__, data, SaganBluedotURLCache[i].alertid);
                 }
-                pthread_mutex_lock(&SaganProcBluedotWorkMutex);
-                counters->bluedot_url_cache_hit++;
-                pthread_mutex_unlock(&SaganProcBluedotWorkMutex);
+                Sagan_Thread_Counters()->bluedot_url_cache_hit++;
 
                 return(SaganBluedotURLCache[i].alertid);
 
@@ -918,9 +894,7 @@ unsigned char Sagan_Bluedot_Lookup(char *data,  unsigned char type, int rule_pos
                     Sagan_Log(S_DEBUG, "[%s, line %d] Pulled file filename '%s' from Bluedot filename cache with category of \"%d\".", __FILE__, __LINE__, data, SaganBluedotFilenameCache[i].alertid);
                 }
 
-                pthread_mutex_lock(&SaganProcBluedotWorkMutex);
-                counters->bluedot_filename_cache_hit++;
-                pthread_mutex_unlock(&SaganProcBluedotWorkMutex);
+                Sagan_Thread_Counters()->bluedot_filename_cache_hit++;
 
                 return(SaganBluedotFilenameCache[i].alertid);
 
@@ -953,9 +927,7 @@ unsigned char Sagan_Bluedot_Lookup(char *data,  unsigned char type, int rule_pos
     if ( response == NULL ) {
         Sagan_Log(S_WARN, "[%s, line %d] Bluedot returned a empty \"response\".", __FILE__, __LINE__);
 
-        pthread_mutex_lock(&SaganProcBluedotWorkMutex);
-        counters->bluedot_error_count++;
-        pthread_mutex_unlock(&SaganProcBluedotWorkMutex);
+        Sagan_Thread_Counters()->bluedot_error_count++;
 
         Sagan_Bluedot_Clean_Queue(data, type);
 
@@ -1018,9 +990,7 @@ unsigned char Sagan_Bluedot_Lookup(char *data,  unsigned char type, int rule_pos
     if ( cat == NULL ) {
         Sagan_Log(S_WARN, "Bluedot return a qipcode category.");
 
-        pthread_mutex_lock(&SaganProcBluedotWorkMutex);
-        counters->bluedot_error_count++;						// DEBUG <- Total error count
-        pthread_mutex_unlock(&SaganProcBluedotWorkMutex);
+        Sagan_Thread_Counters()->bluedot_error_count++;						// DEBUG <- Total error count
 
         Sagan_Bluedot_Clean_Queue(data, type);
 
@@ -1040,7 +1010,7 @@ unsigned char Sagan_Bluedot_Lookup(char *data,  unsigned char type, int rule_pos
 
     if ( bluedot_alertid == -1 ) {
         Sagan_Log(S_WARN, "Bluedot reports an invalid API key.  Lookup aborted!");
-        counters->bluedot_error_count++;
+        Sagan_Thread_Counters()->bluedot_error_count++;
         return(false);
     }
 
@@ -1055,7 +1025,7 @@ unsigned char Sagan_Bluedot_Lookup(char *data,  unsigned char type, int rule_pos
 
         pthread_mutex_lock(&SaganProcBluedotWorkMutex);
 
-        counters->bluedot_ip_total++;
+        Sagan_Thread_Counters()->bluedot_ip_total++;
 
         SaganBluedotIPCache = (_Sagan_Bluedot_IP_Cache *) realloc(SaganBluedotIPCache, (counters->bluedot_ip_cache_count+1) * sizeof(_Sagan_Bluedot_IP_Cache));
 
@@ -1066,7 +1036,7 @@ unsigned char Sagan_Bluedot_Lookup(char *data,  unsigned char type, int rule_pos
         /* Store data into cache */
 
         SaganBluedotIPCache[counters->bluedot_ip_cache_count].host = ip;
-        SaganBluedotIPCache[counters->bluedot_ip_cache_count].cache_utime = atol(timet);                   /* store utime */
+        SaganBluedotIPCache[counters->bluedot_ip_cache_count].cache_utime = utime;                   /* store utime */
         SaganBluedotIPCache[counters->bluedot_ip_cache_count].cdate_utime = cdate_utime_u32;
         SaganBluedotIPCache[counters->bluedot_ip_cache_count].mdate_utime = mdate_utime_u32;
         SaganBluedotIPCache[counters->bluedot_ip_cache_count].alertid = bluedot_alertid;
@@ -1077,15 +1047,13 @@ unsigned char Sagan_Bluedot_Lookup(char *data,  unsigned char type, int rule_pos
 
         if ( bluedot_alertid != 0 && rulestruct[rule_position].bluedot_mdate_effective_period != 0 ) {
 
-            if ( ( atol(timet) - mdate_utime_u32 ) > rulestruct[rule_position].bluedot_mdate_effective_period ) {
+            if ( ( utime - mdate_utime_u32 ) > rulestruct[rule_position].bluedot_mdate_effective_period ) {
 
                 if ( debug->debugbluedot ) {
                     Sagan_Log(S_DEBUG, "[%s, line %d] qmdate for %s is over %d seconds.  Not alerting.", __FILE__, __LINE__, data, rulestruct[rule_position].bluedot_mdate_effective_period);
                 }
 
-                pthread_mutex_lock(&SaganProcBluedotWorkMutex);
-                counters->bluedot_mdate++;
-                pthread_mutex_unlock(&SaganProcBluedotWorkMutex);
+                Sagan_Thread_Counters()->bluedot_mdate++;
 
                 bluedot_alertid = 0;
             }
@@ -1093,15 +1061,13 @@ unsigned char Sagan_Bluedot_Lookup(char *data,  unsigned char type, int rule_pos
 
         else if ( bluedot_alertid != 0 && rulestruct[rule_position].bluedot_cdate_effective_period != 0 ) {
 
-            if ( ( atol(timet) - cdate_utime_u32 ) > rulestruct[rule_position].bluedot_cdate_effective_period ) {
+            if ( ( utime - cdate_utime_u32 ) > rulestruct[rule_position].bluedot_cdate_effective_period ) {
 
                 if ( debug->debugbluedot ) {
                     Sagan_Log(S_DEBUG, "[%s, line %d] qcdate for %s is over %d seconds.  Not alerting.", __FILE__, __LINE__, data, rulestruct[rule_position].bluedot_cdate_effective_period);
                 }
 
-                pthread_mutex_lock(&SaganProcBluedotWorkMutex);
-                counters->bluedot_cdate++;
-                pthread_mutex_unlock(&SaganProcBluedotWorkMutex);
+                Sagan_Thread_Counters()->bluedot_cdate++;
 
                 bluedot_alertid = 0;
             }
@@ -1116,7 +1082,7 @@ unsigned char Sagan_Bluedot_Lookup(char *data,  unsigned char type, int rule_pos
 
         pthread_mutex_lock(&SaganProcBluedotWorkMutex);
 
-        counters->bluedot_hash_total++;
+        Sagan_Thread_Counters()->bluedot_hash_total++;
 
         SaganBluedotHashCache = (_Sagan_Bluedot_Hash_Cache *) realloc(SaganBluedotHashCache, (counters->bluedot_hash_cache_count+1) * sizeof(_Sagan_Bluedot_Hash_Cache));
 
@@ -1125,7 +1091,7 @@ unsigned char Sagan_Bluedot_Lookup(char *data,  unsigned char type, int rule_pos
         }
 
         strlcpy(SaganBluedotHashCache[counters->bluedot_hash_cache_count].hash, data, sizeof(SaganBluedotHashCache[counters->bluedot_hash_cache_count].hash));
-        SaganBluedotHashCache[counters->bluedot_hash_cache_count].cache_utime = atol(timet);                                                                                     /* store utime */
+        SaganBluedotHashCache[counters->bluedot_hash_cache_count].cache_utime = utime;                                                                                     /* store utime */
         SaganBluedotHashCache[counters->bluedot_hash_cache_count].alertid = bluedot_alertid;
         counters->bluedot_hash_cache_count++;
 
@@ -1138,7 +1104,7 @@ unsigned char Sagan_Bluedot_Lookup(char *data,  unsigned char type, int rule_pos
     else if ( type == BLUEDOT_LOOKUP_URL ) {
         pthread_mutex_lock(&SaganProcBluedotWorkMutex);
 
-        counters->bluedot_url_total++;
+        Sagan_Thread_Counters()->bluedot_url_total++;
 
         SaganBluedotURLCache = (_Sagan_Bluedot_URL_Cache *) realloc(SaganBluedotURLCache, (counters->bluedot_url_cache_count+1) * sizeof(_Sagan_Bluedot_URL_Cache));
 
@@ -1147,7 +1113,7 @@ unsigned char Sagan_Bluedot_Lookup(char *data,  unsigned char type, int rule_pos
         }
 
         strlcpy(SaganBluedotURLCache[counters->bluedot_url_cache_count].url, data, sizeof(SaganBluedotURLCache[counters->bluedot_url_cache_count].url));
-        SaganBluedotURLCache[counters->bluedot_url_cache_count].cache_utime = atol(timet);                                                                                     /* store utime */
+        SaganBluedotURLCache[counters->bluedot_url_cache_count].cache_utime = utime;                                                                                     /* store utime */
         SaganBluedotURLCache[counters->bluedot_url_cache_count].alertid = bluedot_alertid;
         counters->bluedot_url_cache_count++;
 
@@ -1160,7 +1126,7 @@ unsigned char Sagan_Bluedot_Lookup(char *data,  unsigned char type, int rule_pos
     else if ( type == BLUEDOT_LOOKUP_FILENAME ) {
         pthread_mutex_lock(&SaganProcBluedotWorkMutex);
 
-        counters->bluedot_filename_total++;
+        Sagan_Thread_Counters()->bluedot_filename_total++;
 
         SaganBluedotFilenameCache = (_Sagan_Bluedot_Filename_Cache *) realloc(SaganBluedotFilenameCache, (counters->bluedot_filename_cache_count+1) * sizeof(_Sagan_Bluedot_Filename_Cache));
 
@@ -1170,7 +1136,7 @@ unsigned char Sagan_Bluedot_Lookup(char *data,  unsigned char type, int rule_pos
 
 
         strlcpy(SaganBluedotFilenameCache[counters->bluedot_filename_cache_count].filename, data, sizeof(SaganBluedotFilenameCache[counters->bluedot_filename_cache_count].filename));
-        SaganBluedotFilenameCache[counters->bluedot_filename_cache_count].cache_utime = atol(timet);
+        SaganBluedotFilenameCache[counters->bluedot_filename_cache_count].cache_utime = utime;
         SaganBluedotFilenameCache[counters->bluedot_filename_cache_count].alertid = bluedot_alertid;
         counters->bluedot_filename_cache_count++;
 
@@ -1199,9 +1165,7 @@ int Sagan_Bluedot_Cat_Compare ( unsigned char bluedot_results, int rule_position
 
             if ( bluedot_results == rulestruct[rule_position].bluedot_ip_cats[i] ) {
 
-                pthread_mutex_lock(&SaganProcBluedotWorkMutex);
-                counters->bluedot_ip_positive_hit++;
-                pthread_mutex_unlock(&SaganProcBluedotWorkMutex);
+                Sagan_Thread_Counters()->bluedot_ip_positive_hit++;
 
                 return(true);
             }
@@ -1215,9 +1179,7 @@ int Sagan_Bluedot_Cat_Compare ( unsigned char bluedot_results, int rule_position
         for ( i = 0; i < rulestruct[rule_position].bluedot_hash_cat_count; i++ ) {
 
             if ( bluedot_results == rulestruct[rule_position].bluedot_hash_cats[i] ) {
-                pthread_mutex_lock(&SaganProcBluedotWorkMutex);
-                counters->bluedot_hash_positive_hit++;
-                pthread_mutex_unlock(&SaganProcBluedotWorkMutex);
+                Sagan_Thread_Counters()->bluedot_hash_positive_hit++;
 
                 return(true);
             }
@@ -1229,9 +1191,7 @@ int Sagan_Bluedot_Cat_Compare ( unsigned char bluedot_results, int rule_position
         for ( i = 0; i < rulestruct[rule_position].bluedot_url_cat_count; i++ ) {
 
             if ( bluedot_results == rulestruct[rule_position].bluedot_url_cats[i] ) {
-                pthread_mutex_lock(&SaganProcBluedotWorkMutex);
-                counters->bluedot_url_positive_hit++;
-                pthread_mutex_unlock(&SaganProcBluedotWorkMutex);
+                Sagan_Thread_Counters()->bluedot_url_positive_hit++;
 
                 return(true);
             }
@@ -1243,9 +1203,7 @@ int Sagan_Bluedot_Cat_Compare ( unsigned char bluedot_results, int rule_position
         for ( i = 0; i < rulestruct[rule_position].bluedot_filename_cat_count; i++ ) {
 
             if ( bluedot_results == rulestruct[rule_position].bluedot_filename_cats[i] ) {
-                pthread_mutex_lock(&SaganProcBluedotWorkMutex);
-                counters->bluedot_filename_positive_hit++;
-                pthread_mutex_unlock(&SaganProcBluedotWorkMutex);
+                Sagan_Thread_Counters()->bluedot_filename_positive_hit++;
 
                 return(true);
 
@@ -1268,21 +1226,19 @@ int Sagan_Bluedot_IP_Lookup_All ( char *syslog_message, int rule_position )
 {
 
     int i;
+    int count;
     char results[64];
 
+    const char (*ip)[MAXIP] = NULL;
+
     unsigned char bluedot_results;
     sbool bluedot_flag;
 
-    for ( i = 1; i < MAX_PARSE_IP; i++ ) {
+    count = Sagan_Features_IPs(syslog_message, &ip, NULL);
 
+    for ( i = 0; i < count; i++ ) {
 
-        strlcpy(results, Sagan_Parse_IP(syslog_message, i), sizeof(results));
-
-        /* Failed to find next IP,  short circuit the process */
-
-        if ( results[0] == '0' ) {
-            return(false);
-        }
+        strlcpy(results, ip[i], sizeof(results));
 
         bluedot_results = Sagan_Bluedot_Lookup(results, BLUEDOT_LOOKUP_IP, rule_position);
         bluedot_flag = Sagan_Bluedot_Cat_Compare( bluedot_results, rule_position, BLUEDOT_LOOKUP_IP );
@@ -531,27 +531,17 @@ sbool Sagan_BroIntel_IPADDR_All ( char *syslog_message )
 
     int i;
     int b;
+    int count;
 
-    uint32_t ip;
+    const uint32_t *ip_u32 = NULL;
 
-    char *results = NULL;
+    count = Sagan_Features_IPs(syslog_message, NULL, &ip_u32);
 
-
-    for (i = 1; i < MAX_PARSE_IP; i++) {
-
-        results = Sagan_Parse_IP(syslog_message, i);
-
-        /* Failed to find next IP,  short circuit the process */
-
-        if (!strcmp(results, "0")) {
-            return(false);
-        }
-
-        ip = IP2Bit(results);
+    for (i = 0; i < count; i++) {
 
         for ( b = 0; b < counters->brointel_addr_count; b++ ) {
 
-            if ( Sagan_BroIntel_Intel_Addr[b].u32_ip == ip ) {
+            if ( Sagan_BroIntel_Intel_Addr[b].u32_ip == ip_u32[i] ) {
                 return(true);
             }
         }
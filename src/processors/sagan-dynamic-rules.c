@@ -24,6 +24,11 @@
  * for Sagan to detect logs it might not be monitoring and automatically
  * enable and/or warn the operator.
  *
+ * A rule set can't be loaded in the middle of a batch,  other processors
+ * are reading the rules.  It is queued here and Sagan_Dynamic_Rules_Load()
+ * loads it once the batch is done,  holding SaganReloadLock for writing
+ * like a SIGHUP reload does.
+ *
  */
 
 
@@ -39,6 +44,7 @@
 #include "sagan.h"
 #include "sagan-defs.h"
 #include "sagan-rules.h"
+#include "sagan-prefilter.h"
 #include "sagan-config.h"
 #include "sagan-send-alert.h"
 
@@ -51,6 +57,13 @@ struct _SaganCounters *counters;
 sbool reload_rules;
 
 pthread_mutex_t SaganRulesLoadedMutex;
+pthread_rwlock_t SaganReloadLock;
+
+/* Rule sets waiting for Sagan_Dynamic_Rules_Load().  SaganRulesLoadedMutex
+ * protects both */
+
+static _Rules_Loaded *dynamic_pending = NULL;
+static int dynamic_pending_count = 0;
 
 int Sagan_Dynamic_Rules ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, int rule_position, _Sagan_Processor_Info *processor_info_engine, char *ip_src, char *ip_dst )
 {
@@ -114,14 +127,20 @@ int Sagan_Dynamic_Rules ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, int rule_po
                          config->sagan_port,
                          rule_position );
 
-        /* Lock rules so other threads don't try to use it while we alter/load new rules */
+        /* Loaded once this thread's batch is done */
 
         pthread_mutex_lock(&SaganRulesLoadedMutex);
-        reload_rules = 1;
 
-        Load_Rules(rulestruct[rule_position].dynamic_ruleset);
+        dynamic_pending = (_Rules_Loaded *) realloc(dynamic_pending, (dynamic_pending_count+1) * sizeof(_Rules_Loaded));
+
+        if ( dynamic_pending == NULL ) {
+            Sagan_Log(S_ERROR, "[%s, line %d] Failed to reallocate memory for dynamic_pending. Abort!", __FILE__, __LINE__);
+        }
+
+        strlcpy(dynamic_pending[dynamic_pending_count].ruleset, rulestruct[rule_position].dynamic_ruleset, sizeof(dynamic_pending[dynamic_pending_count].ruleset));
+
+        __atomic_store_n(&dynamic_pending_count, dynamic_pending_count + 1, __ATOMIC_RELEASE);
 
-        reload_rules = 0;
         pthread_mutex_unlock(&SaganRulesLoadedMutex);
 
     }
@@ -162,3 +181,43 @@ int Sagan_Dynamic_Rules ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, int rule_po
     return(0);
 
 }
+
+/****************************************************************************
+ * Sagan_Dynamic_Rules_Load - Loads the rule sets queued by
+ * Sagan_Dynamic_Rules().  Processors call this between batches,  without
+ * SaganReloadLock held.
+ ****************************************************************************/
+
+void Sagan_Dynamic_Rules_Load( void )
+{
+
+    int i;
+
+    if ( __atomic_load_n(&dynamic_pending_count, __ATOMIC_ACQUIRE) == 0 ) {
+        return;
+    }
+
+    /* Waits for every other processor to finish its batch */
+
+    pthread_rwlock_wrlock(&SaganReloadLock);
+    pthread_mutex_lock(&SaganRulesLoadedMutex);
+    reload_rules = 1;
+
+    /* Another processor may have loaded them while we waited */
+
+    if ( dynamic_pending_count > 0 ) {
+
+        for (i = 0; i < dynamic_pending_count; i++) {
+            Load_Rules(dynamic_pending[i].ruleset);
+        }
+
+        Sagan_Prefilter_Build();
+
+        __atomic_store_n(&dynamic_pending_count, 0, __ATOMIC_RELEASE);
+    }
+
+    reload_rules = 0;
+    pthread_mutex_unlock(&SaganRulesLoadedMutex);
+    pthread_rwlock_unlock(&SaganReloadLock);
+
+}
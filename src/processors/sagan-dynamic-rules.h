@@ -23,3 +23,4 @@
 #endif
 
 int Sagan_Dynamic_Rules ( _Sagan_Proc_Syslog *, int, _Sagan_Processor_Info *, char *, char * );
+void Sagan_Dynamic_Rules_Load( void );
@@ -46,7 +46,12 @@
 #include "sagan-rules.h"
 #include "sagan-config.h"
 #include "sagan-ipc.h"
+#include "sagan-tracker.h"
 #include "sagan-check-flow.h"
+#include "sagan-counters.h"
+#include "sagan-rule-index.h"
+#include "sagan-prefilter.h"
+#include "sagan-clock.h"
 
 #include "parsers/parsers.h"
 
@@ -61,8 +66,6 @@
 
 #ifdef HAVE_LIBLOGNORM
 #include "sagan-liblognorm.h"
-struct _SaganNormalizeLiblognorm *SaganNormalizeLiblognorm;
-pthread_mutex_t Lognorm_Mutex;
 #endif
 
 #ifdef HAVE_LIBMAXMINDDB
@@ -76,49 +79,6 @@ struct _SaganConfig *config;
 
 struct _Sagan_IPC_Counters *counters_ipc;
 
-pthread_mutex_t CounterMutex=PTHREAD_MUTEX_INITIALIZER;
-
-pthread_mutex_t After_By_Src_Mutex=PTHREAD_MUTEX_INITIALIZER;
-pthread_mutex_t After_By_Dst_Mutex=PTHREAD_MUTEX_INITIALIZER;
-pthread_mutex_t After_By_Src_Port_Mutex=PTHREAD_MUTEX_INITIALIZER;
-pthread_mutex_t After_By_Dst_Port_Mutex=PTHREAD_MUTEX_INITIALIZER;
-pthread_mutex_t After_By_Username_Mutex=PTHREAD_MUTEX_INITIALIZER;
-
-pthread_mutex_t Thresh_By_Src_Mutex=PTHREAD_MUTEX_INITIALIZER;
-pthread_mutex_t Thresh_By_Dst_Mutex=PTHREAD_MUTEX_INITIALIZER;
-pthread_mutex_t Thresh_By_Src_Port_Mutex=PTHREAD_MUTEX_INITIALIZER;
-pthread_mutex_t Thresh_By_Dst_Port_Mutex=PTHREAD_MUTEX_INITIALIZER;
-pthread_mutex_t Thresh_By_Username_Mutex=PTHREAD_MUTEX_INITIALIZER;
-
-struct thresh_by_src_ipc *threshbysrc_ipc;
-struct thresh_by_dst_ipc *threshbydst_ipc;
-struct thresh_by_srcport_ipc *threshbysrcport_ipc;
-struct thresh_by_dstport_ipc *threshbydstport_ipc;
-struct thresh_by_username_ipc *threshbyusername_ipc;
-
-struct after_by_src_ipc *afterbysrc_ipc;
-struct after_by_dst_ipc *afterbydst_ipc;
-struct after_by_srcport_ipc *afterbysrcport_ipc;
-struct after_by_dstport_ipc *afterbydstport_ipc;
-struct after_by_username_ipc *afterbyusername_ipc;
-
-void Sagan_Engine_Init ( void )
-{
-
-#ifdef HAVE_LIBLOGNORM
-
-    SaganNormalizeLiblognorm = malloc(sizeof(struct _SaganNormalizeLiblognorm));
-
-    if ( SaganNormalizeLiblognorm == NULL ) {
-        Sagan_Log(S_ERROR, "[%s, line %d] Failed to allocate memory for SaganNormalizeLiblognorm. Abort!", __FILE__, __LINE__);
-    }
-
-    memset(SaganNormalizeLiblognorm, 0, sizeof(_SaganNormalizeLiblognorm));
-
-#endif
-
-}
-
 int Sagan_Engine ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, sbool dynamic_rule_flag )
 {
 
@@ -137,30 +97,34 @@ int Sagan_Engine ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, sbool dynamic_rule
     int processor_info_engine_alertid = 0;
 
     sbool after_log_flag = false;
-    sbool after_flag = false;
 
     int threadid = 0;
 
-    int i = 0;
     int b = 0;
+    int c = 0;
     int z = 0;
 
+    int *candidates = NULL;
+    int candidate_count = 0;
+
+    size_t message_len = strlen(SaganProcSyslog_LOCAL->syslog_message);
+    const char *message_lower = NULL;
+    size_t content_start = 0;
+    size_t content_len = 0;
+    size_t content_last = 0;		/* End of the previous content match */
+    char *content_found = NULL;
+
     sbool match = false;
     int sagan_match = 0;				/* Used to determine if all has "matched" (content, pcre, meta_content, etc) */
 
     int rc = 0;
     int ovector[PCRE_OVECCOUNT];
 
-    int alter_num = 0;
-    int meta_alter_num = 0;
 
     sbool xbit_return = 0;
     sbool alert_time_trigger = false;
     sbool check_flow_return = true;  /* 1 = match, 0 = no match */
 
-    char *ptmp;
-    char *tok2;
-
     /* We don't tie these to HAVE_LIBMAXMINDDB because we might have other
      * methods to extract the informaton */
 
@@ -188,19 +152,10 @@ int Sagan_Engine ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, sbool dynamic_rule
     uint32_t ip_dst_u32 = 0;
     uint32_t ip_dstport_u32 = 0;
 
-    char tmpbuf[128];
     char s_msg[1024];
-    char alter_content[MAX_SYSLOGMSG];
-    char meta_alter_content[MAX_SYSLOGMSG];
 
-    time_t t;
-    struct tm *now;
-    char  timet[20];
+    _Sagan_Tracker_Keys track_keys;
 
-    uintmax_t thresh_oldtime;
-    uintmax_t after_oldtime;
-
-    sbool thresh_flag = false;
     sbool thresh_log_flag = false;
 
     int proto = config->sagan_proto;		/* Set proto to default */
@@ -230,173 +185,129 @@ int Sagan_Engine ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, sbool dynamic_rule
 
     sbool liblognorm_status = 0;
 
+#ifdef HAVE_LIBLOGNORM
+    struct _SaganNormalizeLiblognorm *SaganNormalizeLiblognorm = NULL;
+#endif
+
     /* Search for matches */
 
-    /* First we search for 'program' and such.   This way,  we don't waste CPU
-     * time with pcre/content.  */
+    /* First we narrow the rules down by 'program' and such.   This way,  we
+     * don't waste CPU time with pcre/content on rules that can't apply. */
 
-    for(b=0; b < counters->rulecount; b++) {
+    /* Lowercase the message once for all "nocase" searches */
 
-        /* Process "normal" rules.  Skip dynamic rules if it's not time to process them */
+    message_lower = Sagan_Fold_Set(SaganProcSyslog_LOCAL->syslog_message, message_len);
 
-        if ( rulestruct[b].type == NORMAL_RULE || ( rulestruct[b].type == DYNAMIC_RULE && dynamic_rule_flag == true ) ) {
+    /* IPs,  ports,  hashes,  etc. are parsed on demand,  once for this message */
 
-            match = false;
+    Sagan_Features_Reset();
 
-            if ( strcmp(rulestruct[b].s_program, "" )) {
-                strlcpy(tmpbuf, rulestruct[b].s_program, sizeof(tmpbuf));
-                ptmp = strtok_r(tmpbuf, "|", &tok2);
-                match = true;
-                while ( ptmp != NULL ) {
-                    if ( Sagan_Wildcard(ptmp, SaganProcSyslog_LOCAL->syslog_program) == 1 ) {
-                        match = false;
-                    }
+#ifdef HAVE_LIBLOGNORM
 
-                    ptmp = strtok_r(NULL, "|", &tok2);
-                }
-            }
-
-            if ( strcmp(rulestruct[b].s_facility, "" )) {
-                strlcpy(tmpbuf, rulestruct[b].s_facility, sizeof(tmpbuf));
-                ptmp = strtok_r(tmpbuf, "|", &tok2);
-                match = true;
-                while ( ptmp != NULL ) {
-                    if (!strcmp(ptmp, SaganProcSyslog_LOCAL->syslog_facility)) {
-                        match = false;
-                    }
+    /* Normalized on demand,  at most once for this message */
 
-                    ptmp = strtok_r(NULL, "|", &tok2);
-                }
-            }
-
-            if ( strcmp(rulestruct[b].s_syspri, "" )) {
-                strlcpy(tmpbuf, rulestruct[b].s_syspri, sizeof(tmpbuf));
-                ptmp = strtok_r(tmpbuf, "|", &tok2);
-                match = true;
-                while ( ptmp != NULL ) {
-                    if (!strcmp(ptmp, SaganProcSyslog_LOCAL->syslog_priority)) {
-                        match = false;
-                    }
+    Sagan_Normalize_Liblognorm_Reset();
 
-                    ptmp = strtok_r(NULL, "|", &tok2);
-                }
-            }
-
-            if ( strcmp(rulestruct[b].s_level, "" )) {
-                strlcpy(tmpbuf, rulestruct[b].s_level, sizeof(tmpbuf));
-                ptmp = strtok_r(tmpbuf, "|", &tok2);
-                match = true;
-                while ( ptmp != NULL ) {
-                    if (!strcmp(ptmp, SaganProcSyslog_LOCAL->syslog_level)) {
-                        match = false;
-                    }
+#endif
 
-                    ptmp = strtok_r(NULL, "|", &tok2);
-                }
-            }
-
-            if ( strcmp(rulestruct[b].s_tag, "" )) {
-                strlcpy(tmpbuf, rulestruct[b].s_tag, sizeof(tmpbuf));
-                ptmp = strtok_r(tmpbuf, "|", &tok2);
-                match = true;
-                while ( ptmp != NULL ) {
-                    if (!strcmp(ptmp, SaganProcSyslog_LOCAL->syslog_tag)) {
-                        match = false;
-                    }
+    candidates = Sagan_Rule_Index_Candidates(SaganProcSyslog_LOCAL, &candidate_count);
 
-                    ptmp = strtok_r(NULL, "|", &tok2);
-                }
-            }
+    /* One pass for every content: literal of every rule */
 
-            /* If there has been a match above,  or NULL on all,  then we continue with
-             * PCRE/content search */
+    if ( candidate_count != 0 ) {
+        Sagan_Prefilter_Scan(SaganProcSyslog_LOCAL->syslog_message);
+    }
 
-            /* Search via strstr (content:) */
+    for(c=0; c < candidate_count; c++) {
 
-            if ( match == false ) {
+        b = candidates[c];
 
-                if ( rulestruct[b].content_count != 0 ) {
+        /* Skip rules whose content: can't all be in this message */
 
-                    for(z=0; z<rulestruct[b].content_count; z++) {
+        if ( Sagan_Prefilter_Rule(b) == false ) {
+            continue;
+        }
 
+        /* Process "normal" rules.  Skip dynamic rules if it's not time to process them */
 
-                        /* Content: OFFSET */
+        if ( rulestruct[b].type == NORMAL_RULE || ( rulestruct[b].type == DYNAMIC_RULE && dynamic_rule_flag == true ) ) {
 
-                        alter_num = 0;
+            match = false;
 
-                        if ( rulestruct[b].s_offset[z] != 0 ) {
+            /* If there has been a match above,  or NULL on all,  then we continue with
+             * PCRE/content search */
 
-                            if ( strlen(SaganProcSyslog_LOCAL->syslog_message) > rulestruct[b].s_offset[z] ) {
+            /* Search via strstr (content:) */
 
-                                alter_num = strlen(SaganProcSyslog_LOCAL->syslog_message) - rulestruct[b].s_offset[z];
-                                strlcpy(alter_content, SaganProcSyslog_LOCAL->syslog_message + (strlen(SaganProcSyslog_LOCAL->syslog_message) - alter_num), alter_num + 1);
+            if ( match == false ) {
 
-                            } else {
+                if ( rulestruct[b].content_count != 0 ) {
 
-                                alter_content[0] = '\0'; 	/* The offset is larger than the message.  Set content too NULL */
+                    content_last = 0;
 
-                            }
+                    for(z=0; z<rulestruct[b].content_count; z++) {
 
-                        } else {
+                        /* Each content is searched for in a window of the message.
+                         * Nothing is copied,  the window is just a start and length. */
 
-                            strlcpy(alter_content, SaganProcSyslog_LOCAL->syslog_message, sizeof(alter_content));
+                        if ( rulestruct[b].s_distance[z] != 0 || rulestruct[b].s_within[z] != 0 ) {
 
-                        }
+                            /* Content: DISTANCE & WITHIN - Relative to the end of the
+                             * previous match */
 
-                        /* Content: DEPTH */
+                            content_start = content_last + rulestruct[b].s_distance[z];
+                            content_len = rulestruct[b].s_within[z] != 0 ? rulestruct[b].s_within[z] : message_len;
 
-                        if ( rulestruct[b].s_depth[z] != 0 ) {
+                        } else {
 
-                            /* We do +2 to account for alter_count[0] and whitespace at the begin of syslog message */
+                            /* Content: OFFSET & DEPTH.  Depth gets +1 to account for the
+                             * whitespace at the begining of the syslog message */
 
-                            strlcpy(alter_content, alter_content, rulestruct[b].s_depth[z] + 2);
+                            content_start = rulestruct[b].s_offset[z];
+                            content_len = rulestruct[b].s_depth[z] != 0 ? rulestruct[b].s_depth[z] + 1 : message_len;
 
                         }
 
-                        /* Content: DISTANCE */
-
-                        if ( rulestruct[b].s_distance[z] != 0 ) {
-
-                            alter_num = strlen(SaganProcSyslog_LOCAL->syslog_message) - ( rulestruct[b].s_depth[z-1] + rulestruct[b].s_distance[z] + 1);
-                            strlcpy(alter_content, SaganProcSyslog_LOCAL->syslog_message + (strlen(SaganProcSyslog_LOCAL->syslog_message) - alter_num), alter_num + 1);
-
-                            /* Content: WITHIN */
-
-                            if ( rulestruct[b].s_within[z] != 0 ) {
-                                strlcpy(alter_content, alter_content, rulestruct[b].s_within[z] + 1);
-
-                            }
+                        /* The window may go past the end of the message */
 
+                        if ( content_start > message_len ) {
+                            content_start = message_len;
                         }
 
-                        /* If case insensitive */
+                        if ( content_len > message_len - content_start ) {
+                            content_len = message_len - content_start;
+                        }
 
                         if ( rulestruct[b].s_nocase[z] == 1 ) {
 
-                            if (rulestruct[b].content_not[z] != 1 && Sagan_stristr(alter_content, rulestruct[b].s_content[z], false))
-
-                            {
-                                sagan_match++;
-                            } else {
-
-                                /* for content: ! */
+                            /* Case insensitive.  The content is lower case from load,  so
+                             * search the lowercase copy of the message */
 
-                                if ( rulestruct[b].content_not[z] == 1 && !Sagan_stristr(alter_content, rulestruct[b].s_content[z], false)) sagan_match++;
+                            content_found = Sagan_Find(message_lower + content_start, content_len, rulestruct[b].s_content[z], &rulestruct[b].s_content_needle[z]);
 
+                            if ( content_found != NULL ) {
+                                content_found = SaganProcSyslog_LOCAL->syslog_message + ( content_found - message_lower );
                             }
+
                         } else {
 
-                            /* If case sensitive */
+                            content_found = Sagan_Find(SaganProcSyslog_LOCAL->syslog_message + content_start, content_len, rulestruct[b].s_content[z], &rulestruct[b].s_content_needle[z]);
 
-                            if ( rulestruct[b].content_not[z] != 1 && Sagan_strstr(alter_content, rulestruct[b].s_content[z] )) {
-                                sagan_match++;
-                            } else {
+                        }
 
-                                /* for content: ! */
-                                if ( rulestruct[b].content_not[z] == 1 && !Sagan_strstr(alter_content, rulestruct[b].s_content[z])) sagan_match++;
+                        if ( rulestruct[b].content_not[z] != 1 && content_found != NULL ) {
+
+                            sagan_match++;
+                            content_last = ( content_found - SaganProcSyslog_LOCAL->syslog_message ) + rulestruct[b].s_content_needle[z].len;
 
-                            }
                         }
+
+                        /* for content: ! */
+
+                        else if ( rulestruct[b].content_not[z] == 1 && content_found == NULL ) {
+                            sagan_match++;
+                        }
+
                     }
                 }
 
@@ -410,7 +321,7 @@ int Sagan_Engine ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, sbool dynamic_rule
 
                     for(z=0; z<rulestruct[b].pcre_count; z++) {
 
-                        rc = pcre_exec( rulestruct[b].re_pcre[z], rulestruct[b].pcre_extra[z], SaganProcSyslog_LOCAL->syslog_message, (int)strlen(SaganProcSyslog_LOCAL->syslog_message), 0, 0, ovector, PCRE_OVECCOUNT);
+                        rc = pcre_exec( rulestruct[b].re_pcre[z], rulestruct[b].pcre_extra[z], SaganProcSyslog_LOCAL->syslog_message, (int)message_len, 0, 0, ovector, PCRE_OVECCOUNT);
 
                         if ( rc > 0 ) {
                             sagan_match++;
@@ -425,57 +336,34 @@ int Sagan_Engine ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, sbool dynamic_rule
 
                     for (z=0; z<rulestruct[b].meta_content_count; z++) {
 
-                        meta_alter_num = 0;
-
-                        /* Meta_content: OFFSET */
-
-                        if ( rulestruct[b].meta_offset[z] != 0 ) {
-
-                            if ( strlen(SaganProcSyslog_LOCAL->syslog_message) > rulestruct[b].meta_offset[z] ) {
-
-                                meta_alter_num = strlen(SaganProcSyslog_LOCAL->syslog_message) - rulestruct[b].meta_offset[z];
-                                strlcpy(meta_alter_content, SaganProcSyslog_LOCAL->syslog_message + (strlen(SaganProcSyslog_LOCAL->syslog_message) - meta_alter_num), meta_alter_num + 1);
+                        /* Same windows as content,  but meta_distance is still relative
+                         * to the previous meta_depth */
 
-                            } else {
+                        if ( rulestruct[b].meta_distance[z] != 0 ) {
 
-                                meta_alter_content[0] = '\0';    /* The offset is larger than the message.  Set meta_content too NULL */
+                            /* Meta_content: DISTANCE & WITHIN */
 
-                            }
+                            content_start = rulestruct[b].meta_depth[z-1] + rulestruct[b].meta_distance[z] + 1;
+                            content_len = rulestruct[b].meta_within[z] != 0 ? rulestruct[b].meta_within[z] : message_len;
 
                         } else {
 
-                            strlcpy(meta_alter_content, SaganProcSyslog_LOCAL->syslog_message, sizeof(meta_alter_content));
-
-                        }
-
-
-                        /* Meta_content: DEPTH */
-
-                        if ( rulestruct[b].meta_depth[z] != 0 ) {
+                            /* Meta_content: OFFSET & DEPTH */
 
-                            /* We do +2 to account for alter_count[0] and whitespace at the begin of syslog message */
-
-                            strlcpy(meta_alter_content, meta_alter_content, rulestruct[b].meta_depth[z] + 2);
+                            content_start = rulestruct[b].meta_offset[z];
+                            content_len = rulestruct[b].meta_depth[z] != 0 ? rulestruct[b].meta_depth[z] + 1 : message_len;
 
                         }
 
-                        /* Meta_content: DISTANCE */
-
-                        if ( rulestruct[b].meta_distance[z] != 0 ) {
-
-                            meta_alter_num = strlen(SaganProcSyslog_LOCAL->syslog_message) - ( rulestruct[b].meta_depth[z-1] + rulestruct[b].meta_distance[z] + 1 );
-                            strlcpy(meta_alter_content, SaganProcSyslog_LOCAL->syslog_message + (strlen(SaganProcSyslog_LOCAL->syslog_message) - meta_alter_num), meta_alter_num + 1);
-
-                            /* Meta_ontent: WITHIN */
-
-                            if ( rulestruct[b].meta_within[z] != 0 ) {
-                                strlcpy(meta_alter_content, meta_alter_content, rulestruct[b].meta_within[z] + 1);
-
-                            }
+                        if ( content_start > message_len ) {
+                            content_start = message_len;
+                        }
 
+                        if ( content_len > message_len - content_start ) {
+                            content_len = message_len - content_start;
                         }
 
-                        rc = Sagan_Meta_Content_Search(meta_alter_content, b, z);
+                        rc = Sagan_Meta_Content_Search(SaganProcSyslog_LOCAL->syslog_message + content_start, message_lower + content_start, content_len, b, z);
 
                         if ( rc == 1 ) {
                             sagan_match++;
@@ -510,11 +398,9 @@ int Sagan_Engine ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, sbool dynamic_rule
 #ifdef HAVE_LIBLOGNORM
                     if ( rulestruct[b].normalize == 1 ) {
 
-                        pthread_mutex_lock(&Lognorm_Mutex);
-
                         liblognorm_status = 0;
 
-                        Sagan_Normalize_Liblognorm(SaganProcSyslog_LOCAL->syslog_message);
+                        SaganNormalizeLiblognorm = Sagan_Normalize_Liblognorm(SaganProcSyslog_LOCAL->syslog_message, message_len);
 
                         if (SaganNormalizeLiblognorm->ip_src[0] != '0') {
                             strlcpy(ip_src, SaganNormalizeLiblognorm->ip_src, sizeof(ip_src));
@@ -573,8 +459,6 @@ int Sagan_Engine ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, sbool dynamic_rule
 
                         }
 
-                        pthread_mutex_unlock(&Lognorm_Mutex);
-
                     }
 
 #endif
@@ -587,22 +471,22 @@ int Sagan_Engine ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, sbool dynamic_rule
                         /* parse_src_ip: {position} */
 
                         if ( rulestruct[b].s_find_src_ip == 1 ) {
-                            strlcpy(ip_src, Sagan_Parse_IP(SaganProcSyslog_LOCAL->syslog_message, rulestruct[b].s_find_src_pos), sizeof(ip_src));
+                            strlcpy(ip_src, Sagan_Features_IP(SaganProcSyslog_LOCAL->syslog_message, rulestruct[b].s_find_src_pos), sizeof(ip_src));
                             ip_src_flag = 1;
                         }
 
                         /* parse_dst_ip: {postion} */
 
                         if ( rulestruct[b].s_find_dst_ip == 1 ) {
-                            strlcpy(ip_dst, Sagan_Parse_IP(SaganProcSyslog_LOCAL->syslog_message, rulestruct[b].s_find_dst_pos), sizeof(ip_dst));
+                            strlcpy(ip_dst, Sagan_Features_IP(SaganProcSyslog_LOCAL->syslog_message, rulestruct[b].s_find_dst_pos), sizeof(ip_dst));
                             ip_dst_flag = 1;
                         }
 
                         /* parse_port */
 
                         if ( rulestruct[b].s_find_port == 1 ) {
-                            normalize_src_port = Sagan_Parse_Src_Port(SaganProcSyslog_LOCAL->syslog_message);
-                            normalize_dst_port = Sagan_Parse_Dst_Port(SaganProcSyslog_LOCAL->syslog_message);
+                            normalize_src_port = Sagan_Features_Src_Port(SaganProcSyslog_LOCAL->syslog_message);
+                            normalize_dst_port = Sagan_Features_Dst_Port(SaganProcSyslog_LOCAL->syslog_message);
                         } else {
                             normalize_src_port = config->sagan_port;
                         }
@@ -610,16 +494,15 @@ int Sagan_Engine ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, sbool dynamic_rule
                         /* parse_hash: md5 */
 
                         if ( rulestruct[b].s_find_hash_type == PARSE_HASH_MD5 ) {
-                            strlcpy(normalize_md5_hash, Sagan_Parse_Hash(SaganProcSyslog_LOCAL->syslog_message, PARSE_HASH_MD5), sizeof(normalize_md5_hash));
+                            strlcpy(normalize_md5_hash, Sagan_Features_Hash(SaganProcSyslog_LOCAL->syslog_message, PARSE_HASH_MD5), sizeof(normalize_md5_hash));
                         }
 
                         else if ( rulestruct[b].s_find_hash_type == PARSE_HASH_SHA1 ) {
-                            strlcpy(normalize_sha1_hash, Sagan_Parse_Hash(SaganProcSyslog_LOCAL->syslog_message, PARSE_HASH_SHA1), sizeof(normalize_sha1_hash));
+                            strlcpy(normalize_sha1_hash, Sagan_Features_Hash(SaganProcSyslog_LOCAL->syslog_message, PARSE_HASH_SHA1), sizeof(normalize_sha1_hash));
                         }
 
                         else if ( rulestruct[b].s_find_hash_type == PARSE_HASH_SHA256 ) {
-                            strlcpy(normalize_sha256_hash, Sagan_Parse_Hash(SaganProcSyslog_LOCAL->syslog_message, PARSE_HASH_SHA256), sizeof(normalize_sha256_hash));
-                            printf("-> %s\n", normalize_sha256_hash);
+                            strlcpy(normalize_sha256_hash, Sagan_Features_Hash(SaganProcSyslog_LOCAL->syslog_message, PARSE_HASH_SHA256), sizeof(normalize_sha256_hash));
                         }
 
                         /*  DEBUG
@@ -638,11 +521,11 @@ int Sagan_Engine ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, sbool dynamic_rule
                     proto = 0;
 
                     if ( rulestruct[b].s_find_proto_program == 1 ) {
-                        proto = Sagan_Parse_Proto_Program(SaganProcSyslog_LOCAL->syslog_program);
+                        proto = Sagan_Features_Proto_Program(SaganProcSyslog_LOCAL->syslog_program);
                     }
 
                     if ( rulestruct[b].s_find_proto == 1 && proto == 0 ) {
-                        proto = Sagan_Parse_Proto(SaganProcSyslog_LOCAL->syslog_message);
+                        proto = Sagan_Features_Proto(SaganProcSyslog_LOCAL->syslog_message);
                     }
 
                     /* If proto is not searched or has failed,  default to whatever the rule told us to
@@ -689,6 +572,20 @@ int Sagan_Engine ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, sbool dynamic_rule
                     ip_dstport_u32 = normalize_dst_port;
                     ip_srcport_u32 = normalize_src_port;
 
+                    /* Everything threshold/after can "track" by */
+
+                    track_keys.ip_src = ip_src_u32;
+                    track_keys.ip_dst = ip_dst_u32;
+                    track_keys.src_port = ip_srcport_u32;
+                    track_keys.dst_port = ip_dstport_u32;
+                    track_keys.username = normalize_username;
+                    track_keys.filename = normalize_filename;
+                    track_keys.http_uri = normalize_http_uri;
+                    track_keys.http_hostname = normalize_http_hostname;
+                    track_keys.md5 = normalize_md5_hash;
+                    track_keys.sha1 = normalize_sha1_hash;
+                    track_keys.sha256 = normalize_sha256_hash;
+
                     strlcpy(s_msg, rulestruct[b].s_msg, sizeof(s_msg));
 
                     /* Check for flow of rule - has_flow is set as rule loading.  It 1, then
@@ -700,11 +597,11 @@ int Sagan_Engine ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, sbool dynamic_rule
 
                         if(check_flow_return == false) {
 
-                            counters->follow_flow_drop++;
+                            Sagan_Thread_Counters()->follow_flow_drop++;
 
                         }
 
-                        counters->follow_flow_total++;
+                        Sagan_Thread_Counters()->follow_flow_total++;
 
                     }
 
@@ -740,7 +637,7 @@ int Sagan_Engine ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, sbool dynamic_rule
                                     geoip2_isset = false;
                                 } else {
                                     geoip2_isset = true;
-                                    counters->geoip2_hit++;
+                                    Sagan_Thread_Counters()->geoip2_hit++;
                                 }
                             }
 
@@ -750,7 +647,7 @@ int Sagan_Engine ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, sbool dynamic_rule
 
                                 if ( geoip2_return == 1 ) {
                                     geoip2_isset = true;
-                                    counters->geoip2_hit++;
+                                    Sagan_Thread_Counters()->geoip2_hit++;
                                 } else {
                                     geoip2_isset = false;
                                 }
@@ -975,442 +872,9 @@ int Sagan_Engine ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, sbool dynamic_rule
 
                                                                 after_log_flag = true;
 
-                                                                t = time(NULL);
-                                                                now=localtime(&t);
-                                                                strftime(timet, sizeof(timet), "%s",  now);
-
-                                                                /* After by source IP address */
-
-                                                                if ( rulestruct[b].after_method == AFTER_BY_SRC ) {
-
-                                                                    after_flag = false;
-
-                                                                    for (i = 0; i < counters_ipc->after_count_by_src; i++ ) {
-                                                                        if ( afterbysrc_ipc[i].ipsrc == ip_src_u32  && !strcmp(afterbysrc_ipc[i].sid, rulestruct[b].s_sid )) {
-
-                                                                            after_flag = true;
-
-                                                                            Sagan_File_Lock(config->shm_after_by_src);
-                                                                            pthread_mutex_lock(&After_By_Src_Mutex);
-
-                                                                            afterbysrc_ipc[i].count++;
-                                                                            after_oldtime = atol(timet) - afterbysrc_ipc[i].utime;
-                                                                            afterbysrc_ipc[i].utime = atol(timet);
-
-                                                                            if ( after_oldtime > rulestruct[b].after_seconds ) {
-                                                                                afterbysrc_ipc[i].count=1;
-                                                                                afterbysrc_ipc[i].utime = atol(timet);
-                                                                                after_log_flag = true;
-                                                                            }
-
-                                                                            pthread_mutex_unlock(&After_By_Src_Mutex);
-                                                                            Sagan_File_Unlock(config->shm_after_by_src);
-
-                                                                            if ( rulestruct[b].after_count < afterbysrc_ipc[i].count ) {
-                                                                                after_log_flag = false;
-
-                                                                                if ( debug->debuglimits ) {
-                                                                                    Sagan_Log(S_NORMAL, "After SID %s by source IP address. [%s]", afterbysrc_ipc[i].sid, ip_src);
-                                                                                }
-
-
-                                                                                pthread_mutex_lock(&CounterMutex);
-                                                                                counters->after_total++;
-                                                                                pthread_mutex_unlock(&CounterMutex);
-                                                                            }
-
-                                                                        }
-                                                                    }
-                                                                }
-
-
-                                                                /* If not found,  add it to the array */
-
-                                                                if ( after_flag == false ) {
-
-                                                                    if ( Sagan_Clean_IPC_Object(AFTER_BY_SRC) == 0 ) {
-
-                                                                        Sagan_File_Lock(config->shm_after_by_src);
-                                                                        pthread_mutex_lock(&After_By_Src_Mutex);
-
-                                                                        afterbysrc_ipc[counters_ipc->after_count_by_src].ipsrc = ip_src_u32;
-                                                                        strlcpy(afterbysrc_ipc[counters_ipc->after_count_by_src].sid, rulestruct[b].s_sid, sizeof(afterbysrc_ipc[counters_ipc->after_count_by_src].sid));
-                                                                        afterbysrc_ipc[counters_ipc->after_count_by_src].count = 1;
-                                                                        afterbysrc_ipc[counters_ipc->after_count_by_src].utime = atol(timet);
-                                                                        afterbysrc_ipc[counters_ipc->after_count_by_src].expire = rulestruct[b].after_seconds;
-
-                                                                        Sagan_File_Unlock(config->shm_after_by_src);
-
-                                                                        Sagan_File_Lock(config->shm_counters);
-
-                                                                        counters_ipc->after_count_by_src++;
-
-                                                                        pthread_mutex_unlock(&After_By_Src_Mutex);
-                                                                        Sagan_File_Unlock(config->shm_counters);
-
-                                                                    }
-
-                                                                }
-
-
-                                                                /* After by source IP port */
-
-                                                                if ( rulestruct[b].after_method == 4 ) {
-
-                                                                    after_flag = false;
-
-                                                                    /* Check array for matching src / sid */
-
-                                                                    for (i = 0; i < counters_ipc->after_count_by_srcport; i++ ) {
-                                                                        if ( afterbysrcport_ipc[i].ipsrcport == ip_srcport_u32 && !strcmp(afterbysrcport_ipc[i].sid, rulestruct[b].s_sid )) {
-
-                                                                            after_flag = true;
-
-                                                                            Sagan_File_Lock(config->shm_after_by_srcport);
-                                                                            pthread_mutex_lock(&After_By_Src_Port_Mutex);
-
-                                                                            afterbysrcport_ipc[i].count++;
-                                                                            after_oldtime = atol(timet) - afterbysrcport_ipc[i].utime;
-                                                                            afterbysrcport_ipc[i].utime = atol(timet);
-
-                                                                            if ( after_oldtime > rulestruct[b].after_seconds ) {
-                                                                                afterbysrcport_ipc[i].count=1;
-                                                                                afterbysrcport_ipc[i].utime = atol(timet);
-                                                                                after_log_flag = true;
-                                                                            }
-
-                                                                            pthread_mutex_unlock(&After_By_Src_Port_Mutex);
-                                                                            Sagan_File_Unlock(config->shm_after_by_srcport);
-
-                                                                            if ( rulestruct[b].after_count < afterbysrcport_ipc[i].count ) {
-                                                                                after_log_flag = false;
-
-                                                                                if ( debug->debuglimits ) {
-                                                                                    Sagan_Log(S_NORMAL, "After SID %s by source IP port. [%d]", afterbysrcport_ipc[i].sid, ip_srcport_u32);
-                                                                                }
-
-                                                                                pthread_mutex_lock(&CounterMutex);
-                                                                                counters->after_total++;
-                                                                                pthread_mutex_unlock(&CounterMutex);
-                                                                            }
-                                                                        }
-                                                                    }
-
-                                                                    /* If not found,  add it to the array */
-
-                                                                    if ( after_flag == false ) {
-
-                                                                        if ( Sagan_Clean_IPC_Object(AFTER_BY_SRCPORT) == 0 ) {
-
-                                                                            Sagan_File_Lock(config->shm_after_by_srcport);
-                                                                            pthread_mutex_lock(&After_By_Src_Port_Mutex);
-
-                                                                            afterbysrcport_ipc[counters_ipc->after_count_by_srcport].ipsrcport = ip_srcport_u32;
-                                                                            strlcpy(afterbysrcport_ipc[counters_ipc->after_count_by_srcport].sid, rulestruct[b].s_sid, sizeof(afterbysrcport_ipc[counters_ipc->after_count_by_srcport].sid));
-                                                                            afterbysrcport_ipc[counters_ipc->after_count_by_srcport].count = 1;
-                                                                            afterbysrcport_ipc[counters_ipc->after_count_by_srcport].utime = atol(timet);
-                                                                            afterbysrcport_ipc[counters_ipc->after_count_by_srcport].expire = rulestruct[b].after_seconds;
-
-                                                                            Sagan_File_Unlock(config->shm_after_by_srcport);
-
-                                                                            Sagan_File_Lock(config->shm_counters);
-
-                                                                            counters_ipc->after_count_by_srcport++;
-
-                                                                            pthread_mutex_unlock(&After_By_Src_Port_Mutex);
-                                                                            Sagan_File_Unlock(config->shm_counters);
-
-                                                                        }
-
-                                                                    }
-                                                                }
-
-
-                                                                /* After by destination IP address */
-
-                                                                if ( rulestruct[b].after_method == 2 ) {
-
-                                                                    after_flag = false;
-
-                                                                    /* Check array for matching src / sid */
-
-                                                                    for (i = 0; i < counters_ipc->after_count_by_dst; i++ ) {
-                                                                        if ( afterbydst_ipc[i].ipdst == ip_dst_u32 && !strcmp(afterbydst_ipc[i].sid, rulestruct[b].s_sid )) {
-                                                                            after_flag = true;
-
-                                                                            Sagan_File_Lock(config->shm_after_by_dst);
-                                                                            pthread_mutex_lock(&After_By_Dst_Mutex);
-
-                                                                            afterbydst_ipc[i].count++;
-                                                                            after_oldtime = atol(timet) - afterbydst_ipc[i].utime;
-                                                                            afterbydst_ipc[i].utime = atol(timet);
-
-                                                                            if ( after_oldtime > rulestruct[b].after_seconds ) {
-                                                                                afterbydst_ipc[i].count=1;
-                                                                                afterbydst_ipc[i].utime = atol(timet);
-                                                                                after_log_flag = true;
-                                                                            }
-
-                                                                            pthread_mutex_unlock(&After_By_Dst_Mutex);
-                                                                            Sagan_File_Unlock(config->shm_after_by_dst);
-
-                                                                            if ( rulestruct[b].after_count < afterbydst_ipc[i].count ) {
-                                                                                after_log_flag = false;
-
-                                                                                if ( debug->debuglimits ) {
-                                                                                    Sagan_Log(S_NORMAL, "After SID %s by destination IP address. [%s]", afterbydst_ipc[i].sid, ip_dst);
-                                                                                }
-
-
-                                                                                pthread_mutex_lock(&CounterMutex);
-                                                                                counters->after_total++;
-                                                                                pthread_mutex_unlock(&CounterMutex);
-                                                                            }
-                                                                        }
-                                                                    }
-
-                                                                    /* If not found,  add it to the array */
-
-                                                                    if ( after_flag == false ) {
-
-                                                                        if ( Sagan_Clean_IPC_Object(AFTER_BY_DST) == 0 ) {
-
-                                                                            Sagan_File_Lock(config->shm_after_by_dst);
-                                                                            pthread_mutex_lock(&After_By_Dst_Mutex);
-
-                                                                            afterbydst_ipc[counters_ipc->after_count_by_dst].ipdst = ip_dst_u32;
-                                                                            strlcpy(afterbydst_ipc[counters_ipc->after_count_by_dst].sid, rulestruct[b].s_sid, sizeof(afterbydst_ipc[counters_ipc->after_count_by_dst].sid));
-                                                                            afterbydst_ipc[counters_ipc->after_count_by_dst].count = 1;
-                                                                            afterbydst_ipc[counters_ipc->after_count_by_dst].utime = atol(timet);
-                                                                            afterbydst_ipc[counters_ipc->after_count_by_dst].expire = rulestruct[b].after_seconds;
-
-                                                                            Sagan_File_Unlock(config->shm_after_by_dst);
-
-                                                                            Sagan_File_Lock(config->shm_counters);
-
-                                                                            counters_ipc->after_count_by_dst++;
-
-                                                                            pthread_mutex_unlock(&After_By_Dst_Mutex);
-                                                                            Sagan_File_Unlock(config->shm_counters);
-
-                                                                        }
-
-                                                                    }
-                                                                }
-
-                                                                /* After by source IP port */
-
-                                                                if ( rulestruct[b].after_method == 4 ) {
-
-                                                                    after_flag = false;
-
-                                                                    /* Check array for matching src / sid */
-
-                                                                    for (i = 0; i < counters_ipc->after_count_by_srcport; i++ ) {
-                                                                        if ( afterbysrcport_ipc[i].ipsrcport == ip_srcport_u32 && !strcmp(afterbysrcport_ipc[i].sid, rulestruct[b].s_sid )) {
-                                                                            after_flag = true;
-
-                                                                            Sagan_File_Lock(config->shm_after_by_srcport);
-                                                                            pthread_mutex_lock(&After_By_Src_Port_Mutex);
-
-                                                                            afterbysrcport_ipc[i].count++;
-                                                                            after_oldtime = atol(timet) - afterbysrcport_ipc[i].utime;
-                                                                            afterbysrcport_ipc[i].utime = atol(timet);
-
-                                                                            if ( after_oldtime > rulestruct[b].after_seconds ) {
-                                                                                afterbysrcport_ipc[i].count=1;
-                                                                                afterbysrcport_ipc[i].utime = atol(timet);
-                                                                                after_log_flag = true;
-                                                                            }
-
-                                                                            pthread_mutex_unlock(&After_By_Src_Port_Mutex);
-                                                                            Sagan_File_Unlock(config->shm_after_by_srcport);
-
-                                                                            if ( rulestruct[b].after_count < afterbysrcport_ipc[i].count ) {
-                                                                                after_log_flag = false;
-
-                                                                                if ( debug->debuglimits ) {
-                                                                                    Sagan_Log(S_NORMAL, "After SID %s by source IP port. [%d]", afterbysrcport_ipc[i].sid, ip_dstport_u32);
-                                                                                }
-
-                                                                                pthread_mutex_lock(&CounterMutex);
-                                                                                counters->after_total++;
-                                                                                pthread_mutex_unlock(&CounterMutex);
-                                                                            }
-                                                                        }
-                                                                    }
-
-                                                                    /* If not found,  add it to the array */
-
-                                                                    if ( after_flag == false ) {
-
-                                                                        if ( Sagan_Clean_IPC_Object(AFTER_BY_SRCPORT) == 0 ) {
-
-                                                                            Sagan_File_Lock(config->shm_after_by_srcport);
-                                                                            pthread_mutex_lock(&After_By_Src_Port_Mutex);
-
-                                                                            afterbysrcport_ipc[counters_ipc->after_count_by_srcport].ipsrcport = ip_srcport_u32;
-                                                                            strlcpy(afterbysrcport_ipc[counters_ipc->after_count_by_srcport].sid, rulestruct[b].s_sid, sizeof(afterbysrcport_ipc[counters_ipc->after_count_by_srcport].sid));
-                                                                            afterbysrcport_ipc[counters_ipc->after_count_by_srcport].count = 1;
-                                                                            afterbysrcport_ipc[counters_ipc->after_count_by_srcport].utime = atol(timet);
-                                                                            afterbysrcport_ipc[counters_ipc->after_count_by_srcport].expire = rulestruct[b].after_seconds;
-
-                                                                            Sagan_File_Unlock(config->shm_after_by_srcport);
-
-                                                                            Sagan_File_Lock(config->shm_counters);
-
-                                                                            counters_ipc->after_count_by_srcport++;
-
-                                                                            pthread_mutex_unlock(&After_By_Src_Port_Mutex);
-                                                                            Sagan_File_Unlock(config->shm_counters);
-
-                                                                        }
-
-                                                                    }
-                                                                }
-
-                                                                /* After by destination IP port */
-
-                                                                if ( rulestruct[b].after_method == 5 ) {
-
-                                                                    after_flag = false;
-
-                                                                    /* Check array for matching src / sid */
-
-                                                                    for (i = 0; i < counters_ipc->after_count_by_dstport; i++ ) {
-                                                                        if ( afterbydstport_ipc[i].ipdstport == ip_dstport_u32 && !strcmp(afterbydstport_ipc[i].sid, rulestruct[b].s_sid )) {
-                                                                            after_flag = true;
-
-                                                                            Sagan_File_Lock(config->shm_after_by_dstport);
-                                                                            pthread_mutex_lock(&After_By_Dst_Port_Mutex);
-
-                                                                            afterbydstport_ipc[i].count++;
-                                                                            after_oldtime = atol(timet) - afterbydstport_ipc[i].utime;
-                                                                            afterbydstport_ipc[i].utime = atol(timet);
-
-                                                                            if ( after_oldtime > rulestruct[b].after_seconds ) {
-                                                                                afterbydstport_ipc[i].count=1;
-                                                                                afterbydstport_ipc[i].utime = atol(timet);
-                                                                                after_log_flag = true;
-                                                                            }
-
-                                                                            pthread_mutex_unlock(&After_By_Dst_Port_Mutex);
-                                                                            Sagan_File_Unlock(config->shm_after_by_dstport);
-
-                                                                            if ( rulestruct[b].after_count < afterbydstport_ipc[i].count ) {
-                                                                                after_log_flag = false;
-
-                                                                                if ( debug->debuglimits ) {
-                                                                                    Sagan_Log(S_NORMAL, "After SID %s by destination IP port. [%d]", afterbydstport_ipc[i].sid, ip_dstport_u32);
-                                                                                }
-
-                                                                                pthread_mutex_lock(&CounterMutex);
-                                                                                counters->after_total++;
-                                                                                pthread_mutex_unlock(&CounterMutex);
-                                                                            }
-                                                                        }
-                                                                    }
-
-                                                                    /* If not found,  add it to the array */
-
-                                                                    if ( after_flag == false ) {
-
-                                                                        if ( Sagan_Clean_IPC_Object(AFTER_BY_DSTPORT) == 0 ) {
-
-                                                                            Sagan_File_Lock(config->shm_after_by_dstport);
-                                                                            pthread_mutex_lock(&After_By_Dst_Port_Mutex);
-
-                                                                            afterbydstport_ipc[counters_ipc->after_count_by_dstport].ipdstport = ip_dstport_u32;
-                                                                            strlcpy(afterbydstport_ipc[counters_ipc->after_count_by_dstport].sid, rulestruct[b].s_sid, sizeof(afterbydstport_ipc[counters_ipc->after_count_by_dstport].sid));
-                                                                            afterbydstport_ipc[counters_ipc->after_count_by_dstport].count = 1;
-                                                                            afterbydstport_ipc[counters_ipc->after_count_by_dstport].utime = atol(timet);
-                                                                            afterbydstport_ipc[counters_ipc->after_count_by_dstport].expire = rulestruct[b].after_seconds;
-
-                                                                            Sagan_File_Unlock(config->shm_after_by_dstport);
-
-                                                                            Sagan_File_Lock(config->shm_counters);
-
-                                                                            counters_ipc->after_count_by_dstport++;
-
-                                                                            pthread_mutex_unlock(&After_By_Dst_Port_Mutex);
-                                                                            Sagan_File_Unlock(config->shm_counters);
-
-                                                                        }
-
-                                                                    }
-                                                                }
-
-                                                                /* After by username */
-
-                                                                if ( rulestruct[b].after_method == 3 && normalize_username[0] != '\0' ) {
-
-                                                                    after_flag = false;
-
-                                                                    /* Check array for matching username / sid */
-
-                                                                    for (i = 0; i < counters_ipc->after_count_by_username; i++ ) {
-
-                                                                        if ( !strcmp(afterbyusername_ipc[i].username, normalize_username) && !strcmp(afterbyusername_ipc[i].sid, rulestruct[b].s_sid )) {
-                                                                            after_flag = true;
-
-                                                                            Sagan_File_Lock(config->shm_after_by_username);
-                                                                            pthread_mutex_lock(&After_By_Username_Mutex);
-
-                                                                            afterbyusername_ipc[i].count++;
-                                                                            after_oldtime = atol(timet) - afterbyusername_ipc[i].utime;
-                                                                            afterbyusername_ipc[i].utime = atol(timet);
-
-                                                                            if ( after_oldtime > rulestruct[b].after_seconds ) {
-                                                                                afterbyusername_ipc[i].count=1;
-                                                                                afterbyusername_ipc[i].utime = atol(timet);
-                                                                                after_log_flag = true;
-                                                                            }
-
-                                                                            pthread_mutex_unlock(&After_By_Username_Mutex);
-                                                                            Sagan_File_Unlock(config->shm_after_by_username);
-
-                                                                            if ( rulestruct[b].after_count < afterbyusername_ipc[i].count ) {
-                                                                                after_log_flag = false;
-
-                                                                                if ( debug->debuglimits ) {
-                                                                                    Sagan_Log(S_NORMAL, "After SID %s by_username. [%s]", afterbydst_ipc[i].sid, normalize_username);
-                                                                                }
-
-                                                                                pthread_mutex_lock(&CounterMutex);
-                                                                                counters->after_total++;
-                                                                                pthread_mutex_unlock(&CounterMutex);
-
-                                                                            }
-                                                                        }
-                                                                    }
-
-                                                                    /* If not found, add to the username array */
-
-                                                                    if ( after_flag == false ) {
-
-                                                                        if ( Sagan_Clean_IPC_Object(AFTER_BY_DST) == 0 ) {
-
-                                                                            Sagan_File_Lock(config->shm_after_by_username);
-                                                                            pthread_mutex_lock(&After_By_Username_Mutex);
-
-                                                                            strlcpy(afterbyusername_ipc[counters_ipc->after_count_by_username].username, normalize_username, sizeof(afterbyusername_ipc[counters_ipc->after_count_by_username].username));
-                                                                            strlcpy(afterbyusername_ipc[counters_ipc->after_count_by_username].sid, rulestruct[b].s_sid, sizeof(afterbyusername_ipc[counters_ipc->after_count_by_username].sid));
-                                                                            afterbyusername_ipc[counters_ipc->after_count_by_username].count = 1;
-                                                                            afterbyusername_ipc[counters_ipc->after_count_by_username].utime = atol(timet);
-                                                                            afterbyusername_ipc[counters_ipc->after_count_by_username].expire = rulestruct[b].after_seconds;
-
-                                                                            Sagan_File_Unlock(config->shm_after_by_username);
-
-                                                                            Sagan_File_Lock(config->shm_counters);
-
-                                                                            counters_ipc->after_count_by_username++;
-
-                                                                            pthread_mutex_unlock(&After_By_Username_Mutex);
-                                                                            Sagan_File_Unlock(config->shm_counters);
-
-                                                                        }
-
-                                                                    }
+                                                                if ( rulestruct[b].after_count < Sagan_Tracker_Hit(TRACK_AFTER, rulestruct[b].after_method, rulestruct[b].sid, &track_keys, rulestruct[b].after_seconds) ) {
+                                                                    after_log_flag = false;
+                                                                    Sagan_Thread_Counters()->after_total++;
                                                                 }
 
                                                             } /* End of After */
@@ -1423,391 +887,15 @@ int Sagan_Engine ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, sbool dynamic_rule
 
                                                             if ( rulestruct[b].threshold_type != 0 && after_log_flag == false ) {
 
-                                                                t = time(NULL);
-                                                                now=localtime(&t);
-                                                                strftime(timet, sizeof(timet), "%s",  now);
-
-                                                                /* Thresholding by source IP address */
-
-                                                                if ( rulestruct[b].threshold_method == 1 ) {
-                                                                    thresh_flag = false;
-
-                                                                    /* Check array for matching src / sid */
-
-                                                                    for (i = 0; i < counters_ipc->thresh_count_by_src; i++ ) {
-                                                                        if ( threshbysrc_ipc[i].ipsrc == ip_src_u32 && !strcmp(threshbysrc_ipc[i].sid, rulestruct[b].s_sid )) {
-
-                                                                            thresh_flag = true;
-
-                                                                            Sagan_File_Lock(config->shm_thresh_by_src);
-                                                                            pthread_mutex_lock(&Thresh_By_Src_Mutex);
-
-                                                                            threshbysrc_ipc[i].count++;
-                                                                            thresh_oldtime = atol(timet) - threshbysrc_ipc[i].utime;
-
-                                                                            threshbysrc_ipc[i].utime = atol(timet);
-
-                                                                            if ( thresh_oldtime > rulestruct[b].threshold_seconds ) {
-                                                                                threshbysrc_ipc[i].count=1;
-                                                                                threshbysrc_ipc[i].utime = atol(timet);
-                                                                                thresh_log_flag = false;
-                                                                            }
-
-                                                                            pthread_mutex_unlock(&Thresh_By_Src_Mutex);
-                                                                            Sagan_File_Unlock(config->shm_thresh_by_src);
-
-                                                                            if ( rulestruct[b].threshold_count < threshbysrc_ipc[i].count ) {
-                                                                                thresh_log_flag = true;
-
-                                                                                if ( debug->debuglimits ) {
-                                                                                    Sagan_Log(S_NORMAL, "Threshold SID %s by source IP address. [%s]", threshbysrc_ipc[i].sid, ip_src);
-                                                                                }
-
-                                                                                pthread_mutex_lock(&CounterMutex);
-                                                                                counters->threshold_total++;
-                                                                                pthread_mutex_unlock(&CounterMutex);
-
-                                                                            }
-
-                                                                        }
-                                                                    }
-
-                                                                    /* If not found,  add it to the array */
-
-                                                                    if ( thresh_flag == false ) {
-
-                                                                        if ( Sagan_Clean_IPC_Object(THRESH_BY_SRC) == 0 ) {
-
-                                                                            Sagan_File_Lock(config->shm_thresh_by_src);
-                                                                            pthread_mutex_lock(&Thresh_By_Src_Mutex);
-
-                                                                            threshbysrc_ipc[counters_ipc->thresh_count_by_src].ipsrc = ip_src_u32;
-                                                                            strlcpy(threshbysrc_ipc[counters_ipc->thresh_count_by_src].sid, rulestruct[b].s_sid, sizeof(threshbysrc_ipc[counters_ipc->thresh_count_by_src].sid));
-                                                                            threshbysrc_ipc[counters_ipc->thresh_count_by_src].count = 1;
-                                                                            threshbysrc_ipc[counters_ipc->thresh_count_by_src].utime = atol(timet);
-                                                                            threshbysrc_ipc[counters_ipc->thresh_count_by_src].expire = rulestruct[b].threshold_seconds;
-
-                                                                            Sagan_File_Unlock(config->shm_thresh_by_src);
-
-                                                                            Sagan_File_Lock(config->shm_counters);
-
-                                                                            counters_ipc->thresh_count_by_src++;
-
-                                                                            pthread_mutex_unlock(&Thresh_By_Src_Mutex);
-                                                                            Sagan_File_Unlock(config->shm_counters);
-
-                                                                        }
-
-                                                                    }
-                                                                }
-
-                                                                /* Thresholding by destination IP address */
-
-                                                                if ( rulestruct[b].threshold_method == 2 ) {
-                                                                    thresh_flag = false;
-
-                                                                    /* Check array for matching src / sid */
-
-                                                                    for (i = 0; i < counters_ipc->thresh_count_by_dst; i++ ) {
-                                                                        if ( threshbydst_ipc[i].ipdst == ip_dst_u32 && !strcmp(threshbydst_ipc[i].sid, rulestruct[b].s_sid )) {
-
-                                                                            thresh_flag = true;
-
-                                                                            Sagan_File_Lock(config->shm_thresh_by_dst);
-                                                                            pthread_mutex_lock(&Thresh_By_Dst_Mutex);
-
-                                                                            threshbydst_ipc[i].count++;
-                                                                            thresh_oldtime = atol(timet) - threshbydst_ipc[i].utime;
-                                                                            threshbydst_ipc[i].utime = atol(timet);
-                                                                            if ( thresh_oldtime > rulestruct[b].threshold_seconds ) {
-                                                                                threshbydst_ipc[i].count=1;
-                                                                                threshbydst_ipc[i].utime = atol(timet);
-                                                                                thresh_log_flag = false;
-                                                                            }
-
-                                                                            pthread_mutex_unlock(&Thresh_By_Src_Mutex);
-                                                                            Sagan_File_Unlock(config->shm_thresh_by_dst);
-
-
-                                                                            if ( rulestruct[b].threshold_count < threshbydst_ipc[i].count ) {
-                                                                                thresh_log_flag = true;
-
-                                                                                if ( debug->debuglimits ) {
-                                                                                    Sagan_Log(S_NORMAL, "Threshold SID %s by destination IP address. [%s]", threshbydst_ipc[i].sid, ip_dst);
-                                                                                }
-
-                                                                                pthread_mutex_lock(&CounterMutex);;
-                                                                                counters->threshold_total++;
-                                                                                pthread_mutex_unlock(&CounterMutex);
-                                                                            }
-                                                                        }
-                                                                    }
-
-                                                                    /* If not found,  add it to the array */
-
-                                                                    if ( thresh_flag == false ) {
-
-                                                                        if ( Sagan_Clean_IPC_Object(THRESH_BY_DST) == 0 ) {
-
-                                                                            Sagan_File_Lock(config->shm_thresh_by_dst);
-                                                                            pthread_mutex_lock(&Thresh_By_Src_Mutex);
-
-                                                                            threshbydst_ipc[counters_ipc->thresh_count_by_dst].ipdst = ip_dst_u32;
-                                                                            strlcpy(threshbydst_ipc[counters_ipc->thresh_count_by_dst].sid, rulestruct[b].s_sid, sizeof(threshbydst_ipc[counters_ipc->thresh_count_by_dst].sid));
-                                                                            threshbydst_ipc[counters_ipc->thresh_count_by_dst].count = 1;
-                                                                            threshbydst_ipc[counters_ipc->thresh_count_by_dst].utime = atol(timet);
-                                                                            threshbydst_ipc[counters_ipc->thresh_count_by_dst].expire = rulestruct[b].threshold_seconds;
-
-                                                                            Sagan_File_Unlock(config->shm_thresh_by_dst);
-
-                                                                            Sagan_File_Lock(config->shm_counters);
-
-                                                                            counters_ipc->thresh_count_by_dst++;
-
-                                                                            pthread_mutex_unlock(&Thresh_By_Src_Mutex);
-                                                                            Sagan_File_Unlock(config->shm_counters);
-
-                                                                        }
-
-                                                                    }
-                                                                }
-
-                                                                /* Thresholding by source IP port */
-
-                                                                if ( rulestruct[b].threshold_method == 4 ) {
-
-                                                                    thresh_flag = false;
-
-                                                                    /* Check array for matching src / sid */
-
-                                                                    for (i = 0; i < counters_ipc->thresh_count_by_srcport; i++ ) {
-
-                                                                        if ( threshbysrcport_ipc[i].ipsrcport == ip_srcport_u32 && !strcmp(threshbysrcport_ipc[i].sid, rulestruct[b].s_sid )) {
-
-                                                                            thresh_flag = true;
-
-                                                                            Sagan_File_Lock(config->shm_thresh_by_srcport);
-                                                                            pthread_mutex_lock(&Thresh_By_Src_Port_Mutex);
-
-                                                                            threshbysrcport_ipc[i].count++;
-                                                                            thresh_oldtime = atol(timet) - threshbysrcport_ipc[i].utime;
-                                                                            threshbysrcport_ipc[i].utime = atol(timet);
-                                                                            if ( thresh_oldtime > rulestruct[b].threshold_seconds ) {
-                                                                                threshbysrcport_ipc[i].count=1;
-                                                                                threshbysrcport_ipc[i].utime = atol(timet);
-                                                                                thresh_log_flag = false;
-                                                                            }
-
-                                                                            pthread_mutex_unlock(&Thresh_By_Src_Port_Mutex);
-                                                                            Sagan_File_Unlock(config->shm_thresh_by_srcport);
-
-
-                                                                            if ( rulestruct[b].threshold_count < threshbysrcport_ipc[i].count ) {
-                                                                                thresh_log_flag = true;
-
-                                                                                if ( debug->debuglimits ) {
-                                                                                    Sagan_Log(S_NORMAL, "Threshold SID %s by source IP port. [%s]", threshbydstport_ipc[i].sid, ip_dstport_u32);
-                                                                                }
-
-                                                                                pthread_mutex_lock(&CounterMutex);;
-                                                                                counters->threshold_total++;
-                                                                                pthread_mutex_unlock(&CounterMutex);
-                                                                            }
-                                                                        }
-                                                                    }
-
-                                                                    /* If not found,  add it to the array */
-
-                                                                    if ( thresh_flag == false ) {
-
-                                                                        if ( Sagan_Clean_IPC_Object(THRESH_BY_SRCPORT) == 0 ) {
-
-                                                                            Sagan_File_Lock(config->shm_thresh_by_srcport);
-                                                                            pthread_mutex_lock(&Thresh_By_Src_Port_Mutex);
-
-
-                                                                            threshbysrcport_ipc[counters_ipc->thresh_count_by_srcport].ipsrcport = ip_srcport_u32;
-                                                                            strlcpy(threshbysrcport_ipc[counters_ipc->thresh_count_by_srcport].sid, rulestruct[b].s_sid, sizeof(threshbysrcport_ipc[counters_ipc->thresh_count_by_srcport].sid));
-                                                                            threshbysrcport_ipc[counters_ipc->thresh_count_by_srcport].count = 1;
-                                                                            threshbysrcport_ipc[counters_ipc->thresh_count_by_srcport].utime = atol(timet);
-                                                                            threshbysrcport_ipc[counters_ipc->thresh_count_by_srcport].expire = rulestruct[b].threshold_seconds;
-
-                                                                            Sagan_File_Unlock(config->shm_thresh_by_srcport);
-
-                                                                            Sagan_File_Lock(config->shm_counters);
-
-                                                                            counters_ipc->thresh_count_by_srcport++;
-
-                                                                            pthread_mutex_unlock(&Thresh_By_Src_Port_Mutex);
-                                                                            Sagan_File_Unlock(config->shm_counters);
-
-                                                                        }
-
-                                                                    }
-                                                                }
-
-                                                                /* Thresholding by destination IP port */
-
-                                                                if ( rulestruct[b].threshold_method == 5 ) {
-
-                                                                    thresh_flag = false;
-
-                                                                    /* Check array for matching src / sid */
-
-                                                                    for (i = 0; i < counters_ipc->thresh_count_by_dstport; i++ ) {
-                                                                        if ( threshbydstport_ipc[i].ipdstport == ip_dstport_u32 && !strcmp(threshbydstport_ipc[i].sid, rulestruct[b].s_sid )) {
-
-                                                                            thresh_flag = true;
-
-                                                                            Sagan_File_Lock(config->shm_thresh_by_dstport);
-                                                                            pthread_mutex_lock(&Thresh_By_Dst_Port_Mutex);
-
-                                                                            threshbydstport_ipc[i].count++;
-                                                                            thresh_oldtime = atol(timet) - threshbydstport_ipc[i].utime;
-                                                                            threshbydstport_ipc[i].utime = atol(timet);
-                                                                            if ( thresh_oldtime > rulestruct[b].threshold_seconds ) {
-                                                                                threshbydstport_ipc[i].count=1;
-                                                                                threshbydstport_ipc[i].utime = atol(timet);
-                                                                                thresh_log_flag = false;
-                                                                            }
-
-                                                                            pthread_mutex_unlock(&Thresh_By_Dst_Port_Mutex);
-                                                                            Sagan_File_Unlock(config->shm_thresh_by_dstport);
-
-
-                                                                            if ( rulestruct[b].threshold_count < threshbydstport_ipc[i].count ) {
-                                                                                thresh_log_flag = true;
-
-                                                                                if ( debug->debuglimits ) {
-                                                                                    Sagan_Log(S_NORMAL, "Threshold SID %s by destination IP PORT. [%s]", threshbydstport_ipc[i].sid, ip_dstport_u32);
-                                                                                }
-
-                                                                                pthread_mutex_lock(&CounterMutex);;
-                                                                                counters->threshold_total++;
-                                                                                pthread_mutex_unlock(&CounterMutex);
-                                                                            }
-                                                                        }
-                                                                    }
-
-                                                                    /* If not found,  add it to the array */
-
-                                                                    if ( thresh_flag == false ) {
-
-                                                                        if ( Sagan_Clean_IPC_Object(THRESH_BY_DSTPORT) == 0 ) {
-
-                                                                            Sagan_File_Lock(config->shm_thresh_by_dstport);
-                                                                            pthread_mutex_lock(&Thresh_By_Dst_Port_Mutex);
-
-
-                                                                            threshbydstport_ipc[counters_ipc->thresh_count_by_dstport].ipdstport = ip_dstport_u32;
-                                                                            strlcpy(threshbydstport_ipc[counters_ipc->thresh_count_by_dstport].sid, rulestruct[b].s_sid, sizeof(threshbydstport_ipc[counters_ipc->thresh_count_by_dstport].sid));
-                                                                            threshbydstport_ipc[counters_ipc->thresh_count_by_dstport].count = 1;
-                                                                            threshbydstport_ipc[counters_ipc->thresh_count_by_dstport].utime = atol(timet);
-                                                                            threshbydstport_ipc[counters_ipc->thresh_count_by_dstport].expire = rulestruct[b].threshold_seconds;
-
-                                                                            Sagan_File_Unlock(config->shm_thresh_by_dstport);
-
-                                                                            Sagan_File_Lock(config->shm_counters);
-
-                                                                            counters_ipc->thresh_count_by_dstport++;
-
-                                                                            pthread_mutex_unlock(&Thresh_By_Dst_Port_Mutex);
-                                                                            Sagan_File_Unlock(config->shm_counters);
-
-                                                                        }
-
-                                                                    }
-                                                                }
-
-
-                                                                if ( rulestruct[b].threshold_method == 3 && normalize_username[0] != '\0' ) {
-
-                                                                    thresh_flag = false;
-
-                                                                    /* Check array fror matching username / sid */
-
-                                                                    for (i = 0; i < counters_ipc->thresh_count_by_username; i++) {
-
-                                                                        if ( !strcmp(threshbyusername_ipc[i].username, normalize_username) && !strcmp(threshbyusername_ipc[i].sid, rulestruct[b].s_sid )) {
-
-                                                                            thresh_flag = true;
-
-                                                                            Sagan_File_Lock(config->shm_thresh_by_username);
-                                                                            pthread_mutex_lock(&Thresh_By_Username_Mutex);
-
-                                                                            threshbyusername_ipc[i].count++;
-                                                                            thresh_oldtime = atol(timet) - threshbyusername_ipc[i].utime;
-                                                                            threshbyusername_ipc[i].utime = atol(timet);
-
-                                                                            if ( thresh_oldtime > rulestruct[b].threshold_seconds ) {
-                                                                                threshbyusername_ipc[i].count=1;
-                                                                                threshbyusername_ipc[i].utime = atol(timet);
-                                                                                thresh_log_flag = false;
-                                                                            }
-
-                                                                            pthread_mutex_unlock(&Thresh_By_Username_Mutex);
-                                                                            Sagan_File_Unlock(config->shm_thresh_by_username);
-
-                                                                            if ( rulestruct[b].threshold_count < threshbyusername_ipc[i].count ) {
-
-                                                                                thresh_log_flag = true;
-
-                                                                                if ( debug->debuglimits ) {
-                                                                                    Sagan_Log(S_NORMAL, "Threshold SID %s by_username. [%s]", threshbyusername_ipc[i].sid, normalize_username);
-                                                                                }
-
-                                                                                pthread_mutex_lock(&CounterMutex);;
-                                                                                counters->threshold_total++;
-                                                                                pthread_mutex_unlock(&CounterMutex);
-
-                                                                            }
-
-                                                                        }
-                                                                    }
-
-                                                                    /* Username not found, add it to array */
-
-                                                                    if ( thresh_flag == false ) {
-
-                                                                        Sagan_File_Lock(config->shm_thresh_by_username);
-                                                                        pthread_mutex_lock(&Thresh_By_Username_Mutex);
-
-                                                                        strlcpy(threshbyusername_ipc[counters_ipc->thresh_count_by_username].username, normalize_username, sizeof(threshbyusername_ipc[counters_ipc->thresh_count_by_username].username));
-                                                                        strlcpy(threshbyusername_ipc[counters_ipc->thresh_count_by_username].sid, rulestruct[b].s_sid, sizeof(threshbyusername_ipc[counters_ipc->thresh_count_by_username].sid));
-                                                                        threshbyusername_ipc[counters_ipc->thresh_count_by_username].count = 1;
-                                                                        threshbyusername_ipc[counters_ipc->thresh_count_by_username].utime = atol(timet);
-                                                                        threshbyusername_ipc[counters_ipc->thresh_count_by_username].expire = rulestruct[b].threshold_seconds;
-
-
-                                                                        Sagan_File_Unlock(config->shm_thresh_by_username);
-
-//                                                                   if ( config->max_threshold_by_username < counters_ipc->thresh_count_by_username ) {
-//                                                                        Sagan_Log(S_WARN, "[%s, line %d] Max 'threshold_by_username' of %d has been reached! Consider increasing 'threshold_by_username'!", __FILE__, __LINE__, config->max_threshold_by_username );
-
-//									pthread_mutex_unlock(&Thresh_By_Username_Mutex);
-
-
-//                                                                    } else {
-
-                                                                        Sagan_File_Lock(config->shm_counters);
-
-                                                                        counters_ipc->thresh_count_by_username++;
-
-                                                                        pthread_mutex_unlock(&Thresh_By_Username_Mutex);
-                                                                        Sagan_File_Unlock(config->shm_counters);
-
-//                                                                    }
-
-                                                                    }
-
+                                                                if ( rulestruct[b].threshold_count < Sagan_Tracker_Hit(TRACK_THRESHOLD, rulestruct[b].threshold_method, rulestruct[b].sid, &track_keys, rulestruct[b].threshold_seconds) ) {
+                                                                    thresh_log_flag = true;
+                                                                    Sagan_Thread_Counters()->threshold_total++;
                                                                 }
 
                                                             }  /* End of thresholding */
 
 
-                                                            pthread_mutex_lock(&CounterMutex);
-                                                            counters->saganfound++;
-                                                            pthread_mutex_unlock(&CounterMutex);
+                                                            Sagan_Thread_Counters()->saganfound++;
 
                                                             /* Check for thesholding & "after" */
 
@@ -1911,6 +999,8 @@ int Sagan_Engine ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, sbool dynamic_rule
 
     } /* End for for loop */
 
+    Sagan_Fold_Clear();
+
     free(processor_info_engine);
 
     return(0);
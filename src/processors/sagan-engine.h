@@ -28,4 +28,3 @@
 #define SAGAN_PROCESSOR_GENERATOR_ID 1
 
 int Sagan_Engine ( _Sagan_Proc_Syslog *, sbool );
-void Sagan_Engine_Init ( void );
@@ -40,6 +40,8 @@
 #include "sagan.h"
 #include "sagan-defs.h"
 #include "sagan-config.h"
+#include "sagan-counters.h"
+#include "sagan-clock.h"
 #include "sagan-lockfile.h"
 
 struct _SaganConfig *config;
@@ -58,13 +60,7 @@ void Sagan_Perfmonitor_Handler( void )
     unsigned long total=0;
     unsigned long seconds=0;
 
-    char curtime_utime[64] = { 0 };
-    time_t t;
-    struct tm *now;
-
-    t = time(NULL);
-    now=localtime(&t);
-    strftime(curtime_utime, sizeof(curtime_utime), "%s",  now);
+    uint64_t curtime_utime = 0;
 
     uintmax_t last_sagantotal = 0;
     uintmax_t last_saganfound = 0;
@@ -111,15 +107,15 @@ void Sagan_Perfmonitor_Handler( void )
 
         sleep(config->perfmonitor_time);
 
-        t = time(NULL);
-        now=localtime(&t);
-        strftime(curtime_utime, sizeof(curtime_utime), "%s",  now);
-        seconds = atol(curtime_utime) - atol(config->sagan_startutime);
+        Sagan_Counters_Sum();
+
+        curtime_utime = Sagan_Clock_Now();
+        seconds = curtime_utime - config->sagan_startutime;
 
 
         if ( config->perfmonitor_flag ) {
 
-            fprintf(config->perfmonitor_file_stream, "%s,", curtime_utime),
+            fprintf(config->perfmonitor_file_stream, "%" PRIu64 ",", curtime_utime),
 
                     fprintf(config->perfmonitor_file_stream, "%" PRIuMAX ",", counters->sagantotal - last_sagantotal);
             last_sagantotal = counters->sagantotal;
@@ -37,207 +37,209 @@
 #include <pthread.h>
 #include <arpa/inet.h>
 #include <unistd.h>
+#include <stdbool.h>
 
 #include "sagan.h"
 #include "sagan-defs.h"
+#include "sagan-message.h"
 #include "sagan-send-alert.h"
 #include "sagan-track-clients.h"
 #include "sagan-report-clients.h"
 #include "sagan-config.h"
+#include "sagan-clock.h"
+#include "sagan-timer.h"
 
 struct _Sagan_Track_Clients_IPC *SaganTrackClients_ipc;
 struct _Sagan_IPC_Counters *counters_ipc;
 
 struct _SaganConfig *config;
 struct _Sagan_Processor_Info *processor_info_track_client = NULL;
-struct _Sagan_Proc_Syslog *SaganProcSyslog;
 
 /****************************************************************************
- * Sagan_Track_Clients_Init - Initialize shared memory object for the
- * tracking client processor to use
+ * Sagan_Track_Clients_Status - Atomically moves a client from one status
+ * to another.  Returns false if another thread or Sagan process got there
+ * first.
  ****************************************************************************/
 
-void Sagan_Track_Clients_Init ( void )
+static sbool Sagan_Track_Clients_Status ( int i, sbool from, sbool to )
 {
+    return( __atomic_compare_exchange_n(&SaganTrackClients_ipc[i].status, &from, to, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED) );
+}
 
-    processor_info_track_client = malloc(sizeof(struct _Sagan_Processor_Info));
+/****************************************************************************
+ * Sagan_Report_Clients_Alert - Sends a client up/down alert to the output
+ * plugins
+ ****************************************************************************/
 
-    if ( processor_info_track_client == NULL ) {
-        Sagan_Log(S_ERROR, "[%s, line %d] Failed to allocate memory for processor_info_track_client. Abort!", __FILE__, __LINE__);
-    }
+static void Sagan_Report_Clients_Alert ( char *tmp_ip, int alertid, char *tmp_message, uint64_t utime )
+{
 
-    memset(processor_info_track_client, 0, sizeof(_Sagan_Processor_Info));
+    struct _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL = NULL;
 
-    processor_info_track_client->processor_name         =       PROCESSOR_NAME;
-    processor_info_track_client->processor_generator_id =       PROCESSOR_GENERATOR_ID;
-    processor_info_track_client->processor_name         =       PROCESSOR_NAME;
-    processor_info_track_client->processor_facility     =       PROCESSOR_FACILITY;
-    processor_info_track_client->processor_priority     =       PROCESSOR_PRIORITY;
-    processor_info_track_client->processor_pri          =       PROCESSOR_PRI;
-    processor_info_track_client->processor_class        =       PROCESSOR_CLASS;
-    processor_info_track_client->processor_tag          =       PROCESSOR_TAG;
-    processor_info_track_client->processor_rev          =       PROCESSOR_REV;
+    char *tmp = NULL;
 
-}
+    /* We populate this for output plugins */
 
-/****************************************************************************
- * Sagan_Report_Clients - Main routine to "report" via IPC/memory IPs that
- * are reporting or not.
- ****************************************************************************/
+    SaganProcSyslog_LOCAL = malloc(sizeof(struct _Sagan_Proc_Syslog));
 
-void Sagan_Report_Clients ( void )
-{
+    if ( SaganProcSyslog_LOCAL == NULL ) {
+        Sagan_Log(S_ERROR, "[%s, line %d] Failed to allocate memory for SaganProcSyslog_LOCAL. Abort!", __FILE__, __LINE__);
+    }
 
+    Sagan_Message_Reset(SaganProcSyslog_LOCAL);
 
-    for(;;) {
+    SaganProcSyslog_LOCAL->syslog_host = Sagan_Message_Append(SaganProcSyslog_LOCAL, tmp_ip, strlen(tmp_ip));
+    SaganProcSyslog_LOCAL->syslog_facility = PROCESSOR_FACILITY;
+    SaganProcSyslog_LOCAL->syslog_priority = PROCESSOR_PRIORITY;
+    SaganProcSyslog_LOCAL->syslog_level = "info";
+    SaganProcSyslog_LOCAL->syslog_tag = "00";
+    SaganProcSyslog_LOCAL->syslog_program = PROCESSOR_NAME;
 
-        struct _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL = NULL;
+    tmp = Sagan_Return_Date(utime);
+    SaganProcSyslog_LOCAL->syslog_date = Sagan_Message_Append(SaganProcSyslog_LOCAL, tmp, strlen(tmp));
 
-        int alertid;
-        int i;
+    tmp = Sagan_Return_Time(utime);
+    SaganProcSyslog_LOCAL->syslog_time = Sagan_Message_Append(SaganProcSyslog_LOCAL, tmp, strlen(tmp));
 
-        char *tmp_ip = NULL;
+    SaganProcSyslog_LOCAL->syslog_message = Sagan_Message_Append(SaganProcSyslog_LOCAL, tmp_message, strlen(tmp_message));
+    SaganProcSyslog_LOCAL->syslog_message_len = strlen(SaganProcSyslog_LOCAL->syslog_message);
 
-        char utime_tmp[20] = { 0 };
-        time_t t;
-        struct tm *now;
+    /* Send alert to output plugins */
 
-        uintmax_t utime_u32;
+    Sagan_Send_Alert(SaganProcSyslog_LOCAL,
+                     processor_info_track_client,
+                     SaganProcSyslog_LOCAL->syslog_host,
+                     config->sagan_host,
+                     "\0",
+                     "\0",
+                     config->sagan_proto,
+                     alertid,
+                     config->sagan_port,
+                     config->sagan_port,
+                     0);
 
-        t = time(NULL);
-        now=localtime(&t);
-        strftime(utime_tmp, sizeof(utime_tmp), "%s",  now);
-        utime_u32 = atol(utime_tmp);
+    free(SaganProcSyslog_LOCAL);
 
-        int expired_time = config->pp_sagan_track_clients * 60;
+}
 
-        /* We populate this later for output plugins */
+/****************************************************************************
+ * Sagan_Report_Clients - Timer callback for a client (id is its position,
+ * key its IP).  Reports the client as down once it has been quiet for
+ * "track_clients" minutes,  then checks every TRACK_CLIENTS_RECHECK
+ * seconds for it to come back.
+ ****************************************************************************/
 
-        SaganProcSyslog_LOCAL = malloc(sizeof(struct _Sagan_Proc_Syslog));
+static uint64_t Sagan_Report_Clients ( uint32_t id, uint64_t key, uint64_t utime )
+{
 
-        if ( SaganProcSyslog_LOCAL == NULL ) {
-            Sagan_Log(S_ERROR, "[%s, line %d] Failed to allocate memory for SaganProcSyslog_LOCAL. Abort!", __FILE__, __LINE__);
-        }
+    char *tmp_ip = NULL;
+    char tmp_message[MAX_SYSLOGMSG] = { 0 };
 
-        /*********************************/
-        /* Look through "known" system */
+    int expired_time = config->pp_sagan_track_clients * 60;
+    long last;
 
-        for (i=0; i<counters_ipc->track_clients_client_count; i++) {
+    /* Table was reset */
 
-            /* Check if host is in a down state */
+    if ( id >= (uint32_t)__atomic_load_n(&counters_ipc->track_clients_client_count, __ATOMIC_ACQUIRE) ||
+         SaganTrackClients_ipc[id].host_u32 != key ) {
+        return(0);
+    }
 
-            if ( SaganTrackClients_ipc[i].status == 1 ) {
+    last = __atomic_load_n(&SaganTrackClients_ipc[id].utime, __ATOMIC_RELAXED);
 
-                /* If host was done, verify host last seen time is still not an expired time */
+    /* Check if host is in a down state */
 
-                if ( ( utime_u32 - SaganTrackClients_ipc[i].utime ) < expired_time ) {
+    if ( SaganTrackClients_ipc[id].status == 1 ) {
 
-                    /* Update status and seen time */
+        /* Still down */
 
-                    Sagan_File_Lock(config->shm_track_clients);
-                    SaganTrackClients_ipc[i].status = 0;
-                    Sagan_File_Unlock(config->shm_track_clients);
+        if ( (uint64_t)last + expired_time <= utime ) {
+            return(utime + TRACK_CLIENTS_RECHECK);
+        }
 
-                    /* Update counters */
+        /* Update status.  Only the thread/process that flips the status
+         * reports it */
 
-                    Sagan_File_Lock(config->shm_counters);
-                    counters_ipc->track_clients_down--;
-                    Sagan_File_Unlock(config->shm_counters);
+        if ( Sagan_Track_Clients_Status(id, 1, 0) == true ) {
 
-                    tmp_ip = Bit2IP(SaganTrackClients_ipc[i].host_u32);
+            __atomic_sub_fetch(&counters_ipc->track_clients_down, 1, __ATOMIC_RELAXED);
 
-                    Sagan_Log(S_WARN, "[Processor: %s] Logs are being received from %s again.",  PROCESSOR_NAME, tmp_ip );
+            tmp_ip = Bit2IP(SaganTrackClients_ipc[id].host_u32);
 
-                    /* Populate SaganProcSyslog_LOCAL for output plugins */
+            Sagan_Log(S_WARN, "[Processor: %s] Logs are being received from %s again.",  PROCESSOR_NAME, tmp_ip );
 
-                    strlcpy(SaganProcSyslog_LOCAL->syslog_host, tmp_ip, sizeof(SaganProcSyslog_LOCAL->syslog_host));
-                    strlcpy(SaganProcSyslog_LOCAL->syslog_facility, PROCESSOR_FACILITY, sizeof(SaganProcSyslog_LOCAL->syslog_facility));
-                    strlcpy(SaganProcSyslog_LOCAL->syslog_priority, PROCESSOR_PRIORITY, sizeof(SaganProcSyslog_LOCAL->syslog_priority));
-                    strlcpy(SaganProcSyslog_LOCAL->syslog_level, "info", sizeof(SaganProcSyslog_LOCAL->syslog_level));
-                    strlcpy(SaganProcSyslog_LOCAL->syslog_tag, "00", sizeof(SaganProcSyslog_LOCAL->syslog_tag));
-                    strlcpy(SaganProcSyslog_LOCAL->syslog_program, PROCESSOR_NAME, sizeof(SaganProcSyslog_LOCAL->syslog_program));
+            snprintf(tmp_message, sizeof(tmp_message), "The IP address %s was previously not sending logs. The system appears to be sending logs again at %s", tmp_ip, ctime(&last) );
 
-                    snprintf(SaganProcSyslog_LOCAL->syslog_date, sizeof(SaganProcSyslog_LOCAL->syslog_date), "%s", Sagan_Return_Date(utime_u32));
-                    snprintf(SaganProcSyslog_LOCAL->syslog_time, sizeof(SaganProcSyslog_LOCAL->syslog_time), "%s", Sagan_Return_Time(utime_u32));
+            Sagan_Report_Clients_Alert(tmp_ip, 101, tmp_message, utime);		/* See gen-msg.map */
+        }
 
-                    snprintf(SaganProcSyslog_LOCAL->syslog_message, sizeof(SaganProcSyslog_LOCAL->syslog_message)-1, "The IP address %s was previously not sending logs. The system appears to be sending logs again at %s", tmp_ip, ctime(&SaganTrackClients_ipc[i].utime) );
+        return(last + expired_time);
 
-                    alertid=101;		/* See gen-msg.map */
+    }
 
-                    /* Send alert to output plugins */
+    /**** Check if last seen time of host has exceeded track time meaning it's down! ****/
 
-                    Sagan_Send_Alert(SaganProcSyslog_LOCAL,
-                                     processor_info_track_client,
-                                     SaganProcSyslog_LOCAL->syslog_host,
-                                     config->sagan_host,
-                                     "\0",
-                                     "\0",
-                                     config->sagan_proto,
-                                     alertid,
-                                     config->sagan_port,
-                                     config->sagan_port,
-                                     0);
-                } /* End last seen check time */
+    if ( (uint64_t)last + expired_time > utime ) {
+        return(last + expired_time);
+    }
 
-            } else {
+    if ( Sagan_Track_Clients_Status(id, 0, 1) == true ) {
 
-                /**** Check if last seen time of host has exceeded track time meaning it's down! ****/
+        __atomic_add_fetch(&counters_ipc->track_clients_down, 1, __ATOMIC_RELAXED);
 
-                if ( ( utime_u32 - SaganTrackClients_ipc[i].utime ) >= expired_time ) {
-                    /* Update status and utime */
+        tmp_ip = Bit2IP(SaganTrackClients_ipc[id].host_u32);
 
-                    Sagan_File_Lock(config->shm_track_clients);
-                    SaganTrackClients_ipc[i].status = 1;
-                    Sagan_File_Unlock(config->shm_track_clients);
+        Sagan_Log(S_WARN, "[Processor: %s] Logs have not been seen from %s for %d minute(s).", PROCESSOR_NAME, tmp_ip, config->pp_sagan_track_clients);
 
-                    /* Update counters */
+        snprintf(tmp_message, sizeof(tmp_message), "Sagan has not recieved any logs from the IP address %s in over %d minute(s). Last log was seen at %s. This could be an indication that the system is down.", tmp_ip, config->pp_sagan_track_clients, ctime(&last) );
 
-                    Sagan_File_Lock(config->shm_counters);
-                    counters_ipc->track_clients_down++;
-                    Sagan_File_Unlock(config->shm_counters);
+        Sagan_Report_Clients_Alert(tmp_ip, 100, tmp_message, utime);		/* See gen-msg.map */
+    }
 
-                    tmp_ip = Bit2IP(SaganTrackClients_ipc[i].host_u32);
+    return(utime + TRACK_CLIENTS_RECHECK);
 
-                    Sagan_Log(S_WARN, "[Processor: %s] Logs have not been seen from %s for %d minute(s).", PROCESSOR_NAME, tmp_ip, config->pp_sagan_track_clients);
+} /* End Sagan_report_clients */
 
-                    /* Populate SaganProcSyslog_LOCAL for output plugins */
+/****************************************************************************
+ * Sagan_Track_Clients_Init - Initialize shared memory object for the
+ * tracking client processor to use
+ ****************************************************************************/
 
-                    strlcpy(SaganProcSyslog_LOCAL->syslog_host, tmp_ip, sizeof(SaganProcSyslog_LOCAL->syslog_host));
-                    strlcpy(SaganProcSyslog_LOCAL->syslog_facility, PROCESSOR_FACILITY, sizeof(SaganProcSyslog_LOCAL->syslog_facility));
-                    strlcpy(SaganProcSyslog_LOCAL->syslog_priority, PROCESSOR_PRIORITY, sizeof(SaganProcSyslog_LOCAL->syslog_priority));
-                    strlcpy(SaganProcSyslog_LOCAL->syslog_level, "info", sizeof(SaganProcSyslog_LOCAL->syslog_level));
-                    strlcpy(SaganProcSyslog_LOCAL->syslog_tag, "00", sizeof(SaganProcSyslog_LOCAL->syslog_tag));
-                    strlcpy(SaganProcSyslog_LOCAL->syslog_program, PROCESSOR_NAME, sizeof(SaganProcSyslog_LOCAL->syslog_program));
+void Sagan_Track_Clients_Init ( void )
+{
 
-                    snprintf(SaganProcSyslog_LOCAL->syslog_date, sizeof(SaganProcSyslog_LOCAL->syslog_date), "%s", Sagan_Return_Date(utime_u32));
-                    snprintf(SaganProcSyslog_LOCAL->syslog_time, sizeof(SaganProcSyslog_LOCAL->syslog_time), "%s", Sagan_Return_Time(utime_u32));
+    int i;
+    int count;
+    uint64_t utime;
 
-                    snprintf(SaganProcSyslog_LOCAL->syslog_message, sizeof(SaganProcSyslog_LOCAL->syslog_message)-1, "Sagan has not recieved any logs from the IP address %s in over %d minute(s). Last log was seen at %s. This could be an indication that the system is down.", tmp_ip, config->pp_sagan_track_clients, ctime(&SaganTrackClients_ipc[i].utime) );
+    processor_info_track_client = malloc(sizeof(struct _Sagan_Processor_Info));
 
-                    alertid=100;	/* See gen-msg.map  */
+    if ( processor_info_track_client == NULL ) {
+        Sagan_Log(S_ERROR, "[%s, line %d] Failed to allocate memory for processor_info_track_client. Abort!", __FILE__, __LINE__);
+    }
 
-                    /* Send alert to output plugins */
+    memset(processor_info_track_client, 0, sizeof(_Sagan_Processor_Info));
 
-                    Sagan_Send_Alert(SaganProcSyslog_LOCAL,
-                                     processor_info_track_client,
-                                     SaganProcSyslog_LOCAL->syslog_host,
-                                     config->sagan_host,
-                                     "\0",
-                                     "\0",
-                                     config->sagan_proto,
-                                     alertid,
-                                     config->sagan_port,
-                                     config->sagan_port,
-                                     0);
+    processor_info_track_client->processor_name         =       PROCESSOR_NAME;
+    processor_info_track_client->processor_generator_id =       PROCESSOR_GENERATOR_ID;
+    processor_info_track_client->processor_name         =       PROCESSOR_NAME;
+    processor_info_track_client->processor_facility     =       PROCESSOR_FACILITY;
+    processor_info_track_client->processor_priority     =       PROCESSOR_PRIORITY;
+    processor_info_track_client->processor_pri          =       PROCESSOR_PRI;
+    processor_info_track_client->processor_class        =       PROCESSOR_CLASS;
+    processor_info_track_client->processor_tag          =       PROCESSOR_TAG;
+    processor_info_track_client->processor_rev          =       PROCESSOR_REV;
 
-                }  /* End of existing utime check */
+    /* Clients are checked by the housekeeping thread.  Add timers for the
+     * ones loaded from the IPC file */
 
-            } /* End of else */
+    Sagan_Timer_Register(TIMER_TRACK_CLIENTS, Sagan_Report_Clients);
 
-        }  /* End for 'for' loop */
-        free(SaganProcSyslog_LOCAL);
-        sleep(60);
+    utime = Sagan_Clock_Now();
+    count = __atomic_load_n(&counters_ipc->track_clients_client_count, __ATOMIC_ACQUIRE);
 
-    } /* End Ifinite Loop */
+    for (i=0; i<count; i++) {
+        Sagan_Timer_Add(TIMER_TRACK_CLIENTS, i, SaganTrackClients_ipc[i].host_u32, utime);
+    }
 
-} /* End Sagan_report_clients */
+}
@@ -36,5 +36,6 @@
 #define PROCESSOR_TAG NULL
 #define PROCESSOR_GENERATOR_ID 100
 
+#define TRACK_CLIENTS_RECHECK 60		/* Seconds between checks of a down client */
+
 void Sagan_Track_Clients_Init ( void );
-void Sagan_Report_Clients ( void );
@@ -42,6 +42,9 @@
 #include "sagan-defs.h"
 #include "sagan-track-clients.h"
 #include "sagan-config.h"
+#include "sagan-clock.h"
+#include "sagan-ipc-lock.h"
+#include "sagan-timer.h"
 
 struct _Sagan_Track_Clients_IPC *SaganTrackClients_ipc;
 struct _Sagan_IPC_Counters *counters_ipc;
@@ -56,16 +59,10 @@ struct _SaganConfig *config;
 int Sagan_Track_Clients ( uint32_t host_u32 )
 {
 
-    char utime_tmp[20] = { 0 };
-    time_t t;
-    struct tm *now;
     int i;
-    uintmax_t utime_u64;
+    int count;
+    uintmax_t utime_u64 = Sagan_Clock_Now();
 
-    t = time(NULL);
-    now=localtime(&t);
-    strftime(utime_tmp, sizeof(utime_tmp), "%s",  now);
-    utime_u64 = atol(utime_tmp);
     int expired_time = config->pp_sagan_track_clients * 60;
 
     if ( host_u32 == 0 ) {
@@ -77,35 +74,52 @@ int Sagan_Track_Clients ( uint32_t host_u32 )
     /** Record Clients Here **/
     /*************************/
 
-    for (i=0; i<counters_ipc->track_clients_client_count; i++) {
+    count = __atomic_load_n(&counters_ipc->track_clients_client_count, __ATOMIC_ACQUIRE);
+
+    for (i=0; i<count; i++) {
         if ( SaganTrackClients_ipc[i].host_u32 == host_u32 ) {
+            __atomic_store_n(&SaganTrackClients_ipc[i].utime, utime_u64, __ATOMIC_RELAXED);
+            __atomic_store_n(&SaganTrackClients_ipc[i].expire, expired_time, __ATOMIC_RELAXED);
+            return(true);
+        }
+    }
 
-            Sagan_File_Lock(config->shm_track_clients);
-            SaganTrackClients_ipc[i].utime = utime_u64;
-            SaganTrackClients_ipc[i].expire = expired_time;
-            Sagan_File_Unlock(config->shm_track_clients);
+    /* New client.  Another thread or Sagan process may have added it
+     * since the search above,  so check the new entries again under
+     * the lock */
+
+    Sagan_IPC_Lock(&counters_ipc->track_clients_lock);
+
+    for (i=count; i<counters_ipc->track_clients_client_count; i++) {
+        if ( SaganTrackClients_ipc[i].host_u32 == host_u32 ) {
+            Sagan_IPC_Unlock(&counters_ipc->track_clients_lock);
             return(true);
         }
     }
 
     if ( counters_ipc->track_clients_client_count < config->max_track_clients ) {
-        Sagan_File_Lock(config->shm_track_clients);
-        SaganTrackClients_ipc[counters_ipc->track_clients_client_count].host_u32 = host_u32;
-        SaganTrackClients_ipc[counters_ipc->track_clients_client_count].utime = utime_u64;
-        SaganTrackClients_ipc[counters_ipc->track_clients_client_count].status = 0;
-        SaganTrackClients_ipc[counters_ipc->track_clients_client_count].expire = expired_time;
-        Sagan_File_Unlock(config->shm_track_clients);
-
-        Sagan_File_Lock(config->shm_counters);
-        counters_ipc->track_clients_client_count++;
-        Sagan_File_Unlock(config->shm_counters);
-        return(false);
 
-    } else {
+        i = counters_ipc->track_clients_client_count;
 
-        Sagan_Log(S_WARN, "[%s, line %d] Client tracking has reached it's max! (%d).  Increase 'track_clients' in your configuration!", __FILE__, __LINE__, config->max_track_clients);
+        SaganTrackClients_ipc[i].host_u32 = host_u32;
+        SaganTrackClients_ipc[i].utime = utime_u64;
+        SaganTrackClients_ipc[i].status = 0;
+        SaganTrackClients_ipc[i].expire = expired_time;
+
+        /* Publish the entry only once it's filled in */
+
+        __atomic_store_n(&counters_ipc->track_clients_client_count, i + 1, __ATOMIC_RELEASE);
+
+        Sagan_IPC_Unlock(&counters_ipc->track_clients_lock);
+
+        Sagan_Timer_Add(TIMER_TRACK_CLIENTS, i, host_u32, utime_u64 + expired_time);
+        return(false);
 
     }
 
+    Sagan_IPC_Unlock(&counters_ipc->track_clients_lock);
+
+    Sagan_Log(S_WARN, "[%s, line %d] Client tracking has reached it's max! (%d).  Increase 'track_clients' in your configuration!", __FILE__, __LINE__, config->max_track_clients);
+
     return(true);
 } /* CLose sagan_track_clients */
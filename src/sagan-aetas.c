@@ -42,52 +42,21 @@
 #include "sagan.h"
 #include "sagan-aetas.h"
 #include "sagan-rules.h"
+#include "sagan-clock.h"
 
 struct _Rule_Struct *rulestruct;
 
 int Sagan_Check_Time(int rule_number)
 {
 
-    char ct[64] = { 0 };
-    char buf[80] = { 0 };
-
-    int day_current;
-
-    time_t     now;
-    struct     tm  ts;
-
-    /* For current utime */
-    time_t t;
-    struct tm *now_utime;
+    const _Sagan_Clock *now = Sagan_Clock_Get();
 
+    int day_current = now->wday;
+    int current_time = now->hhmm;
 
     sbool   next_day = 0;
     sbool   off_day = 0;
 
-    char current_time_tmp[5];
-    char hour_tmp[3];
-    char minute_tmp[3];
-
-    int	 current_time;
-
-    /* Get current utime / and day of the week */
-
-    t = time(NULL);
-    now_utime=localtime(&t);
-    strftime(ct, sizeof(ct), "%s",  now_utime);
-    day_current = localtime(&t)->tm_wday;
-
-    time(&now);
-    ts = *localtime(&now);
-
-    strftime(hour_tmp, sizeof(buf), "%H", &ts);
-    strftime(minute_tmp, sizeof(buf), "%M", &ts);
-
-    snprintf(current_time_tmp, sizeof(current_time_tmp), "%s%s",  hour_tmp, minute_tmp);
-    current_time = atoi(current_time_tmp);
-
-    strftime(buf, sizeof(buf), "%d", &ts);
-
     /* We check if rule extends to a new day */
 
     if ( rulestruct[rule_number].aetas_start > rulestruct[rule_number].aetas_end ) {
@@ -18,25 +18,36 @@
 ** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
 */
 
-/* sagan-check-flow.c */
+/* sagan-check-flow.c
+ *
+ * Flow (source/destination address) checks.  The address lists in a rule
+ * header are compiled at load into sorted,  merged ranges (one set that
+ * must match,  one that must not) so a check is a binary search.  Lists
+ * are shared by every rule that expands to the same text,  so all the
+ * rules using $HOME_NET point at one copy.
+ *
+ */
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"             /* From autoconf */
 #endif
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
-#include <pthread.h>
-#include <errno.h>
-#include <unistd.h>
+#include <stdbool.h>
 
 #include "sagan.h"
 #include "sagan-defs.h"
 #include "sagan-rules.h"
 #include "sagan-config.h"
+#include "sagan-check-flow.h"
 
 struct _Rule_Struct *rulestruct;
 
+static struct _Sagan_Flow_List *flow_lists = NULL;
+
 /********************/ /************************/ /*****************/
 /***** flow_type ****/ /******* flow_var *******/ /*** direction ***/
 /* 0 = not in group */ /**      0 = any       **/ /**   0 = any   **/
@@ -45,165 +56,253 @@ struct _Rule_Struct *rulestruct;
 /* 3 = match ip     */ /************************/ /*****************/
 /********************/ /************************/ /*****************/
 
-sbool Sagan_Check_Flow( int b, uint32_t ip_src_u32, uint32_t ip_dst_u32)
+/*****************************************************************************
+ * Sagan_Flow_List_Get - The list already compiled from this text,  or NULL
+ *****************************************************************************/
+
+struct _Sagan_Flow_List *Sagan_Flow_List_Get( const char *key )
 {
 
-    uint32_t *src;
-    uint32_t *dst;
+    struct _Sagan_Flow_List *list;
 
-    uint32_t ip_src;
-    uint32_t ip_dst;
+    for ( list = flow_lists; list != NULL; list = list->next ) {
+        if ( !strcmp(list->key, key) ) {
+            return(list);
+        }
+    }
 
-    src = &ip_src_u32;
-    dst = &ip_dst_u32;
+    return(NULL);
+}
 
-    if(rulestruct[b].direction == 0 || rulestruct[b].direction == 1) {
-        ip_src = *src;
-        ip_dst = *dst;
-    } else {
-        ip_src = *dst;
-        ip_dst = *src;
+/*****************************************************************************
+ * Sagan_Flow_List_New - An empty list for this text.  Fill it with
+ * Sagan_Flow_List_Add(),  then Sagan_Flow_List_Finish().
+ *****************************************************************************/
+
+struct _Sagan_Flow_List *Sagan_Flow_List_New( const char *key )
+{
+
+    struct _Sagan_Flow_List *list;
+
+    list = malloc(sizeof(_Sagan_Flow_List));
+
+    if ( list == NULL ) {
+        Sagan_Log(S_ERROR, "[%s, line %d] Failed to allocate memory for flow list. Abort!", __FILE__, __LINE__);
     }
 
-    /*flow 1*/
-    int w=0;
-    int a1=0;
-    int eq1=0;
-    int ne1=0;
-    int eq1_val=0;
-    int ne1_val=0;
-//    char *tmptoken1;
-//    char *saveptrflow1;
-//    char *tmp1;
-//    char tmp_flow_1[512];
-    int f1;
-
-    /*flow 2*/
-    int z=0;
-    int a2=0;
-    int eq2=0;
-    int ne2=0;
-    int eq2_val=0;
-    int ne2_val=0;
-//    char *tmptoken2;
-//    char *saveptrflow2;
-//    char *tmp2;
-//    char tmp_flow_2[512];
-    int f2;
-
-//    uint32_t lo;
-//    uint32_t hi;
+    memset(list, 0, sizeof(_Sagan_Flow_List));
 
-    int i;
-    int failed=0;
-
-    /*Begin flow_1*/
-    if(rulestruct[b].flow_1_var != 0) {
-        for(i=0; i < rulestruct[b].flow_1_counter + 1; i++) {
-            w++;
-            f1 = rulestruct[b].flow_1_type[w];
-
-            if(f1 == 0) {
-                ne1++;
-                if(ip_src > rulestruct[b].flow_1[i].lo && ip_src < rulestruct[b].flow_1[i].hi) {
-                    ne1_val++;
-                }
-            } else if(f1 == 1) {
-                eq1++;
-                if(ip_src > rulestruct[b].flow_1[i].lo && ip_src < rulestruct[b].flow_1[i].hi) {
-                    eq1_val++;
-                }
-            } else if(f1 == 2) {
-                ne1++;
-                if(ip_src == rulestruct[b].flow_1[i].lo ) {
-                    ne1_val++;
-                }
-            } else if(f1 == 3) {
-                eq1++;
-                if(ip_src == rulestruct[b].flow_1[i].lo ) {
-                    eq1_val++;
-                }
-            }
-        }
+    list->key = strdup(key);
+    list->size = MAX_CHECK_FLOWS;
+    list->in = malloc(MAX_CHECK_FLOWS * sizeof(_Sagan_Flow_Range));
+    list->not = malloc(MAX_CHECK_FLOWS * sizeof(_Sagan_Flow_Range));
+
+    if ( list->key == NULL || list->in == NULL || list->not == NULL ) {
+        Sagan_Log(S_ERROR, "[%s, line %d] Failed to allocate memory for flow list. Abort!", __FILE__, __LINE__);
+    }
+
+    list->next = flow_lists;
+    flow_lists = list;
+
+    return(list);
+}
+
+/*****************************************************************************
+ * Sagan_Flow_List_Add - Adds one parsed entry.  Ranges from
+ * Netaddr_To_Range() have always been matched exclusive of their network
+ * and broadcast addresses,  so they go in as lo+1 .. hi-1.
+ *****************************************************************************/
+
+void Sagan_Flow_List_Add( struct _Sagan_Flow_List *list, uint32_t lo, uint32_t hi, int type )
+{
+
+    struct _Sagan_Flow_Range *set;
+    int *count;
+
+    if ( type == 1 || type == 3 ) {
+        list->has_in = true;
+        set = list->in;
+        count = &list->in_count;
     } else {
-        a1=1;
+        set = list->not;
+        count = &list->not_count;
     }
 
-    /* if ne1, did anything match (meaning failed) */
-    if(ne1>0) {
-        if(ne1_val > 0) {
-            failed++;
+    if ( type == 0 || type == 1 ) {
+
+        if ( hi < lo || hi - lo < 2 ) {
+            return;
         }
+
+        lo++;
+        hi--;
+
+    } else {
+
+        hi = lo;
+
     }
 
-    /* if eq1, did anything not match meaning failed */
-    if(eq1>0) {
-        if(eq1_val < 1) {
-            failed++;
-        }
+    if ( *count < list->size ) {
+        set[*count].lo = lo;
+        set[*count].hi = hi;
+        (*count)++;
     }
+}
 
-    /* if either failed, we did not match, no need to check the second flow... we already failed! */
-    if(a1 != 1) {
-        if(failed > 0) {
-            return 0;
-        }
+/*****************************************************************************
+ * Sagan_Flow_Range_Merge - Sorts a set of ranges and merges those that
+ * overlap or touch.  Returns the new count.
+ *****************************************************************************/
+
+static int Sagan_Flow_Range_Compare( const void *a, const void *b )
+{
+
+    const struct _Sagan_Flow_Range *x = a;
+    const struct _Sagan_Flow_Range *y = b;
+
+    return( x->lo < y->lo ? -1 : x->lo > y->lo );
+}
+
+static int Sagan_Flow_Range_Merge( struct _Sagan_Flow_Range *set, int count )
+{
+
+    int merged = 0;
+    int i;
+
+    if ( count == 0 ) {
+        return(0);
     }
 
-    /*Begin flow_2*/
-    if(rulestruct[b].flow_2_var != 0) {
-        for(i=0; i < rulestruct[b].flow_2_counter + 1; i++) {
-            z++;
-            f2 = rulestruct[b].flow_2_type[z];
-
-            if(f2 == 0) {
-                ne2++;
-                if(ip_dst > rulestruct[b].flow_2[i].lo && ip_dst < rulestruct[b].flow_2[i].hi) {
-                    ne2_val++;
-                }
-            } else if(f2 == 1) {
-                eq2++;
-                if(ip_dst > rulestruct[b].flow_2[i].lo && ip_dst < rulestruct[b].flow_2[i].hi) {
-                    eq2_val++;
-                }
-            } else if(f2 == 2) {
-                ne2++;
-                if(ip_dst == rulestruct[b].flow_2[i].lo) {
-                    ne2_val++;
-                }
-            } else if(f2 == 3) {
-                eq2++;
-                if(ip_dst == rulestruct[b].flow_2[i].lo) {
-                    eq2_val++;
-                }
+    qsort(set, count, sizeof(_Sagan_Flow_Range), Sagan_Flow_Range_Compare);
+
+    for ( i = 1; i < count; i++ ) {
+
+        if ( set[merged].hi == UINT32_MAX || set[i].lo <= set[merged].hi + 1 ) {
+
+            if ( set[i].hi > set[merged].hi ) {
+                set[merged].hi = set[i].hi;
             }
+
+        } else {
+
+            set[++merged] = set[i];
+
         }
-    } else {
-        a2=1;
     }
 
-    /* if ne2, did anything match (meaning failed) */
-    if(ne2>0) {
-        if(ne2_val > 0) {
-            failed++;
-        }
+    return(merged + 1);
+}
+
+/*****************************************************************************
+ * Sagan_Flow_List_Finish - Sorts and merges a list once all of its
+ * entries are in
+ *****************************************************************************/
+
+void Sagan_Flow_List_Finish( struct _Sagan_Flow_List *list )
+{
+
+    list->in_count = Sagan_Flow_Range_Merge(list->in, list->in_count);
+    list->not_count = Sagan_Flow_Range_Merge(list->not, list->not_count);
+
+}
+
+/*****************************************************************************
+ * Sagan_Flow_List_Free - Releases every compiled list.  Used when the
+ * rules are reloaded.
+ *****************************************************************************/
+
+void Sagan_Flow_List_Free( void )
+{
+
+    struct _Sagan_Flow_List *list;
+
+    while ( flow_lists != NULL ) {
+
+        list = flow_lists;
+        flow_lists = list->next;
+
+        free(list->key);
+        free(list->in);
+        free(list->not);
+        free(list);
     }
+}
+
+/*****************************************************************************
+ * Sagan_Flow_Range_Find - Binary search for the range holding "ip"
+ *****************************************************************************/
+
+static sbool Sagan_Flow_Range_Find( const struct _Sagan_Flow_Range *set, int count, uint32_t ip )
+{
+
+    int lo = 0;
+    int hi = count - 1;
+    int mid;
+
+    while ( lo <= hi ) {
 
-    /* if eq2, did anything not match meaning failed */
-    if(eq2>0) {
-        if(eq2_val < 1) {
-            failed++;
+        mid = lo + ( hi - lo ) / 2;
+
+        if ( ip < set[mid].lo ) {
+            hi = mid - 1;
+        } else if ( ip > set[mid].hi ) {
+            lo = mid + 1;
+        } else {
+            return(true);
         }
     }
 
-    /* if either failed, we did not match, leave */
-    if(a2 != 1) {
-        if(failed > 0) {
-            return 0;
-        }
+    return(false);
+}
+
+/*****************************************************************************
+ * Sagan_Flow_List_Match - Is "ip" in one of the list's "in" entries (if it
+ * has any) and in none of its "not" entries?
+ *****************************************************************************/
+
+static sbool Sagan_Flow_List_Match( const struct _Sagan_Flow_List *list, uint32_t ip )
+{
+
+    if ( list->has_in && !Sagan_Flow_Range_Find(list->in, list->in_count, ip) ) {
+        return(false);
+    }
+
+    if ( Sagan_Flow_Range_Find(list->not, list->not_count, ip) ) {
+        return(false);
+    }
+
+    return(true);
+}
+
+sbool Sagan_Check_Flow( int b, uint32_t ip_src_u32, uint32_t ip_dst_u32)
+{
+
+    uint32_t ip_src;
+    uint32_t ip_dst;
+
+    if(rulestruct[b].direction == 0 || rulestruct[b].direction == 1) {
+        ip_src = ip_src_u32;
+        ip_dst = ip_dst_u32;
+    } else {
+        ip_src = ip_dst_u32;
+        ip_dst = ip_src_u32;
+    }
+
+    /* flow_1 */
+
+    if ( rulestruct[b].flow_1_var != 0 && !Sagan_Flow_List_Match(rulestruct[b].flow_1_list, ip_src) ) {
+        return(false);
+    }
+
+    /* flow_2 */
+
+    if ( rulestruct[b].flow_2_var != 0 && !Sagan_Flow_List_Match(rulestruct[b].flow_2_list, ip_dst) ) {
+        return(false);
     }
 
     /* If we made it to this point we have a match */
-    return 1;
+
+    return(true);
 
 }/*We are done*/
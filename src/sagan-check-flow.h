@@ -22,4 +22,35 @@
 #include "config.h"             /* From autoconf */
 #endif
 
+/* A rule's flow address list,  compiled to sorted,  merged and inclusive
+ * ranges.  Rules with the same (expanded) list share one. */
+
+typedef struct _Sagan_Flow_Range _Sagan_Flow_Range;
+struct _Sagan_Flow_Range {
+    uint32_t lo;
+    uint32_t hi;
+};
+
+typedef struct _Sagan_Flow_List _Sagan_Flow_List;
+struct _Sagan_Flow_List {
+
+    char *key;
+
+    sbool has_in;			/* Has "in group"/"match ip" entries */
+    struct _Sagan_Flow_Range *in;
+    int in_count;
+
+    struct _Sagan_Flow_Range *not;
+    int not_count;
+
+    int size;				/* Ranges allocated in each of in/not */
+
+    struct _Sagan_Flow_List *next;
+};
+
+struct _Sagan_Flow_List *Sagan_Flow_List_Get( const char * );
+struct _Sagan_Flow_List *Sagan_Flow_List_New( const char * );
+void Sagan_Flow_List_Add( struct _Sagan_Flow_List *, uint32_t, uint32_t, int );
+void Sagan_Flow_List_Finish( struct _Sagan_Flow_List * );
+void Sagan_Flow_List_Free( void );
 sbool Sagan_Check_Flow( int b, uint32_t ip_src_u32, uint32_t ip_dst_u32);
@@ -0,0 +1,140 @@
+/*
+** Copyright (C) 2009-2017 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2017 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* sagan-clock.c
+ *
+ * A process wide,  one second resolution clock.  Stateful code (after,
+ * threshold,  xbits,  client tracking,  Bluedot cache,  alert_time and
+ * Sagan_Log()) used to call time(),  localtime(),  strftime("%s") and
+ * atol() for every event.  localtime() takes a global lock in glibc,  so
+ * under many processor threads that was a point of contention.  The
+ * ticker thread below does that work once a second instead.
+ *
+ * Until the ticker is started (after we daemonize),  readers refresh the
+ * clock themselves.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "sagan.h"
+#include "sagan-clock.h"
+
+#define CLOCK_SLOTS		4		/* Readers have CLOCK_SLOTS-1 ticks to use a snapshot */
+
+uint64_t sagan_clock_epoch = 0;
+_Sagan_Clock *sagan_clock = NULL;
+sbool sagan_clock_ticking = false;
+
+static _Sagan_Clock clock_slots[CLOCK_SLOTS];
+static int clock_slot = 0;
+
+pthread_mutex_t Sagan_Clock_Mutex=PTHREAD_MUTEX_INITIALIZER;
+
+/****************************************************************************
+ * Sagan_Clock_Init - Load the time zone and take the first reading
+ ****************************************************************************/
+
+void Sagan_Clock_Init( void )
+{
+    tzset();
+    Sagan_Clock_Update();
+}
+
+/****************************************************************************
+ * Sagan_Clock_Update - Take a reading and publish it
+ ****************************************************************************/
+
+void Sagan_Clock_Update( void )
+{
+
+    _Sagan_Clock *c;
+    time_t t;
+
+    pthread_mutex_lock(&Sagan_Clock_Mutex);
+
+    t = time(NULL);
+
+    /* Same second,  nothing to publish */
+
+    if ( sagan_clock != NULL && sagan_clock->epoch == (uint64_t)t ) {
+        pthread_mutex_unlock(&Sagan_Clock_Mutex);
+        return;
+    }
+
+    clock_slot = ( clock_slot + 1 ) % CLOCK_SLOTS;
+    c = &clock_slots[clock_slot];
+
+    localtime_r(&t, &c->tm);
+
+    c->epoch = (uint64_t)t;
+    c->wday = c->tm.tm_wday;
+    c->hhmm = ( c->tm.tm_hour * 100 ) + c->tm.tm_min;
+    strftime(c->log_stamp, sizeof(c->log_stamp), "%m/%d/%Y %H:%M:%S", &c->tm);
+
+    __atomic_store_n(&sagan_clock, c, __ATOMIC_RELEASE);
+    __atomic_store_n(&sagan_clock_epoch, c->epoch, __ATOMIC_RELAXED);
+
+    pthread_mutex_unlock(&Sagan_Clock_Mutex);
+
+}
+
+/****************************************************************************
+ * Sagan_Clock_Ticker - Thread that refreshes the clock just after each
+ * second boundary
+ ****************************************************************************/
+
+void Sagan_Clock_Ticker( void )
+{
+
+    struct timespec now;
+    struct timespec nap;
+
+    Sagan_Clock_Update();
+    __atomic_store_n(&sagan_clock_ticking, true, __ATOMIC_RELAXED);
+
+    while(1) {
+
+        clock_gettime(CLOCK_REALTIME, &now);
+
+        nap.tv_sec = 0;
+        nap.tv_nsec = 1000000000L - now.tv_nsec + 1000000L;	/* 1ms past the boundary */
+
+        if ( nap.tv_nsec >= 1000000000L ) {
+            nap.tv_nsec -= 1000000000L;
+        }
+
+        nanosleep(&nap, NULL);
+
+        Sagan_Clock_Update();
+
+    }
+
+}
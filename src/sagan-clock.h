@@ -0,0 +1,82 @@
+/*
+** Copyright (C) 2009-2017 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2017 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* sagan-clock.h
+ *
+ * Process wide coarse clock.  A ticker thread refreshes the current time
+ * once a second;  hot paths read it without calling time()/localtime().
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdint.h>
+#include <time.h>
+
+/* One published reading of the clock.  The ticker fills a free slot and
+ * then swaps the "current" pointer,  so readers never see a partially
+ * written snapshot */
+
+typedef struct _Sagan_Clock _Sagan_Clock;
+struct _Sagan_Clock {
+    uint64_t	epoch;			/* Seconds since the epoch */
+    struct tm	tm;			/* Local time */
+    int		wday;			/* Day of the week (0 == Sunday) */
+    int		hhmm;			/* Local time as HHMM (for "alert_time") */
+    char	log_stamp[24];		/* "%m/%d/%Y %H:%M:%S" for Sagan_Log() */
+};
+
+extern uint64_t sagan_clock_epoch;
+extern _Sagan_Clock *sagan_clock;
+extern sbool sagan_clock_ticking;
+
+void Sagan_Clock_Init( void );
+void Sagan_Clock_Update( void );
+void Sagan_Clock_Ticker( void );
+
+/****************************************************************************
+ * Sagan_Clock_Now - Current epoch seconds (single load once ticking)
+ ****************************************************************************/
+
+static inline uint64_t Sagan_Clock_Now( void )
+{
+    if ( __builtin_expect(!__atomic_load_n(&sagan_clock_ticking, __ATOMIC_RELAXED), 0) ) {
+        Sagan_Clock_Update();
+    }
+
+    return( __atomic_load_n(&sagan_clock_epoch, __ATOMIC_RELAXED) );
+}
+
+/****************************************************************************
+ * Sagan_Clock_Get - Current snapshot (epoch, local time, day of week, log
+ * stamp).  Read what you need right away,  the slot is reused a few ticks
+ * later.
+ ****************************************************************************/
+
+static inline const _Sagan_Clock *Sagan_Clock_Get( void )
+{
+    if ( __builtin_expect(!__atomic_load_n(&sagan_clock_ticking, __ATOMIC_RELAXED), 0) ) {
+        Sagan_Clock_Update();
+    }
+
+    return( __atomic_load_n(&sagan_clock, __ATOMIC_ACQUIRE) );
+}
@@ -55,11 +55,22 @@ struct _SaganConfig {
     char         sagan_lockfile[MAXPATH];
     char         sagan_fifo[MAXPATH];
     sbool        sagan_is_file;                       /* FIFO or FILE */
+
+    sbool        udp_input_flag;                      /* Native UDP syslog input */
+    char         udp_address[MAXHOST];
+    int          udp_port;
+    int          udp_threads;
+    int          udp_rcvbuf;
+
+    sbool        tcp_input_flag;                      /* Native TCP syslog input */
+    char         tcp_address[MAXHOST];
+    int          tcp_port;
+    int          tcp_max_clients;
     char         sagan_log_path[MAXPATH];
     char         sagan_rule_path[MAXPATH];
     char         sagan_host[MAXHOST];
     char         sagan_extern[MAXPATH];
-    char         sagan_startutime[20];                  /* Records utime at startup */
+    uint64_t     sagan_startutime;                      /* Records utime at startup */
     char         home_net[MAXPATH];
     char         external_net[MAXPATH];
     sbool	 force_fifo_ownership_flag;		/* Chmod FIFO upon start */
@@ -70,6 +81,7 @@ struct _SaganConfig {
     sbool        output_thread_flag;
 
     int          max_processor_threads;
+    int          max_processor_queue;
 
     sbool        sagan_external_output_flag;            /* For things like external, email, fwsam */
 
@@ -77,6 +89,10 @@ struct _SaganConfig {
     sbool        sagan_ext_flag;
     sbool        disable_dns_warnings;
     sbool        syslog_src_lookup;
+    int          dns_cache_size;
+    int          dns_threads;
+    int          dns_ttl;
+    int          dns_negative_ttl;
     int          sagan_proto;
 
     sbool	 pcre_jit; 				/* For PCRE JIT support testing */
@@ -117,17 +133,7 @@ struct _SaganConfig {
 
     int		shm_counters;
     int		shm_xbit;
-    int 	shm_thresh_by_src;
-    int		shm_thresh_by_dst;
-    int		shm_thresh_by_dstport;
-    int		shm_thresh_by_srcport;
-    int		shm_thresh_by_username;
-
-    int		shm_after_by_src;
-    int		shm_after_by_dst;
-    int 	shm_after_by_srcport;
-    int		shm_after_by_dstport;
-    int		shm_after_by_username;
+    int		shm_tracker;
 
     int		shm_track_clients;
 
@@ -137,17 +143,7 @@ struct _SaganConfig {
 
     int		max_xbits;
 
-    int		max_threshold_by_src;
-    int		max_threshold_by_dst;
-    int         max_threshold_by_srcport;
-    int		max_threshold_by_dstport;
-    int		max_threshold_by_username;
-
-    int		max_after_by_src;
-    int		max_after_by_dst;
-    int         max_after_by_srcport;
-    int		max_after_by_dstport;
-    int		max_after_by_username;
+    int		max_tracker;
 
     int		max_track_clients;
 
@@ -0,0 +1,167 @@
+/*
+** Copyright (C) 2009-2017 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2017 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* sagan-counters.c
+ *
+ * Statistics that are bumped for every message (or every alert) used to
+ * be shared fields in _SaganCounters protected by a global mutex.  Each
+ * thread now gets its own cache line aligned _Sagan_Thread_Counters the
+ * first time it counts something.  The blocks are only read when they
+ * are summed back into _SaganCounters for the stats and perfmon output.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#include "sagan.h"
+#include "sagan-defs.h"
+#include "sagan-counters.h"
+
+struct _SaganCounters *counters;
+
+static struct _Sagan_Thread_Counters *SaganThreadCounters = NULL;
+static pthread_mutex_t SaganThreadCountersMutex=PTHREAD_MUTEX_INITIALIZER;
+
+/*****************************************************************************
+ * Sagan_Thread_Counters - Returns the calling thread's counters,  creating
+ * them on first use.
+ *****************************************************************************/
+
+_Sagan_Thread_Counters *Sagan_Thread_Counters( void )
+{
+
+    static __thread struct _Sagan_Thread_Counters *local = NULL;
+
+    if ( local != NULL ) {
+        return(local);
+    }
+
+    if ( posix_memalign((void **)&local, CACHE_LINE_SIZE, sizeof(struct _Sagan_Thread_Counters)) != 0 ) {
+        Sagan_Log(S_ERROR, "[%s, line %d] Failed to allocate memory for thread counters. Abort!", __FILE__, __LINE__);
+    }
+
+    memset(local, 0, sizeof(struct _Sagan_Thread_Counters));
+
+    /* Blocks are never freed,  so counts from a thread that exits are kept */
+
+    pthread_mutex_lock(&SaganThreadCountersMutex);
+    local->next = SaganThreadCounters;
+    SaganThreadCounters = local;
+    pthread_mutex_unlock(&SaganThreadCountersMutex);
+
+    return(local);
+}
+
+/*****************************************************************************
+ * Sagan_Counters_Sum - Adds up every thread's counters into the global
+ * _SaganCounters.  Called before the counters are displayed.
+ *****************************************************************************/
+
+void Sagan_Counters_Sum( void )
+{
+
+    struct _Sagan_Thread_Counters total;
+    struct _Sagan_Thread_Counters *block;
+
+    uintmax_t *sum = (uintmax_t *)&total;
+    uintmax_t *field;
+
+    size_t fields = offsetof(struct _Sagan_Thread_Counters, next) / sizeof(uintmax_t);
+    size_t i;
+
+    memset(&total, 0, sizeof(total));
+
+    pthread_mutex_lock(&SaganThreadCountersMutex);
+
+    for ( block = SaganThreadCounters; block != NULL; block = block->next ) {
+
+        field = (uintmax_t *)block;
+
+        for ( i = 0; i < fields; i++ ) {
+            sum[i] += __atomic_load_n(&field[i], __ATOMIC_RELAXED);
+        }
+    }
+
+    pthread_mutex_unlock(&SaganThreadCountersMutex);
+
+    counters->sagantotal = total.sagantotal;
+    counters->saganfound = total.saganfound;
+    counters->threshold_total = total.threshold_total;
+    counters->after_total = total.after_total;
+    counters->ignore_count = total.ignore_count;
+    counters->alert_total = total.alert_total;
+    counters->sagan_log_drop = total.sagan_log_drop;
+    counters->worker_thread_exhaustion = total.worker_thread_exhaustion;
+
+    counters->malformed_host = total.malformed_host;
+    counters->malformed_facility = total.malformed_facility;
+    counters->malformed_priority = total.malformed_priority;
+    counters->malformed_level = total.malformed_level;
+    counters->malformed_tag = total.malformed_tag;
+    counters->malformed_date = total.malformed_date;
+    counters->malformed_time = total.malformed_time;
+    counters->malformed_program = total.malformed_program;
+    counters->malformed_message = total.malformed_message;
+
+    counters->blacklist_hit_count = total.blacklist_hit_count;
+    counters->blacklist_lookup_count = total.blacklist_lookup_count;
+
+    counters->follow_flow_total = total.follow_flow_total;
+    counters->follow_flow_drop = total.follow_flow_drop;
+
+    counters->tracker_total = total.tracker_total;
+    counters->tracker_new = total.tracker_new;
+    counters->tracker_expired = total.tracker_expired;
+    counters->tracker_full = total.tracker_full;
+
+#ifdef HAVE_LIBMAXMINDDB
+    counters->geoip2_hit = total.geoip2_hit;
+    counters->geoip2_miss = total.geoip2_miss;
+#endif
+
+#ifdef WITH_BLUEDOT
+    counters->bluedot_ip_cache_hit = total.bluedot_ip_cache_hit;
+    counters->bluedot_ip_positive_hit = total.bluedot_ip_positive_hit;
+    counters->bluedot_ip_total = total.bluedot_ip_total;
+    counters->bluedot_mdate = total.bluedot_mdate;
+    counters->bluedot_cdate = total.bluedot_cdate;
+    counters->bluedot_mdate_cache = total.bluedot_mdate_cache;
+    counters->bluedot_cdate_cache = total.bluedot_cdate_cache;
+    counters->bluedot_error_count = total.bluedot_error_count;
+    counters->bluedot_hash_cache_hit = total.bluedot_hash_cache_hit;
+    counters->bluedot_hash_positive_hit = total.bluedot_hash_positive_hit;
+    counters->bluedot_hash_total = total.bluedot_hash_total;
+    counters->bluedot_url_cache_hit = total.bluedot_url_cache_hit;
+    counters->bluedot_url_positive_hit = total.bluedot_url_positive_hit;
+    counters->bluedot_url_total = total.bluedot_url_total;
+    counters->bluedot_filename_cache_hit = total.bluedot_filename_cache_hit;
+    counters->bluedot_filename_positive_hit = total.bluedot_filename_positive_hit;
+    counters->bluedot_filename_total = total.bluedot_filename_total;
+#endif
+
+}
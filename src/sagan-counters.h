@@ -0,0 +1,98 @@
+/*
+** Copyright (C) 2009-2017 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2017 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* sagan-counters.h
+ *
+ * Per-thread statistics counters
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdint.h>
+
+#include "sagan-defs.h"
+
+/* Each thread bumps its own block without locks or atomics.  Every field
+ * before "next" must be a uintmax_t,  they are summed as an array by
+ * Sagan_Counters_Sum() */
+
+typedef struct _Sagan_Thread_Counters _Sagan_Thread_Counters;
+struct _Sagan_Thread_Counters {
+
+    uintmax_t sagantotal;
+    uintmax_t saganfound;
+    uintmax_t threshold_total;
+    uintmax_t after_total;
+    uintmax_t ignore_count;
+    uintmax_t alert_total;
+    uintmax_t sagan_log_drop;
+    uintmax_t worker_thread_exhaustion;
+
+    uintmax_t malformed_host;
+    uintmax_t malformed_facility;
+    uintmax_t malformed_priority;
+    uintmax_t malformed_level;
+    uintmax_t malformed_tag;
+    uintmax_t malformed_date;
+    uintmax_t malformed_time;
+    uintmax_t malformed_program;
+    uintmax_t malformed_message;
+
+    uintmax_t blacklist_hit_count;
+    uintmax_t blacklist_lookup_count;
+
+    uintmax_t follow_flow_total;
+    uintmax_t follow_flow_drop;
+
+    uintmax_t tracker_total;
+    uintmax_t tracker_new;
+    uintmax_t tracker_expired;
+    uintmax_t tracker_full;
+
+    uintmax_t geoip2_hit;
+    uintmax_t geoip2_miss;
+
+    uintmax_t bluedot_ip_cache_hit;
+    uintmax_t bluedot_ip_positive_hit;
+    uintmax_t bluedot_ip_total;
+    uintmax_t bluedot_mdate;
+    uintmax_t bluedot_cdate;
+    uintmax_t bluedot_mdate_cache;
+    uintmax_t bluedot_cdate_cache;
+    uintmax_t bluedot_error_count;
+    uintmax_t bluedot_hash_cache_hit;
+    uintmax_t bluedot_hash_positive_hit;
+    uintmax_t bluedot_hash_total;
+    uintmax_t bluedot_url_cache_hit;
+    uintmax_t bluedot_url_positive_hit;
+    uintmax_t bluedot_url_total;
+    uintmax_t bluedot_filename_cache_hit;
+    uintmax_t bluedot_filename_positive_hit;
+    uintmax_t bluedot_filename_total;
+
+    struct _Sagan_Thread_Counters *next;
+
+} __attribute__ ((aligned(CACHE_LINE_SIZE)));
+
+_Sagan_Thread_Counters *Sagan_Thread_Counters( void );
+void Sagan_Counters_Sum( void );
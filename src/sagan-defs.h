@@ -55,6 +55,11 @@
 
 #define MAX_THREADS     	4096            /* Max system threads */
 #define MAX_SYSLOGMSG   	10240		/* Max length of a syslog message */
+#define MESSAGE_HEADER_SIZE	512		/* Message buffer room for fields that are not views */
+#define INPUT_BUFFER_SIZE	1048576		/* FIFO/file read() buffer */
+#define UDP_BATCH		32		/* Datagrams per recvmmsg() call */
+#define TCP_BUFFER_SIZE		(MAX_SYSLOGMSG * 2)	/* Per TCP connection framing buffer */
+#define TCP_EPOLL_EVENTS	64		/* Events per epoll_wait() call */
 
 #define MAX_VAR_NAME_SIZE  	64		/* Max "var" name size */
 #define MAX_VAR_VALUE_SIZE 	4096		/* Max "var" value size */
@@ -62,7 +67,9 @@
 #define MAX_PCRE		10		/* Max PCRE within a rule */
 #define MAX_CONTENT		30		/* Max 'content' within a rule */
 #define MAX_META_CONTENT	10		/* Max 'meta_content' within a rule */
+#define META_CONTENT_FIND_MAX	4		/* meta_content lists up to this long are searched entry by entry */
 #define MAX_XBITS		20		/* Max 'xbits' within a rule */
+#define MAX_XBIT_NAMES		10		/* Max names in one xbit (bit1&bit2) */
 
 #define MAX_CHECK_FLOWS		50		/* Max amount of IP addresses to be checked in a flow */
 
@@ -103,6 +110,22 @@
 /* defaults if the user doesn't define */
 
 #define MAX_PROCESSOR_THREADS   50
+#define MAX_PROCESSOR_QUEUE	1024		/* Work queue depth (rounded up to power of 2) */
+#define UDP_THREADS		2
+#define UDP_PORT		514
+#define UDP_ADDRESS		"0.0.0.0"
+#define TCP_PORT		514
+#define TCP_ADDRESS		"0.0.0.0"
+#define TCP_MAX_CLIENTS		1024
+#define PROCESSOR_BATCH		8		/* Max messages a processor thread pulls at once */
+#define DNS_CACHE_SIZE		4096		/* Max source-lookup cache entries */
+#define DNS_THREADS		2		/* source-lookup resolver threads */
+#define DNS_TTL			3600		/* Seconds a successful lookup is cached */
+#define DNS_NEGATIVE_TTL	300		/* Seconds a failed lookup is cached */
+
+#define CACHE_LINE_SIZE		64		/* Used to pad hot shared data */
+#define QUEUE_SPIN_COUNT	1000		/* Spins before a queue wait blocks */
+#define RULE_INDEX_BUCKETS	4096		/* Rule header index hash buckets (power of 2) */
 
 #define SUNDAY			1
 #define MONDAY			2
@@ -136,45 +159,29 @@
 
 #define COUNTERS_IPC_FILE 		"sagan-counters.shared"
 #define XBIT_IPC_FILE 	     	        "sagan-xbits.shared"
-#define THRESH_BY_SRC_IPC_FILE 		"sagan-thresh-by-source.shared"
-#define THRESH_BY_DST_IPC_FILE 		"sagan-thresh-by-destination.shared"
-#define THRESH_BY_DSTPORT_IPC_FILE 	"sagan-thresh-by-destination-port.shared"
-#define THRESH_BY_SRCPORT_IPC_FILE 	"sagan-thresh-by-source-port.shared"
-#define THRESH_BY_USERNAME_IPC_FILE 	"sagan-thresh-by-username.shared"
-#define AFTER_BY_SRC_IPC_FILE 		"sagan-after-by-source.shared"
-#define AFTER_BY_DST_IPC_FILE 		"sagan-after-by-destination.shared"
-#define AFTER_BY_SRCPORT_IPC_FILE 	"sagan-after-by-source-port.shared"
-#define AFTER_BY_DSTPORT_IPC_FILE 	"sagan-after-by-destination-port.shared"
-#define AFTER_BY_USERNAME_IPC_FILE 	"sagan-after-by-username.shared"
+#define TRACKER_IPC_FILE 		"sagan-tracker.shared"
 #define CLIENT_TRACK_IPC_FILE 		"sagan-track-clients.shared"
 
+/* IPC hash table format (see _Sagan_IPC_Hash) */
+
+#define IPC_HASH_MAGIC			0x53474854	/* "SGHT" */
+#define IPC_HASH_VERSION		6
+#define IPC_HASH_HEADER_SIZE		64
+#define IPC_HASH_SHARD_SIZE		64
+#define IPC_HASH_SHARDS			256		/* Most shards per table */
+#define IPC_HASH_SHARD_MIN		64		/* Fewest entries per shard */
+
+/* Xbit names are shared by every Sagan process (see _Sagan_IPC_Xbit_Names) */
+
+#define XBIT_NAME_SIZE			64
+#define XBIT_NAMES_MAX			4096
+
 /* Default IPC/mmap sizes */
 
 #define DEFAULT_IPC_CLIENT_TRACK_IPC	10000
-#define DEFAULT_IPC_AFTER_BY_SRC	1000000
-#define DEFAULT_IPC_AFTER_BY_DST	1000000
-#define DEFAULT_IPC_AFTER_BY_SRC_PORT   1000000
-#define DEFAULT_IPC_AFTER_BY_DST_PORT	1000000
-#define DEFAULT_IPC_AFTER_BY_USERNAME	10000
-#define DEFAULT_IPC_THRESH_BY_SRC	1000000
-#define DEFAULT_IPC_THRESH_BY_DST	1000000
-#define DEFAULT_IPC_THRESH_BY_SRC_PORT	1000000
-#define DEFAULT_IPC_THRESH_BY_DST_PORT  1000000
-#define DEFAULT_IPC_THRESH_BY_USERNAME	10000
+#define DEFAULT_IPC_TRACKER		1000000
 #define DEFAULT_IPC_XBITS		10000
 
-#define AFTER_BY_SRC			1
-#define AFTER_BY_DST			2
-#define AFTER_BY_DSTPORT		3
-#define AFTER_BY_USERNAME		4
-#define THRESH_BY_SRC			5
-#define THRESH_BY_DST			6
-#define THRESH_BY_DSTPORT		7
-#define THRESH_BY_USERNAME		8
-#define XBIT				9
-#define THRESH_BY_SRCPORT		10
-#define AFTER_BY_SRCPORT		11
-
 #define PARSE_HASH_MD5			1
 #define	PARSE_HASH_SHA1			2
 #define PARSE_HASH_SHA256		3
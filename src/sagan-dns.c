@@ -0,0 +1,346 @@
+/*
+** Copyright (C) 2009-2017 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2017 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* sagan-dns.c
+ *
+ * Cache for "source-lookup".  Entries are found through a hash table and
+ * kept on an LRU list so the cache never grows past "dns-cache-size".
+ * Successful lookups are kept for "dns-ttl" seconds and failed ones for
+ * "dns-negative-ttl" seconds.
+ *
+ * The processor threads never resolve anything themselves.  A miss queues
+ * the hostname for one of the resolver threads and the message is tagged
+ * with config->sagan_host until the answer is in.  An expired entry keeps
+ * being used while it is refreshed.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "sagan.h"
+#include "sagan-defs.h"
+#include "sagan-config.h"
+#include "sagan-queue.h"
+#include "sagan-dns.h"
+
+struct _SaganConfig *config;
+struct _SaganCounters *counters;
+
+pthread_mutex_t SaganDNSCacheMutex=PTHREAD_MUTEX_INITIALIZER;
+
+static struct _Sagan_DNS_Entry *dnscache = NULL;
+static int *dnscache_buckets = NULL;
+static uint32_t dnscache_mask = 0;
+
+static int dnscache_size = 0;			/* What was allocated.  "dns-cache-size" may change on a reload */
+static int dnscache_used = 0;
+static int dnscache_lru_head = -1;		/* Most recently used */
+static int dnscache_lru_tail = -1;		/* Next to be evicted */
+
+static struct _Sagan_Queue *SaganDNSQueue = NULL;
+
+/*****************************************************************************
+ * Sagan_DNS_Hash - FNV-1a
+ *****************************************************************************/
+
+static uint32_t Sagan_DNS_Hash( const char *hostname )
+{
+
+    uint32_t hash = 2166136261U;
+
+    while ( *hostname != '\0' ) {
+        hash ^= (unsigned char)*hostname++;
+        hash *= 16777619U;
+    }
+
+    return(hash);
+}
+
+static void Sagan_DNS_LRU_Unlink( int i )
+{
+
+    if ( dnscache[i].lru_prev != -1 ) {
+        dnscache[dnscache[i].lru_prev].lru_next = dnscache[i].lru_next;
+    } else {
+        dnscache_lru_head = dnscache[i].lru_next;
+    }
+
+    if ( dnscache[i].lru_next != -1 ) {
+        dnscache[dnscache[i].lru_next].lru_prev = dnscache[i].lru_prev;
+    } else {
+        dnscache_lru_tail = dnscache[i].lru_prev;
+    }
+}
+
+static void Sagan_DNS_LRU_Push( int i )
+{
+
+    dnscache[i].lru_prev = -1;
+    dnscache[i].lru_next = dnscache_lru_head;
+
+    if ( dnscache_lru_head != -1 ) {
+        dnscache[dnscache_lru_head].lru_prev = i;
+    }
+
+    dnscache_lru_head = i;
+
+    if ( dnscache_lru_tail == -1 ) {
+        dnscache_lru_tail = i;
+    }
+}
+
+/*****************************************************************************
+ * Sagan_DNS_Find - Returns the entry for "hostname" or -1.  The cache lock
+ * must be held.
+ *****************************************************************************/
+
+static int Sagan_DNS_Find( const char *hostname, uint32_t hash )
+{
+
+    int i;
+
+    for ( i = dnscache_buckets[hash & dnscache_mask]; i != -1; i = dnscache[i].next ) {
+        if ( dnscache[i].hash == hash && !strcmp(dnscache[i].hostname, hostname) ) {
+            return(i);
+        }
+    }
+
+    return(-1);
+}
+
+/*****************************************************************************
+ * Sagan_DNS_Insert - Adds an unresolved entry for "hostname",  evicting the
+ * least recently used entry if the cache is full.  The cache lock must be
+ * held.
+ *****************************************************************************/
+
+static int Sagan_DNS_Insert( const char *hostname, uint32_t hash )
+{
+
+    int i;
+    int *link;
+
+    if ( dnscache_used < dnscache_size ) {
+
+        i = dnscache_used++;
+        counters->dns_cache_count++;
+
+    } else {
+
+        i = dnscache_lru_tail;
+
+        Sagan_DNS_LRU_Unlink(i);
+
+        for ( link = &dnscache_buckets[dnscache[i].hash & dnscache_mask]; *link != i; link = &dnscache[*link].next );
+
+        *link = dnscache[i].next;
+
+    }
+
+    strlcpy(dnscache[i].hostname, hostname, sizeof(dnscache[i].hostname));
+    dnscache[i].src_ip[0] = '\0';
+    dnscache[i].hash = hash;
+    dnscache[i].expires = 0;
+    dnscache[i].state = DNS_UNRESOLVED;
+    dnscache[i].pending = false;
+
+    dnscache[i].next = dnscache_buckets[hash & dnscache_mask];
+    dnscache_buckets[hash & dnscache_mask] = i;
+
+    Sagan_DNS_LRU_Push(i);
+
+    return(i);
+}
+
+/*****************************************************************************
+ * Sagan_DNS_Init - Allocates the cache and its request queue.  This is only
+ * done at start up,  so a "dns-cache-size" changed by a reload takes effect
+ * on the next restart.
+ *****************************************************************************/
+
+void Sagan_DNS_Init( void )
+{
+
+    uint32_t buckets = 2;
+    uint32_t i;
+
+    dnscache_size = config->dns_cache_size;
+
+    while ( buckets < (uint32_t)dnscache_size * 2 ) {
+        buckets <<= 1;
+    }
+
+    dnscache = malloc(dnscache_size * sizeof(struct _Sagan_DNS_Entry));
+
+    if ( dnscache == NULL ) {
+        Sagan_Log(S_ERROR, "[%s, line %d] Failed to allocate memory for dnscache. Abort!", __FILE__, __LINE__);
+    }
+
+    memset(dnscache, 0, dnscache_size * sizeof(struct _Sagan_DNS_Entry));
+
+    dnscache_buckets = malloc(buckets * sizeof(int));
+
+    if ( dnscache_buckets == NULL ) {
+        Sagan_Log(S_ERROR, "[%s, line %d] Failed to allocate memory for dnscache_buckets. Abort!", __FILE__, __LINE__);
+    }
+
+    for ( i = 0; i < buckets; i++ ) {
+        dnscache_buckets[i] = -1;
+    }
+
+    dnscache_mask = buckets - 1;
+
+    SaganDNSQueue = Sagan_Queue_Init(dnscache_size, sizeof(dnscache[0].hostname));
+
+}
+
+/*****************************************************************************
+ * Sagan_DNS_Lookup - Copies the address for "hostname" to "src_ip".  If
+ * the address isn't known (yet),  config->sagan_host is used.  Never blocks
+ * on DNS.
+ *****************************************************************************/
+
+void Sagan_DNS_Lookup( const char *hostname, char *src_ip, size_t size )
+{
+
+    char request[sizeof(dnscache[0].hostname)] = { 0 };
+
+    uint32_t hash;
+    time_t now = time(NULL);
+    sbool queue = false;
+    int i;
+
+    /* "source-lookup" turned on by a reload.  There are no resolver
+       threads until a restart */
+
+    if ( dnscache == NULL ) {
+        strlcpy(src_ip, config->sagan_host, size);
+        return;
+    }
+
+    strlcpy(request, hostname, sizeof(request));
+    hash = Sagan_DNS_Hash(request);
+
+    pthread_mutex_lock(&SaganDNSCacheMutex);
+
+    i = Sagan_DNS_Find(request, hash);
+
+    if ( i == -1 ) {
+
+        i = Sagan_DNS_Insert(request, hash);
+
+    } else {
+
+        Sagan_DNS_LRU_Unlink(i);
+        Sagan_DNS_LRU_Push(i);
+
+    }
+
+    if ( dnscache[i].pending == false && dnscache[i].expires <= now ) {
+        dnscache[i].pending = true;
+        queue = true;
+    }
+
+    if ( dnscache[i].state == DNS_FOUND ) {
+        strlcpy(src_ip, dnscache[i].src_ip, size);
+    } else {
+        strlcpy(src_ip, config->sagan_host, size);
+    }
+
+    pthread_mutex_unlock(&SaganDNSCacheMutex);
+
+    /* If the resolvers are that far behind,  let a later message retry */
+
+    if ( queue == true && Sagan_Queue_Try_Push(SaganDNSQueue, request) == false ) {
+
+        pthread_mutex_lock(&SaganDNSCacheMutex);
+
+        i = Sagan_DNS_Find(request, hash);
+
+        if ( i != -1 ) {
+            dnscache[i].pending = false;
+        }
+
+        pthread_mutex_unlock(&SaganDNSCacheMutex);
+    }
+
+}
+
+/*****************************************************************************
+ * Sagan_DNS_Resolver - Resolver thread.  Takes hostnames queued by
+ * Sagan_DNS_Lookup() and stores the results.
+ *****************************************************************************/
+
+void Sagan_DNS_Resolver( void )
+{
+
+    char hostname[sizeof(dnscache[0].hostname)];
+    char src_ip[sizeof(dnscache[0].src_ip)];
+
+    uint32_t hash;
+    int i;
+
+    for (;;) {
+
+        Sagan_Queue_Pop_Batch(SaganDNSQueue, hostname, 1);
+
+        strlcpy(src_ip, DNS_Lookup(hostname), sizeof(src_ip));
+
+        hash = Sagan_DNS_Hash(hostname);
+
+        pthread_mutex_lock(&SaganDNSCacheMutex);
+
+        /* The entry may have been evicted while we were waiting */
+
+        i = Sagan_DNS_Find(hostname, hash);
+
+        if ( i != -1 ) {
+
+            if ( src_ip[0] == '0' ) {
+
+                dnscache[i].state = DNS_NOT_FOUND;
+                dnscache[i].expires = time(NULL) + config->dns_negative_ttl;
+                counters->dns_miss_count++;
+
+            } else {
+
+                strlcpy(dnscache[i].src_ip, src_ip, sizeof(dnscache[i].src_ip));
+                dnscache[i].state = DNS_FOUND;
+                dnscache[i].expires = time(NULL) + config->dns_ttl;
+
+            }
+
+            dnscache[i].pending = false;
+        }
+
+        pthread_mutex_unlock(&SaganDNSCacheMutex);
+    }
+
+}
@@ -0,0 +1,56 @@
+/*
+** Copyright (C) 2009-2017 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2017 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* sagan-dns.h
+ *
+ * Cache and resolver threads for "source-lookup"
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <time.h>
+
+#define DNS_UNRESOLVED		0
+#define DNS_FOUND		1
+#define DNS_NOT_FOUND		2
+
+typedef struct _Sagan_DNS_Entry _Sagan_DNS_Entry;
+struct _Sagan_DNS_Entry {
+
+    char hostname[64];
+    char src_ip[64];
+
+    uint32_t hash;
+    time_t expires;
+
+    int state;			/* DNS_UNRESOLVED,  DNS_FOUND or DNS_NOT_FOUND */
+    sbool pending;		/* Queued for a resolver thread */
+
+    int next;			/* Hash chain,  -1 terminated */
+    int lru_prev;
+    int lru_next;
+};
+
+void Sagan_DNS_Init( void );
+void Sagan_DNS_Lookup( const char *, char *, size_t );
+void Sagan_DNS_Resolver( void );
@@ -0,0 +1,166 @@
+/*
+** Copyright (C) 2009-2017 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2017 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* sagan-framer.c
+ *
+ * Splits the FIFO/file input into lines.  Rather than one fgets() per line,
+ * we read() large blocks and split them with memchr().  Lines are returned
+ * "in place" so the caller can tokenize them without another copy.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "sagan.h"
+#include "sagan-defs.h"
+#include "sagan-framer.h"
+
+/****************************************************************************
+ * Sagan_Framer_Init - Allocate the read buffer and attach it to "fd"
+ ****************************************************************************/
+
+void Sagan_Framer_Init( _Sagan_Framer *framer, int fd, size_t size )
+{
+
+    framer->buf = malloc(size + 1);
+
+    if ( framer->buf == NULL ) {
+        Sagan_Log(S_ERROR, "[%s, line %d] Failed to allocate memory for input framer. Abort!", __FILE__, __LINE__);
+    }
+
+    framer->size = size;
+    framer->fd = fd;
+    framer->start = 0;
+    framer->end = 0;
+}
+
+/****************************************************************************
+ * Sagan_Framer_Reset - Attach the framer to a new descriptor and drop any
+ * buffered data.
+ ****************************************************************************/
+
+void Sagan_Framer_Reset( _Sagan_Framer *framer, int fd )
+{
+    framer->fd = fd;
+    framer->start = 0;
+    framer->end = 0;
+}
+
+/****************************************************************************
+ * Sagan_Framer_Next - Return the next line.  On success,  "line" points
+ * into the framer buffer (NULL terminated,  no '\n') and is valid until
+ * the next call.  Returns 1 for a line,  0 on EOF (FIFO writer gone or end
+ * of file) and -1 on a read() error.
+ ****************************************************************************/
+
+int Sagan_Framer_Next( _Sagan_Framer *framer, char **line, size_t *len )
+{
+
+    char *nl = NULL;
+    ssize_t bytes = 0;
+
+    for (;;) {
+
+        /* Complete line already in the buffer? */
+
+        if ( framer->end > framer->start ) {
+
+            nl = memchr(framer->buf + framer->start, '\n', framer->end - framer->start);
+
+            if ( nl != NULL ) {
+
+                *nl = '\0';
+                *line = framer->buf + framer->start;
+                *len = nl - *line;
+                framer->start = ( nl - framer->buf ) + 1;
+
+                return(1);
+            }
+        }
+
+        /* Carry any partial line to the front of the buffer */
+
+        if ( framer->start > 0 ) {
+
+            if ( framer->end > framer->start ) {
+                memmove(framer->buf, framer->buf + framer->start, framer->end - framer->start);
+            }
+
+            framer->end -= framer->start;
+            framer->start = 0;
+        }
+
+        /* A single line larger than our buffer.  Like fgets(),  hand back
+         * what we have and continue with the remainder next time */
+
+        if ( framer->end == framer->size ) {
+
+            framer->buf[framer->end] = '\0';
+            *line = framer->buf;
+            *len = framer->end;
+            framer->start = framer->end;
+
+            return(1);
+        }
+
+        bytes = read(framer->fd, framer->buf + framer->end, framer->size - framer->end);
+
+        if ( bytes > 0 ) {
+            framer->end += bytes;
+            continue;
+        }
+
+        if ( bytes < 0 && errno == EINTR ) {
+            continue;
+        }
+
+        /* EOF or error.  Flush an unterminated last line first */
+
+        if ( framer->end > framer->start ) {
+
+            framer->buf[framer->end] = '\0';
+            *line = framer->buf + framer->start;
+            *len = framer->end - framer->start;
+            framer->start = framer->end;
+
+            return(1);
+        }
+
+        return( bytes == 0 ? 0 : -1 );
+    }
+}
+
+/****************************************************************************
+ * Sagan_Framer_Free - Release the read buffer
+ ****************************************************************************/
+
+void Sagan_Framer_Free( _Sagan_Framer *framer )
+{
+    free(framer->buf);
+    framer->buf = NULL;
+}
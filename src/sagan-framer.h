@@ -0,0 +1,44 @@
+/*
+** Copyright (C) 2009-2017 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2017 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stddef.h>
+
+/* Line framer for the FIFO/file input.  Data is read() in large chunks
+ * into "buf";  complete lines are handed back as pointers into "buf" (the
+ * '\n' is replaced with a NULL).  Any partial line left at the end of a
+ * chunk is carried over to the front of the buffer for the next read() */
+
+typedef struct _Sagan_Framer _Sagan_Framer;
+struct _Sagan_Framer {
+    int		fd;
+    char	*buf;
+    size_t	size;		/* Usable buffer size (one byte kept for NULL) */
+    size_t	start;		/* Start of unconsumed data */
+    size_t	end;		/* End of valid data */
+};
+
+void Sagan_Framer_Init( _Sagan_Framer *, int, size_t );
+void Sagan_Framer_Reset( _Sagan_Framer *, int );
+int Sagan_Framer_Next( _Sagan_Framer *, char **, size_t * );
+void Sagan_Framer_Free( _Sagan_Framer * );
@@ -48,6 +48,7 @@
 #include "sagan-rules.h"
 #include "sagan-geoip2.h"
 #include "sagan-config.h"
+#include "sagan-counters.h"
 
 #define GEOIP_FOUND_NOT_USER_DEFINED	0	/* GeoIP2 was found for IP,  but wasn't listed in user defined countries */
 #define GEOIP_FOUND_WAS_USER_DEFINED	1	/* GeoIP2 was found AND was in user defined countries */
@@ -59,7 +60,6 @@ struct _Rule_Struct *rulestruct;
 struct _SaganDebug *debug;
 struct _SaganCounters *counters;
 
-pthread_mutex_t SaganGeoIP2Mutex=PTHREAD_MUTEX_INITIALIZER;
 
 void Sagan_Open_GeoIP2_Database( void )
 {
@@ -123,9 +123,7 @@ int Sagan_GeoIP2_Lookup_Country( char *ipaddr, int rule_position )
     res = MMDB_get_value(&result.entry, &entry_data, "country", "iso_code", NULL);
 
     if (res != MMDB_SUCCESS) {
-        pthread_mutex_lock(&SaganGeoIP2Mutex);
-        counters->geoip2_miss++;
-        pthread_mutex_unlock(&SaganGeoIP2Mutex);
+        Sagan_Thread_Counters()->geoip2_miss++;
 
         Sagan_Log(S_WARN, "Country code MMDB_get_value failure (%s) for %s.", MMDB_strerror(res), ipaddr);
         return(GEOIP_NOT_FOUND);
@@ -134,9 +132,7 @@ int Sagan_GeoIP2_Lookup_Country( char *ipaddr, int rule_position )
 
     if (!entry_data.has_data || entry_data.type != MMDB_DATA_TYPE_UTF8_STRING) {
 
-        pthread_mutex_lock(&SaganGeoIP2Mutex);
-        counters->geoip2_miss++;
-        pthread_mutex_unlock(&SaganGeoIP2Mutex);
+        Sagan_Thread_Counters()->geoip2_miss++;
 
         if ( debug->debuggeoip2 ) {
             Sagan_Log(S_DEBUG, "Country code for %s not found in GeoIP2 DB", ipaddr);
@@ -0,0 +1,401 @@
+/*
+** Copyright (C) 2009-2017 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2017 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* sagan-ipc-hash.c
+ *
+ * Open addressing (linear probing) hash tables that live inside the IPC
+ * mmap files,  so every Sagan process sharing the IPC directory sees the
+ * same table.  Entries are keyed by a numeric rule sid and a 64 bit key
+ * (IP address,  port or a hash of a string) and are compared as integers.
+ * Deletes use backward shifting,  so there are no tombstones and probe
+ * sequences stay short.
+ *
+ * A table is split into up to IPC_HASH_SHARDS shards.  The high bits of
+ * a key's hash pick the shard and the low bits its home slot;  probing
+ * never leaves the shard.  Each shard has its own lock and limit,  so
+ * unrelated keys don't contend and a full shard is cleaned on its own.
+ *
+ * The table is sized once,  at Sagan_IPC_Init() time,  to keep each
+ * shard's load factor at or under 3/4.  Callers lock the shard returned
+ * by Sagan_IPC_Hash_Shard() around Find/Insert/Delete/Expire.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "sagan.h"
+#include "sagan-defs.h"
+#include "sagan-ipc-hash.h"
+#include "sagan-ipc-lock.h"
+
+/****************************************************************************
+ * Sagan_IPC_Hash_Layout - Shard count and slots per shard for
+ * "max_entries"
+ ****************************************************************************/
+
+static void Sagan_IPC_Hash_Layout( int max_entries, uint32_t *shards, uint32_t *shard_capacity )
+{
+
+    uint64_t per_shard;
+    uint64_t want;
+    uint64_t capacity = 16;
+
+    *shards = 1;
+
+    while ( *shards < IPC_HASH_SHARDS && (uint64_t)max_entries / ( *shards * 2 ) >= IPC_HASH_SHARD_MIN ) {
+        *shards <<= 1;
+    }
+
+    per_shard = ( (uint64_t)max_entries + *shards - 1 ) / *shards;
+    want = per_shard + ( per_shard / 3 ) + 1;
+
+    while ( capacity < want ) {
+        capacity <<= 1;
+    }
+
+    *shard_capacity = (uint32_t)capacity;
+}
+
+/****************************************************************************
+ * Sagan_IPC_Hash_Mix - Hash of a sid/key pair.  Low 32 bits pick the home
+ * slot,  high 32 bits the shard.
+ ****************************************************************************/
+
+static inline uint64_t Sagan_IPC_Hash_Mix( uint32_t sid, uint64_t key )
+{
+
+    uint64_t x = key ^ ( (uint64_t)sid * 0x9E3779B97F4A7C15ULL );
+
+    x ^= x >> 33;
+    x *= 0xFF51AFD7ED558CCDULL;
+    x ^= x >> 33;
+    x *= 0xC4CEB9FE1A85EC53ULL;
+    x ^= x >> 33;
+
+    return(x);
+}
+
+static inline _Sagan_IPC_Hash_Shard *Sagan_IPC_Hash_Shard_Ptr( _Sagan_IPC_Hash *h, uint32_t shard )
+{
+    return( (_Sagan_IPC_Hash_Shard *)((unsigned char *)h + IPC_HASH_HEADER_SIZE + ((size_t)shard * IPC_HASH_SHARD_SIZE)) );
+}
+
+/****************************************************************************
+ * Sagan_IPC_Hash_Size - Bytes the mmap file needs for "max_entries"
+ ****************************************************************************/
+
+size_t Sagan_IPC_Hash_Size( int max_entries, size_t entry_size )
+{
+
+    uint32_t shards;
+    uint32_t shard_capacity;
+
+    Sagan_IPC_Hash_Layout(max_entries, &shards, &shard_capacity);
+
+    return( IPC_HASH_HEADER_SIZE + ( (size_t)shards * IPC_HASH_SHARD_SIZE ) + ( (size_t)shards * shard_capacity * entry_size ) );
+}
+
+/****************************************************************************
+ * Sagan_IPC_Hash_Attach - Validate a freshly mapped table.  If the file
+ * holds an older layout (or was sized for a different maximum) it is
+ * cleared and re-initialized.  Returns true if the existing data was kept.
+ ****************************************************************************/
+
+sbool Sagan_IPC_Hash_Attach( _Sagan_IPC_Hash *h, int max_entries, size_t entry_size )
+{
+
+    uint32_t shards;
+    uint32_t shard_capacity;
+    uint32_t i;
+    uint32_t left;
+
+    Sagan_IPC_Hash_Layout(max_entries, &shards, &shard_capacity);
+
+    if ( h->magic == IPC_HASH_MAGIC && h->version == IPC_HASH_VERSION &&
+            h->entry_size == entry_size && h->max_entries == (uint32_t)max_entries &&
+            h->shards == shards && h->shard_capacity == shard_capacity &&
+            h->count <= h->capacity ) {
+        return(true);
+    }
+
+    memset(h, 0, Sagan_IPC_Hash_Size(max_entries, entry_size));
+
+    h->magic = IPC_HASH_MAGIC;
+    h->version = IPC_HASH_VERSION;
+    h->entry_size = entry_size;
+    h->max_entries = max_entries;
+    h->count = 0;
+    h->shards = shards;
+    h->shard_capacity = shard_capacity;
+    h->capacity = shards * shard_capacity;
+    h->slots_offset = IPC_HASH_HEADER_SIZE + ( shards * IPC_HASH_SHARD_SIZE );
+
+    /* Split "max_entries" over the shards */
+
+    left = max_entries;
+
+    for ( i = 0; i < shards; i++ ) {
+        Sagan_IPC_Hash_Shard_Ptr(h, i)->max_entries = left / ( shards - i );
+        left -= Sagan_IPC_Hash_Shard_Ptr(h, i)->max_entries;
+    }
+
+    return(false);
+}
+
+/****************************************************************************
+ * Sagan_IPC_Hash_Shard - The shard a sid/key pair lives in
+ ****************************************************************************/
+
+uint32_t Sagan_IPC_Hash_Shard( _Sagan_IPC_Hash *h, uint32_t sid, uint64_t key )
+{
+    return( (uint32_t)( Sagan_IPC_Hash_Mix(sid, key) >> 32 ) & ( h->shards - 1 ) );
+}
+
+void Sagan_IPC_Hash_Lock( _Sagan_IPC_Hash *h, uint32_t shard )
+{
+    Sagan_IPC_Lock(&Sagan_IPC_Hash_Shard_Ptr(h, shard)->lock);
+}
+
+void Sagan_IPC_Hash_Unlock( _Sagan_IPC_Hash *h, uint32_t shard )
+{
+    Sagan_IPC_Unlock(&Sagan_IPC_Hash_Shard_Ptr(h, shard)->lock);
+}
+
+/****************************************************************************
+ * Sagan_IPC_Hash_Find - Returns the entry for sid/key or NULL
+ ****************************************************************************/
+
+void *Sagan_IPC_Hash_Find( _Sagan_IPC_Hash *h, uint32_t sid, uint64_t key )
+{
+
+    uint64_t x = Sagan_IPC_Hash_Mix(sid, key);
+    uint32_t mask = h->shard_capacity - 1;
+    uint32_t base = ( (uint32_t)( x >> 32 ) & ( h->shards - 1 ) ) * h->shard_capacity;
+    uint32_t i = (uint32_t)x & mask;
+
+    _Sagan_IPC_Hash_Slot *slot;
+
+    /* A shard is never full,  so an empty slot always ends the probe */
+
+    while(1) {
+
+        slot = IPC_HASH_SLOT(h, base + i);
+
+        if ( slot->used == false ) {
+            return(NULL);
+        }
+
+        if ( slot->key == key && slot->sid == sid ) {
+            return(slot);
+        }
+
+        i = ( i + 1 ) & mask;
+    }
+
+}
+
+/****************************************************************************
+ * Sagan_IPC_Hash_Find_Next - For tables that keep more than one entry per
+ * sid/key (the caller tells them apart).  Returns the entry for sid/key
+ * after "entry",  the first one if "entry" is NULL,  or NULL if there are
+ * no more.
+ ****************************************************************************/
+
+void *Sagan_IPC_Hash_Find_Next( _Sagan_IPC_Hash *h, uint32_t sid, uint64_t key, void *entry )
+{
+
+    uint64_t x = Sagan_IPC_Hash_Mix(sid, key);
+    uint32_t mask = h->shard_capacity - 1;
+    uint32_t base = ( (uint32_t)( x >> 32 ) & ( h->shards - 1 ) ) * h->shard_capacity;
+    uint32_t i = (uint32_t)x & mask;
+
+    _Sagan_IPC_Hash_Slot *slot;
+
+    /* Entries with the same sid/key are all in the run starting at their
+     * home slot,  so carry on from this one */
+
+    if ( entry != NULL ) {
+        i = ( (uint32_t)( ( (unsigned char *)entry - ( (unsigned char *)h + h->slots_offset ) ) / h->entry_size ) - base + 1 ) & mask;
+    }
+
+    while(1) {
+
+        slot = IPC_HASH_SLOT(h, base + i);
+
+        if ( slot->used == false ) {
+            return(NULL);
+        }
+
+        if ( slot->key == key && slot->sid == sid ) {
+            return(slot);
+        }
+
+        i = ( i + 1 ) & mask;
+    }
+
+}
+
+/****************************************************************************
+ * Sagan_IPC_Hash_Insert - Claims a zeroed entry for sid/key.  Unless the
+ * table is read with Sagan_IPC_Hash_Find_Next(),  sid/key must not
+ * already be in it.  Returns NULL when the key's shard is full.
+ ****************************************************************************/
+
+void *Sagan_IPC_Hash_Insert( _Sagan_IPC_Hash *h, uint32_t sid, uint64_t key )
+{
+
+    uint64_t x = Sagan_IPC_Hash_Mix(sid, key);
+    uint32_t mask = h->shard_capacity - 1;
+    uint32_t shard = (uint32_t)( x >> 32 ) & ( h->shards - 1 );
+    uint32_t base = shard * h->shard_capacity;
+    uint32_t i = (uint32_t)x & mask;
+
+    _Sagan_IPC_Hash_Shard *s = Sagan_IPC_Hash_Shard_Ptr(h, shard);
+    _Sagan_IPC_Hash_Slot *slot;
+
+    if ( s->count >= s->max_entries ) {
+        return(NULL);
+    }
+
+    while(1) {
+
+        slot = IPC_HASH_SLOT(h, base + i);
+
+        if ( slot->used == false ) {
+            break;
+        }
+
+        i = ( i + 1 ) & mask;
+    }
+
+    memset(slot, 0, h->entry_size);
+
+    slot->used = true;
+    slot->sid = sid;
+    slot->key = key;
+
+    s->count++;
+    __atomic_add_fetch(&h->count, 1, __ATOMIC_RELAXED);
+
+    return(slot);
+}
+
+/****************************************************************************
+ * Sagan_IPC_Hash_Delete - Removes an entry and shifts any following
+ * entries of the same probe run back into the hole.
+ ****************************************************************************/
+
+void Sagan_IPC_Hash_Delete( _Sagan_IPC_Hash *h, void *entry )
+{
+
+    uint32_t mask = h->shard_capacity - 1;
+    uint32_t index = (uint32_t)( ( (unsigned char *)entry - ( (unsigned char *)h + h->slots_offset ) ) / h->entry_size );
+    uint32_t shard = index / h->shard_capacity;
+    uint32_t base = shard * h->shard_capacity;
+    uint32_t hole = index - base;
+    uint32_t j = hole;
+    uint32_t home;
+
+    _Sagan_IPC_Hash_Slot *slot;
+
+    IPC_HASH_SLOT(h, base + hole)->used = false;
+
+    while(1) {
+
+        j = ( j + 1 ) & mask;
+        slot = IPC_HASH_SLOT(h, base + j);
+
+        if ( slot->used == false ) {
+            break;
+        }
+
+        home = (uint32_t)Sagan_IPC_Hash_Mix(slot->sid, slot->key) & mask;
+
+        /* Leave the entry where it is if its home slot lies (cyclically)
+         * after the hole,  moving it would put it before its home */
+
+        if ( hole <= j ? ( hole < home && home <= j ) : ( hole < home || home <= j ) ) {
+            continue;
+        }
+
+        memcpy(IPC_HASH_SLOT(h, base + hole), slot, h->entry_size);
+        slot->used = false;
+        hole = j;
+    }
+
+    Sagan_IPC_Hash_Shard_Ptr(h, shard)->count--;
+    __atomic_sub_fetch(&h->count, 1, __ATOMIC_RELAXED);
+}
+
+/****************************************************************************
+ * Sagan_IPC_Hash_Expire - Drops a shard's entries that are older than
+ * their "expire" seconds.  Returns the number of entries removed.
+ ****************************************************************************/
+
+int Sagan_IPC_Hash_Expire( _Sagan_IPC_Hash *h, uint32_t shard, uint64_t utime )
+{
+
+    uint32_t base = shard * h->shard_capacity;
+    uint32_t i;
+    int removed = 0;
+
+    _Sagan_IPC_Hash_Slot *slot;
+
+    for ( i = 0; i < h->shard_capacity; i++ ) {
+
+        slot = IPC_HASH_SLOT(h, base + i);
+
+        /* A delete can shift a later entry into this slot,  so look at
+         * it again before moving on */
+
+        while ( slot->used == true && ( utime - slot->utime ) >= (uint64_t)slot->expire ) {
+            Sagan_IPC_Hash_Delete(h, slot);
+            removed++;
+        }
+    }
+
+    return(removed);
+}
+
+/****************************************************************************
+ * Sagan_IPC_Hash_Bytes - 64 bit FNV-1a,  used to build table keys out of
+ * strings and other variable length data.  Start with IPC_HASH_FNV_BASIS;
+ * passing a previous result continues that hash.
+ ****************************************************************************/
+
+uint64_t Sagan_IPC_Hash_Bytes( uint64_t hash, const void *data, size_t len )
+{
+
+    const unsigned char *p = data;
+
+    while ( len-- > 0 ) {
+        hash ^= *p++;
+        hash *= 1099511628211ULL;
+    }
+
+    return(hash);
+}
@@ -0,0 +1,49 @@
+/*
+** Copyright (C) 2009-2017 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2017 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* sagan-ipc-hash.h
+ *
+ * Fixed capacity,  open addressing hash tables laid out inside the IPC
+ * (mmap) files.  See _Sagan_IPC_Hash in sagan.h for the layout.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdint.h>
+
+#define IPC_HASH_FNV_BASIS	14695981039346656037ULL
+
+#define IPC_HASH_SLOT(h, i) \
+	((_Sagan_IPC_Hash_Slot *)((unsigned char *)(h) + (h)->slots_offset + ((size_t)(i) * (h)->entry_size)))
+
+size_t Sagan_IPC_Hash_Size( int, size_t );
+sbool Sagan_IPC_Hash_Attach( _Sagan_IPC_Hash *, int, size_t );
+uint32_t Sagan_IPC_Hash_Shard( _Sagan_IPC_Hash *, uint32_t, uint64_t );
+void Sagan_IPC_Hash_Lock( _Sagan_IPC_Hash *, uint32_t );
+void Sagan_IPC_Hash_Unlock( _Sagan_IPC_Hash *, uint32_t );
+void *Sagan_IPC_Hash_Find( _Sagan_IPC_Hash *, uint32_t, uint64_t );
+void *Sagan_IPC_Hash_Find_Next( _Sagan_IPC_Hash *, uint32_t, uint64_t, void * );
+void *Sagan_IPC_Hash_Insert( _Sagan_IPC_Hash *, uint32_t, uint64_t );
+void Sagan_IPC_Hash_Delete( _Sagan_IPC_Hash *, void * );
+int Sagan_IPC_Hash_Expire( _Sagan_IPC_Hash *, uint32_t, uint64_t );
+uint64_t Sagan_IPC_Hash_Bytes( uint64_t, const void *, size_t );
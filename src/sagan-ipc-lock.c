@@ -0,0 +1,122 @@
+/*
+** Copyright (C) 2009-2017 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2017 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* sagan-ipc-lock.c
+ *
+ * Spinlocks for data shared between Sagan processes.  These replace
+ * fcntl() locking of the whole IPC file plus a process local mutex;
+ * taking an uncontended lock is a single atomic instruction.  Critical
+ * sections are expected to be short (a hash probe,  a counter update).
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <signal.h>
+#include <sched.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/types.h>
+
+#include "sagan.h"
+#include "sagan-ipc-lock.h"
+
+#define IPC_LOCK_SPINS		64		/* Busy waits before yielding */
+#define IPC_LOCK_CHECK		1024		/* Yields between holder checks */
+
+static uint32_t ipc_lock_pid;
+
+/*****************************************************************************
+ * Sagan_IPC_Lock_Atfork - The lock owner is the pid,  which changes when
+ * Sagan daemonizes
+ *****************************************************************************/
+
+static void Sagan_IPC_Lock_Atfork( void )
+{
+    ipc_lock_pid = getpid();
+}
+
+void Sagan_IPC_Lock_Init( void )
+{
+
+    ipc_lock_pid = getpid();
+
+    if ( pthread_atfork(NULL, NULL, Sagan_IPC_Lock_Atfork) != 0 ) {
+        Sagan_Log(S_ERROR, "[%s, line %d] Cannot register IPC lock fork handler. Abort!", __FILE__, __LINE__);
+    }
+
+}
+
+/*****************************************************************************
+ * Sagan_IPC_Lock - Acquire a shared lock
+ *****************************************************************************/
+
+void Sagan_IPC_Lock( uint32_t *lock )
+{
+
+    uint32_t holder = 0;
+    uint32_t waits = 0;
+
+    while ( __atomic_compare_exchange_n(lock, &holder, ipc_lock_pid, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED) == false ) {
+
+        waits++;
+
+        if ( waits < IPC_LOCK_SPINS ) {
+
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#endif
+
+        } else {
+
+            sched_yield();
+
+            /* A process that died holding the lock will never release
+             * it.  Threads of this process are assumed to be alive. */
+
+            if ( waits % IPC_LOCK_CHECK == 0 && holder != ipc_lock_pid &&
+                    kill((pid_t)holder, 0) == -1 && errno == ESRCH ) {
+
+                if ( __atomic_compare_exchange_n(lock, &holder, 0, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED) == true ) {
+                    Sagan_Log(S_WARN, "[%s, line %d] Released an IPC lock held by exited process %" PRIu32 ".", __FILE__, __LINE__, holder);
+                }
+            }
+        }
+
+        holder = 0;
+    }
+
+}
+
+/*****************************************************************************
+ * Sagan_IPC_Unlock - Release a shared lock
+ *****************************************************************************/
+
+void Sagan_IPC_Unlock( uint32_t *lock )
+{
+    __atomic_store_n(lock, 0, __ATOMIC_RELEASE);
+}
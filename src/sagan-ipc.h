@@ -32,7 +32,6 @@
 #endif
 
 void Sagan_IPC_Init(void);
-sbool Sagan_Clean_IPC_Object( int );
 void Sagan_IPC_Check_Object(char *, sbool, char *);
 
 
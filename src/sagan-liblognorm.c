@@ -21,6 +21,10 @@
 /* sagan-liblognorm.c
  *
  * These functions deal with liblognorm / data normalization.
+ *
+ * Every processor thread has its own liblognorm context and its own
+ * results,  so normalization needs no lock.  A message is normalized at
+ * most once,  the first time a rule with "normalize" asks for it.
  */
 
 #ifdef HAVE_CONFIG_H
@@ -33,7 +37,7 @@
 #include <sys/stat.h>
 #include <stdlib.h>
 #include <string.h>
-#include <pthread.h>
+#include <stdbool.h>
 
 #include <liblognorm.h>
 #include <json.h>
@@ -46,10 +50,6 @@
 struct _SaganConfig *config;
 struct _SaganDebug *debug;
 
-struct _SaganNormalizeLiblognorm *SaganNormalizeLiblognorm = NULL;
-
-pthread_mutex_t Lognorm_Mutex = PTHREAD_MUTEX_INITIALIZER;
-
 /************************************************************************
  * liblognorm GLOBALS
  ************************************************************************/
@@ -58,64 +58,188 @@ struct stat liblognorm_fileinfo;
 struct liblognorm_toload_struct *liblognormtoloadstruct;
 int liblognorm_count;
 
-static ln_ctx ctx;
-
 struct _SaganCounters *counters;
 
+/* Rulebases to load into each thread's context.  A list is never changed
+ * once it is published.  Adding a rulebase,  or a reload,  publishes a new
+ * one with the next generation and threads rebuild their contexts when
+ * they see it.
+ *
+ * Lists are only published at start up (before the processors) or during
+ * a SIGHUP reload,  with SaganReloadLock held for writing.  No thread is
+ * reading the old list then,  so it is freed right away. */
+
+typedef struct _Sagan_Rulebases _Sagan_Rulebases;
+struct _Sagan_Rulebases {
+    int generation;
+    int count;
+    char file[][MAXPATH];
+};
+
+static _Sagan_Rulebases *rulebases = NULL;
+
+static __thread ln_ctx ctx = NULL;
+static __thread int ctx_generation = 0;
+
+static __thread struct _SaganNormalizeLiblognorm result;
+static __thread sbool result_valid = false;
 
 /************************************************************************
- * Sagan_Liblognorm_Load
+ * Sagan_Liblognorm_Publish
  *
- * Load in the normalization files into memory
+ * Replaces the rulebase list with the first "count" files of the current
+ * one,  plus "infile" if it isn't NULL
  ************************************************************************/
 
-void Sagan_Liblognorm_Load(char *infile)
+static void Sagan_Liblognorm_Publish( int count, const char *infile )
 {
 
-    SaganNormalizeLiblognorm = malloc(sizeof(struct _SaganNormalizeLiblognorm));
+    _Sagan_Rulebases *old = rulebases;
+    _Sagan_Rulebases *new = NULL;
+
+    new = malloc(sizeof(_Sagan_Rulebases) + ( count + 1 ) * sizeof(new->file[0]));
 
-    if ( SaganNormalizeLiblognorm == NULL ) {
-        Sagan_Log(S_ERROR, "[%s, line %d] Failed to allocate memory for SaganNormalizeLiblognorm. Abort!", __FILE__, __LINE__);
+    if ( new == NULL ) {
+        Sagan_Log(S_ERROR, "[%s, line %d] Failed to allocate memory for liblognorm rulebases. Abort!", __FILE__, __LINE__);
     }
 
-    memset(SaganNormalizeLiblognorm, 0, sizeof(_SaganNormalizeLiblognorm));
+    new->generation = old != NULL ? old->generation + 1 : 1;
+    new->count = count;
 
-    if((ctx = ln_initCtx()) == NULL) {
-        Sagan_Log(S_ERROR, "[%s, line %d] Cannot initialize liblognorm context.", __FILE__, __LINE__);
+    if ( count > 0 ) {
+        memcpy(new->file, old->file, count * sizeof(new->file[0]));
+    }
+
+    if ( infile != NULL ) {
+        strlcpy(new->file[new->count], infile, sizeof(new->file[new->count]));
+        new->count++;
     }
 
-//    for (i=0; i < counters->liblognormtoload_count; i++)
-//        {
+    __atomic_store_n(&rulebases, new, __ATOMIC_RELEASE);
+
+    free(old);
+
+}
+
+/************************************************************************
+ * Sagan_Liblognorm_Clear
+ *
+ * Drops every rulebase.  Called at the start of a SIGHUP reload so the
+ * configuration's "normalize" entries are read again from scratch.
+ ************************************************************************/
+
+void Sagan_Liblognorm_Clear( void )
+{
+
+    Sagan_Liblognorm_Publish(0, NULL);
+
+}
+
+/************************************************************************
+ * Sagan_Liblognorm_Load
+ *
+ * Registers a normalization file.  Each thread loads it into its own
+ * context the first time it normalizes,  and again after a reload.
+ ************************************************************************/
+
+void Sagan_Liblognorm_Load(char *infile)
+{
+
+    int count = rulebases != NULL ? rulebases->count : 0;
+    int i;
+
     Sagan_Log(S_NORMAL, "Loading %s for normalization.", infile);
 
     if (stat(infile, &liblognorm_fileinfo)) {
         Sagan_Log(S_ERROR, "%s was not fonnd.", infile);
     }
 
-    ln_loadSamples(ctx, infile);
-//       }
+    /* Listed twice in the configuration */
+
+    for (i = 0; i < count; i++) {
+        if (!strcmp(rulebases->file[i], infile)) {
+            return;
+        }
+    }
+
+    Sagan_Liblognorm_Publish(count, infile);
+
+}
+
+/************************************************************************
+ * Sagan_Liblognorm_Context
+ *
+ * The calling thread's context,  (re)built if the rulebase list changed
+ ************************************************************************/
+
+static ln_ctx Sagan_Liblognorm_Context( void )
+{
+
+    const _Sagan_Rulebases *list = __atomic_load_n(&rulebases, __ATOMIC_ACQUIRE);
+    int generation = list != NULL ? list->generation : 0;
+    int i;
+
+    if ( ctx != NULL && ctx_generation == generation ) {
+        return(ctx);
+    }
+
+    if ( ctx != NULL ) {
+        ln_exitCtx(ctx);
+    }
+
+    if((ctx = ln_initCtx()) == NULL) {
+        Sagan_Log(S_ERROR, "[%s, line %d] Cannot initialize liblognorm context.", __FILE__, __LINE__);
+    }
+
+    for (i = 0; list != NULL && i < list->count; i++) {
+        ln_loadSamples(ctx, list->file[i]);
+    }
+
+    ctx_generation = generation;
+
+    return(ctx);
+}
+
+/************************************************************************
+ * Sagan_Normalize_Liblognorm_Reset
+ *
+ * Forget the thread's last results.  Called for each new message.
+ ************************************************************************/
+
+void Sagan_Normalize_Liblognorm_Reset( void )
+{
+
+    result_valid = false;
 
 }
 
 /***********************************************************************
  * sagan_normalize_liblognom
  *
- * Locates interesting log data via Rainer's liblognorm library
+ * Locates interesting log data via Rainer's liblognorm library.  Only
+ * the first call after Sagan_Normalize_Liblognorm_Reset() does the work,
+ * later ones return the same per thread results.
  ***********************************************************************/
 
-void Sagan_Normalize_Liblognorm(char *syslog_msg)
+struct _SaganNormalizeLiblognorm *Sagan_Normalize_Liblognorm(const char *syslog_msg, size_t syslog_msg_len)
 {
 
-    char buf[10*1024] = { 0 };
+    struct _SaganNormalizeLiblognorm *SaganNormalizeLiblognorm = &result;
+
     char tmp_host[254] = { 0 };
 
-    const char *cstr = NULL;
     const char *tmp = NULL;
 
     struct json_object *json = NULL;
 
     json_object *string_obj;
 
+    if ( result_valid == true ) {
+        return(SaganNormalizeLiblognorm);
+    }
+
+    result_valid = true;
+
     SaganNormalizeLiblognorm->ip_src[0] = '0';
     SaganNormalizeLiblognorm->ip_src[1] = '\0';
     SaganNormalizeLiblognorm->ip_dst[0] = '0';
@@ -132,15 +256,13 @@ void Sagan_Normalize_Liblognorm(char *syslog_msg)
     SaganNormalizeLiblognorm->http_uri[0] = '\0';
     SaganNormalizeLiblognorm->http_hostname[0] = '\0';
 
+    SaganNormalizeLiblognorm->filename[0] = '\0';
+
     SaganNormalizeLiblognorm->src_port = 0;
     SaganNormalizeLiblognorm->dst_port = 0;
 
-    snprintf(buf, sizeof(buf),"%s", syslog_msg);
-
     /* int ln_normalize(ln_ctx ctx, const char *str, size_t strLen, struct json_object **json_p); */
-    ln_normalize(ctx, buf, strlen(buf), &json);
-
-    cstr = (char*)json_object_to_json_string(json);
+    ln_normalize(Sagan_Liblognorm_Context(), syslog_msg, syslog_msg_len, &json);
 
     /* Get source address information */
 
@@ -268,7 +390,7 @@ void Sagan_Normalize_Liblognorm(char *syslog_msg)
         Sagan_Log(S_DEBUG, "Liblognorm DEBUG output:");
         Sagan_Log(S_DEBUG, "---------------------------------------------------");
         Sagan_Log(S_DEBUG, "Log message to normalize: |%s|", syslog_msg);
-        Sagan_Log(S_DEBUG, "Parsed: %s", cstr);
+        Sagan_Log(S_DEBUG, "Parsed: %s", json_object_to_json_string(json));
         Sagan_Log(S_DEBUG, "Source IP: %s", SaganNormalizeLiblognorm->ip_src);
         Sagan_Log(S_DEBUG, "Destination IP: %s", SaganNormalizeLiblognorm->ip_dst);
         Sagan_Log(S_DEBUG, "Source Port: %d", SaganNormalizeLiblognorm->src_port);
@@ -288,6 +410,8 @@ void Sagan_Normalize_Liblognorm(char *syslog_msg)
 
 
     json_object_put(json);
+
+    return(SaganNormalizeLiblognorm);
 }
 
 #endif
@@ -64,4 +64,6 @@ typedef struct _SaganNormalizeLiblognorm {
 
 
 void Sagan_Liblognorm_Load( char * );
-void Sagan_Normalize_Liblognorm( char * );
+void Sagan_Liblognorm_Clear( void );
+void Sagan_Normalize_Liblognorm_Reset( void );
+struct _SaganNormalizeLiblognorm *Sagan_Normalize_Liblognorm( const char *, size_t );
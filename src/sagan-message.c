@@ -0,0 +1,164 @@
+/*
+** Copyright (C) 2009-2017 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2017 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* sagan-message.c
+ *
+ * Messages are allocated once at start up and recycled.  An input thread
+ * takes a message from the pool,  fills its buffer and passes the pointer
+ * through the work queue.  The processor thread that handles it puts it
+ * back when done.  Nothing but the pointer is copied along the way.
+ *
+ * The free list is just another Sagan_Queue.  When every message is in
+ * flight,  Sagan_Message_Get() blocks,  which holds the inputs back the
+ * same way a full work queue used to.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "sagan.h"
+#include "sagan-defs.h"
+#include "sagan-queue.h"
+#include "sagan-message.h"
+
+static struct _Sagan_Queue *SaganMessagePool = NULL;
+
+/*****************************************************************************
+ * Sagan_Message_Pool_Init - Allocates "count" messages and places them in
+ * the pool.  Returns the number of messages.
+ *****************************************************************************/
+
+uint64_t Sagan_Message_Pool_Init( uint64_t count )
+{
+
+    struct _Sagan_Proc_Syslog *messages = NULL;
+    struct _Sagan_Proc_Syslog *msg = NULL;
+    uint64_t i;
+
+    SaganMessagePool = Sagan_Queue_Init(count, sizeof(struct _Sagan_Proc_Syslog *));
+
+    messages = malloc(count * sizeof(struct _Sagan_Proc_Syslog));
+
+    if ( messages == NULL ) {
+        Sagan_Log(S_ERROR, "[%s, line %d] Failed to allocate memory for the message pool. Abort!", __FILE__, __LINE__);
+    }
+
+    for ( i = 0; i < count; i++ ) {
+        msg = &messages[i];
+        Sagan_Message_Reset(msg);
+        Sagan_Queue_Push(SaganMessagePool, &msg);
+    }
+
+    return(count);
+}
+
+/*****************************************************************************
+ * Sagan_Message_Get - Takes an empty message from the pool,  blocking if
+ * every message is in use.
+ *****************************************************************************/
+
+_Sagan_Proc_Syslog *Sagan_Message_Get( void )
+{
+
+    struct _Sagan_Proc_Syslog *msg = NULL;
+
+    Sagan_Queue_Pop_Batch(SaganMessagePool, &msg, 1);
+    Sagan_Message_Reset(msg);
+
+    return(msg);
+}
+
+/*****************************************************************************
+ * Sagan_Message_Put - Returns a message to the pool
+ *****************************************************************************/
+
+void Sagan_Message_Put( _Sagan_Proc_Syslog *msg )
+{
+    Sagan_Queue_Push(SaganMessagePool, &msg);
+}
+
+/*****************************************************************************
+ * Sagan_Message_Available - Number of messages free in the pool
+ *****************************************************************************/
+
+uint64_t Sagan_Message_Available( void )
+{
+    return(Sagan_Queue_Count(SaganMessagePool));
+}
+
+/*****************************************************************************
+ * Sagan_Message_Reset - Empties the buffer and points every field at ""
+ *****************************************************************************/
+
+void Sagan_Message_Reset( _Sagan_Proc_Syslog *msg )
+{
+
+    msg->syslog_host = "";
+    msg->syslog_facility = "";
+    msg->syslog_priority = "";
+    msg->syslog_level = "";
+    msg->syslog_tag = "";
+    msg->syslog_date = "";
+    msg->syslog_time = "";
+    msg->syslog_program = "";
+    msg->syslog_message = "";
+    msg->syslog_message_len = 0;
+
+    msg->syslog_raw = false;
+    msg->buf_len = 0;
+
+}
+
+/*****************************************************************************
+ * Sagan_Message_Append - Copies "len" bytes of "str" to the unused end of
+ * the message buffer and returns a pointer to the (NUL terminated) copy.
+ * Used for fields that can't be a view of the original line.  The copy is
+ * truncated if the buffer is full.
+ *****************************************************************************/
+
+char *Sagan_Message_Append( _Sagan_Proc_Syslog *msg, const char *str, size_t len )
+{
+
+    char *p = msg->buf + msg->buf_len;
+    size_t room = sizeof(msg->buf) - msg->buf_len;
+
+    if ( room == 0 ) {
+        return("");
+    }
+
+    if ( len > room - 1 ) {
+        len = room - 1;
+    }
+
+    memcpy(p, str, len);
+    p[len] = '\0';
+
+    msg->buf_len += len + 1;
+
+    return(p);
+}
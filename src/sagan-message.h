@@ -0,0 +1,38 @@
+/*
+** Copyright (C) 2009-2017 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2017 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* sagan-message.h
+ *
+ * Pool of recycled _Sagan_Proc_Syslog messages.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdint.h>
+
+uint64_t Sagan_Message_Pool_Init( uint64_t );
+_Sagan_Proc_Syslog *Sagan_Message_Get( void );
+void Sagan_Message_Put( _Sagan_Proc_Syslog * );
+uint64_t Sagan_Message_Available( void );
+void Sagan_Message_Reset( _Sagan_Proc_Syslog * );
+char *Sagan_Message_Append( _Sagan_Proc_Syslog *, const char *, size_t );
@@ -28,6 +28,11 @@
  *
  * The %sagan% becomes whatever the variable holds.
  *
+ * Each expanded list is compiled once at rule load
+ * (Sagan_Meta_Content_Compile()).  Watchlists can run to hundreds of
+ * entries,  so rather than one substring search per entry,  longer lists
+ * become a single Aho-Corasick DFA and the message is walked once.
+ *
  */
 
 #ifdef HAVE_CONFIG_H
@@ -35,6 +40,7 @@
 #endif
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
 
@@ -44,49 +50,246 @@
 #include "sagan-rules.h"
 #include "parsers/parsers.h"
 
+struct _SaganCounters *counters;
 struct _Rule_Struct *rulestruct;
 
-int Sagan_Meta_Content_Search(char *syslog_msg, int rule_position , int meta_content_count)
+/*****************************************************************************
+ * Sagan_Meta_Content_Compile - Builds the matcher for one expanded
+ * meta_content list.  meta_nocase entries must already be lowercased.
+ *****************************************************************************/
+
+struct _Sagan_Meta_Matcher *Sagan_Meta_Content_Compile(char **entries, int count)
 {
 
-    int z = meta_content_count;
+    struct _Sagan_Meta_Matcher *m;
+
+    int *fail = NULL;
+    int *queue = NULL;
+    int head = 0;
+    int tail = 0;
+
+    size_t max_states = 1;
+    int state;
+    int child;
+    int *next;
+    int c;
     int i;
 
-    /* Normal "meta_content" search */
+    const unsigned char *p;
 
-    if ( rulestruct[rule_position].meta_content_not[z] == 0 ) {
-        for ( i=0; i<rulestruct[rule_position].meta_content_containers[z].meta_counter; i++ ) {
-            if ( rulestruct[rule_position].meta_content_case[z] == 1 ) {
-                if (Sagan_stristr(syslog_msg, rulestruct[rule_position].meta_content_containers[z].meta_content_converted[i], true)) {
-                    return(true);
-                }
-            } else {
-                if (Sagan_strstr(syslog_msg, rulestruct[rule_position].meta_content_containers[z].meta_content_converted[i])) {
-                    return(true);
-                }
+    m = malloc(sizeof(_Sagan_Meta_Matcher));
+
+    if ( m == NULL ) {
+        Sagan_Log(S_ERROR, "[%s, line %d] Failed to allocate memory for meta_content. Abort!", __FILE__, __LINE__);
+    }
+
+    memset(m, 0, sizeof(_Sagan_Meta_Matcher));
+
+    m->count = count;
+
+    /* A few entries are quicker to find one at a time with the vector
+     * kernels than by walking the message byte by byte */
+
+    if ( count <= META_CONTENT_FIND_MAX ) {
+
+        m->literal = malloc(count * sizeof(char *));
+        m->needle = malloc(count * sizeof(_Sagan_Needle));
+
+        if ( m->literal == NULL || m->needle == NULL ) {
+            Sagan_Log(S_ERROR, "[%s, line %d] Failed to allocate memory for meta_content. Abort!", __FILE__, __LINE__);
+        }
+
+        for ( i = 0; i < count; i++ ) {
+
+            m->literal[i] = strdup(entries[i]);
+
+            if ( m->literal[i] == NULL ) {
+                Sagan_Log(S_ERROR, "[%s, line %d] Failed to allocate memory for meta_content. Abort!", __FILE__, __LINE__);
             }
+
+            Sagan_Needle_Compile(&m->needle[i], m->literal[i], strlen(m->literal[i]));
         }
 
-        return(false);
+        return(m);
+    }
 
-    } else {
+    /* Bytes that appear in no entry share class 0 */
+
+    m->class_count = 1;
+
+    for ( i = 0; i < count; i++ ) {
+        for ( p = (const unsigned char *)entries[i]; *p != '\0'; p++ ) {
+
+            if ( m->classes[*p] == 0 ) {
+                m->classes[*p] = m->class_count++;
+            }
+
+            max_states++;
+        }
+    }
+
+    m->delta = calloc(max_states * m->class_count, sizeof(int));
+    m->accept = calloc(max_states, sizeof(unsigned char));
+    fail = calloc(max_states, sizeof(int));
+    queue = malloc(max_states * sizeof(int));
+
+    if ( m->delta == NULL || m->accept == NULL || fail == NULL || queue == NULL ) {
+        Sagan_Log(S_ERROR, "[%s, line %d] Failed to allocate memory for meta_content. Abort!", __FILE__, __LINE__);
+    }
+
+    /* Trie of the entries.  An empty entry accepts at the root,  which
+     * matches any message (as strstr() would). */
+
+    m->state_count = 1;
+
+    for ( i = 0; i < count; i++ ) {
+
+        state = 0;
+
+        for ( p = (const unsigned char *)entries[i]; *p != '\0'; p++ ) {
+
+            next = &m->delta[state * m->class_count + m->classes[*p]];
+
+            if ( *next == 0 ) {
+                *next = m->state_count++;
+            }
+
+            state = *next;
+        }
+
+        m->accept[state] = 1;
+    }
+
+    /* Failure links,  breadth first,  folded into the transition table */
+
+    for ( c = 0; c < m->class_count; c++ ) {
+
+        child = m->delta[c];
+
+        if ( child != 0 ) {
+            queue[tail++] = child;
+        }
+    }
+
+    while ( head < tail ) {
+
+        state = queue[head++];
+
+        for ( c = 0; c < m->class_count; c++ ) {
+
+            child = m->delta[state * m->class_count + c];
+
+            if ( child != 0 ) {
+
+                fail[child] = m->delta[fail[state] * m->class_count + c];
+                m->accept[child] |= m->accept[fail[child]];
+                queue[tail++] = child;
 
-        for ( i=0; i<rulestruct[rule_position].meta_content_containers[z].meta_counter; i++ ) {
-            if ( rulestruct[rule_position].meta_content_case[z] == 1 ) {
-                if (Sagan_stristr(syslog_msg, rulestruct[rule_position].meta_content_containers[z].meta_content_converted[i], true)) {
-                    return(false);
-                }
             } else {
 
-                if (Sagan_strstr(syslog_msg, rulestruct[rule_position].meta_content_containers[z].meta_content_converted[i])) {
-                    return(false);
+                m->delta[state * m->class_count + c] = m->delta[fail[state] * m->class_count + c];
+
+            }
+        }
+    }
+
+    free(fail);
+    free(queue);
+
+    m->delta = realloc(m->delta, m->state_count * m->class_count * sizeof(int));
+
+    return(m);
+}
+
+/*****************************************************************************
+ * Sagan_Meta_Content_Free - Releases the matchers of all loaded rules.
+ * Used when the rules are reloaded.
+ *****************************************************************************/
+
+void Sagan_Meta_Content_Free(void)
+{
+
+    struct _Sagan_Meta_Matcher *m;
+
+    int b;
+    int z;
+    int i;
+
+    for ( b = 0; b < counters->rulecount; b++ ) {
+        for ( z = 0; z < rulestruct[b].meta_content_count; z++ ) {
+
+            m = rulestruct[b].meta_content_containers[z].matcher;
+
+            if ( m == NULL ) {
+                continue;
+            }
+
+            if ( m->literal != NULL ) {
+                for ( i = 0; i < m->count; i++ ) {
+                    free(m->literal[i]);
                 }
             }
 
+            free(m->literal);
+            free(m->needle);
+            free(m->delta);
+            free(m->accept);
+            free(m);
+
+            rulestruct[b].meta_content_containers[z].matcher = NULL;
+        }
+    }
+}
+
+/*****************************************************************************
+ * Sagan_Meta_Content_Search - Is any entry of the rule's z'th meta_content
+ * within the window (or,  for meta_content: !,  none of them)?
+ *****************************************************************************/
+
+int Sagan_Meta_Content_Search(const char *syslog_msg, const char *syslog_msg_lower, size_t syslog_msg_len, int rule_position , int meta_content_count)
+{
+
+    struct _Sagan_Meta_Matcher *m = rulestruct[rule_position].meta_content_containers[meta_content_count].matcher;
+
+    const unsigned char *p;
+    const unsigned char *end;
+    const char *haystack;
+
+    sbool found = false;
+    int state = 0;
+    int i;
+
+    /* meta_nocase entries are lowercased at load time,  so they are searched
+     * against the folded copy of the message */
+
+    haystack = rulestruct[rule_position].meta_content_case[meta_content_count] == 1 ? syslog_msg_lower : syslog_msg;
+
+    if ( m->literal != NULL ) {
+
+        for ( i = 0; i < m->count; i++ ) {
+            if ( Sagan_Find(haystack, syslog_msg_len, m->literal[i], &m->needle[i]) ) {
+                found = true;
+                break;
+            }
+        }
+
+    } else {
+
+        found = m->accept[0];
+
+        for ( p = (const unsigned char *)haystack, end = p + syslog_msg_len; p < end && found == false; p++ ) {
+            state = m->delta[state * m->class_count + m->classes[*p]];
+            found = m->accept[state];
         }
 
-        return(true);
+    }
+
+    /* Normal "meta_content" search or meta_content: ! */
+
+    if ( rulestruct[rule_position].meta_content_not[meta_content_count] == 0 ) {
+        return(found);
+    }
 
-    } /* End of "else" meta_content_not[z] == 0 */
+    return(!found);
 
 } /* End of Sagan_Meta_Content_Search() */
@@ -22,5 +22,26 @@
 #include "config.h"             /* From autoconf */
 #endif
 
-int Sagan_Meta_Content_Search(char *, int, int);
+/* One compiled meta_content list.  Short lists keep their entries for the
+ * vector substring search,  longer ones become a DFA that answers "is any
+ * entry present?" in a single pass over the message. */
+
+typedef struct _Sagan_Meta_Matcher _Sagan_Meta_Matcher;
+struct _Sagan_Meta_Matcher {
+
+    int count;
+
+    char **literal;			/* count <= META_CONTENT_FIND_MAX */
+    struct _Sagan_Needle *needle;
+
+    unsigned char classes[256];		/* count > META_CONTENT_FIND_MAX */
+    int class_count;
+    int *delta;				/* [state * class_count + class] -> next state */
+    unsigned char *accept;		/* Some entry ends at (or on the failure chain of) this state */
+    int state_count;
+};
+
+struct _Sagan_Meta_Matcher *Sagan_Meta_Content_Compile(char **, int);
+void Sagan_Meta_Content_Free(void);
+int Sagan_Meta_Content_Search(const char *, const char *, size_t, int, int);
 
@@ -0,0 +1,338 @@
+/*
+** Copyright (C) 2009-2017 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2017 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* sagan-prefilter.c
+ *
+ * Every content: a rule requires (i.e. not content: !) is compiled into a
+ * single case insensitive Aho-Corasick automaton.  One pass over a message
+ * marks which literals it contains,  and a rule only goes on to the full
+ * offset/depth/pcre/meta_content checks in Sagan_Engine() if all of its
+ * literals were seen.  Matching is case insensitive so that it is safe for
+ * both "nocase" and case sensitive content.
+ *
+ * The automaton is rebuilt from scratch once the rules are loaded
+ * (Sagan_Prefilter_Build()).  Rules loaded after the last build are
+ * always passed.
+ *
+ * Builds happen before the processors start or with SaganReloadLock held
+ * for writing (SIGHUP and dynamic rule loads).  Processors hold it for
+ * reading over each batch and only use the automaton between a
+ * Sagan_Prefilter_Scan() and the Sagan_Prefilter_Rule() calls for the same
+ * message,  so the old one can be freed as soon as the new one is in place.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <ctype.h>
+
+#include "sagan.h"
+#include "sagan-defs.h"
+#include "sagan-rules.h"
+#include "sagan-prefilter.h"
+
+struct _SaganCounters *counters;
+struct _Rule_Struct *rulestruct;
+
+static struct _Sagan_Prefilter *prefilter = NULL;
+
+/* Per thread results of the last Sagan_Prefilter_Scan().  A literal was
+ * seen if its slot holds the current generation. */
+
+static __thread struct _Sagan_Prefilter *scanned = NULL;
+static __thread uint32_t *seen = NULL;
+static __thread int seen_size = 0;
+static __thread uint32_t generation = 0;
+
+static void Sagan_Prefilter_Free( struct _Sagan_Prefilter *pf )
+{
+
+    if ( pf == NULL ) {
+        return;
+    }
+
+    free(pf->delta);
+    free(pf->pattern);
+    free(pf->output);
+    free(pf->rule_first);
+    free(pf->rule_patterns);
+    free(pf);
+}
+
+/*****************************************************************************
+ * Sagan_Prefilter_Insert - Adds a literal to the trie and returns its
+ * pattern number.  The same literal in several rules gets one number.
+ *****************************************************************************/
+
+static int Sagan_Prefilter_Insert( struct _Sagan_Prefilter *pf, const char *literal )
+{
+
+    const unsigned char *p = (const unsigned char *)literal;
+    int state = 0;
+    int *next;
+
+    for ( ; *p != '\0'; p++ ) {
+
+        next = &pf->delta[state * pf->class_count + pf->classes[*p]];
+
+        if ( *next == 0 ) {
+            *next = pf->state_count++;
+        }
+
+        state = *next;
+    }
+
+    if ( pf->pattern[state] == -1 ) {
+        pf->pattern[state] = pf->pattern_count++;
+    }
+
+    return(pf->pattern[state]);
+}
+
+/*****************************************************************************
+ * Sagan_Prefilter_Build - Compiles the literals of all loaded rules.  Call
+ * after Load_Rules(),  before the processors start or with SaganReloadLock
+ * held for writing.
+ *****************************************************************************/
+
+void Sagan_Prefilter_Build( void )
+{
+
+    struct _Sagan_Prefilter *pf;
+    struct _Sagan_Prefilter *old;
+
+    int *fail = NULL;
+    int *queue = NULL;
+    int head = 0;
+    int tail = 0;
+
+    size_t max_states = 1;
+    int literals = 0;
+    int state;
+    int child;
+    int b;
+    int c;
+    int i;
+    int z;
+
+    const unsigned char *p;
+
+    pf = malloc(sizeof(_Sagan_Prefilter));
+
+    if ( pf == NULL ) {
+        Sagan_Log(S_ERROR, "[%s, line %d] Failed to allocate memory for prefilter. Abort!", __FILE__, __LINE__);
+    }
+
+    memset(pf, 0, sizeof(_Sagan_Prefilter));
+
+    /* Only bytes that appear in a literal get their own class.  Everything
+     * else shares class 0,  which always goes back to the root. */
+
+    pf->class_count = 1;
+
+    for ( b = 0; b < counters->rulecount; b++ ) {
+        for ( z = 0; z < rulestruct[b].content_count; z++ ) {
+
+            if ( rulestruct[b].content_not[z] == 1 ) {
+                continue;
+            }
+
+            for ( p = (const unsigned char *)rulestruct[b].s_content[z]; *p != '\0'; p++ ) {
+
+                if ( pf->classes[tolower(*p)] == 0 ) {
+                    pf->classes[tolower(*p)] = pf->class_count++;
+                }
+
+                max_states++;
+            }
+
+            literals++;
+        }
+    }
+
+    for ( i = 0; i < 256; i++ ) {
+        pf->classes[i] = pf->classes[tolower(i)];
+    }
+
+    pf->rule_count = counters->rulecount;
+    pf->rule_first = malloc((pf->rule_count + 1) * sizeof(int));
+    pf->rule_patterns = malloc((literals + 1) * sizeof(int));
+    pf->delta = calloc(max_states * pf->class_count, sizeof(int));
+    pf->pattern = malloc(max_states * sizeof(int));
+    pf->output = malloc(max_states * sizeof(int));
+    fail = calloc(max_states, sizeof(int));
+    queue = malloc(max_states * sizeof(int));
+
+    if ( pf->rule_first == NULL || pf->rule_patterns == NULL || pf->delta == NULL ||
+         pf->pattern == NULL || pf->output == NULL || fail == NULL || queue == NULL ) {
+        Sagan_Log(S_ERROR, "[%s, line %d] Failed to allocate memory for prefilter. Abort!", __FILE__, __LINE__);
+    }
+
+    for ( i = 0; i < (int)max_states; i++ ) {
+        pf->pattern[i] = -1;
+        pf->output[i] = -1;
+    }
+
+    /* Trie of all literals.  A transition of 0 means "none" since nothing
+     * goes back to the root until the failure links are filled in. */
+
+    pf->state_count = 1;
+    literals = 0;
+
+    for ( b = 0; b < pf->rule_count; b++ ) {
+
+        pf->rule_first[b] = literals;
+
+        for ( z = 0; z < rulestruct[b].content_count; z++ ) {
+            if ( rulestruct[b].content_not[z] != 1 && rulestruct[b].s_content[z][0] != '\0' ) {
+                pf->rule_patterns[literals++] = Sagan_Prefilter_Insert(pf, rulestruct[b].s_content[z]);
+            }
+        }
+    }
+
+    pf->rule_first[pf->rule_count] = literals;
+
+    /* Failure links,  breadth first.  Missing transitions are filled in
+     * from the failure state so scanning is one lookup per byte. */
+
+    for ( c = 0; c < pf->class_count; c++ ) {
+
+        child = pf->delta[c];
+
+        if ( child != 0 ) {
+            fail[child] = 0;
+            queue[tail++] = child;
+        }
+    }
+
+    while ( head < tail ) {
+
+        state = queue[head++];
+
+        for ( c = 0; c < pf->class_count; c++ ) {
+
+            child = pf->delta[state * pf->class_count + c];
+
+            if ( child != 0 ) {
+
+                fail[child] = pf->delta[fail[state] * pf->class_count + c];
+                pf->output[child] = pf->pattern[fail[child]] != -1 ? fail[child] : pf->output[fail[child]];
+                queue[tail++] = child;
+
+            } else {
+
+                pf->delta[state * pf->class_count + c] = pf->delta[fail[state] * pf->class_count + c];
+
+            }
+        }
+    }
+
+    free(fail);
+    free(queue);
+
+    pf->delta = realloc(pf->delta, pf->state_count * pf->class_count * sizeof(int));
+
+    /* No processor is in the middle of a batch (see above),  so nobody is
+     * scanning the old automaton */
+
+    old = prefilter;
+    __atomic_store_n(&prefilter, pf, __ATOMIC_RELEASE);
+    Sagan_Prefilter_Free(old);
+
+    Sagan_Log(S_NORMAL, "Content prefilter: %d literals, %d states, %d byte classes.", pf->pattern_count, pf->state_count, pf->class_count);
+}
+
+/*****************************************************************************
+ * Sagan_Prefilter_Scan - Marks the literals found in a message for the
+ * calling thread's following Sagan_Prefilter_Rule() calls.
+ *****************************************************************************/
+
+void Sagan_Prefilter_Scan( const char *message )
+{
+
+    struct _Sagan_Prefilter *pf = __atomic_load_n(&prefilter, __ATOMIC_ACQUIRE);
+
+    const unsigned char *p = (const unsigned char *)message;
+    int state = 0;
+    int out;
+
+    scanned = pf;
+
+    if ( pf == NULL ) {
+        return;
+    }
+
+    if ( pf->pattern_count > seen_size ) {
+
+        seen = realloc(seen, pf->pattern_count * sizeof(uint32_t));
+
+        if ( seen == NULL ) {
+            Sagan_Log(S_ERROR, "[%s, line %d] Failed to reallocate memory for prefilter results. Abort!", __FILE__, __LINE__);
+        }
+
+        memset(seen + seen_size, 0, (pf->pattern_count - seen_size) * sizeof(uint32_t));
+        seen_size = pf->pattern_count;
+    }
+
+    if ( ++generation == 0 ) {
+        memset(seen, 0, seen_size * sizeof(uint32_t));
+        generation = 1;
+    }
+
+    for ( ; *p != '\0'; p++ ) {
+
+        state = pf->delta[state * pf->class_count + pf->classes[*p]];
+
+        for ( out = pf->pattern[state] != -1 ? state : pf->output[state]; out != -1; out = pf->output[out] ) {
+            seen[pf->pattern[out]] = generation;
+        }
+    }
+}
+
+/*****************************************************************************
+ * Sagan_Prefilter_Rule - Were all of the rule's content: literals in the
+ * last message scanned?
+ *****************************************************************************/
+
+sbool Sagan_Prefilter_Rule( int rule )
+{
+
+    int i;
+
+    if ( scanned == NULL || rule >= scanned->rule_count ) {
+        return(true);
+    }
+
+    for ( i = scanned->rule_first[rule]; i < scanned->rule_first[rule + 1]; i++ ) {
+
+        if ( seen[scanned->rule_patterns[i]] != generation ) {
+            return(false);
+        }
+    }
+
+    return(true);
+}
@@ -0,0 +1,50 @@
+/*
+** Copyright (C) 2009-2017 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2017 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* sagan-prefilter.h
+ *
+ * Aho-Corasick prefilter over every rule's content: literals
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+typedef struct _Sagan_Prefilter _Sagan_Prefilter;
+struct _Sagan_Prefilter {
+
+    unsigned char classes[256];		/* Byte to class,  case folded.  0 == in no literal */
+    int class_count;
+
+    int *delta;				/* [state * class_count + class] -> next state */
+    int *pattern;			/* Literal that ends at this state,  or -1 */
+    int *output;			/* Next state down the failure chain ending a literal,  or -1 */
+    int state_count;
+    int pattern_count;
+
+    int *rule_first;			/* Rule's literals are rule_patterns[rule_first[r]..rule_first[r+1]] */
+    int *rule_patterns;
+    int rule_count;
+};
+
+void Sagan_Prefilter_Build( void );
+void Sagan_Prefilter_Scan( const char * );
+sbool Sagan_Prefilter_Rule( int );
@@ -28,14 +28,22 @@
 #endif
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <pthread.h>
 #include <string.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
 #include <stdbool.h>
 
 #include "sagan.h"
 #include "sagan-defs.h"
 #include "sagan-ignore-list.h"
 #include "sagan-config.h"
+#include "sagan-queue.h"
+#include "sagan-message.h"
+#include "sagan-split.h"
+#include "sagan-dns.h"
+#include "sagan-counters.h"
 #include "parsers/parsers.h"
 
 #include "processors/sagan-engine.h"
@@ -45,114 +53,251 @@
 
 struct _Sagan_Ignorelist *SaganIgnorelist;
 struct _SaganCounters *counters;
-struct _Sagan_Proc_Syslog *SaganProcSyslog;
+struct _Sagan_Queue *SaganProcQueue;	/* Comes from sagan.c */
 struct _SaganConfig *config;
 struct _Rule_Struct *rulestruct;
+struct _SaganDebug *debug;
 
-int proc_msgslot; 		/* Comes from sagan.c */
 sbool dynamic_rule_flag;
 
-pthread_cond_t SaganProcDoWork;
-pthread_mutex_t SaganProcWorkMutex;
-
-pthread_cond_t SaganReloadCond;
-pthread_mutex_t SaganReloadMutex;
+pthread_rwlock_t SaganReloadLock;
 
 pthread_mutex_t SaganDynamicFlag;
 
-pthread_mutex_t SaganIgnoreCounter=PTHREAD_MUTEX_INITIALIZER;
 pthread_mutex_t SaganClientTracker=PTHREAD_MUTEX_INITIALIZER;
 
 
-void Sagan_Processor ( void )
+/*****************************************************************************
+ * Sagan_Processor_Parse - Splits a raw "|" delimited line from the FIFO into
+ * its fields.  This used to be done by the reader thread in main() and is
+ * now done here so that it runs in parallel across the processor threads.
+ * The line is split in place within the message buffer.
+ *****************************************************************************/
+
+static const char *split_names[SPLIT_FIELDS] = {
+    "host", "facility", "priority", "level", "tag", "date", "time", "program", "message"
+};
+
+static const char *split_errors[SPLIT_FIELDS] = {
+    NULL, "SAGAN: FACILITY ERROR", "SAGAN: PRIORITY ERROR", "SAGAN: LEVEL ERROR",
+    "SAGAN: TAG ERROR", "SAGAN: DATE ERROR", "SAGAN: TIME ERROR", "SAGAN: PROGRAM ERROR",
+    "SAGAN: MESSAGE ERROR"
+};
+
+static void Sagan_Processor_Parse( struct _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL )
 {
 
-    struct _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL = NULL;
-    SaganProcSyslog_LOCAL = malloc(sizeof(struct _Sagan_Proc_Syslog));
+    struct sockaddr_in sa;
+    char src_dns_lookup[64];
+
+    struct _Sagan_Split split;
+    char *field[SPLIT_FIELDS];
+    char *line = SaganProcSyslog_LOCAL->buf;
+
+    struct _Sagan_Thread_Counters *local = Sagan_Thread_Counters();
+
+    uintmax_t *malformed[SPLIT_FIELDS] = {
+        &local->malformed_host, &local->malformed_facility, &local->malformed_priority,
+        &local->malformed_level, &local->malformed_tag, &local->malformed_date,
+        &local->malformed_time, &local->malformed_program, &local->malformed_message
+    };
 
-    if ( SaganProcSyslog_LOCAL == NULL ) {
-        Sagan_Log(S_ERROR, "[%s, line %d] Failed to allocate memory for SaganProcSyslog_LOCAL. Abort!", __FILE__, __LINE__);
+    char *syslog_host=NULL;
+    char *syslog_msg=NULL;
+
+    int count;
+    int i;
+
+    SaganProcSyslog_LOCAL->syslog_raw = false;
+
+    /* One pass finds every delimiter.  The fields are then terminated in
+     * place so they can be used as strings */
+
+    count = Sagan_Split_Fields(line, SaganProcSyslog_LOCAL->buf_len - 1, &split);
+
+    /* Like the old strlcpy() into syslog_message,  only the message is
+     * held to MAX_SYSLOGMSG */
+
+    if ( count == SPLIT_FIELDS && split.len[SPLIT_MESSAGE] > MAX_SYSLOGMSG - 1 ) {
+        split.len[SPLIT_MESSAGE] = MAX_SYSLOGMSG - 1;
     }
 
-    memset(SaganProcSyslog_LOCAL, 0, sizeof(struct _Sagan_Proc_Syslog));
+    for (i = 0; i < SPLIT_FIELDS; i++) {
+
+        if ( i < count ) {
+            field[i] = line + split.offset[i];
+            field[i][split.len[i]] = '\0';
+            continue;
+        }
+
+        field[i] = (char *)split_errors[i];
+
+        /* The host is checked below */
+
+        if ( i == SPLIT_HOST ) {
+            continue;
+        }
+
+        (*malformed[i])++;
+
+        if ( debug->debugmalformed ) {
+            Sagan_Log(S_WARN, "Sagan received a malformed '%s'", split_names[i]);
+        }
+    }
+
+    syslog_host = field[SPLIT_HOST];
+    syslog_msg = field[SPLIT_MESSAGE];
+
+    /* If we're using DNS (and we shouldn't be!),  the lookup goes through the
+     * cache in sagan-dns.c.  A miss is resolved in the background,  so we
+     * never wait on a DNS server here */
+
+    if (config->syslog_src_lookup && syslog_host != NULL ) {
+        if ( inet_pton(AF_INET, syslog_host, &(sa.sin_addr)) == 0 ) { 	/* Is inbound a valid IP? */
+            Sagan_DNS_Lookup(syslog_host, src_dns_lookup, sizeof(src_dns_lookup));
+            syslog_host = src_dns_lookup;
+        }
+
+    } else {
+
+        /* We check to see if values from our FIFO are valid.  If we aren't doing DNS related
+        * stuff (above),  we start basic check with the syslog_host */
+
+        if (syslog_host == NULL || inet_pton(AF_INET, syslog_host, &(sa.sin_addr)) == 0  ) {
+            syslog_host = config->sagan_host;
+
+            local->malformed_host++;
+
+            if ( debug->debugmalformed ) {
+                Sagan_Log(S_WARN, "Sagan received a malformed 'host' (replaced with %s)", config->sagan_host);
+            }
+        }
+    }
+
+    /* If the message is lost,  all is lost.  Typically,  you don't lose part of the message,
+     * it's more likely to lose all  - Champ Clark III 11/17/2011 */
+
+    if ( count < SPLIT_FIELDS ) {
+        local->sagan_log_drop++;
+    }
+
+    if (debug->debugsyslog) {
+
+        Sagan_Log(S_DEBUG, "[%s, line %d] **[RAW Syslog]*********************************", __FILE__, __LINE__);
+        Sagan_Log(S_DEBUG, "[%s, line %d] Host: %s | Program: %s | Facility: %s | Priority: %s | Level: %s | Tag: %s", __FILE__, __LINE__, syslog_host, field[SPLIT_PROGRAM], field[SPLIT_FACILITY], field[SPLIT_PRIORITY], field[SPLIT_LEVEL], field[SPLIT_TAG]);
+        Sagan_Log(S_DEBUG, "[%s, line %d] Raw message: %s", __FILE__, __LINE__, syslog_msg);
+
+    }
+
+    /* The fields are views of the line in "buf".  Only a looked up host
+     * needs to be copied in */
+
+    if ( syslog_host == src_dns_lookup ) {
+        syslog_host = Sagan_Message_Append(SaganProcSyslog_LOCAL, src_dns_lookup, strlen(src_dns_lookup));
+    }
+
+    SaganProcSyslog_LOCAL->syslog_host = syslog_host;
+    SaganProcSyslog_LOCAL->syslog_facility = field[SPLIT_FACILITY];
+    SaganProcSyslog_LOCAL->syslog_priority = field[SPLIT_PRIORITY];
+    SaganProcSyslog_LOCAL->syslog_level = field[SPLIT_LEVEL];
+    SaganProcSyslog_LOCAL->syslog_tag = field[SPLIT_TAG];
+    SaganProcSyslog_LOCAL->syslog_date = field[SPLIT_DATE];
+    SaganProcSyslog_LOCAL->syslog_time = field[SPLIT_TIME];
+    SaganProcSyslog_LOCAL->syslog_program = field[SPLIT_PROGRAM];
+    SaganProcSyslog_LOCAL->syslog_message = syslog_msg;
+    SaganProcSyslog_LOCAL->syslog_message_len = count == SPLIT_FIELDS ? split.len[SPLIT_MESSAGE] : strlen(syslog_msg);
+
+}
+
+void Sagan_Processor ( void )
+{
+
+    struct _Sagan_Proc_Syslog *SaganProcSyslog_BATCH[PROCESSOR_BATCH];
+    struct _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL = NULL;
 
     sbool ignore_flag = false;
 
     int i;
+    int batch;
+    int batch_count;
 
     for (;;) {
 
-        pthread_mutex_lock(&SaganProcWorkMutex);
+        /* Blocks until at least one event is queued,  then takes up to
+         * PROCESSOR_BATCH events in the order they arrived */
 
-        while ( proc_msgslot == 0 ) pthread_cond_wait(&SaganProcDoWork, &SaganProcWorkMutex);
+        batch_count = Sagan_Queue_Pop_Batch(SaganProcQueue, SaganProcSyslog_BATCH, PROCESSOR_BATCH);
 
-        if ( config->sagan_reload ) {
-            pthread_cond_wait(&SaganReloadCond, &SaganReloadMutex);
-        }
+        /* The rules can't change under a batch.  A SIGHUP reload holds
+         * SaganReloadLock for writing,  so it waits for this batch to finish
+         * and we wait here while it runs */
 
-        proc_msgslot--;	/* This was ++ before coming over, so we now -- it to get to
-					 * original value */
+        pthread_rwlock_rdlock(&SaganReloadLock);
 
-        strlcpy(SaganProcSyslog_LOCAL->syslog_host, SaganProcSyslog[proc_msgslot].syslog_host, sizeof(SaganProcSyslog_LOCAL->syslog_host));
-        strlcpy(SaganProcSyslog_LOCAL->syslog_facility, SaganProcSyslog[proc_msgslot].syslog_facility, sizeof(SaganProcSyslog_LOCAL->syslog_facility));
-        strlcpy(SaganProcSyslog_LOCAL->syslog_priority, SaganProcSyslog[proc_msgslot].syslog_priority, sizeof(SaganProcSyslog_LOCAL->syslog_priority));
-        strlcpy(SaganProcSyslog_LOCAL->syslog_level, SaganProcSyslog[proc_msgslot].syslog_level, sizeof(SaganProcSyslog_LOCAL->syslog_level));
-        strlcpy(SaganProcSyslog_LOCAL->syslog_tag, SaganProcSyslog[proc_msgslot].syslog_tag, sizeof(SaganProcSyslog_LOCAL->syslog_tag));
-        strlcpy(SaganProcSyslog_LOCAL->syslog_date, SaganProcSyslog[proc_msgslot].syslog_date, sizeof(SaganProcSyslog_LOCAL->syslog_date));
-        strlcpy(SaganProcSyslog_LOCAL->syslog_time, SaganProcSyslog[proc_msgslot].syslog_time, sizeof(SaganProcSyslog_LOCAL->syslog_time));
-        strlcpy(SaganProcSyslog_LOCAL->syslog_program, SaganProcSyslog[proc_msgslot].syslog_program, sizeof(SaganProcSyslog_LOCAL->syslog_program));
-        strlcpy(SaganProcSyslog_LOCAL->syslog_message, SaganProcSyslog[proc_msgslot].syslog_message, sizeof(SaganProcSyslog_LOCAL->syslog_message));
+        for ( batch = 0; batch < batch_count; batch++ ) {
 
-        pthread_mutex_unlock(&SaganProcWorkMutex);
+            SaganProcSyslog_LOCAL = SaganProcSyslog_BATCH[batch];
 
-        /* Check for general "drop" items.  We do this first so we can save CPU later */
+            /* Lines from the FIFO arrive unsplit */
 
-        if ( config->sagan_droplist_flag ) {
+            if ( SaganProcSyslog_LOCAL->syslog_raw ) {
+                Sagan_Processor_Parse(SaganProcSyslog_LOCAL);
+            }
+
+            /* Check for general "drop" items.  We do this first so we can save CPU later */
 
-            ignore_flag = false;
+            if ( config->sagan_droplist_flag ) {
 
-            for (i = 0; i < counters->droplist_count; i++) {
+                ignore_flag = false;
 
-                if (Sagan_strstr(SaganProcSyslog_LOCAL->syslog_message, SaganIgnorelist[i].ignore_string)) {
+                for (i = 0; i < counters->droplist_count; i++) {
 
-                    pthread_mutex_lock(&SaganIgnoreCounter);
-                    counters->ignore_count++;
-                    pthread_mutex_unlock(&SaganIgnoreCounter);
+                    if (Sagan_strstr(SaganProcSyslog_LOCAL->syslog_message, SaganIgnorelist[i].ignore_string)) {
 
-                    ignore_flag = true;
-                    goto outside_loop;	/* Stop processing from ignore list */
+                        Sagan_Thread_Counters()->ignore_count++;
+
+                        ignore_flag = true;
+                        goto outside_loop;	/* Stop processing from ignore list */
+                    }
                 }
             }
-        }
 
 outside_loop:
 
-        /* If we're in a ignore state,  then we can bypass the processors */
+            /* If we're in a ignore state,  then we can bypass the processors */
 
-        if ( ignore_flag == false ) {
+            if ( ignore_flag == false ) {
 
-            Sagan_Engine(SaganProcSyslog_LOCAL, dynamic_rule_flag );
+                Sagan_Engine(SaganProcSyslog_LOCAL, dynamic_rule_flag );
 
-            /* If this is a dynamic run,  reset back to normal */
+                /* If this is a dynamic run,  reset back to normal */
 
-            if ( dynamic_rule_flag == DYNAMIC_RULE ) {
+                if ( dynamic_rule_flag == DYNAMIC_RULE ) {
 
-                pthread_mutex_lock(&SaganDynamicFlag);
-                dynamic_rule_flag = 0;
-                pthread_mutex_unlock(&SaganDynamicFlag);
+                    pthread_mutex_lock(&SaganDynamicFlag);
+                    dynamic_rule_flag = 0;
+                    pthread_mutex_unlock(&SaganDynamicFlag);
 
-            }
+                }
 
-            if ( config->sagan_track_clients_flag ) {
-                Sagan_Track_Clients( IP2Bit(SaganProcSyslog_LOCAL->syslog_host) );
-            }
+                if ( config->sagan_track_clients_flag ) {
+                    Sagan_Track_Clients( IP2Bit(SaganProcSyslog_LOCAL->syslog_host) );
+                }
+
+            } // End if if (ignore_Flag)
+
+            Sagan_Message_Put(SaganProcSyslog_LOCAL);
+
+        } // for (batch)
+
+        pthread_rwlock_unlock(&SaganReloadLock);
 
-        } // End if if (ignore_Flag)
+        /* Rule sets a "dynamic_load" rule asked for in this batch */
 
+        Sagan_Dynamic_Rules_Load();
 
     } //  for (;;)
 
     Sagan_Log(S_WARN, "[%s, line %d] Holy cow! You should never see this message!", __FILE__, __LINE__);
-    free(SaganProcSyslog_LOCAL);		/* Should never make it here */
 }
 
@@ -91,8 +91,15 @@ void Load_Protocol_Map( const char *map )
                 }
 
                 map_message[counters->mapcount_message].proto = atoi(map2);
-                if (!strcmp(map3, "nocase")) map_message[counters->mapcount_message].nocase = 1;
+                map_message[counters->mapcount_message].nocase = !strcmp(map3, "nocase") ? 1 : 0;
                 strlcpy(map_message[counters->mapcount_message].search, map4, sizeof(map_message[counters->mapcount_message].search));
+
+                /* Lowercase once here rather than on every search */
+
+                if ( map_message[counters->mapcount_message].nocase == 1 ) {
+                    To_LowerC(map_message[counters->mapcount_message].search);
+                }
+
                 counters->mapcount_message++;
             }
 
@@ -104,8 +111,15 @@ void Load_Protocol_Map( const char *map )
                 }
 
                 map_program[counters->mapcount_program].proto = atoi(map2);
-                if (!strcmp(map3, "nocase")) map_program[counters->mapcount_program].nocase = 1;
+                map_program[counters->mapcount_program].nocase = !strcmp(map3, "nocase") ? 1 : 0;
                 strlcpy(map_program[counters->mapcount_program].program, map4, sizeof(map_program[counters->mapcount_program].program));
+
+                /* Lowercase once here rather than on every search */
+
+                if ( map_program[counters->mapcount_program].nocase == 1 ) {
+                    To_LowerC(map_program[counters->mapcount_program].program);
+                }
+
                 counters->mapcount_program++;
             }
 
@@ -0,0 +1,366 @@
+/*
+** Copyright (C) 2009-2017 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2017 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* sagan-queue.c
+ *
+ * A bounded,  lock-free multi-producer/multi-consumer ring used to hand
+ * work from the input thread(s) to the processor threads.  Producers and
+ * consumers only touch their own position counter and the cell they claim,
+ * so the hot path never takes a lock.  When the ring is full (or empty),
+ * callers spin for a short time and then block on a condition variable.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "sagan.h"
+#include "sagan-defs.h"
+#include "sagan-queue.h"
+
+#define QUEUE_CELL_HEADER	sizeof(uint64_t)
+
+/****************************************************************************
+ * Sagan_Queue_Relax - CPU "pause" while spinning on a busy queue
+ ****************************************************************************/
+
+static inline void Sagan_Queue_Relax( void )
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#else
+    __asm__ __volatile__("" ::: "memory");
+#endif
+}
+
+static inline uint64_t *Sagan_Queue_Seq( _Sagan_Queue *q, uint64_t pos )
+{
+    return( (uint64_t *)(q->cells + (pos & q->mask) * q->cell_size) );
+}
+
+static sbool Sagan_Queue_Is_Full( _Sagan_Queue *q )
+{
+    uint64_t pos = __atomic_load_n(&q->enqueue_pos, __ATOMIC_SEQ_CST);
+    uint64_t seq = __atomic_load_n(Sagan_Queue_Seq(q, pos), __ATOMIC_SEQ_CST);
+
+    return( (int64_t)(seq - pos) < 0 );
+}
+
+static sbool Sagan_Queue_Is_Empty( _Sagan_Queue *q )
+{
+    uint64_t pos = __atomic_load_n(&q->dequeue_pos, __ATOMIC_SEQ_CST);
+    uint64_t seq = __atomic_load_n(Sagan_Queue_Seq(q, pos), __ATOMIC_SEQ_CST);
+
+    return( (int64_t)(seq - (pos + 1)) < 0 );
+}
+
+/****************************************************************************
+ * Sagan_Queue_Wake - Wake a sleeper on the other side of the queue.  The
+ * fence pairs with the waiter count increment in Sagan_Queue_Wait_* so a
+ * sleeper cannot miss the cell we just published.
+ ****************************************************************************/
+
+static inline void Sagan_Queue_Wake( _Sagan_Queue *q, int *waiters, pthread_cond_t *cond )
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    if ( __atomic_load_n(waiters, __ATOMIC_RELAXED) != 0 ) {
+        pthread_mutex_lock(&q->lock);
+        pthread_cond_signal(cond);
+        pthread_mutex_unlock(&q->lock);
+    }
+}
+
+static void Sagan_Queue_Wait_Full( _Sagan_Queue *q, int *spin )
+{
+
+    if ( ++(*spin) < QUEUE_SPIN_COUNT ) {
+        Sagan_Queue_Relax();
+        return;
+    }
+
+    pthread_mutex_lock(&q->lock);
+    __atomic_add_fetch(&q->producer_waiters, 1, __ATOMIC_SEQ_CST);
+
+    while ( Sagan_Queue_Is_Full(q) ) {
+        pthread_cond_wait(&q->not_full, &q->lock);
+    }
+
+    __atomic_sub_fetch(&q->producer_waiters, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&q->lock);
+
+    *spin = 0;
+}
+
+static void Sagan_Queue_Wait_Empty( _Sagan_Queue *q, int *spin )
+{
+
+    if ( ++(*spin) < QUEUE_SPIN_COUNT ) {
+        Sagan_Queue_Relax();
+        return;
+    }
+
+    pthread_mutex_lock(&q->lock);
+    __atomic_add_fetch(&q->consumer_waiters, 1, __ATOMIC_SEQ_CST);
+
+    while ( Sagan_Queue_Is_Empty(q) ) {
+        pthread_cond_wait(&q->not_empty, &q->lock);
+    }
+
+    __atomic_sub_fetch(&q->consumer_waiters, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&q->lock);
+
+    *spin = 0;
+}
+
+/****************************************************************************
+ * Sagan_Queue_Init - Allocate a queue of at least "depth" elements, each
+ * "elem_size" bytes.  Depth is rounded up to a power of two.
+ ****************************************************************************/
+
+_Sagan_Queue *Sagan_Queue_Init( uint64_t depth, size_t elem_size )
+{
+
+    _Sagan_Queue *q = NULL;
+    uint64_t size = 2;
+    uint64_t i;
+
+    while ( size < depth ) {
+        size <<= 1;
+    }
+
+    q = malloc(sizeof(_Sagan_Queue));
+
+    if ( q == NULL ) {
+        Sagan_Log(S_ERROR, "[%s, line %d] Failed to allocate memory for queue. Abort!", __FILE__, __LINE__);
+    }
+
+    memset(q, 0, sizeof(_Sagan_Queue));
+
+    q->elem_size = elem_size;
+    q->cell_size = ( QUEUE_CELL_HEADER + elem_size + CACHE_LINE_SIZE - 1 ) & ~((size_t)CACHE_LINE_SIZE - 1);
+    q->mask = size - 1;
+
+    if ( posix_memalign((void **)&q->cells, CACHE_LINE_SIZE, q->cell_size * size) != 0 ) {
+        Sagan_Log(S_ERROR, "[%s, line %d] Failed to allocate memory for %" PRIu64 " queue cells. Abort!", __FILE__, __LINE__, size);
+    }
+
+    memset(q->cells, 0, q->cell_size * size);
+
+    /* Cell "i" is free for the producer holding position "i" */
+
+    for ( i = 0; i < size; i++ ) {
+        *Sagan_Queue_Seq(q, i) = i;
+    }
+
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->not_empty, NULL);
+    pthread_cond_init(&q->not_full, NULL);
+
+    return(q);
+}
+
+/****************************************************************************
+ * Sagan_Queue_Claim - Claim the next free cell for writing.  If the queue
+ * is full,  either wait for room or return NULL.
+ ****************************************************************************/
+
+static void *Sagan_Queue_Claim( _Sagan_Queue *q, uint64_t *ticket, sbool wait )
+{
+
+    uint64_t pos = __atomic_load_n(&q->enqueue_pos, __ATOMIC_RELAXED);
+    uint64_t seq;
+    int64_t dif;
+    int spin = 0;
+
+    for (;;) {
+
+        seq = __atomic_load_n(Sagan_Queue_Seq(q, pos), __ATOMIC_ACQUIRE);
+        dif = (int64_t)(seq - pos);
+
+        if ( dif == 0 ) {
+
+            if ( __atomic_compare_exchange_n(&q->enqueue_pos, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED) ) {
+                *ticket = pos;
+                return( (unsigned char *)Sagan_Queue_Seq(q, pos) + QUEUE_CELL_HEADER );
+            }
+
+            /* Lost the race,  "pos" now holds the current position */
+
+        } else if ( dif < 0 ) {
+
+            if ( wait == false ) {
+                return(NULL);
+            }
+
+            Sagan_Queue_Wait_Full(q, &spin);
+            pos = __atomic_load_n(&q->enqueue_pos, __ATOMIC_RELAXED);
+
+        } else {
+
+            pos = __atomic_load_n(&q->enqueue_pos, __ATOMIC_RELAXED);
+
+        }
+    }
+}
+
+/****************************************************************************
+ * Sagan_Queue_Reserve - Claim the next free cell for writing.  Blocks
+ * (spin, then sleep) if the queue is full.  The returned pointer is filled
+ * in place and handed to consumers with Sagan_Queue_Commit().
+ ****************************************************************************/
+
+void *Sagan_Queue_Reserve( _Sagan_Queue *q, uint64_t *ticket )
+{
+    return(Sagan_Queue_Claim(q, ticket, true));
+}
+
+/****************************************************************************
+ * Sagan_Queue_Commit - Publish a cell claimed with Sagan_Queue_Reserve()
+ ****************************************************************************/
+
+void Sagan_Queue_Commit( _Sagan_Queue *q, uint64_t ticket )
+{
+    __atomic_store_n(Sagan_Queue_Seq(q, ticket), ticket + 1, __ATOMIC_RELEASE);
+    Sagan_Queue_Wake(q, &q->consumer_waiters, &q->not_empty);
+}
+
+/****************************************************************************
+ * Sagan_Queue_Push - Copy one element into the queue
+ ****************************************************************************/
+
+void Sagan_Queue_Push( _Sagan_Queue *q, const void *elem )
+{
+    uint64_t ticket;
+    void *cell = Sagan_Queue_Reserve(q, &ticket);
+
+    memcpy(cell, elem, q->elem_size);
+    Sagan_Queue_Commit(q, ticket);
+}
+
+/****************************************************************************
+ * Sagan_Queue_Try_Push - Copy one element into the queue unless it is full.
+ * Returns false if the element was not queued.
+ ****************************************************************************/
+
+sbool Sagan_Queue_Try_Push( _Sagan_Queue *q, const void *elem )
+{
+    uint64_t ticket;
+    void *cell = Sagan_Queue_Claim(q, &ticket, false);
+
+    if ( cell == NULL ) {
+        return(false);
+    }
+
+    memcpy(cell, elem, q->elem_size);
+    Sagan_Queue_Commit(q, ticket);
+
+    return(true);
+}
+
+/****************************************************************************
+ * Sagan_Queue_Try_Pop - Copy one element out of the queue if one is ready
+ ****************************************************************************/
+
+static sbool Sagan_Queue_Try_Pop( _Sagan_Queue *q, void *out )
+{
+
+    uint64_t pos = __atomic_load_n(&q->dequeue_pos, __ATOMIC_RELAXED);
+    uint64_t *seqp;
+    uint64_t seq;
+    int64_t dif;
+
+    for (;;) {
+
+        seqp = Sagan_Queue_Seq(q, pos);
+        seq = __atomic_load_n(seqp, __ATOMIC_ACQUIRE);
+        dif = (int64_t)(seq - (pos + 1));
+
+        if ( dif == 0 ) {
+
+            if ( __atomic_compare_exchange_n(&q->dequeue_pos, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED) ) {
+
+                memcpy(out, (unsigned char *)seqp + QUEUE_CELL_HEADER, q->elem_size);
+
+                /* Hand the cell back to producers for the next lap */
+
+                __atomic_store_n(seqp, pos + q->mask + 1, __ATOMIC_RELEASE);
+                Sagan_Queue_Wake(q, &q->producer_waiters, &q->not_full);
+
+                return(true);
+            }
+
+        } else if ( dif < 0 ) {
+
+            return(false);
+
+        } else {
+
+            pos = __atomic_load_n(&q->dequeue_pos, __ATOMIC_RELAXED);
+
+        }
+    }
+}
+
+/****************************************************************************
+ * Sagan_Queue_Pop_Batch - Wait for at least one element,  then take up to
+ * "max" elements in FIFO order.  "out" must have room for "max" elements.
+ * Returns the number of elements copied.
+ ****************************************************************************/
+
+int Sagan_Queue_Pop_Batch( _Sagan_Queue *q, void *out, int max )
+{
+
+    unsigned char *dst = out;
+    int spin = 0;
+    int count = 1;
+
+    while ( Sagan_Queue_Try_Pop(q, dst) == false ) {
+        Sagan_Queue_Wait_Empty(q, &spin);
+    }
+
+    while ( count < max && Sagan_Queue_Try_Pop(q, dst + count * q->elem_size) == true ) {
+        count++;
+    }
+
+    return(count);
+}
+
+/****************************************************************************
+ * Sagan_Queue_Count - Approximate number of queued elements (for stats and
+ * for draining at EOF).
+ ****************************************************************************/
+
+uint64_t Sagan_Queue_Count( _Sagan_Queue *q )
+{
+    uint64_t tail = __atomic_load_n(&q->dequeue_pos, __ATOMIC_ACQUIRE);
+    uint64_t head = __atomic_load_n(&q->enqueue_pos, __ATOMIC_ACQUIRE);
+
+    return( head > tail ? head - tail : 0 );
+}
@@ -0,0 +1,63 @@
+/*
+** Copyright (C) 2009-2017 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2017 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include "sagan-defs.h"
+
+/* Bounded multi-producer/multi-consumer ring.  Each cell carries a sequence
+ * number that tells producers and consumers whether the cell is free or
+ * full for a given lap around the ring (Dmitry Vyukov's design).  Element
+ * data is stored in-line in the cells */
+
+typedef struct _Sagan_Queue _Sagan_Queue;
+struct _Sagan_Queue {
+
+    unsigned char *cells;
+    size_t	cell_size;
+    size_t	elem_size;
+    uint64_t	mask;
+
+    char	pad0[CACHE_LINE_SIZE];
+    uint64_t	enqueue_pos;
+    char	pad1[CACHE_LINE_SIZE];
+    uint64_t	dequeue_pos;
+    char	pad2[CACHE_LINE_SIZE];
+
+    int		consumer_waiters;
+    int		producer_waiters;
+
+    pthread_mutex_t lock;
+    pthread_cond_t  not_empty;
+    pthread_cond_t  not_full;
+};
+
+_Sagan_Queue *Sagan_Queue_Init( uint64_t, size_t );
+void *Sagan_Queue_Reserve( _Sagan_Queue *, uint64_t * );
+void Sagan_Queue_Commit( _Sagan_Queue *, uint64_t );
+void Sagan_Queue_Push( _Sagan_Queue *, const void * );
+sbool Sagan_Queue_Try_Push( _Sagan_Queue *, const void * );
+int Sagan_Queue_Pop_Batch( _Sagan_Queue *, void *, int );
+uint64_t Sagan_Queue_Count( _Sagan_Queue * );
@@ -0,0 +1,438 @@
+/*
+** Copyright (C) 2009-2017 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2017 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* sagan-rule-index.c
+ *
+ * Sagan_Engine() used to walk every rule for every message,  splitting the
+ * rule's program,  facility,  priority,  level and tag on "|" each time to
+ * see if the rule applied.  Here those options are split once as the rule
+ * is loaded,  and each rule is filed under one exact value it requires (its
+ * program if it has one).  A message only looks at the rules filed under
+ * its own values,  plus the rules with a wildcard program and rules with
+ * no header options at all.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "sagan.h"
+#include "sagan-defs.h"
+#include "sagan-rules.h"
+#include "sagan-rule-index.h"
+
+struct _Rule_Struct *rulestruct;
+
+static struct _Sagan_Rule_Header *rule_headers = NULL;
+static int rule_headers_size = 0;
+
+static struct _Sagan_Rule_Key *rule_keys = NULL;
+static int rule_keys_count = 0;
+static int rule_keys_size = 0;
+
+static int rule_buckets[RULE_INDEX_BUCKETS];
+static sbool rule_buckets_init = false;
+
+static struct _Sagan_Rule_List rule_wildcard;	/* Wildcard program only */
+static struct _Sagan_Rule_List rule_any;	/* No header options */
+
+/* Order in which a rule's options are tried when picking what to file it
+ * under.  Most selective first. */
+
+static const int rule_index_order[RULE_INDEX_FIELDS] = {
+    RULE_INDEX_PROGRAM, RULE_INDEX_TAG, RULE_INDEX_FACILITY, RULE_INDEX_LEVEL, RULE_INDEX_PRIORITY
+};
+
+/*****************************************************************************
+ * Sagan_Rule_Index_Hash - FNV-1a over the field and value
+ *****************************************************************************/
+
+static uint32_t Sagan_Rule_Index_Hash( int field, const char *value )
+{
+
+    uint32_t hash = 2166136261U;
+
+    hash ^= (unsigned char)field;
+    hash *= 16777619U;
+
+    while ( *value != '\0' ) {
+        hash ^= (unsigned char)*value++;
+        hash *= 16777619U;
+    }
+
+    return(hash);
+}
+
+static void Sagan_Rule_List_Add( struct _Sagan_Rule_List *list, int rule )
+{
+
+    /* Repeated alternatives ("sshd|sshd") only file the rule once */
+
+    if ( list->count != 0 && list->rules[list->count - 1] == rule ) {
+        return;
+    }
+
+    if ( list->count == list->size ) {
+
+        list->size = list->size == 0 ? 16 : list->size * 2;
+        list->rules = (int *) realloc(list->rules, list->size * sizeof(int));
+
+        if ( list->rules == NULL ) {
+            Sagan_Log(S_ERROR, "[%s, line %d] Failed to reallocate memory for rule index list. Abort!", __FILE__, __LINE__);
+        }
+    }
+
+    list->rules[list->count++] = rule;
+}
+
+static struct _Sagan_Rule_Key *Sagan_Rule_Index_Find( int field, const char *value )
+{
+
+    uint32_t hash = Sagan_Rule_Index_Hash(field, value);
+    int i;
+
+    if ( rule_buckets_init == false ) {
+        return(NULL);
+    }
+
+    for ( i = rule_buckets[hash & (RULE_INDEX_BUCKETS - 1)]; i != -1; i = rule_keys[i].next ) {
+
+        if ( rule_keys[i].hash == hash && rule_keys[i].field == field && !strcmp(rule_keys[i].value, value) ) {
+            return(&rule_keys[i]);
+        }
+    }
+
+    return(NULL);
+}
+
+static struct _Sagan_Rule_Key *Sagan_Rule_Index_Insert( int field, const char *value )
+{
+
+    struct _Sagan_Rule_Key *key = Sagan_Rule_Index_Find(field, value);
+    uint32_t bucket;
+    int i;
+
+    if ( key != NULL ) {
+        return(key);
+    }
+
+    if ( rule_buckets_init == false ) {
+
+        for ( i = 0; i < RULE_INDEX_BUCKETS; i++ ) {
+            rule_buckets[i] = -1;
+        }
+
+        rule_buckets_init = true;
+    }
+
+    if ( rule_keys_count == rule_keys_size ) {
+
+        rule_keys_size = rule_keys_size == 0 ? 64 : rule_keys_size * 2;
+        rule_keys = (_Sagan_Rule_Key *) realloc(rule_keys, rule_keys_size * sizeof(_Sagan_Rule_Key));
+
+        if ( rule_keys == NULL ) {
+            Sagan_Log(S_ERROR, "[%s, line %d] Failed to reallocate memory for rule_keys. Abort!", __FILE__, __LINE__);
+        }
+    }
+
+    key = &rule_keys[rule_keys_count];
+    memset(key, 0, sizeof(_Sagan_Rule_Key));
+
+    strlcpy(key->value, value, sizeof(key->value));
+    key->field = field;
+    key->hash = Sagan_Rule_Index_Hash(field, value);
+
+    bucket = key->hash & (RULE_INDEX_BUCKETS - 1);
+    key->next = rule_buckets[bucket];
+    rule_buckets[bucket] = rule_keys_count;
+
+    rule_keys_count++;
+
+    return(key);
+}
+
+/*****************************************************************************
+ * Sagan_Rule_Header_Split - Copies a "|" separated option into the header
+ * buffer as '\0' separated alternatives.  Returns the next free offset.
+ *****************************************************************************/
+
+static int Sagan_Rule_Header_Split( struct _Sagan_Rule_Header *header, int field, const char *option, int pos )
+{
+
+    char tmpbuf[256];
+    char *ptmp = NULL;
+    char *tok = NULL;
+
+    header->field[field] = pos;
+
+    strlcpy(tmpbuf, option, sizeof(tmpbuf));
+    ptmp = strtok_r(tmpbuf, "|", &tok);
+
+    while ( ptmp != NULL ) {
+
+        header->set |= 1 << field;
+
+        if ( field == RULE_INDEX_PROGRAM && strpbrk(ptmp, "*?") != NULL ) {
+            header->wildcard = true;
+        }
+
+        pos += strlcpy(header->buf + pos, ptmp, RULE_HEADER_SIZE - pos) + 1;
+        ptmp = strtok_r(NULL, "|", &tok);
+    }
+
+    header->buf[pos++] = '\0';
+
+    return(pos);
+}
+
+/*****************************************************************************
+ * Sagan_Rule_Header_Match - Does "value" match one of the field's
+ * alternatives?
+ *****************************************************************************/
+
+static sbool Sagan_Rule_Header_Match( struct _Sagan_Rule_Header *header, int field, char *value )
+{
+
+    char *alt = header->buf + header->field[field];
+
+    for ( ; *alt != '\0'; alt += strlen(alt) + 1 ) {
+
+        if ( field == RULE_INDEX_PROGRAM && header->wildcard == true ) {
+
+            if ( Sagan_Wildcard(alt, value) == true ) {
+                return(true);
+            }
+
+        } else if ( !strcmp(alt, value) ) {
+            return(true);
+        }
+    }
+
+    return(false);
+}
+
+static sbool Sagan_Rule_Header_Check( int rule, char **values )
+{
+
+    struct _Sagan_Rule_Header *header = &rule_headers[rule];
+    int field;
+
+    for ( field = 0; field < RULE_INDEX_FIELDS; field++ ) {
+
+        if ( ( header->set & ( 1 << field ) ) && Sagan_Rule_Header_Match(header, field, values[field]) == false ) {
+            return(false);
+        }
+    }
+
+    return(true);
+}
+
+/*****************************************************************************
+ * Sagan_Rule_Index_Add - Called by Load_Rules() for each new rule.  Rules
+ * must be added in order.
+ *****************************************************************************/
+
+void Sagan_Rule_Index_Add( int rule )
+{
+
+    struct _Sagan_Rule_Header *header;
+    struct _Sagan_Rule_Key *key;
+
+    char *alt;
+    int field;
+    int pos = 0;
+    int i;
+
+    if ( rule >= rule_headers_size ) {
+
+        rule_headers_size = rule_headers_size == 0 ? 256 : rule_headers_size * 2;
+        rule_headers = (_Sagan_Rule_Header *) realloc(rule_headers, rule_headers_size * sizeof(_Sagan_Rule_Header));
+
+        if ( rule_headers == NULL ) {
+            Sagan_Log(S_ERROR, "[%s, line %d] Failed to reallocate memory for rule_headers. Abort!", __FILE__, __LINE__);
+        }
+    }
+
+    header = &rule_headers[rule];
+    memset(header, 0, sizeof(_Sagan_Rule_Header));
+
+    pos = Sagan_Rule_Header_Split(header, RULE_INDEX_PROGRAM, rulestruct[rule].s_program, pos);
+    pos = Sagan_Rule_Header_Split(header, RULE_INDEX_FACILITY, rulestruct[rule].s_facility, pos);
+    pos = Sagan_Rule_Header_Split(header, RULE_INDEX_PRIORITY, rulestruct[rule].s_syspri, pos);
+    pos = Sagan_Rule_Header_Split(header, RULE_INDEX_LEVEL, rulestruct[rule].s_level, pos);
+    pos = Sagan_Rule_Header_Split(header, RULE_INDEX_TAG, rulestruct[rule].s_tag, pos);
+
+    /* File the rule under every alternative of its most selective exact
+     * option.  A message has one value per field,  so it can only find
+     * the rule once. */
+
+    for ( i = 0; i < RULE_INDEX_FIELDS; i++ ) {
+
+        field = rule_index_order[i];
+
+        if ( !( header->set & ( 1 << field ) ) || ( field == RULE_INDEX_PROGRAM && header->wildcard == true ) ) {
+            continue;
+        }
+
+        for ( alt = header->buf + header->field[field]; *alt != '\0'; alt += strlen(alt) + 1 ) {
+            key = Sagan_Rule_Index_Insert(field, alt);
+            Sagan_Rule_List_Add(&key->list, rule);
+        }
+
+        return;
+    }
+
+    /* Nothing exact to file it under */
+
+    if ( header->wildcard == true ) {
+        Sagan_Rule_List_Add(&rule_wildcard, rule);
+    } else {
+        Sagan_Rule_List_Add(&rule_any, rule);
+    }
+}
+
+/*****************************************************************************
+ * Sagan_Rule_Index_Free - Drops the index when the rules are reloaded
+ *****************************************************************************/
+
+void Sagan_Rule_Index_Free( void )
+{
+
+    int i;
+
+    for ( i = 0; i < rule_keys_count; i++ ) {
+        free(rule_keys[i].list.rules);
+    }
+
+    free(rule_keys);
+    free(rule_headers);
+    free(rule_wildcard.rules);
+    free(rule_any.rules);
+
+    rule_keys = NULL;
+    rule_keys_count = 0;
+    rule_keys_size = 0;
+
+    rule_headers = NULL;
+    rule_headers_size = 0;
+
+    memset(&rule_wildcard, 0, sizeof(_Sagan_Rule_List));
+    memset(&rule_any, 0, sizeof(_Sagan_Rule_List));
+
+    rule_buckets_init = false;
+}
+
+/*****************************************************************************
+ * Sagan_Rule_Index_Candidates - Returns the rules whose program,  facility,
+ * priority,  level and tag all match the message,  in rule order.  The
+ * array belongs to the calling thread and is reused on the next call.
+ *****************************************************************************/
+
+int *Sagan_Rule_Index_Candidates( struct _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, int *count )
+{
+
+    static __thread int *candidates = NULL;
+    static __thread int candidates_size = 0;
+
+    struct _Sagan_Rule_List *lists[RULE_INDEX_FIELDS + 2];
+    struct _Sagan_Rule_Key *key;
+
+    int pos[RULE_INDEX_FIELDS + 2];
+    int list_count = 0;
+    int total = 0;
+    int found = 0;
+    int field;
+    int best;
+    int rule;
+    int i;
+
+    char *values[RULE_INDEX_FIELDS];
+
+    values[RULE_INDEX_PROGRAM] = SaganProcSyslog_LOCAL->syslog_program;
+    values[RULE_INDEX_FACILITY] = SaganProcSyslog_LOCAL->syslog_facility;
+    values[RULE_INDEX_PRIORITY] = SaganProcSyslog_LOCAL->syslog_priority;
+    values[RULE_INDEX_LEVEL] = SaganProcSyslog_LOCAL->syslog_level;
+    values[RULE_INDEX_TAG] = SaganProcSyslog_LOCAL->syslog_tag;
+
+    for ( field = 0; field < RULE_INDEX_FIELDS; field++ ) {
+
+        key = Sagan_Rule_Index_Find(field, values[field]);
+
+        if ( key != NULL ) {
+            lists[list_count++] = &key->list;
+        }
+    }
+
+    lists[list_count++] = &rule_wildcard;
+    lists[list_count++] = &rule_any;		/* Must be last,  see below */
+
+    for ( i = 0; i < list_count; i++ ) {
+        pos[i] = 0;
+        total += lists[i]->count;
+    }
+
+    if ( total > candidates_size ) {
+
+        candidates_size = total;
+        candidates = (int *) realloc(candidates, candidates_size * sizeof(int));
+
+        if ( candidates == NULL ) {
+            Sagan_Log(S_ERROR, "[%s, line %d] Failed to reallocate memory for candidates. Abort!", __FILE__, __LINE__);
+        }
+    }
+
+    /* Each list is in rule order,  merge them so that rules still fire in
+     * the order they were loaded */
+
+    while ( 1 ) {
+
+        best = -1;
+
+        for ( i = 0; i < list_count; i++ ) {
+
+            if ( pos[i] < lists[i]->count && ( best == -1 || lists[i]->rules[pos[i]] < lists[best]->rules[pos[best]] ) ) {
+                best = i;
+            }
+        }
+
+        if ( best == -1 ) {
+            break;
+        }
+
+        rule = lists[best]->rules[pos[best]++];
+
+        /* Rules with no header options don't need checking */
+
+        if ( best == list_count - 1 || Sagan_Rule_Header_Check(rule, values) == true ) {
+            candidates[found++] = rule;
+        }
+    }
+
+    *count = found;
+
+    return(candidates);
+}
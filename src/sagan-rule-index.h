@@ -0,0 +1,74 @@
+/*
+** Copyright (C) 2009-2017 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2017 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* sagan-rule-index.h
+ *
+ * Index of rules by their program,  facility,  priority,  level and tag
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdint.h>
+
+#define RULE_INDEX_PROGRAM	0
+#define RULE_INDEX_FACILITY	1
+#define RULE_INDEX_PRIORITY	2
+#define RULE_INDEX_LEVEL	3
+#define RULE_INDEX_TAG		4
+#define RULE_INDEX_FIELDS	5
+
+/* Enough for s_program + s_facility + s_syspri + s_level + s_tag plus
+ * the list terminators */
+
+#define RULE_HEADER_SIZE	384
+
+/* A rule's header options split once at load.  Each field is a run of
+ * '\0' terminated alternatives ending in an empty string */
+
+typedef struct _Sagan_Rule_Header _Sagan_Rule_Header;
+struct _Sagan_Rule_Header {
+    char buf[RULE_HEADER_SIZE];
+    uint16_t field[RULE_INDEX_FIELDS];
+    unsigned char set;			/* Bit per field that has a value */
+    sbool wildcard;			/* program: has a '*' or '?' */
+};
+
+typedef struct _Sagan_Rule_List _Sagan_Rule_List;
+struct _Sagan_Rule_List {
+    int *rules;				/* Ascending rule positions */
+    int count;
+    int size;
+};
+
+typedef struct _Sagan_Rule_Key _Sagan_Rule_Key;
+struct _Sagan_Rule_Key {
+    char value[256];
+    int field;
+    uint32_t hash;
+    int next;				/* Hash chain,  -1 terminated */
+    struct _Sagan_Rule_List list;
+};
+
+void Sagan_Rule_Index_Add( int );
+void Sagan_Rule_Index_Free( void );
+int *Sagan_Rule_Index_Candidates( struct _Sagan_Proc_Syslog *, int * );
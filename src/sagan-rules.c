@@ -40,6 +40,7 @@
 #include <string.h>
 #include <getopt.h>
 #include <time.h>
+#include <stdbool.h>
 #include <pcre.h>
 
 #include "version.h"
@@ -51,6 +52,10 @@
 #include "sagan-lockfile.h"
 #include "sagan-classifications.h"
 #include "sagan-rules.h"
+#include "sagan-rule-index.h"
+#include "sagan-meta-content.h"
+#include "sagan-check-flow.h"
+#include "sagan-tracker.h"
 #include "sagan-config.h"
 #include "parsers/parsers.h"
 
@@ -158,6 +163,7 @@ void Load_Rules( char *ruleset )
     int flow_2_count=0;
 
     sbool pcreflag=0;
+    sbool xbit_interned=true;
     int pcreoptions=0;
 
     int i=0;
@@ -203,6 +209,8 @@ void Load_Rules( char *ruleset )
                 Sagan_Log(S_ERROR, "[%s, line %d] Failed to reallocate memory for rulestruct. Abort!", __FILE__, __LINE__);
             }
 
+            memset(&rulestruct[counters->rulecount], 0, sizeof(_Rule_Struct));
+
         }
 
         Remove_Return(rulebuf);
@@ -389,6 +397,22 @@ void Load_Rules( char *ruleset )
                     }
                     rulestruct[counters->rulecount].flow_1_var = 1;   /* 1 = var */
                     rulestruct[counters->rulecount].flow_1_counter = flow_1_count;
+
+                    /* Compile the list,  or share the one already compiled from the
+                     * same text.  flow_1_type[] is 1 based. */
+
+                    rulestruct[counters->rulecount].flow_1_list = Sagan_Flow_List_Get(flow_a);
+
+                    if ( rulestruct[counters->rulecount].flow_1_list == NULL ) {
+
+                        rulestruct[counters->rulecount].flow_1_list = Sagan_Flow_List_New(flow_a);
+
+                        for ( i = 0; i < flow_1_count; i++ ) {
+                            Sagan_Flow_List_Add(rulestruct[counters->rulecount].flow_1_list, rulestruct[counters->rulecount].flow_1[i].lo, rulestruct[counters->rulecount].flow_1[i].hi, rulestruct[counters->rulecount].flow_1_type[i+1]);
+                        }
+
+                        Sagan_Flow_List_Finish(rulestruct[counters->rulecount].flow_1_list);
+                    }
                 }
             }
 
@@ -479,6 +503,22 @@ void Load_Rules( char *ruleset )
                     }
                     rulestruct[counters->rulecount].flow_2_var = 1;   /* 1 = var */
                     rulestruct[counters->rulecount].flow_2_counter = flow_2_count;
+
+                    /* Compile the list,  or share the one already compiled from the
+                     * same text.  flow_2_type[] is 1 based. */
+
+                    rulestruct[counters->rulecount].flow_2_list = Sagan_Flow_List_Get(flow_b);
+
+                    if ( rulestruct[counters->rulecount].flow_2_list == NULL ) {
+
+                        rulestruct[counters->rulecount].flow_2_list = Sagan_Flow_List_New(flow_b);
+
+                        for ( i = 0; i < flow_2_count; i++ ) {
+                            Sagan_Flow_List_Add(rulestruct[counters->rulecount].flow_2_list, rulestruct[counters->rulecount].flow_2[i].lo, rulestruct[counters->rulecount].flow_2[i].hi, rulestruct[counters->rulecount].flow_2_type[i+1]);
+                        }
+
+                        Sagan_Flow_List_Finish(rulestruct[counters->rulecount].flow_2_list);
+                    }
                 }
             }
 
@@ -641,6 +681,9 @@ void Load_Rules( char *ruleset )
                     rulestruct[counters->rulecount].xbit_type[xbit_count]  = 1;		/* set */
 
                     strlcpy(rulestruct[counters->rulecount].xbit_name[xbit_count], tmptoken, sizeof(rulestruct[counters->rulecount].xbit_name[xbit_count]));
+                    if ( Sagan_Xbit_Parse(counters->rulecount, xbit_count, linecount, ruleset) == false ) {
+                        xbit_interned = false;
+                    }
 
                     rulestruct[counters->rulecount].xbit_timeout[xbit_count] = atoi(strtok_r(NULL, ",", &saveptrrule2));
 
@@ -676,6 +719,9 @@ void Load_Rules( char *ruleset )
                     }
 
                     strlcpy(rulestruct[counters->rulecount].xbit_name[xbit_count], tmptoken, sizeof(rulestruct[counters->rulecount].xbit_name[xbit_count]));
+                    if ( Sagan_Xbit_Parse(counters->rulecount, xbit_count, linecount, ruleset) == false ) {
+                        xbit_interned = false;
+                    }
 
                     xbit_count++;
 
@@ -703,18 +749,13 @@ void Load_Rules( char *ruleset )
                     }
 
                     strlcpy(rulestruct[counters->rulecount].xbit_name[xbit_count], tmptoken, sizeof(rulestruct[counters->rulecount].xbit_name[xbit_count]));
+                    if ( Sagan_Xbit_Parse(counters->rulecount, xbit_count, linecount, ruleset) == false ) {
+                        xbit_interned = false;
+                    }
 
-                    /* If we have multiple xbit conditions (bit1&bit2),
-                     * we alter the xbit_conditon_count to reflect that.
-                     * |'s are easy.  We just test to see if one of the
-                     * xbits matched or not!
-                     */
+                    /* bit1&bit2 and bit1|bit2 are one condition,  see Sagan_Xbit_Parse() */
 
-                    if (Sagan_strstr(rulestruct[counters->rulecount].xbit_name[xbit_count], "&")) {
-                        rulestruct[counters->rulecount].xbit_condition_count = Sagan_Character_Count(rulestruct[counters->rulecount].xbit_name[xbit_count], "&") + 1;
-                    } else {
-                        rulestruct[counters->rulecount].xbit_condition_count++;
-                    }
+                    rulestruct[counters->rulecount].xbit_condition_count++;
 
                     xbit_count++;
                 }
@@ -741,18 +782,13 @@ void Load_Rules( char *ruleset )
                     }
 
                     strlcpy(rulestruct[counters->rulecount].xbit_name[xbit_count], tmptoken, sizeof(rulestruct[counters->rulecount].xbit_name[xbit_count]));
+                    if ( Sagan_Xbit_Parse(counters->rulecount, xbit_count, linecount, ruleset) == false ) {
+                        xbit_interned = false;
+                    }
 
-                    /* If we have multiple xbit conditions (bit1&bit2),
-                     * we alter the xbit_conditon_count to reflect that.
-                     * |'s are easy.  We just test to see if one of the
-                     * xbits matched or not!
-                     */
+                    /* bit1&bit2 and bit1|bit2 are one condition,  see Sagan_Xbit_Parse() */
 
-                    if (Sagan_strstr(rulestruct[counters->rulecount].xbit_name[xbit_count], "&")) {
-                        rulestruct[counters->rulecount].xbit_condition_count = Sagan_Character_Count(rulestruct[counters->rulecount].xbit_name[xbit_count], "&") + 1;
-                    } else {
-                        rulestruct[counters->rulecount].xbit_condition_count++;
-                    }
+                    rulestruct[counters->rulecount].xbit_condition_count++;
 
                     xbit_count++;
 
@@ -875,9 +911,21 @@ void Load_Rules( char *ruleset )
                 ptmp = strtok_r(tmp2, ",", &tok);
                 meta_content_converted_count = 0;
 
+                rulestruct[counters->rulecount].meta_content_containers[meta_content_count].meta_content_converted = NULL;
+
                 while (ptmp != NULL) {
 
-                    strlcpy(rulestruct[counters->rulecount].meta_content_containers[meta_content_count].meta_content_converted[meta_content_converted_count], Sagan_Replace_Sagan(rulestruct[counters->rulecount].meta_content_help[meta_content_count], ptmp), sizeof(rulestruct[counters->rulecount].meta_content_containers[meta_content_count].meta_content_converted[meta_content_converted_count]));
+                    rulestruct[counters->rulecount].meta_content_containers[meta_content_count].meta_content_converted = (char **) realloc(rulestruct[counters->rulecount].meta_content_containers[meta_content_count].meta_content_converted, (meta_content_converted_count+1) * sizeof(char *));
+
+                    if ( rulestruct[counters->rulecount].meta_content_containers[meta_content_count].meta_content_converted == NULL ) {
+                        Sagan_Log(S_ERROR, "[%s, line %d] Failed to reallocate memory for meta_content. Abort!", __FILE__, __LINE__);
+                    }
+
+                    rulestruct[counters->rulecount].meta_content_containers[meta_content_count].meta_content_converted[meta_content_converted_count] = strdup(Sagan_Replace_Sagan(rulestruct[counters->rulecount].meta_content_help[meta_content_count], ptmp));
+
+                    if ( rulestruct[counters->rulecount].meta_content_containers[meta_content_count].meta_content_converted[meta_content_converted_count] == NULL ) {
+                        Sagan_Log(S_ERROR, "[%s, line %d] Failed to allocate memory for meta_content. Abort!", __FILE__, __LINE__);
+                    }
 
                     meta_content_converted_count++;
 
@@ -908,6 +956,13 @@ void Load_Rules( char *ruleset )
                 rulestruct[counters->rulecount].meta_content_case[meta_content_count-1] = 1;
                 strlcpy(tolower_tmp, To_LowerC(rulestruct[counters->rulecount].meta_content[meta_content_count-1]), sizeof(tolower_tmp));
                 strlcpy(rulestruct[counters->rulecount].meta_content[meta_content_count-1], tolower_tmp, sizeof(rulestruct[counters->rulecount].meta_content[meta_content_count-1]));
+
+                /* The expanded values are searched,  so lowercase them now rather than
+                 * on every search */
+
+                for (i = 0; i < rulestruct[counters->rulecount].meta_content_containers[meta_content_count-1].meta_counter; i++) {
+                    To_LowerC(rulestruct[counters->rulecount].meta_content_containers[meta_content_count-1].meta_content_converted[i]);
+                }
             }
 
 
@@ -977,6 +1032,7 @@ void Load_Rules( char *ruleset )
                 }
 
                 strlcpy(rulestruct[counters->rulecount].s_sid, Remove_Spaces(arg), sizeof(rulestruct[counters->rulecount].s_sid));
+                rulestruct[counters->rulecount].sid = strtoul(rulestruct[counters->rulecount].s_sid, NULL, 10);
             }
 
             if (!strcmp(rulesplit, "tag" )) {
@@ -1477,25 +1533,11 @@ void Load_Rules( char *ruleset )
                     }
 
                     if (Sagan_strstr(tmptoken, "track")) {
+                        tmptok_tmp = strtok_r(tmptoken, " ", &saveptrrule3);
+                        tmptok_tmp = strtok_r(NULL, " ", &saveptrrule3);
 
-                        if (Sagan_strstr(tmptoken, "by_src")) {
-                            rulestruct[counters->rulecount].threshold_method = 1;
-                        }
-
-                        if (Sagan_strstr(tmptoken, "by_dst")) {
-                            rulestruct[counters->rulecount].threshold_method = 2;
-                        }
-
-                        if (Sagan_strstr(tmptoken, "by_username")) {
-                            rulestruct[counters->rulecount].threshold_method = 3;
-                        }
-
-                        if (Sagan_strstr(tmptoken, "by_srcport")) {
-                            rulestruct[counters->rulecount].threshold_method = 4;
-                        }
-
-                        if (Sagan_strstr(tmptoken, "by_dstport")) {
-                            rulestruct[counters->rulecount].threshold_method = 5;
+                        if ( tmptok_tmp == NULL || ( rulestruct[counters->rulecount].threshold_method = Sagan_Tracker_Method(tmptok_tmp) ) == 0 ) {
+                            Sagan_Log(S_ERROR, "[%s, line %d] Unknown 'threshold' track method at line %d in %s. Abort!", __FILE__, __LINE__, linecount, ruleset);
                         }
                     }
 
@@ -1525,29 +1567,12 @@ void Load_Rules( char *ruleset )
                 while( tmptoken != NULL ) {
 
                     if (Sagan_strstr(tmptoken, "track")) {
+                        tmptok_tmp = strtok_r(tmptoken, " ", &saveptrrule3);
+                        tmptok_tmp = strtok_r(NULL, " ", &saveptrrule3);
 
-                        /* DEBUG/FIXME: This needs to line up with sagan-defs! */
-
-                        if (Sagan_strstr(tmptoken, "by_src")) {
-                            rulestruct[counters->rulecount].after_method = 1;
-                        }
-
-                        if (Sagan_strstr(tmptoken, "by_dst")) {
-                            rulestruct[counters->rulecount].after_method = 2;
-                        }
-
-                        if (Sagan_strstr(tmptoken, "by_username")) {
-                            rulestruct[counters->rulecount].after_method = 3;
-                        }
-
-                        if (Sagan_strstr(tmptoken, "by_srcport")) {
-                            rulestruct[counters->rulecount].after_method = 4;
-                        }
-
-                        if (Sagan_strstr(tmptoken, "by_dstport")) {
-                            rulestruct[counters->rulecount].after_method = 5;
+                        if ( tmptok_tmp == NULL || ( rulestruct[counters->rulecount].after_method = Sagan_Tracker_Method(tmptok_tmp) ) == 0 ) {
+                            Sagan_Log(S_ERROR, "[%s, line %d] Unknown 'after' track method at line %d in %s. Abort!", __FILE__, __LINE__, linecount, ruleset);
                         }
-
                     }
 
                     if (Sagan_strstr(tmptoken, "count")) {
@@ -1962,6 +1987,47 @@ void Load_Rules( char *ruleset )
         memset(netstr, 0, sizeof(netstr));
         memset(rulestr, 0, sizeof(rulestr));
 
+        /* An xbit name didn't fit in the shared name table.  On a reload or
+         * a dynamic load,  leave the rule out rather than stop Sagan */
+
+        if ( xbit_interned == false ) {
+
+            Sagan_Log(S_WARN, "[%s, line %d] Xbit name table is full (%d names).  Not loading the rule at line %d in %s.", __FILE__, __LINE__, XBIT_NAMES_MAX, linecount, ruleset);
+
+            for (i=0; i<rulestruct[counters->rulecount].meta_content_count; i++) {
+
+                for (d=0; d<rulestruct[counters->rulecount].meta_content_containers[i].meta_counter; d++) {
+                    free(rulestruct[counters->rulecount].meta_content_containers[i].meta_content_converted[d]);
+                }
+
+                free(rulestruct[counters->rulecount].meta_content_containers[i].meta_content_converted);
+            }
+
+            xbit_interned = true;
+            continue;
+        }
+
+        /* Pre-compute the search metadata (length and filter bytes) of every
+         * content literal so the engine never strlen()'s them,  and compile
+         * each meta_content list into its matcher */
+
+        for (i=0; i<rulestruct[counters->rulecount].content_count; i++) {
+            Sagan_Needle_Compile(&rulestruct[counters->rulecount].s_content_needle[i], rulestruct[counters->rulecount].s_content[i], strlen(rulestruct[counters->rulecount].s_content[i]));
+        }
+
+        for (i=0; i<rulestruct[counters->rulecount].meta_content_count; i++) {
+
+            rulestruct[counters->rulecount].meta_content_containers[i].matcher = Sagan_Meta_Content_Compile(rulestruct[counters->rulecount].meta_content_containers[i].meta_content_converted, rulestruct[counters->rulecount].meta_content_containers[i].meta_counter);
+
+            for (d=0; d<rulestruct[counters->rulecount].meta_content_containers[i].meta_counter; d++) {
+                free(rulestruct[counters->rulecount].meta_content_containers[i].meta_content_converted[d]);
+            }
+
+            free(rulestruct[counters->rulecount].meta_content_containers[i].meta_content_converted);
+            rulestruct[counters->rulecount].meta_content_containers[i].meta_content_converted = NULL;
+        }
+
+        Sagan_Rule_Index_Add(counters->rulecount);
         counters->rulecount++;
 
     } /* end of while loop */
@@ -22,6 +22,8 @@
 #include "config.h"             /* From autoconf */
 #endif
 
+#include "parsers/sagan-strstr/sagan-strstr-simd.h"
+
 #ifdef WITH_BLUEDOT
 #define BLUEDOT_MAX_CAT        10
 #endif
@@ -45,8 +47,9 @@ struct arr_flow_2 {
 
 typedef struct meta_content_conversion meta_content_conversion;
 struct meta_content_conversion {
-    char meta_content_converted[MAX_META_CONTENT][256];
+    char **meta_content_converted;		/* Only kept until the rule is loaded */
     int  meta_counter;
+    struct _Sagan_Meta_Matcher *matcher;
 };
 
 typedef struct _Rule_Struct _Rule_Struct;
@@ -58,9 +61,11 @@ struct _Rule_Struct {
     pcre_extra *pcre_extra[MAX_PCRE];
 
     char s_content[MAX_CONTENT][256];
+    struct _Sagan_Needle s_content_needle[MAX_CONTENT];
     char s_reference[MAX_REFERENCE][256];
     char s_classtype[32];
     char s_sid[32];
+    uint32_t sid;			/* Numeric s_sid,  for IPC table keys */
     char s_rev[5];
     int  s_pri;
     char s_program[256];
@@ -93,6 +98,9 @@ struct _Rule_Struct {
     int  flow_1_counter;
     int  flow_2_counter;
 
+    struct _Sagan_Flow_List *flow_1_list;	/* Compiled flow_1/flow_2,  see sagan-check-flow.c */
+    struct _Sagan_Flow_List *flow_2_list;
+
     sbool s_nocase[MAX_CONTENT];
     int s_offset[MAX_CONTENT];
     int s_depth[MAX_CONTENT];
@@ -122,6 +130,9 @@ struct _Rule_Struct {
     int xbit_direction[MAX_XBITS];              /* 0 == none, 1 == both, 2 == by_src, 3 == by_dst */
     int xbit_timeout[MAX_XBITS];                /* How long a xbit is to stay alive (seconds) */
     char xbit_name[MAX_XBITS][64];              /* Name of the xbit */
+    sbool xbit_or[MAX_XBITS];                   /* isset/isnotset names joined by | rather than & */
+    int xbit_name_count[MAX_XBITS];             /* Number of names in xbit_name */
+    uint32_t xbit_id[MAX_XBITS][MAX_XBIT_NAMES];	/* Interned names (0 until the xbit table is mapped) */
 
     int ref_count;
     int dst_port;
@@ -145,11 +156,11 @@ struct _Rule_Struct {
     int drop;                                   /* inline DROP for ext. */
 
     int threshold_type;                         /* 1 = limit,  2 = thresh */
-    int threshold_method;                       /* 1 ==  src,  2 == dst,  3 == username, 4 == srcport, 5 == dstport */
+    int threshold_method;                       /* TRACK_BY_* (sagan-tracker.h) */
     int threshold_count;
     int threshold_seconds;
 
-    int after_method;                           /* 1 ==  src,  2 == dst, 3 == username, 4 == dstport */
+    int after_method;                           /* TRACK_BY_* (sagan-tracker.h) */
     int after_count;
     int after_seconds;
 
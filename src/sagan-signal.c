@@ -52,6 +52,8 @@
 #include "sagan-classifications.h"
 #include "processors/sagan-perfmon.h"
 #include "sagan-rules.h"
+#include "sagan-rule-index.h"
+#include "sagan-meta-content.h"
 #include "sagan-ignore-list.h"
 #include "sagan-check-flow.h"
 
@@ -98,8 +100,16 @@ struct _Sagan_BroIntel_Intel_User_Name *Sagan_BroIntel_Intel_User_Name;
 struct _Sagan_BroIntel_Intel_File_Name *Sagan_BroIntel_Intel_File_Name;
 struct _Sagan_BroIntel_Intel_Cert_Hash *Sagan_BroIntel_Intel_Cert_Hash;
 
-pthread_mutex_t SaganReloadMutex = PTHREAD_MUTEX_INITIALIZER;
-pthread_cond_t SaganReloadCond = PTHREAD_COND_INITIALIZER;
+/* Processors hold this for reading while they work on a batch,  a reload
+ * holds it for writing.  glibc hands a read lock to a new reader even with
+ * a writer waiting,  so ask for writers first where we can or a busy
+ * sensor would never get to reload */
+
+#ifdef PTHREAD_RWLOCK_WRITER_NONRECURSIVE_INITIALIZER_NP
+pthread_rwlock_t SaganReloadLock = PTHREAD_RWLOCK_WRITER_NONRECURSIVE_INITIALIZER_NP;
+#else
+pthread_rwlock_t SaganReloadLock = PTHREAD_RWLOCK_INITIALIZER;
+#endif
 
 void Sig_Handler( void )
 {
@@ -168,58 +178,20 @@ void Sig_Handler( void )
 
             /* IPC Shared Memory */
 
-            Sagan_File_Unlock(config->shm_counters);
-
             if ( close(config->shm_counters) != 0 ) {
                 Sagan_Log(S_WARN, "[%s, line %d] Cannot close IPC counters! [%s]", __FILE__, __LINE__, strerror(errno));
             }
 
-            Sagan_File_Unlock(config->shm_xbit);
-
             if ( close(config->shm_xbit) != 0 ) {
                 Sagan_Log(S_WARN, "[%s, line %d] Cannot close IPC xbit! [%s]", __FILE__, __LINE__, strerror(errno));
             }
 
-            Sagan_File_Unlock(config->shm_thresh_by_src);
-
-            if ( close(config->shm_thresh_by_src) != 0 ) {
-                Sagan_Log(S_WARN, "[%s, line %d] Cannot close IPC thresh_by_src! [%s]", __FILE__, __LINE__, strerror(errno));
-            }
-
-            Sagan_File_Unlock(config->shm_thresh_by_dst);
-
-            if ( close(config->shm_thresh_by_dst) != 0 ) {
-                Sagan_Log(S_WARN, "[%s, line %d] Cannot close IPC thresh_by_dst! [%s]", __FILE__, __LINE__, strerror(errno));
-            }
-
-            Sagan_File_Unlock(config->shm_thresh_by_username);
-
-            if ( close(config->shm_thresh_by_username) != 0 ) {
-                Sagan_Log(S_WARN, "[%s, line %d] Cannot close IPC thresh_by_username! [%s]", __FILE__, __LINE__, strerror(errno));
-            }
-
-            Sagan_File_Unlock(config->shm_after_by_src);
-
-            if ( close(config->shm_after_by_src) != 0 ) {
-                Sagan_Log(S_WARN, "[%s, line %d] Cannot close IPC after_by_src! [%s]", __FILE__, __LINE__, strerror(errno));
-            }
-
-            Sagan_File_Unlock(config->shm_after_by_dst);
-
-            if ( close(config->shm_after_by_dst) != 0 ) {
-                Sagan_Log(S_WARN, "[%s, line %d] Cannot close IPC after_by_dst! [%s]", __FILE__, __LINE__, strerror(errno));
-            }
-
-            Sagan_File_Unlock(config->shm_after_by_username);
-
-            if ( close(config->shm_after_by_username) != 0 ) {
-                Sagan_Log(S_WARN, "[%s, line %d] Cannot close IPC after_by_username! [%s]", __FILE__, __LINE__, strerror(errno));
+            if ( close(config->shm_tracker) != 0 ) {
+                Sagan_Log(S_WARN, "[%s, line %d] Cannot close IPC tracker! [%s]", __FILE__, __LINE__, strerror(errno));
             }
 
             if ( config->sagan_track_clients_flag ) {
 
-                Sagan_File_Unlock(config->shm_track_clients);
-
                 if ( close(config->shm_track_clients) != 0 ) {
                     Sagan_Log(S_WARN, "[%s, line %d] Cannot close IPC _Sagan_Track_Clients! [%s]", __FILE__, __LINE__, strerror(errno));
                 }
@@ -231,6 +203,8 @@ void Sig_Handler( void )
                 Sagan_Perfmonitor_Close();
             }
 
+            Sagan_Xbit_Release();
+
             Remove_Lock_File();
             exit(0);
             break;
@@ -239,7 +213,10 @@ void Sig_Handler( void )
 
             config->sagan_reload = 1;				/* Only this thread can alter this */
 
-            pthread_mutex_lock(&SaganReloadMutex);
+            /* Waits for every batch in progress to finish.  Nothing reads
+             * the rules again until we are done */
+
+            pthread_rwlock_wrlock(&SaganReloadLock);
 
             Sagan_Log(S_NORMAL, "[Reloading Sagan version %s.]-------", VERSION);
 
@@ -250,6 +227,10 @@ void Sig_Handler( void )
 
             Sagan_Open_Log_File(REOPEN, ALL_LOGS);
 
+            /* Needs the old rule count,  so before the reset */
+
+            Sagan_Meta_Content_Free();
+
             /******************/
             /* Reset counters */
             /******************/
@@ -268,6 +249,14 @@ void Sig_Handler( void )
             memset(generator, 0, sizeof(_Sagan_Processor_Generator));
             memset(var, 0, sizeof(_SaganVar));
 
+            Sagan_Rule_Index_Free();
+            Sagan_Flow_List_Free();
+            Sagan_Xbit_Release();
+
+#ifdef HAVE_LIBLOGNORM
+            Sagan_Liblognorm_Clear();
+#endif
+
             /**********************************/
             /* Disabled and reset processors. */
             /**********************************/
@@ -421,8 +410,7 @@ void Sig_Handler( void )
             Sagan_Open_GeoIP2_Database();
 #endif
 
-            pthread_cond_signal(&SaganReloadCond);
-            pthread_mutex_unlock(&SaganReloadMutex);
+            pthread_rwlock_unlock(&SaganReloadLock);
 
             config->sagan_reload = 0;
 
@@ -0,0 +1,301 @@
+/*
+** Copyright (C) 2009-2017 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2017 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* sagan-split.c
+ *
+ * Splits a "|" delimited line from the rsyslog "sagan" template into
+ * offset/length views of its nine fields.  All the delimiters in the
+ * header are found in a single vectorized sweep (SSE2,  or AVX2 when the
+ * CPU supports it) which also catches lines that end before the header
+ * does.  The message is everything after the eighth "|",  so it may
+ * contain "|" itself.
+ *
+ * Unlike strtok_r(),  fields are positional.  An empty field stays empty
+ * rather than shifting the fields that follow it.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "sagan-split.h"
+
+#if defined(HAVE_SSE2) && defined(__x86_64__)
+#define SPLIT_SSE2
+#include <emmintrin.h>
+#if defined(__GNUC__) && __GNUC__ >= 5
+#define SPLIT_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+/*****************************************************************************
+ * Split_Finish - Called once the header is complete or the line has ended
+ * at "pos".  Works out the last field and returns the field count.
+ *****************************************************************************/
+
+static int Split_Finish( const char *line, size_t len, size_t pos, _Sagan_Split *split )
+{
+
+    const char *nl;
+
+    if ( split->count == SPLIT_DELIMITERS ) {
+
+        /* Header is complete.  The message runs up to any '\n' */
+
+        nl = memchr(line + split->offset[SPLIT_MESSAGE], '\n', len - split->offset[SPLIT_MESSAGE]);
+
+        split->len[SPLIT_MESSAGE] = ( nl == NULL ? len : (size_t)(nl - line) ) - split->offset[SPLIT_MESSAGE];
+
+        if ( split->len[SPLIT_MESSAGE] != 0 ) {
+            split->count = SPLIT_FIELDS;
+        }
+
+        return(split->count);
+    }
+
+    /* The line ended early.  Whatever trails the last "|" is the last field */
+
+    split->len[split->count] = pos - split->offset[split->count];
+
+    if ( split->len[split->count] != 0 ) {
+        split->count++;
+    }
+
+    return(split->count);
+}
+
+/*****************************************************************************
+ * Split_Delimiter - Records the "|" or '\n' at "pos".  Returns true when
+ * the sweep can stop.
+ *****************************************************************************/
+
+static inline int Split_Delimiter( const char *line, size_t pos, _Sagan_Split *split )
+{
+
+    if ( line[pos] == '\n' ) {
+        return(true);
+    }
+
+    split->len[split->count] = pos - split->offset[split->count];
+    split->count++;
+    split->offset[split->count] = pos + 1;
+
+    return(split->count == SPLIT_DELIMITERS);
+}
+
+/*****************************************************************************
+ * Sagan_Split_Fields_Scalar - Byte at a time version.  Used on non-x86
+ * CPUs and for the tail of a line shorter than a vector.
+ *****************************************************************************/
+
+int Sagan_Split_Fields_Scalar( const char *line, size_t len, _Sagan_Split *split )
+{
+
+    size_t i;
+
+    split->count = 0;
+    split->offset[0] = 0;
+
+    for ( i = 0; i < len; i++ ) {
+        if ( ( line[i] == '|' || line[i] == '\n' ) && Split_Delimiter(line, i, split) ) {
+            return(Split_Finish(line, len, i, split));
+        }
+    }
+
+    return(Split_Finish(line, len, len, split));
+}
+
+#ifdef SPLIT_SSE2
+
+static int Split_Fields_SSE2( const char *line, size_t len, _Sagan_Split *split )
+{
+
+    const __m128i pipe = _mm_set1_epi8('|');
+    const __m128i nl = _mm_set1_epi8('\n');
+
+    __m128i v;
+    uint32_t mask;
+    size_t pos;
+    size_t i;
+
+    split->count = 0;
+    split->offset[0] = 0;
+
+    for ( i = 0; i + 16 <= len; i += 16 ) {
+
+        v = _mm_loadu_si128((const __m128i *)(line + i));
+        mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, pipe), _mm_cmpeq_epi8(v, nl)));
+
+        while ( mask != 0 ) {
+
+            pos = i + __builtin_ctz(mask);
+            mask &= mask - 1;
+
+            if ( Split_Delimiter(line, pos, split) ) {
+                return(Split_Finish(line, len, pos, split));
+            }
+        }
+    }
+
+    for ( ; i < len; i++ ) {
+        if ( ( line[i] == '|' || line[i] == '\n' ) && Split_Delimiter(line, i, split) ) {
+            return(Split_Finish(line, len, i, split));
+        }
+    }
+
+    return(Split_Finish(line, len, len, split));
+}
+
+#endif
+
+#ifdef SPLIT_AVX2
+
+__attribute__((target("avx2")))
+static int Split_Fields_AVX2( const char *line, size_t len, _Sagan_Split *split )
+{
+
+    const __m256i pipe = _mm256_set1_epi8('|');
+    const __m256i nl = _mm256_set1_epi8('\n');
+
+    __m256i v;
+    uint32_t mask;
+    size_t pos;
+    size_t i;
+
+    split->count = 0;
+    split->offset[0] = 0;
+
+    for ( i = 0; i + 32 <= len; i += 32 ) {
+
+        v = _mm256_loadu_si256((const __m256i *)(line + i));
+        mask = (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, pipe), _mm256_cmpeq_epi8(v, nl)));
+
+        while ( mask != 0 ) {
+
+            pos = i + __builtin_ctz(mask);
+            mask &= mask - 1;
+
+            if ( Split_Delimiter(line, pos, split) ) {
+                return(Split_Finish(line, len, pos, split));
+            }
+        }
+    }
+
+    for ( ; i < len; i++ ) {
+        if ( ( line[i] == '|' || line[i] == '\n' ) && Split_Delimiter(line, i, split) ) {
+            return(Split_Finish(line, len, i, split));
+        }
+    }
+
+    return(Split_Finish(line, len, len, split));
+}
+
+#endif
+
+static const _Sagan_Split_Kernel Split_Kernels[] = {
+    { "scalar", Sagan_Split_Fields_Scalar },
+#ifdef SPLIT_SSE2
+    { "SSE2", Split_Fields_SSE2 },
+#endif
+#ifdef SPLIT_AVX2
+    { "AVX2", Split_Fields_AVX2 },
+#endif
+};
+
+#if defined(SPLIT_SSE2)
+static _Sagan_Split_Func Split_Fields_Func = Split_Fields_SSE2;
+#else
+static _Sagan_Split_Func Split_Fields_Func = Sagan_Split_Fields_Scalar;
+#endif
+
+/*****************************************************************************
+ * Sagan_Split_Init - Picks the fastest splitter this CPU supports.  Called
+ * once at start up,  before any processor threads exist.  Returns the
+ * name of the version in use.
+ *****************************************************************************/
+
+const char *Sagan_Split_Init( void )
+{
+
+#ifdef SPLIT_AVX2
+
+    __builtin_cpu_init();
+
+    if ( __builtin_cpu_supports("avx2") ) {
+        Split_Fields_Func = Split_Fields_AVX2;
+        return("AVX2");
+    }
+
+#endif
+
+#ifdef SPLIT_SSE2
+    return("SSE2");
+#else
+    return("scalar");
+#endif
+
+}
+
+/*****************************************************************************
+ * Sagan_Split_Fields - Splits "len" bytes of "line" into "split".  Returns
+ * the number of fields found.  Anything less than SPLIT_FIELDS is a
+ * malformed line.
+ *****************************************************************************/
+
+int Sagan_Split_Fields( const char *line, size_t len, _Sagan_Split *split )
+{
+    return(Split_Fields_Func(line, len, split));
+}
+
+/*****************************************************************************
+ * Sagan_Split_Kernels - The splitters this CPU can run.  For benchmarking.
+ *****************************************************************************/
+
+const _Sagan_Split_Kernel *Sagan_Split_Kernels( int *count )
+{
+
+    int i;
+
+    *count = 0;
+
+#ifdef SPLIT_AVX2
+    __builtin_cpu_init();
+#endif
+
+    for ( i = 0; i < (int)( sizeof(Split_Kernels) / sizeof(Split_Kernels[0]) ); i++ ) {
+
+#ifdef SPLIT_AVX2
+        if ( !strcmp(Split_Kernels[i].name, "AVX2") && !__builtin_cpu_supports("avx2") ) {
+            break;
+        }
+#endif
+
+        (*count)++;
+    }
+
+    return(Split_Kernels);
+}
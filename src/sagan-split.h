@@ -0,0 +1,72 @@
+/*
+** Copyright (C) 2009-2017 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2017 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* sagan-split.h
+ *
+ * Splits a line written to the FIFO by the rsyslog "sagan" template into
+ * its "|" delimited fields.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SPLIT_FIELDS		9		/* host|facility|priority|level|tag|date|time|program|message */
+#define SPLIT_DELIMITERS	(SPLIT_FIELDS - 1)
+
+enum _Sagan_Split_Field {
+    SPLIT_HOST = 0,
+    SPLIT_FACILITY,
+    SPLIT_PRIORITY,
+    SPLIT_LEVEL,
+    SPLIT_TAG,
+    SPLIT_DATE,
+    SPLIT_TIME,
+    SPLIT_PROGRAM,
+    SPLIT_MESSAGE
+};
+
+/* Offset/length view of each field within the original line.  Only the
+ * first "count" fields are valid.  A well formed line has SPLIT_FIELDS
+ * fields with a non-empty message. */
+
+typedef struct _Sagan_Split _Sagan_Split;
+struct _Sagan_Split {
+    uint32_t offset[SPLIT_FIELDS];
+    uint32_t len[SPLIT_FIELDS];
+    int count;
+};
+
+typedef int (*_Sagan_Split_Func)( const char *, size_t, _Sagan_Split * );
+
+typedef struct _Sagan_Split_Kernel _Sagan_Split_Kernel;
+struct _Sagan_Split_Kernel {
+    const char *name;
+    _Sagan_Split_Func split;
+};
+
+const char *Sagan_Split_Init( void );
+int Sagan_Split_Fields( const char *, size_t, _Sagan_Split * );
+int Sagan_Split_Fields_Scalar( const char *, size_t, _Sagan_Split * );
+const _Sagan_Split_Kernel *Sagan_Split_Kernels( int * );
@@ -39,6 +39,8 @@
 #include "sagan-defs.h"
 #include "sagan-stats.h"
 #include "sagan-config.h"
+#include "sagan-counters.h"
+#include "sagan-clock.h"
 
 struct _SaganCounters *counters;
 struct _Sagan_IPC_Counters *counters_ipc;
@@ -48,10 +50,6 @@ struct _SaganConfig *config;
 void Sagan_Statistics( void )
 {
 
-    char timet[20];
-
-    time_t t;
-    struct tm *now;
     int seconds = 0;
     unsigned long total=0;
 
@@ -70,13 +68,14 @@ void Sagan_Statistics( void )
 #endif
 
 
+    /* Pull in what the threads have counted since the last time */
+
+    Sagan_Counters_Sum();
+
     /* This is used to calulate the events per/second */
     /* Champ Clark III - 11/17/2011 */
 
-    t = time(NULL);
-    now=localtime(&t);
-    strftime(timet, sizeof(timet), "%s",  now);
-    seconds = atol(timet) - atol(config->sagan_startutime);
+    seconds = Sagan_Clock_Now() - config->sagan_startutime;
 
     /* if statement prevents floating point exception */
 
@@ -107,7 +106,7 @@ void Sagan_Statistics( void )
 
 //        Sagan_Log(S_NORMAL, "           Malformed                : h:%" PRIuMAX "|f:%" PRIuMAX "|p:%" PRIuMAX "|l:%" PRIuMAX "|T:%" PRIuMAX "|d:%" PRIuMAX "|T:%" PRIuMAX "|P:%" PRIuMAX "|M:%" PRIuMAX "", counters->malformed_host, counters->malformed_facility, counters->malformed_priority, counters->malformed_level, counters->malformed_tag, counters->malformed_date, counters->malformed_time, counters->malformed_program, counters->malformed_message);
 
-        Sagan_Log(S_NORMAL, "           Thread Exhaustion        : %" PRIuMAX " (%.3f%%)", counters->worker_thread_exhaustion,  CalcPct( counters->worker_thread_exhaustion, counters->sagantotal) );
+        Sagan_Log(S_NORMAL, "           Work Queue Full          : %" PRIuMAX " (%.3f%%)", counters->worker_thread_exhaustion,  CalcPct( counters->worker_thread_exhaustion, counters->sagantotal) );
 
 
         if (config->sagan_droplist_flag) {
@@ -189,6 +188,14 @@ void Sagan_Statistics( void )
         Sagan_Log(S_NORMAL, "           Total                    : %" PRIuMAX "", counters->follow_flow_total);
         Sagan_Log(S_NORMAL, "           Dropped                  : %" PRIuMAX " (%.3f%%)", counters->follow_flow_drop, CalcPct(counters->follow_flow_drop, counters->follow_flow_total));
 
+        Sagan_Log(S_NORMAL, "");
+        Sagan_Log(S_NORMAL, "          -[ Sagan Threshold/After Tracker Statistics ]-");
+        Sagan_Log(S_NORMAL, "");
+        Sagan_Log(S_NORMAL, "           Lookups                  : %" PRIuMAX "", counters->tracker_total);
+        Sagan_Log(S_NORMAL, "           New entries              : %" PRIuMAX " (%.3f%%)", counters->tracker_new, CalcPct(counters->tracker_new, counters->tracker_total));
+        Sagan_Log(S_NORMAL, "           Expired                  : %" PRIuMAX "", counters->tracker_expired);
+        Sagan_Log(S_NORMAL, "           Table full               : %" PRIuMAX " (%.3f%%)", counters->tracker_full, CalcPct(counters->tracker_full, counters->tracker_total));
+
 #ifdef WITH_BLUEDOT
 
         if (config->bluedot_flag) {
@@ -0,0 +1,376 @@
+/*
+** Copyright (C) 2009-2017 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2017 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* sagan-tcp.c
+ *
+ * Native TCP syslog input.  A single thread accepts sender connections and
+ * services them from an epoll() loop.  Both newline delimited and RFC6587
+ * octet-counted ("LEN SP MSG") framing are accepted,  per message.  Messages
+ * are parsed and placed directly on the processor work queue.  If the queue
+ * is full we stop reading,  which pushes back on senders via TCP flow
+ * control rather than dropping.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#ifdef HAVE_SYS_EPOLL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <ctype.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "sagan.h"
+#include "sagan-defs.h"
+#include "sagan-config.h"
+#include "sagan-queue.h"
+#include "sagan-message.h"
+#include "sagan-counters.h"
+#include "sagan-tcp.h"
+#include "parsers/parsers.h"
+
+struct _SaganConfig *config;
+struct _SaganCounters *counters;
+struct _Sagan_Queue *SaganProcQueue;
+
+
+static int tcp_listen_socket = -1;
+static int tcp_client_count = 0;
+
+static char tcp_date[20] = { 0 };
+static char tcp_time[20] = { 0 };
+
+/****************************************************************************
+ * Sagan_TCP_Init - Create and bind the listening socket.  Called before we
+ * drop privileges.
+ ****************************************************************************/
+
+void Sagan_TCP_Init( void )
+{
+
+    struct sockaddr_in sa;
+    int on = 1;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(config->tcp_port);
+
+    if ( inet_pton(AF_INET, config->tcp_address, &sa.sin_addr) != 1 ) {
+        Sagan_Log(S_ERROR, "[%s, line %d] Invalid TCP listen address '%s'. Abort!", __FILE__, __LINE__, config->tcp_address);
+    }
+
+    if (( tcp_listen_socket = socket(AF_INET, SOCK_STREAM, 0)) == -1 ) {
+        Sagan_Log(S_ERROR, "[%s, line %d] Cannot create TCP socket: %s. Abort!", __FILE__, __LINE__, strerror(errno));
+    }
+
+    setsockopt(tcp_listen_socket, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    if ( bind(tcp_listen_socket, (struct sockaddr *)&sa, sizeof(sa)) == -1 ) {
+        Sagan_Log(S_ERROR, "[%s, line %d] Cannot bind TCP socket to %s:%d: %s. Abort!", __FILE__, __LINE__, config->tcp_address, config->tcp_port, strerror(errno));
+    }
+
+    if ( listen(tcp_listen_socket, SOMAXCONN) == -1 ) {
+        Sagan_Log(S_ERROR, "[%s, line %d] Cannot listen on TCP socket: %s. Abort!", __FILE__, __LINE__, strerror(errno));
+    }
+
+    fcntl(tcp_listen_socket, F_SETFL, fcntl(tcp_listen_socket, F_GETFL, 0) | O_NONBLOCK);
+
+    Sagan_Log(S_NORMAL, "TCP input listening on %s:%d [max %d connections].", config->tcp_address, config->tcp_port, config->tcp_max_clients);
+}
+
+/****************************************************************************
+ * Sagan_TCP_Queue - Parse one framed message and hand it to the processors
+ ****************************************************************************/
+
+static void Sagan_TCP_Queue( _Sagan_TCP_Client *client, char *msg, size_t len )
+{
+
+    struct _Sagan_Proc_Syslog *SaganProcSyslog_MSG = NULL;
+
+    if ( len == 0 ) {
+        return;
+    }
+
+    Sagan_Thread_Counters()->sagantotal++;
+
+    if ( len > MAX_SYSLOGMSG - 1 ) {
+        len = MAX_SYSLOGMSG - 1;
+    }
+
+    /* The frame has to leave the client buffer,  so this is the one copy
+     * a TCP message gets */
+
+    SaganProcSyslog_MSG = Sagan_Message_Get();
+    memcpy(SaganProcSyslog_MSG->buf, msg, len);
+
+    Sagan_Parse_Syslog(SaganProcSyslog_MSG, len, client->host, tcp_date, tcp_time);
+    Sagan_Queue_Push(SaganProcQueue, &SaganProcSyslog_MSG);
+}
+
+/****************************************************************************
+ * Sagan_TCP_Frame - Pull complete messages out of the client buffer.  A
+ * frame starting with a digit is octet-counted,  anything else is newline
+ * delimited.  Returns false if the stream is unrecoverable.
+ ****************************************************************************/
+
+static sbool Sagan_TCP_Frame( _Sagan_TCP_Client *client )
+{
+
+    size_t pos = 0;
+    size_t i = 0;
+    size_t msg_len = 0;
+    char *nl = NULL;
+
+    while ( pos < client->len ) {
+
+        if ( isdigit((unsigned char)client->buf[pos]) ) {
+
+            /* RFC6587 3.4.1 - MSG-LEN SP SYSLOG-MSG */
+
+            msg_len = 0;
+
+            for ( i = pos; i < client->len && i - pos < 6 && isdigit((unsigned char)client->buf[i]); i++ ) {
+                msg_len = ( msg_len * 10 ) + ( client->buf[i] - '0' );
+            }
+
+            if ( i == client->len ) {
+                break;				/* Need more of the header */
+            }
+
+            if ( client->buf[i] != ' ' || msg_len > TCP_BUFFER_SIZE - 8 ) {
+                Sagan_Log(S_WARN, "[%s, line %d] Invalid octet-counted frame from %s.  Closing connection.", __FILE__, __LINE__, client->host);
+                return(false);
+            }
+
+            i++;
+
+            if ( client->len - i < msg_len ) {
+                break;				/* Need more of the message */
+            }
+
+            Sagan_TCP_Queue(client, client->buf + i, msg_len);
+            pos = i + msg_len;
+
+        } else {
+
+            /* Newline delimited (RFC6587 3.4.2) */
+
+            nl = memchr(client->buf + pos, '\n', client->len - pos);
+
+            if ( nl == NULL ) {
+
+                /* A line that fills the whole buffer gets passed on as-is */
+
+                if ( pos == 0 && client->len == TCP_BUFFER_SIZE ) {
+                    Sagan_TCP_Queue(client, client->buf, client->len);
+                    pos = client->len;
+                }
+
+                break;
+            }
+
+            Sagan_TCP_Queue(client, client->buf + pos, nl - ( client->buf + pos ));
+            pos = ( nl - client->buf ) + 1;
+        }
+    }
+
+    /* Carry over any partial frame */
+
+    if ( pos > 0 ) {
+
+        if ( pos < client->len ) {
+            memmove(client->buf, client->buf + pos, client->len - pos);
+        }
+
+        client->len -= pos;
+    }
+
+    return(true);
+}
+
+static void Sagan_TCP_Close( int epfd, _Sagan_TCP_Client *client )
+{
+    epoll_ctl(epfd, EPOLL_CTL_DEL, client->fd, NULL);
+    close(client->fd);
+    free(client);
+    tcp_client_count--;
+}
+
+static void Sagan_TCP_Accept( int epfd )
+{
+
+    struct sockaddr_in from;
+    socklen_t fromlen;
+    struct epoll_event ev;
+    _Sagan_TCP_Client *client = NULL;
+    int fd;
+
+    for (;;) {
+
+        fromlen = sizeof(from);
+
+        if (( fd = accept(tcp_listen_socket, (struct sockaddr *)&from, &fromlen)) == -1 ) {
+
+            if ( errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR ) {
+                Sagan_Log(S_WARN, "[%s, line %d] TCP accept() failed: %s", __FILE__, __LINE__, strerror(errno));
+            }
+
+            return;
+        }
+
+        if ( tcp_client_count >= config->tcp_max_clients ) {
+            Sagan_Log(S_WARN, "[%s, line %d] Maximum TCP connections (%d) reached.  Rejecting connection.", __FILE__, __LINE__, config->tcp_max_clients);
+            close(fd);
+            continue;
+        }
+
+        client = malloc(sizeof(_Sagan_TCP_Client));
+
+        if ( client == NULL ) {
+            Sagan_Log(S_ERROR, "[%s, line %d] Failed to allocate memory for TCP client. Abort!", __FILE__, __LINE__);
+        }
+
+        client->fd = fd;
+        client->len = 0;
+        inet_ntop(AF_INET, &from.sin_addr, client->host, sizeof(client->host));
+
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+        ev.events = EPOLLIN;
+        ev.data.ptr = client;
+
+        if ( epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) == -1 ) {
+            Sagan_Log(S_WARN, "[%s, line %d] epoll_ctl() failed for %s: %s", __FILE__, __LINE__, client->host, strerror(errno));
+            close(fd);
+            free(client);
+            continue;
+        }
+
+        tcp_client_count++;
+    }
+}
+
+/****************************************************************************
+ * Sagan_TCP_Handler - TCP input thread
+ ****************************************************************************/
+
+void Sagan_TCP_Handler( void )
+{
+
+    struct epoll_event ev;
+    struct epoll_event events[TCP_EPOLL_EVENTS];
+    _Sagan_TCP_Client *client = NULL;
+
+    int epfd;
+    int count;
+    int i;
+    ssize_t bytes;
+
+    time_t t;
+    time_t last_t = 0;
+    struct tm now;
+
+    if (( epfd = epoll_create1(0)) == -1 ) {
+        Sagan_Log(S_ERROR, "[%s, line %d] epoll_create1() failed: %s. Abort!", __FILE__, __LINE__, strerror(errno));
+    }
+
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;			/* NULL marks the listening socket */
+
+    if ( epoll_ctl(epfd, EPOLL_CTL_ADD, tcp_listen_socket, &ev) == -1 ) {
+        Sagan_Log(S_ERROR, "[%s, line %d] epoll_ctl() failed: %s. Abort!", __FILE__, __LINE__, strerror(errno));
+    }
+
+    for (;;) {
+
+        count = epoll_wait(epfd, events, TCP_EPOLL_EVENTS, -1);
+
+        if ( count < 0 ) {
+
+            if ( errno != EINTR ) {
+                Sagan_Log(S_WARN, "[%s, line %d] epoll_wait() failed: %s", __FILE__, __LINE__, strerror(errno));
+            }
+
+            continue;
+        }
+
+        /* Receive date/time only changes once per second */
+
+        t = time(NULL);
+
+        if ( t != last_t ) {
+            localtime_r(&t, &now);
+            strftime(tcp_date, sizeof(tcp_date), "%Y-%m-%d", &now);
+            strftime(tcp_time, sizeof(tcp_time), "%H:%M:%S", &now);
+            last_t = t;
+        }
+
+        for ( i = 0; i < count; i++ ) {
+
+            client = events[i].data.ptr;
+
+            if ( client == NULL ) {
+                Sagan_TCP_Accept(epfd);
+                continue;
+            }
+
+            bytes = read(client->fd, client->buf + client->len, TCP_BUFFER_SIZE - client->len);
+
+            if ( bytes < 0 && ( errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ) ) {
+                continue;
+            }
+
+            if ( bytes <= 0 ) {
+
+                /* Sender went away.  Flush any unterminated last line */
+
+                if ( client->len > 0 && !isdigit((unsigned char)client->buf[0]) ) {
+                    Sagan_TCP_Queue(client, client->buf, client->len);
+                }
+
+                Sagan_TCP_Close(epfd, client);
+                continue;
+            }
+
+            client->len += bytes;
+
+            if ( Sagan_TCP_Frame(client) == false ) {
+                Sagan_TCP_Close(epfd, client);
+            }
+        }
+    }
+}
+
+#endif
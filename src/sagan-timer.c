@@ -0,0 +1,270 @@
+/*
+** Copyright (C) 2009-2017 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2017 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* sagan-timer.c
+ *
+ * Expired threshold/after,  xbit and client tracking entries used to be
+ * found by scanning (and compacting) whole tables,  either on every xbit
+ * lookup or when a table filled up.  Instead,  owners add a timer when
+ * they create an entry and the housekeeping thread calls them back once
+ * a second with whatever is due.
+ *
+ * The wheel has TIMER_LEVELS levels of TIMER_SLOTS one second slots.
+ * Level 0 covers the next TIMER_SLOTS seconds,  level 1 the next
+ * TIMER_SLOTS^2 and so on.  When a level wraps,  the next level's slot is
+ * pushed down ("cascaded").  Adding is O(1) and each timer is cascaded at
+ * most TIMER_LEVELS-1 times.
+ *
+ * Timers are never cancelled.  An entry updated after its timer was added
+ * is found still alive by the callback,  which returns its new expire
+ * time.  The wheel is local to this process;  timers for entries created
+ * by other Sagan processes live in those processes.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "sagan.h"
+#include "sagan-timer.h"
+#include "sagan-clock.h"
+
+#define TIMER_BITS		6
+#define TIMER_SLOTS		( 1 << TIMER_BITS )
+#define TIMER_MASK		( TIMER_SLOTS - 1 )
+#define TIMER_LEVELS		4		/* 64^4 seconds,  about 194 days */
+#define TIMER_SLOT_SIZE		16		/* Initial timers per slot */
+
+typedef struct _Sagan_Timer _Sagan_Timer;
+struct _Sagan_Timer {
+    uint64_t when;
+    uint64_t key;
+    uint32_t id;
+    uint32_t type;
+};
+
+typedef struct _Sagan_Timer_Slot _Sagan_Timer_Slot;
+struct _Sagan_Timer_Slot {
+    _Sagan_Timer *timers;
+    uint32_t count;
+    uint32_t size;
+};
+
+static _Sagan_Timer_Slot timer_wheel[TIMER_LEVELS][TIMER_SLOTS];
+static Sagan_Timer_Callback timer_callbacks[TIMER_TYPES];
+static uint64_t timer_now = 0;		/* Last second processed */
+
+pthread_mutex_t Sagan_Timer_Mutex=PTHREAD_MUTEX_INITIALIZER;
+
+/****************************************************************************
+ * Sagan_Timer_Append - Add a timer to a slot
+ ****************************************************************************/
+
+static void Sagan_Timer_Append( _Sagan_Timer_Slot *slot, const _Sagan_Timer *timer )
+{
+
+    if ( slot->count == slot->size ) {
+
+        slot->size = slot->size == 0 ? TIMER_SLOT_SIZE : slot->size * 2;
+        slot->timers = realloc(slot->timers, slot->size * sizeof(_Sagan_Timer));
+
+        if ( slot->timers == NULL ) {
+            Sagan_Log(S_ERROR, "[%s, line %d] Failed to reallocate memory for timers. Abort!", __FILE__, __LINE__);
+        }
+    }
+
+    slot->timers[slot->count++] = *timer;
+
+}
+
+/****************************************************************************
+ * Sagan_Timer_Place - Put a timer in the lowest level that covers it.
+ * Timers already due go in the current slot.  Sagan_Timer_Mutex must be
+ * held.
+ ****************************************************************************/
+
+static void Sagan_Timer_Place( const _Sagan_Timer *timer )
+{
+
+    uint64_t when = timer->when < timer_now ? timer_now : timer->when;
+    uint32_t index;
+    int level;
+
+    /* Past the top level.  Park it at the end of the current rotation
+     * (or the next second,  if that's now),  the callback will just put it
+     * back */
+
+    if ( ( when >> ( TIMER_BITS * TIMER_LEVELS ) ) != ( timer_now >> ( TIMER_BITS * TIMER_LEVELS ) ) ) {
+
+        when = timer_now | ( ( 1ULL << ( TIMER_BITS * TIMER_LEVELS ) ) - 1 );
+
+        if ( when == timer_now ) {
+            Sagan_Timer_Append(&timer_wheel[0][( timer_now + 1 ) & TIMER_MASK], timer);
+            return;
+        }
+    }
+
+    /* Lowest level where "when" is in the same rotation as "now" */
+
+    for ( level = 0; level < TIMER_LEVELS - 1; level++ ) {
+        if ( ( when >> ( TIMER_BITS * ( level + 1 ) ) ) == ( timer_now >> ( TIMER_BITS * ( level + 1 ) ) ) ) {
+            break;
+        }
+    }
+
+    index = ( when >> ( TIMER_BITS * level ) ) & TIMER_MASK;
+
+    Sagan_Timer_Append(&timer_wheel[level][index], timer);
+
+}
+
+/****************************************************************************
+ * Sagan_Timer_Init - Start the wheel at the current time
+ ****************************************************************************/
+
+void Sagan_Timer_Init( void )
+{
+    timer_now = Sagan_Clock_Now();
+}
+
+/****************************************************************************
+ * Sagan_Timer_Register - Set the callback for a timer type
+ ****************************************************************************/
+
+void Sagan_Timer_Register( int type, Sagan_Timer_Callback callback )
+{
+    timer_callbacks[type] = callback;
+}
+
+/****************************************************************************
+ * Sagan_Timer_Add - Call "type"'s callback with id/key at (or just after)
+ * "when"
+ ****************************************************************************/
+
+void Sagan_Timer_Add( int type, uint32_t id, uint64_t key, uint64_t when )
+{
+
+    _Sagan_Timer timer;
+
+    timer.type = type;
+    timer.id = id;
+    timer.key = key;
+
+    pthread_mutex_lock(&Sagan_Timer_Mutex);
+
+    /* The current second may already have been run */
+
+    timer.when = when <= timer_now ? timer_now + 1 : when;
+
+    Sagan_Timer_Place(&timer);
+
+    pthread_mutex_unlock(&Sagan_Timer_Mutex);
+
+}
+
+/****************************************************************************
+ * Sagan_Timer_Advance - Run every timer due up to "utime"
+ ****************************************************************************/
+
+void Sagan_Timer_Advance( uint64_t utime )
+{
+
+    _Sagan_Timer_Slot due;
+    _Sagan_Timer_Slot *slot;
+
+    uint64_t when;
+    uint32_t i;
+    int level;
+
+    while ( timer_now < utime ) {
+
+        pthread_mutex_lock(&Sagan_Timer_Mutex);
+
+        timer_now++;
+
+        /* Push down any higher level slot that starts now */
+
+        for ( level = TIMER_LEVELS - 1; level > 0; level-- ) {
+
+            if ( ( timer_now & ( ( 1ULL << ( TIMER_BITS * level ) ) - 1 ) ) != 0 ) {
+                continue;
+            }
+
+            slot = &timer_wheel[level][( timer_now >> ( TIMER_BITS * level ) ) & TIMER_MASK];
+            due = *slot;
+            memset(slot, 0, sizeof(_Sagan_Timer_Slot));
+
+            for ( i = 0; i < due.count; i++ ) {
+                Sagan_Timer_Place(&due.timers[i]);
+            }
+
+            free(due.timers);
+        }
+
+        slot = &timer_wheel[0][timer_now & TIMER_MASK];
+        due = *slot;
+        memset(slot, 0, sizeof(_Sagan_Timer_Slot));
+
+        pthread_mutex_unlock(&Sagan_Timer_Mutex);
+
+        /* Callbacks take the table locks,  so run them without ours */
+
+        for ( i = 0; i < due.count; i++ ) {
+
+            if ( timer_callbacks[due.timers[i].type] == NULL ) {
+                continue;
+            }
+
+            when = timer_callbacks[due.timers[i].type](due.timers[i].id, due.timers[i].key, timer_now);
+
+            if ( when != 0 ) {
+                Sagan_Timer_Add(due.timers[i].type, due.timers[i].id, due.timers[i].key, when);
+            }
+        }
+
+        free(due.timers);
+    }
+
+}
+
+/****************************************************************************
+ * Sagan_Timer_Handler - Housekeeping thread.  Runs due timers once a
+ * second.
+ ****************************************************************************/
+
+void Sagan_Timer_Handler( void )
+{
+
+    for(;;) {
+
+        Sagan_Timer_Advance(Sagan_Clock_Now());
+        sleep(1);
+
+    }
+
+}
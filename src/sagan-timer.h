@@ -0,0 +1,52 @@
+/*
+** Copyright (C) 2009-2017 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2017 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* sagan-timer.h
+ *
+ * Hierarchical timer wheel that expires IPC entries (threshold/after,
+ * xbits and client tracking) from the housekeeping thread.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdint.h>
+
+/* Timer types.  Each owner registers one callback */
+
+#define TIMER_TRACKER		1
+#define TIMER_XBIT		2
+#define TIMER_TRACK_CLIENTS	3
+#define TIMER_TYPES		4
+
+/* Called from the housekeeping thread when a timer is due.  "id" and
+ * "key" are what was passed to Sagan_Timer_Add().  Return 0 when the
+ * entry is gone,  or the time to be called again (say,  the entry was
+ * updated since the timer was added) */
+
+typedef uint64_t (*Sagan_Timer_Callback)( uint32_t id, uint64_t key, uint64_t utime );
+
+void Sagan_Timer_Init( void );
+void Sagan_Timer_Register( int, Sagan_Timer_Callback );
+void Sagan_Timer_Add( int, uint32_t, uint64_t, uint64_t );
+void Sagan_Timer_Advance( uint64_t );
+void Sagan_Timer_Handler( void );
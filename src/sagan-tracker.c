@@ -0,0 +1,458 @@
+/*
+** Copyright (C) 2009-2017 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2017 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* sagan-tracker.c
+ *
+ * One shared table of event counters for every rule "threshold" and
+ * "after".  Entries are keyed by (sid,  kind,  method,  key bytes),  so any
+ * field Sagan extracts from a message can be tracked without another
+ * table,  file,  lock or counter.
+ *
+ * The table is looked up by a hash of the key,  and entries keep the key's
+ * length and first TRACKER_KEY_SIZE bytes so two keys with the same hash
+ * aren't counted together.  Longer keys (URLs,  say) are told apart by their
+ * length,  first TRACKER_KEY_SIZE bytes and 64 bit hash.
+ *
+ * The table is an _Sagan_IPC_Hash in TRACKER_IPC_FILE,  shared with other
+ * Sagan processes using the same IPC directory.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdio.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "sagan.h"
+#include "sagan-defs.h"
+#include "sagan-config.h"
+#include "sagan-ipc.h"
+#include "sagan-ipc-hash.h"
+#include "sagan-tracker.h"
+#include "sagan-counters.h"
+#include "sagan-clock.h"
+#include "sagan-timer.h"
+
+struct _SaganConfig *config;
+struct _SaganDebug *debug;
+
+static const char *tracker_methods[TRACK_METHODS] = TRACK_METHOD_NAMES;
+
+static _Sagan_IPC_Hash *tracker;
+
+/*****************************************************************************
+ * Sagan_Tracker_Kind - "Threshold" or "After",  for logging
+ *****************************************************************************/
+
+static const char *Sagan_Tracker_Kind( int kind )
+{
+    return( kind == TRACK_AFTER ? "After" : "Threshold" );
+}
+
+/*****************************************************************************
+ * Sagan_Tracker_Match - Is this entry the one for kind/method/key?
+ *****************************************************************************/
+
+static sbool Sagan_Tracker_Match( const _Sagan_IPC_Tracker *entry, int kind, int method, const void *key, size_t key_len )
+{
+
+    return( entry->kind == kind && entry->method == method && entry->key_len == key_len &&
+            !memcmp(entry->key, key, key_len < TRACKER_KEY_SIZE ? key_len : TRACKER_KEY_SIZE) );
+}
+
+/*****************************************************************************
+ * Sagan_Tracker_Value - Printable form of a tracker entry's key
+ *****************************************************************************/
+
+static void Sagan_Tracker_Value( const _Sagan_IPC_Tracker *entry, char *str, size_t size )
+{
+
+    struct in_addr ip_addr;
+    uint32_t u32;
+
+    switch ( entry->method ) {
+
+    case TRACK_BY_SRC:
+    case TRACK_BY_DST:
+
+        memcpy(&u32, entry->key, sizeof(u32));
+        ip_addr.s_addr = htonl(u32);
+
+        if ( inet_ntop(AF_INET, &ip_addr, str, size) == NULL ) {
+            str[0] = '\0';
+        }
+
+        break;
+
+    case TRACK_BY_SRCPORT:
+    case TRACK_BY_DSTPORT:
+
+        memcpy(&u32, entry->key, sizeof(u32));
+        snprintf(str, size, "%" PRIu32, u32);
+        break;
+
+    default:
+
+        snprintf(str, size, "%.*s", entry->key_len < TRACKER_KEY_SIZE ? entry->key_len : TRACKER_KEY_SIZE, entry->key);
+        break;
+    }
+
+}
+
+/*****************************************************************************
+ * Sagan_Tracker_Expire - Timer callback.  Drops the entries for sid/key
+ * (there can be more than one,  see above) that have expired and returns
+ * when the next of the others will.
+ *****************************************************************************/
+
+static uint64_t Sagan_Tracker_Expire( uint32_t sid, uint64_t key, uint64_t utime )
+{
+
+    _Sagan_IPC_Tracker *entry = NULL;
+
+    uint32_t shard = Sagan_IPC_Hash_Shard(tracker, sid, key);
+    uint64_t when = 0;
+    uint64_t expires;
+    int removed = 0;
+
+    Sagan_IPC_Hash_Lock(tracker, shard);
+
+    while ( ( entry = Sagan_IPC_Hash_Find_Next(tracker, sid, key, entry) ) != NULL ) {
+
+        expires = entry->slot.utime + entry->slot.expire;
+
+        /* Deleting moves entries around,  so start over */
+
+        if ( expires <= utime ) {
+            Sagan_IPC_Hash_Delete(tracker, entry);
+            removed++;
+            entry = NULL;
+            continue;
+        }
+
+        if ( when == 0 || expires < when ) {
+            when = expires;
+        }
+    }
+
+    Sagan_IPC_Hash_Unlock(tracker, shard);
+
+    Sagan_Thread_Counters()->tracker_expired += removed;
+
+    return(when);
+}
+
+/*****************************************************************************
+ * Sagan_Tracker_Init - Create (if needed) or map to the tracker table
+ *****************************************************************************/
+
+void Sagan_Tracker_Init( sbool new_counters )
+{
+
+    char tmp_object_check[MAXPATH + sizeof(TRACKER_IPC_FILE) + 1];
+
+    size_t size = Sagan_IPC_Hash_Size(config->max_tracker, sizeof(_Sagan_IPC_Tracker));
+
+    sbool new_object = false;
+    uint32_t i;
+
+    _Sagan_IPC_Tracker *entry;
+    char value[TRACKER_KEY_SIZE + 1];
+
+    snprintf(tmp_object_check, sizeof(tmp_object_check), "%s/%s", config->ipc_directory, TRACKER_IPC_FILE);
+
+    Sagan_IPC_Check_Object(tmp_object_check, new_counters, "tracker");
+
+    if ((config->shm_tracker = open(tmp_object_check, (O_CREAT | O_EXCL | O_RDWR), (S_IREAD | S_IWRITE))) > 0 ) {
+        Sagan_Log(S_NORMAL, "+ Tracker shared object (new).");
+        new_object = true;
+    }
+
+    else if ((config->shm_tracker = open(tmp_object_check, (O_CREAT | O_RDWR), (S_IREAD | S_IWRITE))) < 0 ) {
+        Sagan_Log(S_ERROR, "[%s, line %d] Cannot open() for tracker (%s:%s)", __FILE__, __LINE__, tmp_object_check, strerror(errno));
+    }
+
+    if ( ftruncate(config->shm_tracker, size) != 0 ) {
+        Sagan_Log(S_ERROR, "[%s, line %d] Failed to ftruncate tracker. [%s]", __FILE__, __LINE__, strerror(errno));
+    }
+
+    if (( tracker = mmap(0, size, (PROT_READ | PROT_WRITE), MAP_SHARED, config->shm_tracker, 0)) == MAP_FAILED ) {
+        Sagan_Log(S_ERROR, "[%s, line %d] Error allocating memory for tracker object! [%s]", __FILE__, __LINE__, strerror(errno));
+    }
+
+    if ( Sagan_IPC_Hash_Attach(tracker, config->max_tracker, sizeof(_Sagan_IPC_Tracker)) == false && new_object == false ) {
+        Sagan_Log(S_NORMAL, "* Tracker shared object was an old format or size & has been reset.");
+        new_object = true;
+    }
+
+    if ( new_object == false ) {
+        Sagan_Log(S_NORMAL, "- Tracker shared object reloaded (%u entries loaded / max: %d).", tracker->count, config->max_tracker);
+    }
+
+    /* Expire what we loaded as well as what we add */
+
+    Sagan_Timer_Register(TIMER_TRACKER, Sagan_Tracker_Expire);
+
+    for ( i = 0; i < tracker->capacity && tracker->count != 0; i++ ) {
+
+        entry = (_Sagan_IPC_Tracker *)IPC_HASH_SLOT(tracker, i);
+
+        if ( entry->slot.used ) {
+            Sagan_Timer_Add(TIMER_TRACKER, entry->slot.sid, entry->slot.key, entry->slot.utime + entry->slot.expire);
+        }
+    }
+
+    if ( debug->debugipc && tracker->count >= 1 ) {
+
+        Sagan_Log(S_DEBUG, "");
+        Sagan_Log(S_DEBUG, "*** Threshold/after tracker ***");
+        Sagan_Log(S_DEBUG, "------------------------------------------------------------------------------------------------------------");
+        Sagan_Log(S_DEBUG, "%-10s| %-17s| %-26s| %-11s| %-21s| %-11s| %s", "Kind", "Method", "Key", "Counter", "Date added/modified", "SID", "Expire" );
+        Sagan_Log(S_DEBUG, "------------------------------------------------------------------------------------------------------------");
+
+        for ( i = 0; i < tracker->capacity; i++ ) {
+
+            entry = (_Sagan_IPC_Tracker *)IPC_HASH_SLOT(tracker, i);
+
+            if ( entry->slot.used && entry->method < TRACK_METHODS ) {
+                Sagan_Tracker_Value(entry, value, sizeof(value));
+                Sagan_Log(S_DEBUG, "%-10s| %-17s| %-26s| %-11d| %-21s| %-11u| %d", Sagan_Tracker_Kind(entry->kind), tracker_methods[entry->method], value, entry->count, Sagan_u32_Time_To_Human(entry->slot.utime), entry->slot.sid, entry->slot.expire);
+            }
+        }
+
+        Sagan_Log(S_DEBUG, "");
+    }
+
+}
+
+/*****************************************************************************
+ * Sagan_Tracker_Method - Rule "track" name (by_src,  by_username,  etc) to
+ * TRACK_BY_*.  Returns 0 if the name is unknown.
+ *****************************************************************************/
+
+int Sagan_Tracker_Method( const char *name )
+{
+
+    int i;
+
+    for ( i = 1; i < TRACK_METHODS; i++ ) {
+        if ( !strcmp(name, tracker_methods[i]) ) {
+            return(i);
+        }
+    }
+
+    return(0);
+}
+
+/*****************************************************************************
+ * Sagan_Tracker_Hit - Records one event for a rule's "threshold" or "after"
+ * (kind) and returns the number of events seen for sid/key within "seconds"
+ * of each other,  including this one.
+ *
+ * Returns 0 if the message doesn't have the field being tracked by (say,
+ * no username),  or the table is full and nothing could be expired.  Like
+ * the per-method tables this replaced,  a message without the field never
+ * counts towards an "after" (so never alerts) and is never held back by a
+ * "threshold".
+ *****************************************************************************/
+
+int Sagan_Tracker_Hit( int kind, int method, uint32_t sid, const _Sagan_Tracker_Keys *keys, int seconds )
+{
+
+    _Sagan_IPC_Tracker *entry;
+
+    const void *key = NULL;
+    size_t key_len = 0;
+
+    unsigned char prefix[2];
+    char value[TRACKER_KEY_SIZE + 1];
+    uint64_t hash;
+    uint64_t utime;
+
+    uint32_t shard;
+    int removed = 0;
+    sbool added = false;
+    int count = 0;
+
+    switch ( method ) {
+
+    case TRACK_BY_SRC:
+        key = &keys->ip_src;
+        key_len = sizeof(keys->ip_src);
+        break;
+
+    case TRACK_BY_DST:
+        key = &keys->ip_dst;
+        key_len = sizeof(keys->ip_dst);
+        break;
+
+    case TRACK_BY_SRCPORT:
+        key = &keys->src_port;
+        key_len = sizeof(keys->src_port);
+        break;
+
+    case TRACK_BY_DSTPORT:
+        key = &keys->dst_port;
+        key_len = sizeof(keys->dst_port);
+        break;
+
+    case TRACK_BY_USERNAME:
+        key = keys->username;
+        break;
+
+    case TRACK_BY_FILENAME:
+        key = keys->filename;
+        break;
+
+    case TRACK_BY_HTTP_URI:
+        key = keys->http_uri;
+        break;
+
+    case TRACK_BY_HTTP_HOSTNAME:
+        key = keys->http_hostname;
+        break;
+
+    case TRACK_BY_MD5:
+        key = keys->md5;
+        break;
+
+    case TRACK_BY_SHA1:
+        key = keys->sha1;
+        break;
+
+    case TRACK_BY_SHA256:
+        key = keys->sha256;
+        break;
+
+    default:
+        return(0);
+    }
+
+    /* String fields */
+
+    if ( key_len == 0 ) {
+
+        if ( ((const char *)key)[0] == '\0' ) {
+            return(0);
+        }
+
+        key_len = strlen(key);
+    }
+
+    prefix[0] = kind;
+    prefix[1] = method;
+
+    hash = Sagan_IPC_Hash_Bytes(IPC_HASH_FNV_BASIS, prefix, sizeof(prefix));
+    hash = Sagan_IPC_Hash_Bytes(hash, key, key_len);
+
+    utime = Sagan_Clock_Now();
+    shard = Sagan_IPC_Hash_Shard(tracker, sid, hash);
+
+    Sagan_IPC_Hash_Lock(tracker, shard);
+
+    /* Skip other keys with the same hash */
+
+    entry = NULL;
+
+    while ( ( entry = Sagan_IPC_Hash_Find_Next(tracker, sid, hash, entry) ) != NULL &&
+            Sagan_Tracker_Match(entry, kind, method, key, key_len) == false );
+
+    if ( entry != NULL ) {
+
+        entry->count++;
+
+        if ( utime - entry->slot.utime > (uint64_t)seconds ) {
+            entry->count = 1;
+        }
+
+        entry->slot.utime = utime;
+        count = entry->count;
+
+    } else {
+
+        entry = Sagan_IPC_Hash_Insert(tracker, sid, hash);
+
+        /* Shard is full.  Timers normally keep up,  but drop anything in it
+         * that has expired (say,  left behind by a Sagan process that exited) */
+
+        if ( entry == NULL ) {
+
+            removed = Sagan_IPC_Hash_Expire(tracker, shard, utime);
+            entry = Sagan_IPC_Hash_Insert(tracker, sid, hash);
+        }
+
+        if ( entry != NULL ) {
+
+            entry->count = 1;
+            entry->kind = kind;
+            entry->method = method;
+            entry->slot.utime = utime;
+            entry->slot.expire = seconds;
+            entry->key_len = key_len;
+
+            memcpy(entry->key, key, key_len < TRACKER_KEY_SIZE ? key_len : TRACKER_KEY_SIZE);
+
+            count = 1;
+            added = true;
+        }
+    }
+
+    if ( debug->debuglimits && entry != NULL ) {
+        Sagan_Tracker_Value(entry, value, sizeof(value));
+    }
+
+    Sagan_IPC_Hash_Unlock(tracker, shard);
+
+    if ( removed == 0 && entry == NULL ) {
+        Sagan_Log(S_WARN, "[%s, line %d] Could not clean the tracker.  Nothing to remove!", __FILE__, __LINE__);
+    }
+
+    else if ( removed > 0 && debug->debugipc ) {
+        Sagan_Log(S_DEBUG, "[%s, line %d] Removed %d expired tracker entries.", __FILE__, __LINE__, removed);
+    }
+
+    if ( added == true ) {
+        Sagan_Timer_Add(TIMER_TRACKER, sid, hash, utime + seconds);
+        Sagan_Thread_Counters()->tracker_new++;
+    }
+
+    if ( entry == NULL ) {
+        Sagan_Thread_Counters()->tracker_full++;
+    }
+
+    Sagan_Thread_Counters()->tracker_expired += removed;
+    Sagan_Thread_Counters()->tracker_total++;
+
+    if ( debug->debuglimits && count != 0 ) {
+        Sagan_Log(S_NORMAL, "%s SID %" PRIu32 " %s. [%s] Count: %d", Sagan_Tracker_Kind(kind), sid, tracker_methods[method], value, count);
+    }
+
+    return(count);
+}
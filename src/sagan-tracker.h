@@ -0,0 +1,76 @@
+/*
+** Copyright (C) 2009-2017 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2017 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* sagan-tracker.h
+ *
+ * Keyed event counters behind the rule "threshold" and "after" options.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdint.h>
+
+/* What is being counted */
+
+#define TRACK_THRESHOLD		1
+#define TRACK_AFTER		2
+
+/* "track by_..." methods.  These are stored in _Rule_Struct and in the
+ * tracker file,  so only add to the end */
+
+#define TRACK_BY_SRC		1
+#define TRACK_BY_DST		2
+#define TRACK_BY_USERNAME	3
+#define TRACK_BY_SRCPORT	4
+#define TRACK_BY_DSTPORT	5
+#define TRACK_BY_FILENAME	6
+#define TRACK_BY_HTTP_URI	7
+#define TRACK_BY_HTTP_HOSTNAME	8
+#define TRACK_BY_MD5		9
+#define TRACK_BY_SHA1		10
+#define TRACK_BY_SHA256		11
+#define TRACK_METHODS		12
+
+#define TRACK_METHOD_NAMES { NULL, "by_src", "by_dst", "by_username", "by_srcport", "by_dstport", "by_filename", "by_http_uri", "by_http_hostname", "by_md5", "by_sha1", "by_sha256" }
+
+/* Everything a message can be tracked by.  Strings that were not found
+ * in the message are empty,  not NULL */
+
+typedef struct _Sagan_Tracker_Keys _Sagan_Tracker_Keys;
+struct _Sagan_Tracker_Keys {
+    uint32_t ip_src;
+    uint32_t ip_dst;
+    uint32_t src_port;
+    uint32_t dst_port;
+    const char *username;
+    const char *filename;
+    const char *http_uri;
+    const char *http_hostname;
+    const char *md5;
+    const char *sha1;
+    const char *sha256;
+};
+
+void Sagan_Tracker_Init( sbool );
+int Sagan_Tracker_Method( const char * );
+int Sagan_Tracker_Hit( int, int, uint32_t, const _Sagan_Tracker_Keys *, int );
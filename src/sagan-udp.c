@@ -0,0 +1,305 @@
+/*
+** Copyright (C) 2009-2017 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2017 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* sagan-udp.c
+ *
+ * Native UDP syslog input.  This lets Sagan receive syslog directly rather
+ * than having rsyslog/syslog-ng write to the FIFO.  Each UDP thread gets
+ * its own socket bound with SO_REUSEPORT so the kernel spreads datagrams
+ * across threads.  Datagrams are pulled in batches with recvmmsg() directly
+ * into pool messages,  parsed (RFC3164/RFC5424) and placed on the processor
+ * work queue.
+ *
+ * "udp-address" can be IPv4 or IPv6.  An IPv6 socket also takes IPv4
+ * datagrams,  and their senders are logged in dotted quad form.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "sagan.h"
+#include "sagan-defs.h"
+#include "sagan-config.h"
+#include "sagan-queue.h"
+#include "sagan-message.h"
+#include "sagan-counters.h"
+#include "sagan-udp.h"
+#include "parsers/parsers.h"
+
+struct _SaganConfig *config;
+struct _SaganCounters *counters;
+struct _Sagan_Queue *SaganProcQueue;
+
+
+static int *udp_sockets = NULL;
+static int udp_family = AF_INET;
+
+/****************************************************************************
+ * Sagan_UDP_Host - Printable sender address.  IPv4 mapped IPv6 addresses
+ * are given as plain IPv4.
+ ****************************************************************************/
+
+static void Sagan_UDP_Host( const struct sockaddr_storage *from, char *host, size_t size )
+{
+
+    const struct sockaddr_in6 *sin6 = (const struct sockaddr_in6 *)from;
+
+    if ( from->ss_family == AF_INET ) {
+        inet_ntop(AF_INET, &((const struct sockaddr_in *)from)->sin_addr, host, size);
+    }
+
+    else if ( IN6_IS_ADDR_V4MAPPED(&sin6->sin6_addr) ) {
+        inet_ntop(AF_INET, &sin6->sin6_addr.s6_addr[12], host, size);
+    }
+
+    else {
+        inet_ntop(AF_INET6, &sin6->sin6_addr, host, size);
+    }
+
+}
+
+/****************************************************************************
+ * Sagan_UDP_Init - Create and bind the UDP sockets.  This is called before
+ * we drop privileges so we can bind to port 514.  With SO_REUSEPORT, each
+ * thread gets its own socket.  Without it,  all threads share one.
+ ****************************************************************************/
+
+void Sagan_UDP_Init( void )
+{
+
+    struct sockaddr_storage sa;
+    struct sockaddr_in *sin = (struct sockaddr_in *)&sa;
+    struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *)&sa;
+    socklen_t sa_len = 0;
+
+    int i;
+    int sock;
+    int off = 0;
+
+#ifdef SO_REUSEPORT
+    int on = 1;
+#endif
+
+    udp_sockets = malloc(config->udp_threads * sizeof(int));
+
+    if ( udp_sockets == NULL ) {
+        Sagan_Log(S_ERROR, "[%s, line %d] Failed to allocate memory for udp_sockets. Abort!", __FILE__, __LINE__);
+    }
+
+    memset(&sa, 0, sizeof(sa));
+
+    if ( inet_pton(AF_INET, config->udp_address, &sin->sin_addr) == 1 ) {
+
+        sin->sin_family = AF_INET;
+        sin->sin_port = htons(config->udp_port);
+        sa_len = sizeof(*sin);
+
+    }
+
+    else if ( inet_pton(AF_INET6, config->udp_address, &sin6->sin6_addr) == 1 ) {
+
+        sin6->sin6_family = AF_INET6;
+        sin6->sin6_port = htons(config->udp_port);
+        sa_len = sizeof(*sin6);
+
+    } else {
+
+        Sagan_Log(S_ERROR, "[%s, line %d] Invalid UDP listen address '%s'. Abort!", __FILE__, __LINE__, config->udp_address);
+    }
+
+    udp_family = sa.ss_family;
+
+    for ( i = 0; i < config->udp_threads; i++ ) {
+
+#ifndef SO_REUSEPORT
+
+        if ( i > 0 ) {
+            udp_sockets[i] = udp_sockets[0];
+            continue;
+        }
+
+#endif
+
+        if (( sock = socket(udp_family, SOCK_DGRAM, 0)) == -1 ) {
+            Sagan_Log(S_ERROR, "[%s, line %d] Cannot create UDP socket: %s. Abort!", __FILE__, __LINE__, strerror(errno));
+        }
+
+        /* Take IPv4 as well,  whatever net.ipv6.bindv6only says */
+
+        if ( udp_family == AF_INET6 && setsockopt(sock, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off)) == -1 ) {
+            Sagan_Log(S_WARN, "[%s, line %d] Cannot clear IPV6_V6ONLY: %s", __FILE__, __LINE__, strerror(errno));
+        }
+
+#ifdef SO_REUSEPORT
+
+        if ( setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) == -1 ) {
+            Sagan_Log(S_ERROR, "[%s, line %d] Cannot set SO_REUSEPORT: %s. Abort!", __FILE__, __LINE__, strerror(errno));
+        }
+
+#endif
+
+        if ( config->udp_rcvbuf != 0 ) {
+
+            if ( setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &config->udp_rcvbuf, sizeof(config->udp_rcvbuf)) == -1 ) {
+                Sagan_Log(S_WARN, "[%s, line %d] Cannot set UDP receive buffer to %d bytes: %s", __FILE__, __LINE__, config->udp_rcvbuf, strerror(errno));
+            }
+        }
+
+        if ( bind(sock, (struct sockaddr *)&sa, sa_len) == -1 ) {
+            Sagan_Log(S_ERROR, "[%s, line %d] Cannot bind UDP socket to %s:%d: %s. Abort!", __FILE__, __LINE__, config->udp_address, config->udp_port, strerror(errno));
+        }
+
+        udp_sockets[i] = sock;
+    }
+
+    Sagan_Log(S_NORMAL, "UDP input listening on %s:%d [%d thread(s)].", config->udp_address, config->udp_port, config->udp_threads);
+}
+
+/****************************************************************************
+ * Sagan_UDP_Handler - UDP receive thread.  "arg" is the thread number.
+ ****************************************************************************/
+
+void Sagan_UDP_Handler( void *arg )
+{
+
+    int sock = udp_sockets[(intptr_t)arg];
+    int i;
+    int count;
+
+    char host[INET6_ADDRSTRLEN] = { 0 };
+    char date[20] = { 0 };
+    char timebuf[20] = { 0 };
+
+    time_t t;
+    time_t last_t = 0;
+    struct tm now;
+
+    struct _Sagan_Proc_Syslog *SaganProcSyslog_MSG[UDP_BATCH];
+
+    struct sockaddr_storage from[UDP_BATCH];
+
+#ifdef HAVE_RECVMMSG
+    struct mmsghdr msgs[UDP_BATCH];
+    struct iovec iovecs[UDP_BATCH];
+#else
+    socklen_t fromlen;
+    ssize_t bytes;
+#endif
+
+    /* Datagrams are received straight into pool messages */
+
+#ifdef HAVE_RECVMMSG
+
+    memset(msgs, 0, sizeof(msgs));
+
+    for ( i = 0; i < UDP_BATCH; i++ ) {
+        SaganProcSyslog_MSG[i] = Sagan_Message_Get();
+        iovecs[i].iov_base = SaganProcSyslog_MSG[i]->buf;
+        iovecs[i].iov_len = MAX_SYSLOGMSG - 1;
+        msgs[i].msg_hdr.msg_iov = &iovecs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_name = &from[i];
+    }
+
+#else
+
+    SaganProcSyslog_MSG[0] = Sagan_Message_Get();
+
+#endif
+
+    for (;;) {
+
+#ifdef HAVE_RECVMMSG
+
+        for ( i = 0; i < UDP_BATCH; i++ ) {
+            msgs[i].msg_hdr.msg_namelen = sizeof(from[i]);
+        }
+
+        /* Block for the first datagram,  then take whatever else is waiting */
+
+        count = recvmmsg(sock, msgs, UDP_BATCH, MSG_WAITFORONE, NULL);
+
+#else
+
+        fromlen = sizeof(from[0]);
+        bytes = recvfrom(sock, SaganProcSyslog_MSG[0]->buf, MAX_SYSLOGMSG - 1, 0, (struct sockaddr *)&from[0], &fromlen);
+        count = bytes < 0 ? -1 : 1;
+
+#endif
+
+        if ( count < 0 ) {
+
+            if ( errno != EINTR ) {
+                Sagan_Log(S_WARN, "[%s, line %d] UDP receive error: %s", __FILE__, __LINE__, strerror(errno));
+            }
+
+            continue;
+        }
+
+        /* Receive date/time only changes once per second */
+
+        t = time(NULL);
+
+        if ( t != last_t ) {
+            localtime_r(&t, &now);
+            strftime(date, sizeof(date), "%Y-%m-%d", &now);
+            strftime(timebuf, sizeof(timebuf), "%H:%M:%S", &now);
+            last_t = t;
+        }
+
+        Sagan_Thread_Counters()->sagantotal += count;
+
+        for ( i = 0; i < count; i++ ) {
+
+            Sagan_UDP_Host(&from[i], host, sizeof(host));
+
+#ifdef HAVE_RECVMMSG
+            Sagan_Parse_Syslog(SaganProcSyslog_MSG[i], msgs[i].msg_len, host, date, timebuf);
+#else
+            Sagan_Parse_Syslog(SaganProcSyslog_MSG[i], bytes, host, date, timebuf);
+#endif
+
+            Sagan_Queue_Push(SaganProcQueue, &SaganProcSyslog_MSG[i]);
+
+            /* Replace the message we just handed off */
+
+            SaganProcSyslog_MSG[i] = Sagan_Message_Get();
+
+#ifdef HAVE_RECVMMSG
+            iovecs[i].iov_base = SaganProcSyslog_MSG[i]->buf;
+#endif
+        }
+    }
+}
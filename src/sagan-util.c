@@ -53,6 +53,7 @@
 #include "sagan-defs.h"
 #include "sagan-config.h"
 #include "sagan-lockfile.h"
+#include "sagan-clock.h"
 
 #include "parsers/sagan-strstr/sagan-strstr-hook.h"
 
@@ -222,11 +223,8 @@ void Sagan_Log (int type, const char *format,... )
     va_start(ap, format);
     char *chr="*";
     char curtime[64];
-    time_t t;
-    struct tm *now;
-    t = time(NULL);
-    now=localtime(&t);
-    strftime(curtime, sizeof(curtime), "%m/%d/%Y %H:%M:%S",  now);
+
+    strlcpy(curtime, Sagan_Clock_Get()->log_stamp, sizeof(curtime));
 
     if ( type == 1 ) {
         chr="E";
@@ -850,17 +848,15 @@ void Sagan_Open_Log_File( sbool state, int type )
 
 #if defined(HAVE_GETPIPE_SZ) && defined(HAVE_SETPIPE_SZ)
 
-void Sagan_Set_Pipe_Size ( FILE *fd )
+void Sagan_Set_Pipe_Size ( int fd_int )
 {
 
-    int fd_int;
     int current_fifo_size;
     int fd_results;
 
 
     if ( config->sagan_fifo_size != 0 ) {
 
-        fd_int = fileno(fd);
         current_fifo_size = fcntl(fd_int, F_GETPIPE_SZ);
 
         if ( current_fifo_size == config->sagan_fifo_size ) {
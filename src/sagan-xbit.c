@@ -22,6 +22,14 @@
  * sagan-xbit.c - Functions used for tracking events over multiple log
  * lines.
  *
+ * Xbit names are interned to small integer ids when rules are loaded and
+ * set xbits live in a shared hash keyed by (id,  source,  destination).
+ * Along with each xbit,  per source,  per destination and per name roll
+ * ups are kept,  so any "isset"/"isnotset" is one lookup no matter how
+ * many xbits are set.  Each roll up heads a list of its xbits,  so an
+ * "unset" by_src/by_dst/none,  or a roll up that lost its longest lived
+ * xbit,  only looks at the xbits involved.
+ *
  */
 
 
@@ -30,11 +38,17 @@
 #endif
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <pthread.h>
 #include <stdbool.h>
 #include <sys/mman.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+#include <unistd.h>
 
 #include "sagan.h"
 #include "sagan-defs.h"
@@ -42,6 +56,10 @@
 #include "sagan-xbit.h"
 #include "sagan-rules.h"
 #include "sagan-config.h"
+#include "sagan-clock.h"
+#include "sagan-ipc-lock.h"
+#include "sagan-ipc-hash.h"
+#include "sagan-timer.h"
 #include "parsers/parsers.h"
 
 struct _SaganCounters *counters;
@@ -49,605 +67,915 @@ struct _Rule_Struct *rulestruct;
 struct _SaganDebug *debug;
 struct _SaganConfig *config;
 
-pthread_mutex_t Xbit_Mutex=PTHREAD_MUTEX_INITIALIZER;
-pthread_mutex_t CounterMutex;	/* From sagan-engine.c */
-
 struct _Sagan_IPC_Counters *counters_ipc;
-struct _Sagan_IPC_Xbit *xbit_ipc;
+
+static const char *xbit_directions[] = { "none", "both", "by_src", "by_dst", "reverse" };
+
+static _Sagan_IPC_Xbit_Names *xbit_names;
+static _Sagan_IPC_Hash *xbits;
+
+static sbool xbit_held[XBIT_NAMES_MAX];		/* This process counts in the name's "refs" */
 
 /*****************************************************************************
- * Sagan_Xbit_Condition - Used for testing "isset" & "isnotset".  Full
- * rule condition is tested here and returned.
+ * Sagan_Xbit_Name - Name of an interned xbit,  for logging
  *****************************************************************************/
 
-int Sagan_Xbit_Condition(int rule_position, char *ip_src_char, char *ip_dst_char )
+static const char *Sagan_Xbit_Name( uint32_t id )
+{
+
+    if ( id == 0 || id > xbit_names->count ) {
+        return("(unknown)");
+    }
+
+    return(xbit_names->name[id - 1]);
+}
+
+/*****************************************************************************
+ * Sagan_Xbit_Unused - True if no xbit with name "id" is set.  The names
+ * lock must be held.
+ *****************************************************************************/
+
+static sbool Sagan_Xbit_Unused( uint32_t id )
 {
 
-    time_t t;
-    struct tm *now;
-    char  timet[20];
-    char  tmp[128] = { 0 };
-    char *tmp_xbit_name = NULL;
+    uint32_t sid = XBIT_SID(id, XBIT_ANY);
+    uint32_t shard = Sagan_IPC_Hash_Shard(xbits, sid, 0);
+    sbool unused;
+
+    Sagan_IPC_Hash_Lock(xbits, shard);
+    unused = Sagan_IPC_Hash_Find(xbits, sid, 0) == NULL;
+    Sagan_IPC_Hash_Unlock(xbits, shard);
+
+    return(unused);
+}
+
+/*****************************************************************************
+ * Sagan_Xbit_Intern - Returns the id of an xbit name,  adding it to the
+ * shared name table if needed.  A name no process has a rule for and with
+ * no xbits set is given to the new name.  Returns 0 if the table isn't
+ * mapped yet (rules are loaded before Sagan_IPC_Init()) or is full.
+ *****************************************************************************/
+
+static uint32_t Sagan_Xbit_Intern( const char *name )
+{
+
+    uint32_t i;
+    uint32_t id = 0;
+    uint32_t unused = 0;
+
+    if ( xbit_names == NULL ) {
+        return(0);
+    }
+
+    Sagan_IPC_Lock(&counters_ipc->xbit_lock);
+
+    for ( i = 0; i < xbit_names->count; i++ ) {
+
+        if ( !strcmp(xbit_names->name[i], name) ) {
+            id = i + 1;
+            break;
+        }
+
+        if ( unused == 0 && xbit_names->refs[i] == 0 && Sagan_Xbit_Unused(i + 1) ) {
+            unused = i + 1;
+        }
+    }
+
+    if ( id == 0 && unused != 0 ) {
+
+        strlcpy(xbit_names->name[unused - 1], name, sizeof(xbit_names->name[0]));
+        id = unused;
+
+    } else if ( id == 0 && xbit_names->count < XBIT_NAMES_MAX ) {
+
+        strlcpy(xbit_names->name[xbit_names->count], name, sizeof(xbit_names->name[0]));
+        id = xbit_names->count + 1;
+        __atomic_store_n(&xbit_names->count, id, __ATOMIC_RELEASE);
+    }
+
+    /* One reference per process,  dropped by Sagan_Xbit_Release() */
+
+    if ( id != 0 && xbit_held[id - 1] == false ) {
+        xbit_names->refs[id - 1]++;
+        xbit_held[id - 1] = true;
+    }
+
+    Sagan_IPC_Unlock(&counters_ipc->xbit_lock);
+
+    return(id);
+}
+
+/*****************************************************************************
+ * Sagan_Xbit_Release - Drops this process's references to xbit names.
+ * Called before the rules are reloaded and on shut down,  so names no
+ * rule uses any more can be given to new ones.
+ *****************************************************************************/
+
+void Sagan_Xbit_Release( void )
+{
+
+    uint32_t i;
+
+    if ( xbit_names == NULL ) {
+        return;
+    }
+
+    Sagan_IPC_Lock(&counters_ipc->xbit_lock);
+
+    for ( i = 0; i < XBIT_NAMES_MAX; i++ ) {
+
+        if ( xbit_held[i] == true ) {
+            xbit_names->refs[i]--;
+            xbit_held[i] = false;
+        }
+    }
+
+    Sagan_IPC_Unlock(&counters_ipc->xbit_lock);
+
+}
+
+/*****************************************************************************
+ * Sagan_Xbit_Parse - Splits a rule's xbit name (bit1&bit2,  or bit1|bit2
+ * for "isset"/"isnotset") and interns each name.  Returns false if a name
+ * couldn't be interned because the name table is full.
+ *****************************************************************************/
+
+sbool Sagan_Xbit_Parse( int rule_position, int i, int linecount, const char *ruleset )
+{
+
+    struct _Rule_Struct *rule = &rulestruct[rule_position];
+
+    char tmp[sizeof(rule->xbit_name[0])];
+    char *name = NULL;
     char *tok = NULL;
+    const char *delim = "&";
 
-    int i;
-    int a;
+    int count = 0;
+    sbool interned = true;
 
-    uint32_t ip_src;
-    uint32_t ip_dst;
+    rule->xbit_or[i] = false;
 
-    sbool xbit_match = false;
-    int xbit_total_match = 0;
+    if ( ( rule->xbit_type[i] == 3 || rule->xbit_type[i] == 4 ) && Sagan_strstr(rule->xbit_name[i], "|") ) {
+        rule->xbit_or[i] = true;
+        delim = "|";
+    }
 
-    t = time(NULL);
-    now=localtime(&t);
-    strftime(timet, sizeof(timet), "%s",  now);
+    strlcpy(tmp, rule->xbit_name[i], sizeof(tmp));
 
-    ip_src = IP2Bit(ip_src_char);
-    ip_dst = IP2Bit(ip_dst_char);
+    for ( name = strtok_r(tmp, delim, &tok); name != NULL; name = strtok_r(NULL, delim, &tok) ) {
 
-    int and_or = false;
+        if ( count >= MAX_XBIT_NAMES ) {
+            Sagan_Log(S_ERROR, "[%s, line %d] There is to many xbit names in \"%s\" at line %d in %s", __FILE__, __LINE__, rule->xbit_name[i], linecount, ruleset);
+        }
 
-    Sagan_Xbit_Cleanup();
+        rule->xbit_id[i][count] = Sagan_Xbit_Intern(name);
 
-    for (i = 0; i < rulestruct[rule_position].xbit_count; i++) {
+        if ( rule->xbit_id[i][count] == 0 && xbit_names != NULL ) {
+            interned = false;
+        }
 
-        /*******************
-         *      ISSET      *
-         *******************/
+        count++;
+    }
 
-        if ( rulestruct[rule_position].xbit_type[i] == 3 ) {
+    if ( count == 0 ) {
+        Sagan_Log(S_ERROR, "[%s, line %d] Expected xbit name at line %d in %s", __FILE__, __LINE__, linecount, ruleset);
+    }
 
-            for (a = 0; a < counters_ipc->xbit_count; a++) {
+    rule->xbit_name_count[i] = count;
 
-                strlcpy(tmp, rulestruct[rule_position].xbit_name[i], sizeof(tmp));
+    return(interned);
 
-                if (Sagan_strstr(rulestruct[rule_position].xbit_name[i], "|")) {
-                    tmp_xbit_name = strtok_r(tmp, "|", &tok);
-                    and_or = true;
-                } else {
-                    tmp_xbit_name = strtok_r(tmp, "&", &tok);
-                    and_or = false; 					/* Need this? */
-                }
+}
 
-                while (tmp_xbit_name != NULL ) {
+/*****************************************************************************
+ * Sagan_Xbit_Lookup - The entry that answers "isset" for an xbit in a
+ * direction (0 == none,  1 == both,  2 == by_src,  3 == by_dst,
+ * 4 == reverse)
+ *****************************************************************************/
 
-                    if (!strcmp(tmp_xbit_name, xbit_ipc[a].xbit_name) &&
-                        xbit_ipc[a].xbit_state == true ) {
+static void Sagan_Xbit_Lookup( uint32_t id, int direction, uint32_t ip_src, uint32_t ip_dst, uint32_t *sid, uint64_t *key )
+{
 
-                        /* direction: none */
+    switch ( direction ) {
 
-                        if ( rulestruct[rule_position].xbit_direction[i] == 0 )
+    case 0:
+        *sid = XBIT_SID(id, XBIT_ANY);
+        *key = 0;
+        break;
 
-                        {
+    case 2:
+        *sid = XBIT_SID(id, XBIT_BY_SRC);
+        *key = ip_src;
+        break;
 
-                            if ( debug->debugxbit ) {
-                                Sagan_Log(S_DEBUG, "[%s, line %d] \"isset\" xbit \"%s\" (direction: \"none\"). (any -> any)", __FILE__, __LINE__, xbit_ipc[a].xbit_name);
-                            }
+    case 3:
+        *sid = XBIT_SID(id, XBIT_BY_DST);
+        *key = ip_dst;
+        break;
 
-                            xbit_total_match++;
-                        }
+    case 4:
+        *sid = XBIT_SID(id, XBIT_EXACT);
+        *key = XBIT_PAIR(ip_dst, ip_src);
+        break;
 
-                        /* direction: both */
+    default:
+        *sid = XBIT_SID(id, XBIT_EXACT);
+        *key = XBIT_PAIR(ip_src, ip_dst);
+        break;
+    }
 
-                        if ( rulestruct[rule_position].xbit_direction[i] == 1 &&
-                             xbit_ipc[a].ip_src == ip_src &&
-                             xbit_ipc[a].ip_dst == ip_dst )
+}
 
-                        {
+/*****************************************************************************
+ * Sagan_Xbit_Chain_Key - The roll up at the head of chain "c" for an xbit
+ *****************************************************************************/
 
-                            if ( debug->debugxbit ) {
-                                Sagan_Log(S_DEBUG, "[%s, line %d] \"isset\" xbit \"%s\" (direction: \"both\"). (%s -> %s)", __FILE__, __LINE__, xbit_ipc[a].xbit_name, ip_src_char, ip_dst_char);
-                            }
+static uint64_t Sagan_Xbit_Chain_Key( int c, uint32_t ip_src, uint32_t ip_dst )
+{
 
-                            xbit_total_match++;
-                        }
+    switch ( c ) {
 
-                        /* direction: by_src */
+    case XBIT_CHAIN(XBIT_BY_SRC):
+        return(ip_src);
 
-                        if ( rulestruct[rule_position].xbit_direction[i] == 2 &&
-                             xbit_ipc[a].ip_src == ip_src )
+    case XBIT_CHAIN(XBIT_BY_DST):
+        return(ip_dst);
 
-                        {
+    default:
+        return(0);
+    }
 
-                            if ( debug->debugxbit ) {
-                                Sagan_Log(S_DEBUG, "[%s, line %d] \"isset\" xbit \"%s\" (direction: \"by_src\"). (%s -> any)", __FILE__, __LINE__, xbit_ipc[a].xbit_name, ip_src_char);
-                            }
+}
 
-                            xbit_total_match++;
-                        }
+/*****************************************************************************
+ * Sagan_Xbit_Link_Set - Points the next (or previous) link of xbit "pair"
+ * in chain "c" at "to".  The name's lock must be held.
+ *****************************************************************************/
 
-                        /* direction: by_dst */
+static void Sagan_Xbit_Link_Set( uint32_t id, uint64_t pair, int c, sbool next, sbool has, uint64_t to )
+{
 
-                        if ( rulestruct[rule_position].xbit_direction[i] == 3 &&
-                             xbit_ipc[a].ip_dst == ip_dst )
+    _Sagan_IPC_Xbit *xbit;
 
-                        {
+    uint32_t sid = XBIT_SID(id, XBIT_EXACT);
+    uint32_t shard = Sagan_IPC_Hash_Shard(xbits, sid, pair);
 
-                            if ( debug->debugxbit) {
-                                Sagan_Log(S_DEBUG, "[%s, line %d] \"isset\" xbit \"%s\" (direction: \"by_dst\"). (any -> %s)", __FILE__, __LINE__, xbit_ipc[a].xbit_name, ip_dst_char);
-                            }
+    Sagan_IPC_Hash_Lock(xbits, shard);
 
-                            xbit_total_match++;
-                        }
+    xbit = Sagan_IPC_Hash_Find(xbits, sid, pair);
 
-                        /* direction: reverse */
+    if ( xbit != NULL && next == true ) {
+        xbit->has_next[c] = has;
+        xbit->next[c] = to;
+    } else if ( xbit != NULL ) {
+        xbit->has_prev[c] = has;
+        xbit->prev[c] = to;
+    }
 
-                        if ( rulestruct[rule_position].xbit_direction[i] == 4 &&
-                             xbit_ipc[a].ip_src == ip_dst &&
-                             xbit_ipc[a].ip_dst == ip_src )
+    Sagan_IPC_Hash_Unlock(xbits, shard);
 
-                        {
-                            if ( debug->debugxbit) {
-                                Sagan_Log(S_DEBUG, "[%s, line %d] \"isset\" xbit \"%s\" (direction: \"reverse\"). (%s -> %s)", __FILE__, __LINE__, xbit_ipc[a].xbit_name, ip_dst_char, ip_src_char);
-                            }
+}
 
-                            xbit_total_match++;
-                        }
+/*****************************************************************************
+ * Sagan_Xbit_Link - Puts a new xbit at the front of its roll up's chain
+ * "c",  creating the roll up if needed.  Returns false if there was no
+ * room for the roll up.  The name's lock must be held.
+ *****************************************************************************/
 
-                    } /* End of strcmp xbit_name & xbit_state = true */
+static sbool Sagan_Xbit_Link( uint32_t id, int c, uint32_t ip_src, uint32_t ip_dst, uintmax_t xbit_expire, uint64_t utime )
+{
 
+    _Sagan_IPC_Xbit *rollup;
 
-                    if ( and_or == true) {
-                        tmp_xbit_name = strtok_r(NULL, "|", &tok);
-                    } else {
-                        tmp_xbit_name = strtok_r(NULL, "&", &tok);
-                    }
+    uint32_t sid = XBIT_SID(id, c + 1);
+    uint64_t key = Sagan_Xbit_Chain_Key(c, ip_src, ip_dst);
+    uint64_t pair = XBIT_PAIR(ip_src, ip_dst);
+    uint32_t shard = Sagan_IPC_Hash_Shard(xbits, sid, key);
+    uint64_t first = 0;
+    sbool has_first = false;
 
-                } /* End of "while tmp_xbit_name" */
+    Sagan_IPC_Hash_Lock(xbits, shard);
 
-            } /* End of "for a" */
+    rollup = Sagan_IPC_Hash_Find(xbits, sid, key);
 
-        } /* End "if" xbit_type == 3 (ISSET) */
+    if ( rollup == NULL ) {
 
-        /*******************
-        *    ISNOTSET     *
-        *******************/
+        rollup = Sagan_IPC_Hash_Insert(xbits, sid, key);
 
-        if ( rulestruct[rule_position].xbit_type[i] == 4 ) {
+        if ( rollup == NULL ) {
+            Sagan_IPC_Hash_Unlock(xbits, shard);
+            return(false);
+        }
 
-            xbit_match = false;
+        rollup->ip_src = c == XBIT_CHAIN(XBIT_BY_SRC) ? ip_src : 0;
+        rollup->ip_dst = c == XBIT_CHAIN(XBIT_BY_DST) ? ip_dst : 0;
+    }
 
-            for (a = 0; a < counters_ipc->xbit_count; a++) {
+    if ( rollup->count > 0 ) {
+        has_first = true;
+        first = rollup->next[0];
+    }
 
-                strlcpy(tmp, rulestruct[rule_position].xbit_name[i], sizeof(tmp));
+    rollup->next[0] = pair;
+    rollup->count++;
 
-                if (Sagan_strstr(rulestruct[rule_position].xbit_name[i], "|")) {
-                    tmp_xbit_name = strtok_r(tmp, "|", &tok);
-                    and_or = true;
-                } else {
-                    tmp_xbit_name = strtok_r(tmp, "&", &tok);
-                    and_or = false;                                  /* Need this? */
-                }
+    if ( xbit_expire > rollup->xbit_expire ) {
+        rollup->xbit_expire = xbit_expire;
+        rollup->slot.utime = utime;
+    }
 
-                while (tmp_xbit_name != NULL ) {
+    Sagan_IPC_Hash_Unlock(xbits, shard);
 
-                    if (!strcmp(tmp_xbit_name, xbit_ipc[a].xbit_name)) {
+    Sagan_Xbit_Link_Set(id, pair, c, true, has_first, first);
 
-                        xbit_match = true;
+    if ( has_first == true ) {
+        Sagan_Xbit_Link_Set(id, first, c, false, true, pair);
+    }
 
-                        if ( xbit_ipc[a].xbit_state == false ) {
+    return(true);
+}
 
-                            /* direction: none */
+/*****************************************************************************
+ * Sagan_Xbit_Unlink - Takes an xbit (a copy of its entry) out of its roll
+ * up's chain "c".  If it may have held the roll up's expire time,  the roll
+ * up is marked stale for Sagan_Xbit_Isset() to work out again.  The name's
+ * lock must be held.
+ *****************************************************************************/
 
-                            if ( rulestruct[rule_position].xbit_direction[i] == 0 ) {
+static void Sagan_Xbit_Unlink( uint32_t id, int c, const _Sagan_IPC_Xbit *xbit, uint64_t utime )
+{
 
-                                if ( debug->debugxbit) {
-                                    Sagan_Log(S_DEBUG, "[%s, line %d] \"isnotset\" xbit \"%s\" (direction: \"none\"). (any -> any)", __FILE__, __LINE__, xbit_ipc[a].xbit_name);
-                                }
+    _Sagan_IPC_Xbit *rollup;
 
-                                xbit_total_match++;
-                            }
+    uint32_t sid = XBIT_SID(id, c + 1);
+    uint64_t key = Sagan_Xbit_Chain_Key(c, xbit->ip_src, xbit->ip_dst);
+    uint32_t shard = Sagan_IPC_Hash_Shard(xbits, sid, key);
+
+    if ( xbit->has_prev[c] == true ) {
+        Sagan_Xbit_Link_Set(id, xbit->prev[c], c, true, xbit->has_next[c], xbit->next[c]);
+    }
 
-                            /* direction: both */
+    if ( xbit->has_next[c] == true ) {
+        Sagan_Xbit_Link_Set(id, xbit->next[c], c, false, xbit->has_prev[c], xbit->prev[c]);
+    }
 
-                            if ( rulestruct[rule_position].xbit_direction[i] == 1 ) {
+    Sagan_IPC_Hash_Lock(xbits, shard);
 
+    rollup = Sagan_IPC_Hash_Find(xbits, sid, key);
 
-                                if ( xbit_ipc[a].ip_src == ip_src &&
-                                     xbit_ipc[a].ip_dst == ip_dst ) {
+    if ( rollup != NULL ) {
 
-                                    if ( debug->debugxbit) {
-                                        Sagan_Log(S_DEBUG, "[%s, line %d] \"isnotset\" xbit \"%s\" (direction: \"both\"). (%s -> %s)", __FILE__, __LINE__, xbit_ipc[a].xbit_name, ip_src_char, ip_dst_char);
-                                    }
+        if ( xbit->has_prev[c] == false ) {
+            rollup->next[0] = xbit->next[c];
+        }
 
-                                    xbit_total_match++;
-                                }
-                            }
+        rollup->count--;
 
-                            /* direction: by_src */
+        if ( rollup->count <= 0 ) {
+            Sagan_IPC_Hash_Delete(xbits, rollup);
+        } else if ( xbit->xbit_expire > utime && xbit->xbit_expire >= rollup->xbit_expire ) {
+            rollup->stale = true;
+        }
+    }
 
-                            if ( rulestruct[rule_position].xbit_direction[i] == 2 ) {
+    Sagan_IPC_Hash_Unlock(xbits, shard);
 
-                                if ( xbit_ipc[a].ip_src == ip_src ) {
+}
 
-                                    if ( debug->debugxbit) {
-                                        Sagan_Log(S_DEBUG, "[%s, line %d] \"isnotset\" xbit \"%s\" (direction: \"by_src\"). (%s -> any)", __FILE__, __LINE__, xbit_ipc[a].xbit_name, ip_src_char);
-                                    }
+/*****************************************************************************
+ * Sagan_Xbit_Recompute - Works out a stale roll up's expire time from the
+ * xbits on its chain and returns it
+ *****************************************************************************/
 
-                                    xbit_total_match++;
-                                }
-                            }
+static uintmax_t Sagan_Xbit_Recompute( uint32_t sid, uint64_t key )
+{
 
-                            /* direction: by_dst */
+    _Sagan_IPC_Xbit *xbit;
 
-                            if ( rulestruct[rule_position].xbit_direction[i] == 3 ) {
+    uint32_t id = XBIT_SID_ID(sid);
+    uint32_t exact = XBIT_SID(id, XBIT_EXACT);
+    uint32_t shard = Sagan_IPC_Hash_Shard(xbits, sid, key);
+    uint32_t xbit_shard;
+    uint64_t pair = 0;
+    uintmax_t xbit_expire = 0;
+    sbool more = false;
+    int c = XBIT_CHAIN(XBIT_SID_KIND(sid));
+    int left = 0;
 
-                                if ( xbit_ipc[a].ip_dst == ip_dst ) {
+    Sagan_IPC_Lock(&xbit_names->lock[id - 1]);
 
-                                    if ( debug->debugxbit) {
-                                        Sagan_Log(S_DEBUG, "[%s, line %d] \"isnotset\" xbit \"%s\" (direction: \"by_dst\"). (any -> %s)", __FILE__, __LINE__, xbit_ipc[a].xbit_name, ip_dst_char);
-                                    }
+    Sagan_IPC_Hash_Lock(xbits, shard);
 
-                                    xbit_total_match++;
-                                }
-                            }
+    xbit = Sagan_IPC_Hash_Find(xbits, sid, key);
 
-                            /* direction: reverse */
+    if ( xbit != NULL && xbit->stale == false ) {
+        xbit_expire = xbit->xbit_expire;
+    } else if ( xbit != NULL && xbit->count > 0 ) {
+        more = true;
+        pair = xbit->next[0];
+        left = xbit->count;
+    }
 
-                            if ( rulestruct[rule_position].xbit_direction[i] == 4 ) {
+    Sagan_IPC_Hash_Unlock(xbits, shard);
 
-                                if ( xbit_ipc[a].ip_src == ip_dst &&
-                                     xbit_ipc[a].ip_dst == ip_src ) {
+    /* "left" only guards against a damaged chain */
 
-                                    if ( debug->debugxbit) {
-                                        Sagan_Log(S_DEBUG, "[%s, line %d] \"isnotset\" xbit \"%s\" (direction: \"reverse\"). (%s -> %s)", __FILE__, __LINE__, xbit_ipc[a].xbit_name, ip_dst_char, ip_src_char);
-                                    }
+    while ( more == true && left-- > 0 ) {
 
-                                    xbit_total_match++;
-                                }
-                            }
+        xbit_shard = Sagan_IPC_Hash_Shard(xbits, exact, pair);
 
-                        } /* End xbit_state == false */
+        Sagan_IPC_Hash_Lock(xbits, xbit_shard);
 
-                    } /* End of strcmp xbit_name */
+        xbit = Sagan_IPC_Hash_Find(xbits, exact, pair);
 
-                    if ( and_or == true ) {
-                        tmp_xbit_name = strtok_r(NULL, "|", &tok);
-                    } else {
-                        tmp_xbit_name = strtok_r(NULL, "&", &tok);
-                    }
+        more = false;
 
-                } /* End of "while tmp_xbit_name" */
-            } /* End of "for a" */
+        if ( xbit != NULL ) {
 
-            if ( and_or == true && xbit_match == true ) {
-                xbit_total_match = rulestruct[rule_position].xbit_condition_count;	/* Do we even need this for OR? */
+            if ( xbit->xbit_expire > xbit_expire ) {
+                xbit_expire = xbit->xbit_expire;
             }
 
-            if ( and_or == false && xbit_match == false ) {
-                xbit_total_match = rulestruct[rule_position].xbit_condition_count;
-            }
+            more = xbit->has_next[c];
+            pair = xbit->next[c];
+        }
 
-        } /* End of "xbit_type[i] == 4" */
+        Sagan_IPC_Hash_Unlock(xbits, xbit_shard);
+    }
 
-    } /* End of "for i" */
+    Sagan_IPC_Hash_Lock(xbits, shard);
 
-    /* IF we match all criteria for isset/isnotset
-     *
-     * If we match the xbit_conditon_count (number of concurrent xbits)
-     * we trigger.  It it's an "or" statement,  we trigger if any of the
-     * xbits are set.
-     *
-     */
+    xbit = Sagan_IPC_Hash_Find(xbits, sid, key);
 
-    if ( ( rulestruct[rule_position].xbit_condition_count == xbit_total_match ) || ( and_or == true && xbit_total_match != 0 ) ) {
+    if ( xbit != NULL && xbit->stale == true ) {
+        xbit->xbit_expire = xbit_expire;
+        xbit->stale = false;
+    }
 
-        if ( debug->debugxbit) {
-            Sagan_Log(S_DEBUG, "[%s, line %d] Condition of xbit returning TRUE. %d %d", __FILE__, __LINE__, rulestruct[rule_position].xbit_condition_count, xbit_total_match);
-        }
+    Sagan_IPC_Hash_Unlock(xbits, shard);
+
+    Sagan_IPC_Unlock(&xbit_names->lock[id - 1]);
+
+    return(xbit_expire);
+}
+
+/*****************************************************************************
+ * Sagan_Xbit_Isset - Is the xbit set (in "direction") at "utime"?
+ *****************************************************************************/
+
+static sbool Sagan_Xbit_Isset( uint32_t id, int direction, uint32_t ip_src, uint32_t ip_dst, uint64_t utime )
+{
+
+    _Sagan_IPC_Xbit *xbit;
+
+    uint32_t sid;
+    uint32_t shard;
+    uint64_t key;
+    sbool set = false;
+    sbool stale = false;
 
-        return(true);
+    if ( id == 0 ) {
+        return(false);
     }
 
-    /* isset/isnotset failed. */
+    Sagan_Xbit_Lookup(id, direction, ip_src, ip_dst, &sid, &key);
 
-    if ( debug->debugxbit) {
-        Sagan_Log(S_DEBUG, "[%s, line %d] Condition of xbit returning FALSE. %d %d", __FILE__, __LINE__, rulestruct[rule_position].xbit_condition_count, xbit_total_match);
+    shard = Sagan_IPC_Hash_Shard(xbits, sid, key);
+
+    Sagan_IPC_Hash_Lock(xbits, shard);
+
+    xbit = Sagan_IPC_Hash_Find(xbits, sid, key);
+
+    if ( xbit != NULL && xbit->count > 0 && utime < xbit->xbit_expire ) {
+        set = true;
+        stale = xbit->stale;
     }
 
-    return(false);
+    Sagan_IPC_Hash_Unlock(xbits, shard);
 
-}  /* End of Sagan_Xbit_Condition(); */
+    if ( stale == true ) {
+        set = utime < Sagan_Xbit_Recompute(sid, key);
+    }
 
+    return(set);
+}
 
 /*****************************************************************************
- * Sagan_Xbit_Set - Used to "set" & "unset" xbit.  All rule "set" and
- * "unset" happen here.
+ * Sagan_Xbit_Refresh - An xbit was "set" again.  Its roll ups move up to
+ * the new expire time,  or are marked stale if it was cut short.  The
+ * name's lock must be held.
  *****************************************************************************/
 
-void Sagan_Xbit_Set(int rule_position, char *ip_src_char, char *ip_dst_char )
+static void Sagan_Xbit_Refresh( uint32_t id, uint32_t ip_src, uint32_t ip_dst, uintmax_t xbit_expire, uintmax_t old_expire, uint64_t utime )
 {
 
-    int i = 0;
-    int a = 0;
+    _Sagan_IPC_Xbit *rollup;
 
-    time_t t;
-    struct tm *now;
-    char  timet[20];
+    uint32_t sid;
+    uint32_t shard;
+    uint64_t key;
+    int c;
 
-    char tmp[128] = { 0 };
-    char *tmp_xbit_name = NULL;
-    char *tok = NULL;
+    for ( c = 0; c < XBIT_CHAINS; c++ ) {
 
-    sbool xbit_match = false;
-    sbool xbit_unset_match = 0;
+        sid = XBIT_SID(id, c + 1);
+        key = Sagan_Xbit_Chain_Key(c, ip_src, ip_dst);
+        shard = Sagan_IPC_Hash_Shard(xbits, sid, key);
 
-    uint32_t ip_src = 0;
-    uint32_t ip_dst = 0;
+        Sagan_IPC_Hash_Lock(xbits, shard);
 
-    ip_src = IP2Bit(ip_src_char);
-    ip_dst = IP2Bit(ip_dst_char);
+        rollup = Sagan_IPC_Hash_Find(xbits, sid, key);
 
-    t = time(NULL);
-    now=localtime(&t);
-    strftime(timet, sizeof(timet), "%s",  now);
+        if ( rollup != NULL ) {
 
-    struct _Sagan_Xbit_Track *xbit_track;
+            if ( old_expire > utime && old_expire > xbit_expire && old_expire >= rollup->xbit_expire ) {
+                rollup->stale = true;
+            }
 
-    xbit_track = malloc(sizeof(_Sagan_Xbit_Track));
+            if ( xbit_expire > rollup->xbit_expire ) {
+                rollup->xbit_expire = xbit_expire;
+                rollup->slot.utime = utime;
+            }
+        }
 
-    if ( xbit_track  == NULL ) {
-        Sagan_Log(S_ERROR, "[%s, line %d] Failed to allocate memory for xbit_track. Abort!", __FILE__, __LINE__);
+        Sagan_IPC_Hash_Unlock(xbits, shard);
     }
 
-    memset(xbit_track, 0, sizeof(_Sagan_Xbit_Track));
+}
 
-    int xbit_track_count = 0;
+/*****************************************************************************
+ * Sagan_Xbit_Delete - Removes an xbit from the table and from the first
+ * "chains" of its roll ups.  "when" is 0 to remove it no matter what,
+ * otherwise it is only removed if it has expired by then.  Its expire time
+ * is returned in "xbit_expire".  Returns true if it was removed.  The
+ * name's lock must be held.
+ *****************************************************************************/
 
-    Sagan_Xbit_Cleanup();
+static sbool Sagan_Xbit_Delete( uint32_t id, uint64_t pair, uint64_t when, uint64_t utime, uintmax_t *xbit_expire, int chains )
+{
 
+    _Sagan_IPC_Xbit *xbit;
+    _Sagan_IPC_Xbit removed;
 
-    for (i = 0; i < rulestruct[rule_position].xbit_count; i++) {
+    uint32_t sid = XBIT_SID(id, XBIT_EXACT);
+    uint32_t shard = Sagan_IPC_Hash_Shard(xbits, sid, pair);
+    sbool found = false;
+    int c;
 
-        /*******************
-         *      UNSET      *
-         *******************/
+    Sagan_IPC_Hash_Lock(xbits, shard);
 
-        if ( rulestruct[rule_position].xbit_type[i] == 2 ) {
+    xbit = Sagan_IPC_Hash_Find(xbits, sid, pair);
 
-            /* Xbits & (ie - bit1&bit2) */
+    if ( xbit != NULL ) {
 
-            strlcpy(tmp, rulestruct[rule_position].xbit_name[i], sizeof(tmp));
-            tmp_xbit_name = strtok_r(tmp, "&", &tok);
+        *xbit_expire = xbit->xbit_expire;
 
-            while( tmp_xbit_name != NULL ) {
+        if ( when == 0 || when >= xbit->xbit_expire ) {
+            memcpy(&removed, xbit, sizeof(_Sagan_IPC_Xbit));
+            Sagan_IPC_Hash_Delete(xbits, xbit);
+            found = true;
+        }
+    }
 
+    Sagan_IPC_Hash_Unlock(xbits, shard);
 
-                for (a = 0; a < counters_ipc->xbit_count; a++) {
+    if ( found == true ) {
 
-                    if ( !strcmp(tmp_xbit_name, xbit_ipc[a].xbit_name )) {
+        __atomic_sub_fetch(&counters_ipc->xbit_count, 1, __ATOMIC_RELAXED);
 
-                        /* direction: none */
+        for ( c = 0; c < chains; c++ ) {
+            Sagan_Xbit_Unlink(id, c, &removed, utime);
+        }
+    }
 
-                        if ( rulestruct[rule_position].xbit_direction[i] == 0 ) {
+    return(found);
+}
 
-                            if ( debug->debugxbit) {
-                                Sagan_Log(S_DEBUG, "[%s, line %d] \"unset\" xbit \"%s\" (direction: \"none\"). (any -> any)", __FILE__, __LINE__, xbit_ipc[a].xbit_name);
-                            }
+/*****************************************************************************
+ * Sagan_Xbit_Add - "set" one xbit.  Returns 1 if it was created,  0 if it
+ * was already set (its expire time is pushed out) or -1 if there was no
+ * room for it.
+ *****************************************************************************/
 
+static int Sagan_Xbit_Add( uint32_t id, uint32_t ip_src, uint32_t ip_dst, int timeout, uint64_t utime )
+{
 
-                            Sagan_File_Lock(config->shm_xbit);
-                            pthread_mutex_lock(&Xbit_Mutex);
+    _Sagan_IPC_Xbit *xbit;
 
-                            xbit_ipc[a].xbit_state = false;
+    uint32_t sid = XBIT_SID(id, XBIT_EXACT);
+    uint64_t key = XBIT_PAIR(ip_src, ip_dst);
+    uint32_t shard = Sagan_IPC_Hash_Shard(xbits, sid, key);
+    uintmax_t xbit_expire = utime + timeout;
+    uintmax_t old_expire = 0;
 
-                            pthread_mutex_unlock(&Xbit_Mutex);
-                            Sagan_File_Unlock(config->shm_xbit);
+    int ret = 0;
+    int c;
 
-                            xbit_unset_match = 1;
+    Sagan_IPC_Lock(&xbit_names->lock[id - 1]);
 
-                        }
+    Sagan_IPC_Hash_Lock(xbits, shard);
 
+    xbit = Sagan_IPC_Hash_Find(xbits, sid, key);
 
-                        /* direction: both */
+    if ( xbit == NULL ) {
 
-                        if ( rulestruct[rule_position].xbit_direction[i] == 1 &&
-                             xbit_ipc[a].ip_src == ip_src &&
-                             xbit_ipc[a].ip_dst == ip_dst ) {
+        if ( __atomic_load_n(&counters_ipc->xbit_count, __ATOMIC_RELAXED) < config->max_xbits ) {
+            xbit = Sagan_IPC_Hash_Insert(xbits, sid, key);
+        }
 
-                            if ( debug->debugxbit) {
-                                Sagan_Log(S_DEBUG, "[%s, line %d] \"unset\" xbit \"%s\" (direction: \"both\"). (%s -> %s)", __FILE__, __LINE__, xbit_ipc[a].xbit_name, ip_src_char, ip_dst_char);
-                            }
+        if ( xbit != NULL ) {
+            xbit->ip_src = ip_src;
+            xbit->ip_dst = ip_dst;
+            xbit->count = 1;
+            ret = 1;
+        } else {
+            ret = -1;
+        }
 
-                            Sagan_File_Lock(config->shm_xbit);
-                            pthread_mutex_lock(&Xbit_Mutex);
+    } else {
 
-                            xbit_ipc[a].xbit_state = false;
+        old_expire = xbit->xbit_expire;
+    }
 
-                            pthread_mutex_unlock(&Xbit_Mutex);
-                            Sagan_File_Unlock(config->shm_xbit);
+    if ( xbit != NULL ) {
+        xbit->slot.utime = utime;
+        xbit->slot.expire = timeout;
+        xbit->xbit_expire = xbit_expire;
+    }
 
-                            xbit_unset_match = 1;
+    Sagan_IPC_Hash_Unlock(xbits, shard);
 
-                        }
+    if ( ret == 1 ) {
 
-                        /* direction: by_src */
+        __atomic_add_fetch(&counters_ipc->xbit_count, 1, __ATOMIC_RELAXED);
 
-                        if ( rulestruct[rule_position].xbit_direction[i] == 2 &&
-                             xbit_ipc[a].ip_src == ip_src )
+        for ( c = 0; c < XBIT_CHAINS && Sagan_Xbit_Link(id, c, ip_src, ip_dst, xbit_expire, utime) == true; c++ );
 
-                        {
+        /* No room for one of its roll ups.  Take it back out of the ones
+         * it made it into */
 
-                            if ( debug->debugxbit) {
-                                Sagan_Log(S_DEBUG, "[%s, line %d] \"unset\" xbit \"%s\" (direction: \"by_src\"). (%s -> any)", __FILE__, __LINE__, xbit_ipc[a].xbit_name, ip_src_char);
-                            }
+        if ( c < XBIT_CHAINS ) {
+            Sagan_Xbit_Delete(id, key, 0, utime, &old_expire, c);
+            ret = -1;
+        }
 
-                            Sagan_File_Lock(config->shm_xbit);
-                            pthread_mutex_lock(&Xbit_Mutex);
+    } else if ( ret == 0 ) {
 
-                            xbit_ipc[a].xbit_state = false;
+        Sagan_Xbit_Refresh(id, ip_src, ip_dst, xbit_expire, old_expire, utime);
+    }
 
-                            pthread_mutex_unlock(&Xbit_Mutex);
-                            Sagan_File_Unlock(config->shm_xbit);
+    Sagan_IPC_Unlock(&xbit_names->lock[id - 1]);
 
-                            xbit_unset_match = 1;
+    if ( ret == 1 ) {
+        Sagan_Timer_Add(TIMER_XBIT, sid, key, xbit_expire);
+    }
 
-                        }
+    if ( ret == -1 ) {
+        Sagan_Log(S_WARN, "[%s, line %d] Xbit shared object is full (%d).  Increase 'xbit' in your configuration!", __FILE__, __LINE__, config->max_xbits);
+    }
 
+    return(ret);
+}
 
-                        /* direction: by_dst */
+/*****************************************************************************
+ * Sagan_Xbit_Remove - "unset" one xbit.  Returns true if it was set.
+ *****************************************************************************/
 
-                        if ( rulestruct[rule_position].xbit_direction[i] == 3 &&
-                             xbit_ipc[a].ip_dst == ip_dst ) {
+static sbool Sagan_Xbit_Remove( uint32_t sid, uint64_t key, uint64_t utime )
+{
 
-                            if ( debug->debugxbit) {
-                                Sagan_Log(S_DEBUG, "[%s, line %d] \"unset\" xbit \"%s\" (direction: \"by_dst\"). (any -> %s)", __FILE__, __LINE__, xbit_ipc[a].xbit_name, ip_dst_char);
-                            }
+    uint32_t id = XBIT_SID_ID(sid);
+    uintmax_t xbit_expire = 0;
+    sbool removed;
 
-                            Sagan_File_Lock(config->shm_xbit);
-                            pthread_mutex_lock(&Xbit_Mutex);
+    Sagan_IPC_Lock(&xbit_names->lock[id - 1]);
 
-                            xbit_ipc[a].xbit_state = false;
+    removed = Sagan_Xbit_Delete(id, key, 0, utime, &xbit_expire, XBIT_CHAINS);
 
-                            pthread_mutex_unlock(&Xbit_Mutex);
-                            Sagan_File_Unlock(config->shm_xbit);
+    Sagan_IPC_Unlock(&xbit_names->lock[id - 1]);
 
-                            xbit_unset_match = 1;
+    return(removed);
+}
 
-                        }
+/*****************************************************************************
+ * Sagan_Xbit_Remove_All - "unset" every xbit "id" has for a source
+ * (by_src),  destination (by_dst) or all of them (none).  They are the
+ * roll up's chain,  so only those xbits are looked at.  Returns the number
+ * removed.
+ *****************************************************************************/
 
-                        /* direction: reverse */
+static int Sagan_Xbit_Remove_All( uint32_t id, int direction, uint32_t ip_src, uint32_t ip_dst, uint64_t utime )
+{
 
-                        if ( rulestruct[rule_position].xbit_direction[i] == 4 &&
-                             xbit_ipc[a].ip_dst == ip_src &&
-                             xbit_ipc[a].ip_src == ip_dst )
+    _Sagan_IPC_Xbit *rollup;
 
-                        {
+    uint32_t sid;
+    uint32_t shard;
+    uint64_t key;
+    uint64_t pair = 0;
+    uintmax_t xbit_expire = 0;
+    sbool more = true;
 
-                            if ( debug->debugxbit) {
-                                Sagan_Log(S_DEBUG, "[%s, line %d] \"unset\" xbit \"%s\" (direction: \"reverse\"). (%s -> %s)", __FILE__, __LINE__, xbit_ipc[a].xbit_name, ip_dst_char, ip_src_char);
-                            }
+    int total = 0;
 
-                            Sagan_File_Lock(config->shm_xbit);
-                            pthread_mutex_lock(&Xbit_Mutex);
+    Sagan_Xbit_Lookup(id, direction, ip_src, ip_dst, &sid, &key);
 
-                            xbit_ipc[a].xbit_state = false;
+    shard = Sagan_IPC_Hash_Shard(xbits, sid, key);
 
-                            pthread_mutex_unlock(&Xbit_Mutex);
-                            Sagan_File_Unlock(config->shm_xbit);
+    Sagan_IPC_Lock(&xbit_names->lock[id - 1]);
 
-                            xbit_unset_match = 1;
+    while ( more == true ) {
 
-                        }
-                    }
-                }
+        more = false;
 
-                if ( debug->debugxbit && xbit_unset_match == 0 ) {
-                    Sagan_Log(S_DEBUG, "[%s, line %d] No xbit found to \"unset\" for %s.", __FILE__, __LINE__, tmp_xbit_name);
-                }
+        Sagan_IPC_Hash_Lock(xbits, shard);
 
-                tmp_xbit_name = strtok_r(NULL, "&", &tok);
-            }
-        } /* While & xbits (ie - bit1&bit2) */
+        rollup = Sagan_IPC_Hash_Find(xbits, sid, key);
 
-        /*******************
-         *      SET        *
-        *******************/
+        if ( rollup != NULL && rollup->count > 0 ) {
+            pair = rollup->next[0];
+            more = true;
+        }
 
-        if ( rulestruct[rule_position].xbit_type[i] == 1 ) {
+        Sagan_IPC_Hash_Unlock(xbits, shard);
 
-            xbit_match = false;
+        /* Removing the first xbit moves the next one up.  If it isn't
+         * there the chain is damaged,  so stop rather than spin */
 
-            /* Xbits & (ie - bit1&bit2) */
+        if ( more == true ) {
+            more = Sagan_Xbit_Delete(id, pair, 0, utime, &xbit_expire, XBIT_CHAINS);
+            total += more;
+        }
+    }
 
-            strlcpy(tmp, rulestruct[rule_position].xbit_name[i], sizeof(tmp));
-            tmp_xbit_name = strtok_r(tmp, "&", &tok);
+    Sagan_IPC_Unlock(&xbit_names->lock[id - 1]);
 
-            while( tmp_xbit_name != NULL ) {
+    return(total);
+}
 
-                for (a = 0; a < counters_ipc->xbit_count; a++) {
+/*****************************************************************************
+ * Sagan_Xbit_Condition - Used for testing "isset" & "isnotset".  Full
+ * rule condition is tested here and returned.
+ *
+ * Every "isset"/"isnotset" in the rule must hold.  For bit1&bit2 that is
+ * every name,  for bit1|bit2 any one of them.
+ *****************************************************************************/
 
-                    /* Do we have the xbit already in memory?  If so,  update the information */
+int Sagan_Xbit_Condition(int rule_position, char *ip_src_char, char *ip_dst_char )
+{
 
-                    if (!strcmp(xbit_ipc[a].xbit_name, tmp_xbit_name) &&
-                        xbit_ipc[a].ip_src == ip_src &&
-                        xbit_ipc[a].ip_dst == ip_dst ) {
+    struct _Rule_Struct *rule = &rulestruct[rule_position];
 
-                        Sagan_File_Lock(config->shm_xbit);
-                        pthread_mutex_lock(&Xbit_Mutex);
+    int i;
+    int a;
 
-                        xbit_ipc[a].xbit_date = atol(timet);
-                        xbit_ipc[a].xbit_expire = atol(timet) + rulestruct[rule_position].xbit_timeout[i];
-                        xbit_ipc[a].xbit_state = true;
+    uint32_t id;
+    uint32_t ip_src;
+    uint32_t ip_dst;
 
-                        if ( debug->debugxbit) {
-                            Sagan_Log(S_DEBUG, "[%s, line %d] [%d] Updated via \"set\" for xbit \"%s\", [%d].  New expire time is %d (%d) [%u -> %u]. ", __FILE__, __LINE__, a, tmp_xbit_name, i, xbit_ipc[i].xbit_expire, rulestruct[rule_position].xbit_timeout[i], xbit_ipc[a].ip_src, xbit_ipc[a].ip_dst);
-                        }
+    sbool set;
+    sbool match;
 
-                        pthread_mutex_unlock(&Xbit_Mutex);
-                        Sagan_File_Unlock(config->shm_xbit);
+    uint64_t utime = Sagan_Clock_Now();
 
-                        xbit_match = true;
-                    }
+    ip_src = IP2Bit(ip_src_char);
+    ip_dst = IP2Bit(ip_dst_char);
 
-                }
+    for (i = 0; i < rule->xbit_count; i++) {
 
+        if ( rule->xbit_type[i] != 3 && rule->xbit_type[i] != 4 ) {
+            continue;
+        }
 
-                /* If the xbit isn't in memory,  store it to be created later */
+        match = !rule->xbit_or[i];
 
-                if ( xbit_match == false ) {
+        for (a = 0; a < rule->xbit_name_count[i]; a++) {
 
-                    xbit_track = ( _Sagan_Xbit_Track * ) realloc(xbit_track, (xbit_track_count+1) * sizeof(_Sagan_Xbit_Track));
+            id = rule->xbit_id[i][a];
 
-                    if ( xbit_track == NULL ) {
-                        Sagan_Log(S_ERROR, "[%s, line %d] Failed to reallocate memory for xbit_track. Abort!", __FILE__, __LINE__);
-                    }
+            set = Sagan_Xbit_Isset(id, rule->xbit_direction[i], ip_src, ip_dst, utime);
 
-                    strlcpy(xbit_track[xbit_track_count].xbit_name, tmp_xbit_name, sizeof(xbit_track[xbit_track_count].xbit_name));
-                    xbit_track[xbit_track_count].xbit_timeout = rulestruct[rule_position].xbit_timeout[i];
-                    xbit_track_count++;
+            if ( rule->xbit_type[i] == 4 ) {
+                set = !set;
+            }
 
-                }
+            if ( debug->debugxbit ) {
+                Sagan_Log(S_DEBUG, "[%s, line %d] \"%s\" xbit \"%s\" (direction: \"%s\") is %s. (%s -> %s)", __FILE__, __LINE__, rule->xbit_type[i] == 3 ? "isset" : "isnotset", Sagan_Xbit_Name(id), xbit_directions[rule->xbit_direction[i]], set ? "true" : "false", ip_src_char, ip_dst_char);
+            }
 
-                tmp_xbit_name = strtok_r(NULL, "&", &tok);
+            /* The first false name decides bit1&bit2,  the first true one
+             * bit1|bit2 */
+
+            if ( set == rule->xbit_or[i] ) {
+                match = set;
+                break;
+            }
+        }
 
-            } /* While & xbits (ie - bit1&bit2) */
+        if ( match == false ) {
 
-        } /* if xbit_type == 1 */
+            if ( debug->debugxbit) {
+                Sagan_Log(S_DEBUG, "[%s, line %d] Condition of xbit returning FALSE.", __FILE__, __LINE__);
+            }
 
-    } /* Out of for i loop */
+            return(false);
+        }
+    }
 
-    /* Do we have any xbits in memory that need to be created?  */
+    if ( debug->debugxbit) {
+        Sagan_Log(S_DEBUG, "[%s, line %d] Condition of xbit returning TRUE.", __FILE__, __LINE__);
+    }
 
-    if ( xbit_track_count != 0 ) {
+    return(true);
 
-        for (i = 0; i < xbit_track_count; i++) {
+}  /* End of Sagan_Xbit_Condition(); */
 
-            if ( Sagan_Clean_IPC_Object(XBIT) == 0 ) {
 
-                Sagan_File_Lock(config->shm_xbit);
-                pthread_mutex_lock(&Xbit_Mutex);
+/*****************************************************************************
+ * Sagan_Xbit_Set - Used to "set" & "unset" xbit.  All rule "set" and
+ * "unset" happen here.
+ *****************************************************************************/
 
-                xbit_ipc[counters_ipc->xbit_count].ip_src = ip_src;
-                xbit_ipc[counters_ipc->xbit_count].ip_dst = ip_dst;
-                xbit_ipc[counters_ipc->xbit_count].xbit_date = atol(timet);
-                xbit_ipc[counters_ipc->xbit_count].xbit_expire = atol(timet) + xbit_track[i].xbit_timeout;
-                xbit_ipc[counters_ipc->xbit_count].xbit_state = true;
-                xbit_ipc[counters_ipc->xbit_count].expire = xbit_track[i].xbit_timeout;
+void Sagan_Xbit_Set(int rule_position, char *ip_src_char, char *ip_dst_char )
+{
 
-                strlcpy(xbit_ipc[counters_ipc->xbit_count].xbit_name, xbit_track[i].xbit_name, sizeof(xbit_ipc[counters_ipc->xbit_count].xbit_name));
+    struct _Rule_Struct *rule = &rulestruct[rule_position];
 
-                pthread_mutex_unlock(&Xbit_Mutex);
-                Sagan_File_Unlock(config->shm_xbit);
+    int i;
+    int a;
+    int ret;
 
-                if ( debug->debugxbit) {
-                    Sagan_Log(S_DEBUG, "[%s, line %d] [%d] Created xbit \"%s\" via \"set\" [%s -> %s],", __FILE__, __LINE__, counters_ipc->xbit_count, xbit_ipc[counters_ipc->xbit_count].xbit_name, ip_src_char, ip_dst_char);
+    uint32_t id;
+    uint32_t sid;
+    uint32_t ip_src;
+    uint32_t ip_dst;
+    uint64_t key;
+    uint64_t utime;
+
+    ip_src = IP2Bit(ip_src_char);
+    ip_dst = IP2Bit(ip_dst_char);
+
+    utime = Sagan_Clock_Now();
+
+    for (i = 0; i < rule->xbit_count; i++) {
+
+        /*******************
+         *      UNSET      *
+         *******************/
+
+        if ( rule->xbit_type[i] == 2 ) {
+
+            for (a = 0; a < rule->xbit_name_count[i]; a++) {
+
+                id = rule->xbit_id[i][a];
+
+                if ( id == 0 ) {
+                    continue;
                 }
 
-                Sagan_File_Lock(config->shm_counters);
-                pthread_mutex_lock(&CounterMutex);
+                /* both & reverse are one xbit,  the rest can be many */
 
-                counters_ipc->xbit_count++;
+                if ( rule->xbit_direction[i] == 1 || rule->xbit_direction[i] == 4 ) {
+                    Sagan_Xbit_Lookup(id, rule->xbit_direction[i], ip_src, ip_dst, &sid, &key);
+                    ret = Sagan_Xbit_Remove(sid, key, utime);
+                } else {
+                    ret = Sagan_Xbit_Remove_All(id, rule->xbit_direction[i], ip_src, ip_dst, utime);
+                }
 
-                pthread_mutex_unlock(&CounterMutex);
-                Sagan_File_Unlock(config->shm_counters);
+                if ( debug->debugxbit ) {
 
+                    if ( ret == 0 ) {
+                        Sagan_Log(S_DEBUG, "[%s, line %d] No xbit found to \"unset\" for %s.", __FILE__, __LINE__, Sagan_Xbit_Name(id));
+                    } else {
+                        Sagan_Log(S_DEBUG, "[%s, line %d] \"unset\" %d xbit \"%s\" (direction: \"%s\"). (%s -> %s)", __FILE__, __LINE__, ret, Sagan_Xbit_Name(id), xbit_directions[rule->xbit_direction[i]], ip_src_char, ip_dst_char);
+                    }
+                }
             }
         }
-    }
 
-    free(xbit_track);
+        /*******************
+         *      SET        *
+        *******************/
+
+        if ( rule->xbit_type[i] == 1 ) {
+
+            for (a = 0; a < rule->xbit_name_count[i]; a++) {
+
+                id = rule->xbit_id[i][a];
+
+                if ( id == 0 ) {
+                    continue;
+                }
+
+                ret = Sagan_Xbit_Add(id, ip_src, ip_dst, rule->xbit_timeout[i], utime);
+
+                if ( debug->debugxbit && ret >= 0 ) {
+                    Sagan_Log(S_DEBUG, "[%s, line %d] %s xbit \"%s\" via \"set\" [%s -> %s].  Expires in %d seconds.", __FILE__, __LINE__, ret == 1 ? "Created" : "Updated", Sagan_Xbit_Name(id), ip_src_char, ip_dst_char, rule->xbit_timeout[i]);
+                }
+            }
+        }
+
+    } /* Out of for i loop */
 
 } /* End of Sagan_Xbit_Set */
 
@@ -686,32 +1014,153 @@ int Sagan_Xbit_Type ( char *type, int linecount, const char *ruleset )
 
 }
 
+/*****************************************************************************
+ * Sagan_Xbit_Expire - Timer callback.  Removes the xbit once it has
+ * expired,  otherwise returns when it will ("set" again since).
+ *****************************************************************************/
+
+static uint64_t Sagan_Xbit_Expire( uint32_t sid, uint64_t key, uint64_t utime )
+{
+
+    uint32_t id = XBIT_SID_ID(sid);
+    uintmax_t xbit_expire = 0;
+    sbool removed;
+
+    Sagan_IPC_Lock(&xbit_names->lock[id - 1]);
+
+    removed = Sagan_Xbit_Delete(id, key, utime, utime, &xbit_expire, XBIT_CHAINS);
+
+    Sagan_IPC_Unlock(&xbit_names->lock[id - 1]);
+
+    if ( removed == false ) {
+        return( xbit_expire > utime ? xbit_expire : 0 );
+    }
+
+    if ( debug->debugxbit ) {
+        Sagan_Log(S_DEBUG, "[%s, line %d] Xbit %s has expired.", __FILE__, __LINE__, Sagan_Xbit_Name(id));
+    }
+
+    return(0);
+
+}
 
 /*****************************************************************************
- * Sagan_Xbit_Cleanup - Find "expired" xbits and toggle the "state"
- * to "off"
+ * Sagan_Xbit_Init - Create (if needed) or map to the xbit names and table,
+ * then intern the names of rules loaded before it was mapped.
  *****************************************************************************/
 
-void Sagan_Xbit_Cleanup(void)
+void Sagan_Xbit_Init( sbool new_counters )
 {
 
-    int i = 0;
+    char tmp_object_check[MAXPATH + sizeof(XBIT_IPC_FILE) + 1];
+
+    int max_entries = config->max_xbits * 4;		/* Each xbit can add 3 roll ups */
+    size_t size = sizeof(_Sagan_IPC_Xbit_Names) + Sagan_IPC_Hash_Size(max_entries, sizeof(_Sagan_IPC_Xbit));
 
-    time_t t;
-    struct tm *now;
-    char  timet[20];
+    sbool new_object = false;
+    uint32_t i;
+    int r;
+    int a;
+
+    _Sagan_IPC_Xbit *xbit;
+
+    /* For convert 32 bit IP to octet */
+
+    struct in_addr ip_addr_src;
+    struct in_addr ip_addr_dst;
+
+    char ip_src[INET_ADDRSTRLEN];
+    char ip_dst[INET_ADDRSTRLEN];
+
+    snprintf(tmp_object_check, sizeof(tmp_object_check), "%s/%s", config->ipc_directory, XBIT_IPC_FILE);
+
+    Sagan_IPC_Check_Object(tmp_object_check, new_counters, "xbit");
+
+    if ((config->shm_xbit = open(tmp_object_check, (O_CREAT | O_EXCL | O_RDWR), (S_IREAD | S_IWRITE))) > 0 ) {
+        Sagan_Log(S_NORMAL, "+ Xbit shared object (new).");
+        new_object = true;
+    }
+
+    else if ((config->shm_xbit = open(tmp_object_check, (O_CREAT | O_RDWR), (S_IREAD | S_IWRITE))) < 0 ) {
+        Sagan_Log(S_ERROR, "[%s, line %d] Cannot open() for xbit (%s:%s)", __FILE__, __LINE__, tmp_object_check, strerror(errno));
+    }
+
+    if ( ftruncate(config->shm_xbit, size) != 0 ) {
+        Sagan_Log(S_ERROR, "[%s, line %d] Failed to ftruncate xbit. [%s]", __FILE__, __LINE__, strerror(errno));
+    }
+
+    if (( xbit_names = mmap(0, size, (PROT_READ | PROT_WRITE), MAP_SHARED, config->shm_xbit, 0)) == MAP_FAILED ) {
+        Sagan_Log(S_ERROR, "[%s, line %d] Error allocating memory for xbit object! [%s]", __FILE__, __LINE__, strerror(errno));
+    }
+
+    xbits = (_Sagan_IPC_Hash *)((unsigned char *)xbit_names + sizeof(_Sagan_IPC_Xbit_Names));
+
+    /* Ids in a reset table mean nothing,  so the names go with it */
+
+    if ( Sagan_IPC_Hash_Attach(xbits, max_entries, sizeof(_Sagan_IPC_Xbit)) == false ) {
+
+        memset(xbit_names, 0, sizeof(_Sagan_IPC_Xbit_Names));
+        memset(xbit_held, 0, sizeof(xbit_held));
+        counters_ipc->xbit_count = 0;
+
+        if ( new_object == false ) {
+            Sagan_Log(S_NORMAL, "* Xbit shared object was an old format or size & has been reset.");
+            new_object = true;
+        }
+    }
+
+    if ( new_object == false ) {
+        Sagan_Log(S_NORMAL, "- Xbit shared object reloaded (%d xbits loaded / max: %d).", counters_ipc->xbit_count, config->max_xbits);
+    }
+
+    /* Expire what we loaded as well as what we add */
+
+    Sagan_Timer_Register(TIMER_XBIT, Sagan_Xbit_Expire);
+
+    for ( i = 0; i < xbits->capacity && xbits->count != 0; i++ ) {
+
+        xbit = (_Sagan_IPC_Xbit *)IPC_HASH_SLOT(xbits, i);
+
+        if ( xbit->slot.used && XBIT_SID_KIND(xbit->slot.sid) == XBIT_EXACT ) {
+            Sagan_Timer_Add(TIMER_XBIT, xbit->slot.sid, xbit->slot.key, xbit->xbit_expire);
+        }
+    }
+
+    if ( debug->debugipc && counters_ipc->xbit_count >= 1 ) {
 
-    t = time(NULL);
-    now=localtime(&t);
-    strftime(timet, sizeof(timet), "%s",  now);
+        Sagan_Log(S_DEBUG, "");
+        Sagan_Log(S_DEBUG, "*** Xbits ***");
+        Sagan_Log(S_DEBUG, "------------------------------------------------------------------------------------------------");
+        Sagan_Log(S_DEBUG, "%-25s| %-16s| %-16s| %-21s| %s", "Xbit name", "SRC IP", "DST IP", "Date added/modified", "Expire");
+        Sagan_Log(S_DEBUG, "------------------------------------------------------------------------------------------------");
+
+        for ( i = 0; i < xbits->capacity; i++ ) {
+
+            xbit = (_Sagan_IPC_Xbit *)IPC_HASH_SLOT(xbits, i);
+
+            if ( xbit->slot.used && XBIT_SID_KIND(xbit->slot.sid) == XBIT_EXACT ) {
+
+                ip_addr_src.s_addr = htonl(xbit->ip_src);
+                ip_addr_dst.s_addr = htonl(xbit->ip_dst);
+
+                inet_ntop(AF_INET, &ip_addr_src, ip_src, sizeof(ip_src));
+                inet_ntop(AF_INET, &ip_addr_dst, ip_dst, sizeof(ip_dst));
+
+                Sagan_Log(S_DEBUG, "%-25s| %-16s| %-16s| %-21s| %d", Sagan_Xbit_Name(XBIT_SID_ID(xbit->slot.sid)), ip_src, ip_dst, Sagan_u32_Time_To_Human(xbit->slot.utime), xbit->slot.expire);
+            }
+        }
+
+        Sagan_Log(S_DEBUG, "");
+    }
 
+    /* Rules are loaded before the IPC objects,  so their names weren't
+     * interned yet */
 
-    for (i=0; i<counters_ipc->xbit_count; i++) {
-        if (  xbit_ipc[i].xbit_state == true && atol(timet) >= xbit_ipc[i].xbit_expire ) {
-            if (debug->debugxbit) {
-                Sagan_Log(S_DEBUG, "[%s, line %d] Setting xbit %s to \"expired\" state.", __FILE__, __LINE__, xbit_ipc[i].xbit_name);
+    for ( r = 0; r < counters->rulecount; r++ ) {
+        for ( a = 0; a < rulestruct[r].xbit_count; a++ ) {
+            if ( Sagan_Xbit_Parse(r, a, 0, "") == false ) {
+                Sagan_Log(S_ERROR, "[%s, line %d] Xbit name table is full (%d names).  Remove %s/%s and restart Sagan. Abort!", __FILE__, __LINE__, XBIT_NAMES_MAX, config->ipc_directory, XBIT_IPC_FILE);
             }
-            xbit_ipc[i].xbit_state = false;
         }
     }
 
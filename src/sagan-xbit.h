@@ -22,28 +22,66 @@
 #include "config.h"             /* From autoconf */
 #endif
 
+#include <stdint.h>
+
 void Sagan_Xbit_Set( int, char *, char * );
 int Sagan_Xbit_Condition ( int, char *, char * );
 int Sagan_Xbit_Type ( char *, int, const char *);
-void Sagan_Xbit_Cleanup(void);
+sbool Sagan_Xbit_Parse( int, int, int, const char * );
+void Sagan_Xbit_Release( void );
+void Sagan_Xbit_Init( sbool );
 
-typedef struct _Sagan_Xbit_Track _Sagan_Xbit_Track;
-struct _Sagan_Xbit_Track {
-    char	xbit_name[64];
-    int		xbit_timeout;
-};
+/* Xbit state is an _Sagan_IPC_Hash.  The slot "sid" is the interned name
+ * and what the entry is keyed by (XBIT_SID()):
+ *
+ * XBIT_EXACT  - One xbit,  keyed by source and destination (XBIT_PAIR()).
+ * XBIT_BY_SRC - Roll up of the xbit's XBIT_EXACT entries with one source,
+ * XBIT_BY_DST - ... one destination,
+ * XBIT_ANY    - ... and all of them (key 0).
+ *
+ * The roll ups make "by_src",  "by_dst" and "none" a single lookup.  Each
+ * roll up is also the head of a list of the xbits it covers,  linked
+ * through the XBIT_EXACT entries (XBIT_CHAIN() picks the links).  Entries
+ * move when the table shifts on a delete,  so links are XBIT_PAIR() keys,
+ * not slots.  Changes to a name's entries are made under its lock in
+ * _Sagan_IPC_Xbit_Names. */
+
+#define XBIT_EXACT		0
+#define XBIT_BY_SRC		1
+#define XBIT_BY_DST		2
+#define XBIT_ANY		3
 
+#define XBIT_CHAINS		3
 
+#define XBIT_SID(id, kind)	( ( (uint32_t)(id) << 2 ) | (kind) )
+#define XBIT_SID_ID(sid)	( (uint32_t)(sid) >> 2 )
+#define XBIT_SID_KIND(sid)	( (uint32_t)(sid) & 3 )
+#define XBIT_PAIR(src, dst)	( ( (uint64_t)(src) << 32 ) | (uint32_t)(dst) )
+#define XBIT_CHAIN(kind)	( (kind) - 1 )
 
 typedef struct _Sagan_IPC_Xbit _Sagan_IPC_Xbit;
 struct _Sagan_IPC_Xbit {
-    char xbit_name[64];
-    sbool xbit_state;
+    _Sagan_IPC_Hash_Slot slot;		/* "utime" is when it was set,  "expire" for how long */
     uint32_t ip_src;
     uint32_t ip_dst;
-    char username[64];
-    uintmax_t xbit_date;
-    uintmax_t xbit_expire;
-    int expire;
+    uintmax_t xbit_expire;		/* Roll ups: latest of their xbits */
+    int count;				/* Roll ups: number of xbits.  Always 1 for XBIT_EXACT */
+    sbool stale;			/* Roll ups: the xbit holding "xbit_expire" went away */
+    sbool has_next[XBIT_CHAINS];
+    sbool has_prev[XBIT_CHAINS];
+    uint64_t next[XBIT_CHAINS];		/* Roll ups: next[0] is the first xbit */
+    uint64_t prev[XBIT_CHAINS];
 };
 
+/* Start of XBIT_IPC_FILE.  Names are interned (rule load) to their
+ * position + 1,  so every process shares the same ids.  The xbit
+ * _Sagan_IPC_Hash follows. */
+
+typedef struct _Sagan_IPC_Xbit_Names _Sagan_IPC_Xbit_Names;
+struct _Sagan_IPC_Xbit_Names {
+    uint32_t count;
+    unsigned char pad[XBIT_NAME_SIZE - sizeof(uint32_t)];
+    char name[XBIT_NAMES_MAX][XBIT_NAME_SIZE];
+    uint32_t lock[XBIT_NAMES_MAX];	/* Sagan_IPC_Lock(),  held while a name's xbits change */
+    uint32_t refs[XBIT_NAMES_MAX];	/* Sagan processes with rules that use the name */
+};
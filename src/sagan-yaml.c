@@ -40,6 +40,7 @@
 #include "sagan-defs.h"
 #include "sagan-yaml.h"
 #include "sagan-rules.h"
+#include "sagan-prefilter.h"
 #include "sagan-config.h"
 #include "sagan-classifications.h"
 #include "sagan-gen-msg.h"
@@ -152,17 +153,7 @@ void Load_YAML_Config( char *yaml_file )
         config->sagan_host[0] = '\0';
         config->sagan_port = 514;
 
-        config->max_threshold_by_src = DEFAULT_IPC_THRESH_BY_SRC;
-        config->max_threshold_by_dst = DEFAULT_IPC_THRESH_BY_DST;
-        config->max_threshold_by_srcport = DEFAULT_IPC_THRESH_BY_SRC_PORT;
-        config->max_threshold_by_dstport = DEFAULT_IPC_THRESH_BY_DST_PORT;
-        config->max_threshold_by_username = DEFAULT_IPC_THRESH_BY_USERNAME;
-
-        config->max_after_by_src = DEFAULT_IPC_AFTER_BY_SRC;
-        config->max_after_by_dst = DEFAULT_IPC_AFTER_BY_DST;
-        config->max_after_by_srcport = DEFAULT_IPC_AFTER_BY_SRC_PORT;
-        config->max_after_by_dstport = DEFAULT_IPC_AFTER_BY_DST_PORT;
-        config->max_after_by_username = DEFAULT_IPC_AFTER_BY_USERNAME;
+        config->max_tracker = DEFAULT_IPC_TRACKER;
 
         config->max_track_clients = DEFAULT_IPC_CLIENT_TRACK_IPC;
         config->pp_sagan_track_clients = TRACK_TIME;
@@ -199,6 +190,23 @@ void Load_YAML_Config( char *yaml_file )
 
         config->sagan_proto = 17;           /* Default to UDP */
         config->max_processor_threads = MAX_PROCESSOR_THREADS;
+        config->max_processor_queue = MAX_PROCESSOR_QUEUE;
+
+        config->dns_cache_size = DNS_CACHE_SIZE;
+        config->dns_threads = DNS_THREADS;
+        config->dns_ttl = DNS_TTL;
+        config->dns_negative_ttl = DNS_NEGATIVE_TTL;
+
+        config->udp_input_flag = false;
+        strlcpy(config->udp_address, UDP_ADDRESS, sizeof(config->udp_address));
+        config->udp_port = UDP_PORT;
+        config->udp_threads = UDP_THREADS;
+        config->udp_rcvbuf = 0;
+
+        config->tcp_input_flag = false;
+        strlcpy(config->tcp_address, TCP_ADDRESS, sizeof(config->tcp_address));
+        config->tcp_port = TCP_PORT;
+        config->tcp_max_clients = TCP_MAX_CLIENTS;
 
         /* PLOG defaults */
 
@@ -504,6 +512,32 @@ void Load_YAML_Config( char *yaml_file )
                         }
                     }
 
+                    else if (!strcmp(last_pass, "dns-cache-size")) {
+
+                        config->dns_cache_size = atoi(Sagan_Var_To_Value(value));
+
+                        if ( config->dns_cache_size <= 0 ) {
+                            Sagan_Log(S_ERROR, "[%s, line %d] sagan:core 'dns-cache-size' is zero/invalid. Abort!", __FILE__, __LINE__);
+                        }
+                    }
+
+                    else if (!strcmp(last_pass, "dns-threads")) {
+
+                        config->dns_threads = atoi(Sagan_Var_To_Value(value));
+
+                        if ( config->dns_threads <= 0 ) {
+                            Sagan_Log(S_ERROR, "[%s, line %d] sagan:core 'dns-threads' is zero/invalid. Abort!", __FILE__, __LINE__);
+                        }
+                    }
+
+                    else if (!strcmp(last_pass, "dns-ttl")) {
+                        config->dns_ttl = atoi(Sagan_Var_To_Value(value));
+                    }
+
+                    else if (!strcmp(last_pass, "dns-negative-ttl")) {
+                        config->dns_negative_ttl = atoi(Sagan_Var_To_Value(value));
+                    }
+
 #if defined(HAVE_GETPIPE_SZ) && defined(HAVE_SETPIPE_SZ)
 
                     else if (!strcmp(last_pass, "fifo-size")) {
@@ -535,6 +569,83 @@ void Load_YAML_Config( char *yaml_file )
 
                     }
 
+                    else if (!strcmp(last_pass, "udp-input")) {
+
+                        if (!strcasecmp(value, "yes") || !strcasecmp(value, "true") || !strcasecmp(value, "enabled") ) {
+                            config->udp_input_flag = true;
+                        }
+                    }
+
+                    else if (!strcmp(last_pass, "udp-address")) {
+                        strlcpy(config->udp_address, Sagan_Var_To_Value(value), sizeof(config->udp_address));
+                    }
+
+                    else if (!strcmp(last_pass, "udp-port")) {
+
+                        config->udp_port = atoi(Sagan_Var_To_Value(value));
+
+                        if ( config->udp_port <= 0 || config->udp_port > 65535 ) {
+                            Sagan_Log(S_ERROR, "[%s, line %d] sagan:core 'udp-port' is invalid. Abort!", __FILE__, __LINE__);
+                        }
+                    }
+
+                    else if (!strcmp(last_pass, "udp-threads")) {
+
+                        config->udp_threads = atoi(Sagan_Var_To_Value(value));
+
+                        if ( config->udp_threads <= 0 ) {
+                            Sagan_Log(S_ERROR, "[%s, line %d] sagan:core 'udp-threads' is zero/invalid. Abort!", __FILE__, __LINE__);
+                        }
+                    }
+
+                    else if (!strcmp(last_pass, "udp-rcvbuf")) {
+                        config->udp_rcvbuf = atoi(Sagan_Var_To_Value(value));
+                    }
+
+                    else if (!strcmp(last_pass, "tcp-input")) {
+
+                        if (!strcasecmp(value, "yes") || !strcasecmp(value, "true") || !strcasecmp(value, "enabled") ) {
+
+#ifndef HAVE_SYS_EPOLL_H
+                            Sagan_Log(S_ERROR, "[%s, line %d] sagan:core 'tcp-input' requires epoll() support which this system lacks. Abort!", __FILE__, __LINE__);
+#endif
+
+                            config->tcp_input_flag = true;
+                        }
+                    }
+
+                    else if (!strcmp(last_pass, "tcp-address")) {
+                        strlcpy(config->tcp_address, Sagan_Var_To_Value(value), sizeof(config->tcp_address));
+                    }
+
+                    else if (!strcmp(last_pass, "tcp-port")) {
+
+                        config->tcp_port = atoi(Sagan_Var_To_Value(value));
+
+                        if ( config->tcp_port <= 0 || config->tcp_port > 65535 ) {
+                            Sagan_Log(S_ERROR, "[%s, line %d] sagan:core 'tcp-port' is invalid. Abort!", __FILE__, __LINE__);
+                        }
+                    }
+
+                    else if (!strcmp(last_pass, "tcp-max-connections")) {
+
+                        config->tcp_max_clients = atoi(Sagan_Var_To_Value(value));
+
+                        if ( config->tcp_max_clients <= 0 ) {
+                            Sagan_Log(S_ERROR, "[%s, line %d] sagan:core 'tcp-max-connections' is zero/invalid. Abort!", __FILE__, __LINE__);
+                        }
+                    }
+
+                    else if (!strcmp(last_pass, "queue-depth")) {
+
+                        config->max_processor_queue = atoi(Sagan_Var_To_Value(value));
+
+                        if ( config->max_processor_queue <= 0 ) {
+                            Sagan_Log(S_ERROR, "[%s, line %d] sagan:core 'queue-depth' is zero/invalid. Abort!", __FILE__, __LINE__);
+                        }
+
+                    }
+
                     else if (!strcmp(last_pass, "classification")) {
 
                         Load_Classifications(Sagan_Var_To_Value(value));
@@ -588,58 +699,22 @@ void Load_YAML_Config( char *yaml_file )
                         }
                     }
 
-                    else if (!strcmp(last_pass, "threshold-by-src")) {
+                    else if (!strcmp(last_pass, "tracker")) {
 
-                        config->max_threshold_by_src = atoi(Sagan_Var_To_Value(value));
+                        config->max_tracker = atoi(Sagan_Var_To_Value(value));
 
-                        if ( config->max_threshold_by_src == 0 ) {
-                            Sagan_Log(S_ERROR, "[%s, line %d] sagan-core|mmap-ipc - 'threshold-by-src' is set to zero.  Abort!", __FILE__, __LINE__);
+                        if ( config->max_tracker == 0 ) {
+                            Sagan_Log(S_ERROR, "[%s, line %d] sagan-core|mmap-ipc - 'tracker' is set to zero.  Abort!", __FILE__, __LINE__);
                         }
                     }
 
-                    else if (!strcmp(last_pass, "threshold-by-dst")) {
+                    /* Threshold/after now share one table,  sized by "tracker" */
 
-                        config->max_threshold_by_dst = atoi(Sagan_Var_To_Value(value));
+                    else if (!strcmp(last_pass, "threshold-by-src") || !strcmp(last_pass, "threshold-by-dst") ||
+                             !strcmp(last_pass, "threshold-by-username") || !strcmp(last_pass, "after-by-src") ||
+                             !strcmp(last_pass, "after-by-dst") || !strcmp(last_pass, "after-by-username")) {
 
-                        if ( config->max_threshold_by_dst == 0 ) {
-                            Sagan_Log(S_ERROR, "[%s, line %d] sagan-core|mmap-ipc - 'threshold-by-dst' is set to zero.  Abort!", __FILE__, __LINE__);
-                        }
-                    }
-
-                    else if (!strcmp(last_pass, "threshold-by-username")) {
-
-                        config->max_threshold_by_username = atoi(Sagan_Var_To_Value(value));
-
-                        if ( config->max_threshold_by_username == 0 ) {
-                            Sagan_Log(S_ERROR, "[%s, line %d] sagan-core|mmap-ipc - 'threshold-by-username' is set to zero.  Abort!", __FILE__, __LINE__);
-                        }
-                    }
-
-                    else if (!strcmp(last_pass, "after-by-src")) {
-
-                        config->max_after_by_src = atoi(Sagan_Var_To_Value(value));
-
-                        if ( config->max_after_by_src == 0 ) {
-                            Sagan_Log(S_ERROR, "[%s, line %d] sagan-core|mmap-ipc - 'after-by-src' is set to zero.  Abort!", __FILE__, __LINE__);
-                        }
-                    }
-
-                    else if (!strcmp(last_pass, "after-by-dst")) {
-
-                        config->max_after_by_dst = atoi(Sagan_Var_To_Value(value));
-
-                        if ( config->max_after_by_dst == 0 ) {
-                            Sagan_Log(S_ERROR, "[%s, line %d] sagan-core|mmap-ipc - 'after-by-dst' is set to zero.  Abort!", __FILE__, __LINE__);
-                        }
-                    }
-
-                    else if (!strcmp(last_pass, "after-by-username")) {
-
-                        config->max_after_by_username = atoi(Sagan_Var_To_Value(value));
-
-                        if ( config->max_after_by_username == 0 ) {
-                            Sagan_Log(S_ERROR, "[%s, line %d] sagan-core|mmap-ipc - 'after-by-username' is set to zero.  Abort!", __FILE__, __LINE__);
-                        }
+                        Sagan_Log(S_WARN, "[%s, line %d] sagan-core|mmap-ipc - '%s' is no longer used.  Use 'tracker' instead.", __FILE__, __LINE__, last_pass);
                     }
 
                     else if (!strcmp(last_pass, "track-clients")) {
@@ -1813,6 +1888,8 @@ void Load_YAML_Config( char *yaml_file )
 
     free(tmp_rules_loaded);
 
+    Sagan_Prefilter_Build();
+
     reload_rules = false;
     pthread_mutex_unlock(&SaganRulesLoadedMutex);
 
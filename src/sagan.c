@@ -58,6 +58,17 @@
 #include "sagan-credits.h"
 #include "sagan-xbit.h"
 #include "sagan-processor.h"
+#include "sagan-queue.h"
+#include "sagan-clock.h"
+#include "sagan-timer.h"
+#include "sagan-framer.h"
+#include "sagan-split.h"
+#include "parsers/sagan-strstr/sagan-strstr-simd.h"
+#include "sagan-message.h"
+#include "sagan-counters.h"
+#include "sagan-dns.h"
+#include "sagan-udp.h"
+#include "sagan-tcp.h"
 #include "sagan-config.h"
 #include "sagan-yaml.h"
 #include "sagan-ignore-list.h"
@@ -100,17 +111,11 @@ struct _SaganDebug *debug;
 #include "processors/sagan-bluedot.h"
 #endif
 
-struct _Sagan_Proc_Syslog *SaganProcSyslog = NULL;
-
-int proc_msgslot = 0;
+struct _Sagan_Queue *SaganProcQueue = NULL;
 
 unsigned char dynamic_rule_flag = 0;
 sbool reload_rules = false;
 
-pthread_cond_t SaganProcDoWork=PTHREAD_COND_INITIALIZER;
-
-pthread_mutex_t SaganProcWorkMutex=PTHREAD_MUTEX_INITIALIZER;
-pthread_mutex_t SaganMalformedCounter=PTHREAD_MUTEX_INITIALIZER;
 pthread_mutex_t SaganRulesLoadedMutex=PTHREAD_MUTEX_INITIALIZER;
 
 pthread_mutex_t SaganDynamicFlag=PTHREAD_MUTEX_INITIALIZER;
@@ -172,6 +177,14 @@ int main(int argc, char **argv)
     sigfillset( &signal_set );
     pthread_sigmask( SIG_BLOCK, &signal_set, NULL );
 
+    /* Coarse clock ticker */
+
+    pthread_t clock_thread;
+
+    /* Housekeeping (timer wheel) */
+
+    pthread_t timer_thread;
+
     /* Key board handler (displays stats, etc */
 
     pthread_t key_thread;
@@ -179,42 +192,33 @@ int main(int argc, char **argv)
     pthread_attr_init(&key_thread_attr);
     pthread_attr_setdetachstate(&key_thread_attr,  PTHREAD_CREATE_DETACHED);
 
-    /* client_tracker_report_handler thread */
 
-    pthread_t ct_report_thread;
-    pthread_attr_t ct_report_thread_attr;
-    pthread_attr_init(&ct_report_thread_attr);
-    pthread_attr_setdetachstate(&ct_report_thread_attr,  PTHREAD_CREATE_DETACHED);
+#ifdef HAVE_SYS_EPOLL_H
 
+    /* TCP input thread */
+
+    pthread_t tcp_thread;
+
+#endif
 
-    struct sockaddr_in sa;
-    char src_dns_lookup[20];
 
-    sbool dns_flag = false;
     sbool fifoerr = false;
 
-    char *syslog_host=NULL;
-    char *syslog_facility=NULL;
-    char *syslog_priority=NULL;
-    char *syslog_level=NULL;
-    char *syslog_tag=NULL;
-    char *syslog_date=NULL;
-    char *syslog_time=NULL;
-    char *syslog_program=NULL;
-    char *syslog_msg=NULL;
+    char *syslogstring=NULL;
+    size_t syslogstring_len = 0;
 
-    char syslogstring[MAX_SYSLOGMSG];
+    struct _Sagan_Framer framer;
+
+    struct _Sagan_Proc_Syslog *SaganProcSyslog_MSG = NULL;
 
     signed char c;
-    char *tok;
     int rc=0;
 
     int i;
 
     int dynamic_line_count = 0;
 
-    time_t t;
-    struct tm *run;
+    uint64_t message_count = 0;
 
     sbool debugflag = false;
 
@@ -238,15 +242,6 @@ int main(int argc, char **argv)
 
     memset(config, 0, sizeof(_SaganConfig));
 
-    struct _SaganDNSCache *dnscache;
-    dnscache = malloc(sizeof(_SaganDNSCache));
-
-    if ( dnscache == NULL ) {
-        Sagan_Log(S_ERROR, "[%s, line %d] Failed to allocate memory for dnscache. Abort!", __FILE__, __LINE__);
-    }
-
-    memset(dnscache, 0, sizeof(_SaganDNSCache));
-
     counters = malloc(sizeof(_SaganCounters));
 
     if ( counters == NULL ) {
@@ -255,9 +250,8 @@ int main(int argc, char **argv)
 
     memset(counters, 0, sizeof(_SaganCounters));
 
-    t = time(NULL);
-    run=localtime(&t);
-    strftime(config->sagan_startutime, sizeof(config->sagan_startutime), "%s",  run);
+    Sagan_Clock_Init();
+    config->sagan_startutime = Sagan_Clock_Now();
 
     strlcpy(config->sagan_config, CONFIG_FILE_PATH, sizeof(config->sagan_config));
 
@@ -462,15 +456,19 @@ int main(int argc, char **argv)
 
     Load_YAML_Config(config->sagan_config);
 
-    Sagan_Engine_Init();
+    /* Enough messages to fill the work queue,  plus what the processor and
+     * input threads can hold at once.  The work queue is as deep as the
+     * pool so a push never waits */
 
-    SaganProcSyslog = malloc(config->max_processor_threads * sizeof(struct _Sagan_Proc_Syslog));
+    message_count = config->max_processor_queue + ( config->max_processor_threads * PROCESSOR_BATCH ) + 2;
 
-    if ( SaganProcSyslog == NULL ) {
-        Sagan_Log(S_ERROR, "[%s, line %d] Failed to allocate memory for SaganProcSyslog. Abort!", __FILE__, __LINE__);
+    if ( config->udp_input_flag ) {
+        message_count += config->udp_threads * UDP_BATCH;
     }
 
-    memset(SaganProcSyslog, 0, sizeof(struct _Sagan_Proc_Syslog));
+    message_count = Sagan_Message_Pool_Init(message_count);
+
+    SaganProcQueue = Sagan_Queue_Init(message_count, sizeof(struct _Sagan_Proc_Syslog *));
 
     pthread_t processor_id[config->max_processor_threads];
     pthread_attr_t thread_processor_attr;
@@ -489,6 +487,9 @@ int main(int argc, char **argv)
 
 #endif
 
+    Sagan_Log(S_NORMAL, "Using the %s field splitter.", Sagan_Split_Init());
+    Sagan_Log(S_NORMAL, "Using the %s substring search.", Sagan_Find_Init());
+
     Sagan_Log(S_NORMAL, "");
     Sagan_Log(S_NORMAL, "Sagan version %s is firing up!", VERSION);
     Sagan_Log(S_NORMAL, "");
@@ -517,9 +518,22 @@ int main(int argc, char **argv)
 #endif
 
 
+    /* Bind UDP/TCP input sockets while we still have "root" (port 514) */
+
+    if ( config->udp_input_flag ) {
+        Sagan_UDP_Init();
+    }
+
+#ifdef HAVE_SYS_EPOLL_H
+    if ( config->tcp_input_flag ) {
+        Sagan_TCP_Init();
+    }
+#endif
+
     Sagan_Droppriv();              /* Become the Sagan user */
     Sagan_Log(S_NORMAL, "---------------------------------------------------------------------------");
 
+    Sagan_Timer_Init();
     Sagan_IPC_Init();
 
     if ( config->perfmonitor_flag ) {
@@ -547,16 +561,9 @@ int main(int argc, char **argv)
 
     if ( config->sagan_track_clients_flag ) {
 
-        Sagan_Track_Clients_Init();
+        /* Clients are reported by the housekeeping thread */
 
-        /* We run a thread for client_tracker_report */
-
-        rc = pthread_create( &ct_report_thread, NULL, (void *)Sagan_Report_Clients, NULL );
-
-        if ( rc != 0 ) {
-            Remove_Lock_File();
-            Sagan_Log(S_ERROR, "[%s, line %d] Error creating client_tracker_report_client thread. [error: %d]", __FILE__, __LINE__, rc);
-        }
+        Sagan_Track_Clients_Init();
 
         if ( config->pp_sagan_track_clients ) {
             Sagan_Log(S_NORMAL, "");
@@ -722,6 +729,26 @@ int main(int argc, char **argv)
         Sagan_Log(S_ERROR, "[%s, line %d] Error creating signal handler thread. [error: %d]", __FILE__, __LINE__, rc);
     }
 
+    /* The clock ticker also has to be started after the fork(),  until it runs
+     * readers update the clock themselves */
+
+    rc = pthread_create( &clock_thread, NULL, (void *)Sagan_Clock_Ticker, NULL );
+
+    if ( rc != 0  ) {
+        Remove_Lock_File();
+        Sagan_Log(S_ERROR, "[%s, line %d] Error creating clock ticker thread. [error: %d]", __FILE__, __LINE__, rc);
+    }
+
+    /* Housekeeping thread.  Expires threshold/after,  xbit and client
+     * tracking entries */
+
+    rc = pthread_create( &timer_thread, NULL, (void *)Sagan_Timer_Handler, NULL );
+
+    if ( rc != 0  ) {
+        Remove_Lock_File();
+        Sagan_Log(S_ERROR, "[%s, line %d] Error creating housekeeping thread. [error: %d]", __FILE__, __LINE__, rc);
+    }
+
 
     /* We don't want the key_handler() if we're in daemon mode! */
 
@@ -747,6 +774,27 @@ int main(int argc, char **argv)
 
     checklockfile();
 
+    if ( config->syslog_src_lookup ) {
+
+        Sagan_Log(S_NORMAL, "Spawning %d DNS resolver Threads.", config->dns_threads);
+
+        Sagan_DNS_Init();
+
+        pthread_t dns_id[config->dns_threads];
+
+        for (i = 0; i < config->dns_threads; i++) {
+
+            rc = pthread_create ( &dns_id[i], &thread_processor_attr, (void *)Sagan_DNS_Resolver, NULL );
+
+            if ( rc != 0 ) {
+
+                Remove_Lock_File();
+                Sagan_Log(S_ERROR, "Could not pthread_create() for DNS resolver [error: %d]", rc);
+
+            }
+        }
+    }
+
     Sagan_Log(S_NORMAL, "Spawning %d Processor Threads.", config->max_processor_threads);
 
     for (i = 0; i < config->max_processor_threads; i++) {
@@ -761,6 +809,39 @@ int main(int argc, char **argv)
         }
     }
 
+#ifdef HAVE_SYS_EPOLL_H
+
+    if ( config->tcp_input_flag ) {
+
+        rc = pthread_create ( &tcp_thread, &thread_processor_attr, (void *)Sagan_TCP_Handler, NULL );
+
+        if ( rc != 0 ) {
+            Remove_Lock_File();
+            Sagan_Log(S_ERROR, "Could not pthread_create() for TCP input [error: %d]", rc);
+        }
+    }
+
+#endif
+
+    if ( config->udp_input_flag ) {
+
+        Sagan_Log(S_NORMAL, "Spawning %d UDP input Threads.", config->udp_threads);
+
+        pthread_t udp_id[config->udp_threads];
+
+        for (i = 0; i < config->udp_threads; i++) {
+
+            rc = pthread_create ( &udp_id[i], &thread_processor_attr, (void *)Sagan_UDP_Handler, (void *)(intptr_t)i );
+
+            if ( rc != 0 ) {
+
+                Remove_Lock_File();
+                Sagan_Log(S_ERROR, "Could not pthread_create() for UDP input [error: %d]", rc);
+
+            }
+        }
+    }
+
     Sagan_Log(S_NORMAL, "");
 
     if ( !config->sagan_is_file ) {
@@ -775,11 +856,13 @@ int main(int argc, char **argv)
 
 
 
+    Sagan_Framer_Init(&framer, -1, INPUT_BUFFER_SIZE);
+
     while(true) {
 
-        FILE *fd;
+        int fd;
 
-        if (( fd = fopen(config->sagan_fifo, "r" )) == NULL ) {
+        if (( fd = open(config->sagan_fifo, O_RDONLY )) == -1 ) {
 
             if ( config->sagan_is_file == false ) {
 
@@ -791,9 +874,9 @@ int main(int argc, char **argv)
                     Sagan_Log(S_ERROR, "Could not create FIFO '%s'. Abort!", config->sagan_fifo);
                 }
 
-                fd = fopen(config->sagan_fifo, "r");
+                fd = open(config->sagan_fifo, O_RDONLY);
 
-                if ( fd == NULL ) {
+                if ( fd == -1 ) {
                     Sagan_Log(S_ERROR, "Error opening %s. Abort!", config->sagan_fifo);
                 }
 
@@ -817,10 +900,12 @@ int main(int argc, char **argv)
             Sagan_Log(S_NORMAL, "Successfully opened FILE (%s) and processing events.....", config->sagan_fifo);
         }
 
-        while(fd != NULL) {
+        Sagan_Framer_Reset(&framer, fd);
+
+        while(fd != -1) {
 
 
-            while(fgets(syslogstring, sizeof(syslogstring), fd) != NULL) {
+            while(Sagan_Framer_Next(&framer, &syslogstring, &syslogstring_len) == 1) {
 
                 /* If the FIFO was in a error state,  let user know the FIFO writer has resumed */
 
@@ -836,7 +921,7 @@ int main(int argc, char **argv)
                     fifoerr = false;
                 }
 
-                counters->sagantotal++;
+                Sagan_Thread_Counters()->sagantotal++;
 
                 /* If Dynamic rules are loaded,  keep track of line count */
 
@@ -845,272 +930,60 @@ int main(int argc, char **argv)
                     dynamic_line_count++;
                 }
 
-                syslog_host = strtok_r(syslogstring, "|", &tok);
-
-                /* If we're using DNS (and we shouldn't be!),  we start DNS checks and lookups
-                 * here.  We cache both good and bad lookups to not over load our DNS server(s).
-                 * The only way DNS cache can be cleared is to restart Sagan */
-
-                if (config->syslog_src_lookup ) {
-                    if ( inet_pton(AF_INET, syslog_host, &(sa.sin_addr)) == 0 ) { 	/* Is inbound a valid IP? */
-                        dns_flag = false;
-
-                        for(i=0; i <= counters->dns_cache_count ; i++) {			/* Check cache first */
-                            if (!strcmp( dnscache[i].hostname, syslog_host)) {
-                                syslog_host = dnscache[i].src_ip;
-                                dns_flag = true;
-                            }
-                        }
-
-                        /* If entry was not found in cache,  look it up */
-
-                        if ( dns_flag == false ) {
-
-                            /* Do a DNS lookup */
-                            strlcpy(src_dns_lookup, DNS_Lookup(syslog_host), sizeof(src_dns_lookup));
-
-                            /* Invalid lookups get the config->sagan_host value */
-
-                            if (src_dns_lookup[0] == '0' ) {
-
-                                strlcpy(src_dns_lookup, config->sagan_host, sizeof(src_dns_lookup));
-                                counters->dns_miss_count++;
+                /* If every message is in flight,  Sagan_Message_Get() will hold
+                 * us here until a processor thread returns one.  We no longer
+                 * drop the event,  but we keep count of how often it happens */
 
-                            }
-
-
-                            /* Add entry to DNS Cache */
-
-                            dnscache = (_SaganDNSCache *) realloc(dnscache, (counters->dns_cache_count+1) * sizeof(_SaganDNSCache));
-
-                            if ( dnscache == NULL ) {
-
-                                Sagan_Log(S_ERROR, "[%s, line %d] Failed to reallocate memory for dnscache. Abort!", __FILE__, __LINE__);
-
-                            }
-
-                            strlcpy(dnscache[counters->dns_cache_count].hostname, syslog_host, sizeof(dnscache[counters->dns_cache_count].hostname));
-                            strlcpy(dnscache[counters->dns_cache_count].src_ip, src_dns_lookup, sizeof(dnscache[counters->dns_cache_count].src_ip));
-                            counters->dns_cache_count++;
-                            syslog_host = src_dns_lookup;
-
-                        }
-                    }
-
-                } else {
-
-                    /* We check to see if values from our FIFO are valid.  If we aren't doing DNS related
-                    * stuff (above),  we start basic check with the syslog_host */
-
-                    if (syslog_host == NULL || inet_pton(AF_INET, syslog_host, &(sa.sin_addr)) == 0  ) {
-                        syslog_host = config->sagan_host;
-
-                        pthread_mutex_lock(&SaganMalformedCounter);
-                        counters->malformed_host++;
-                        pthread_mutex_unlock(&SaganMalformedCounter);
-
-                        if ( debug->debugmalformed ) {
-                            Sagan_Log(S_WARN, "Sagan received a malformed 'host' (replaced with %s)", config->sagan_host);
-                        }
-                    }
-                }
-
-                /* We now check the rest of the values */
-
-                syslog_facility=strtok_r(NULL, "|", &tok);
-
-                if ( syslog_facility == NULL ) {
-
-                    syslog_facility = "SAGAN: FACILITY ERROR";
-
-                    pthread_mutex_lock(&SaganMalformedCounter);
-                    counters->malformed_facility++;
-                    pthread_mutex_unlock(&SaganMalformedCounter);
-
-                    if ( debug->debugmalformed ) {
-                        Sagan_Log(S_WARN, "Sagan received a malformed 'facility'");
-                    }
-                }
-
-                syslog_priority=strtok_r(NULL, "|", &tok);
-
-                if ( syslog_priority == NULL ) {
-
-                    syslog_priority = "SAGAN: PRIORITY ERROR";
-
-                    pthread_mutex_lock(&SaganMalformedCounter);
-                    counters->malformed_priority++;
-                    pthread_mutex_unlock(&SaganMalformedCounter);
-
-                    if ( debug->debugmalformed ) {
-                        Sagan_Log(S_WARN, "Sagan received a malformed 'priority'");
-                    }
-                }
-
-                syslog_level=strtok_r(NULL, "|", &tok);
-
-                if ( syslog_level == NULL ) {
-
-                    syslog_level = "SAGAN: LEVEL ERROR";
-
-                    pthread_mutex_lock(&SaganMalformedCounter);
-                    counters->malformed_level++;
-                    pthread_mutex_unlock(&SaganMalformedCounter);
-
-                    if ( debug->debugmalformed ) {
-                        Sagan_Log(S_WARN, "Sagan received a malformed 'level'");
-                    }
-                }
-
-                syslog_tag=strtok_r(NULL, "|", &tok);
-
-                if ( syslog_tag == NULL ) {
-
-                    syslog_tag = "SAGAN: TAG ERROR";
-
-                    pthread_mutex_lock(&SaganMalformedCounter);
-                    counters->malformed_tag++;
-                    pthread_mutex_unlock(&SaganMalformedCounter);
-
-                    if ( debug->debugmalformed ) {
-                        Sagan_Log(S_WARN, "Sagan received a malformed 'tag'");
-                    }
+                if ( Sagan_Message_Available() == 0 ) {
+                    Sagan_Thread_Counters()->worker_thread_exhaustion++;
                 }
 
-                syslog_date=strtok_r(NULL, "|", &tok);
-
-                if ( syslog_date == NULL ) {
-
-                    syslog_date = "SAGAN: DATE ERROR";
+                SaganProcSyslog_MSG = Sagan_Message_Get();
 
-                    pthread_mutex_lock(&SaganMalformedCounter);
-                    counters->malformed_date++;
-                    pthread_mutex_unlock(&SaganMalformedCounter);
-
-                    if ( debug->debugmalformed ) {
-                        Sagan_Log(S_WARN, "Sagan received a malformed 'date'");
-                    }
-                }
+                /* The line is split and validated by the processor threads
+                 * (Sagan_Processor_Parse()).  We only hand it over raw.  The
+                 * message itself is capped there,  so keep the header too
+                 * and leave room for a looked up host */
 
-                syslog_time=strtok_r(NULL, "|", &tok);
-
-                if ( syslog_time == NULL ) {
-
-                    syslog_time = "SAGAN: TIME ERROR";
-
-                    pthread_mutex_lock(&SaganMalformedCounter);
-                    counters->malformed_time++;
-                    pthread_mutex_unlock(&SaganMalformedCounter);
-
-                    if ( debug->debugmalformed ) {
-                        Sagan_Log(S_WARN, "Sagan received a malformed 'time'");
-                    }
+                if ( syslogstring_len > sizeof(SaganProcSyslog_MSG->buf) - MAXHOST - 1 ) {
+                    syslogstring_len = sizeof(SaganProcSyslog_MSG->buf) - MAXHOST - 1;
                 }
 
+                memcpy(SaganProcSyslog_MSG->buf, syslogstring, syslogstring_len);
+                SaganProcSyslog_MSG->buf[syslogstring_len] = '\0';
+                SaganProcSyslog_MSG->buf_len = syslogstring_len + 1;
+                SaganProcSyslog_MSG->syslog_raw = true;
 
-                syslog_program=strtok_r(NULL, "|", &tok);
+                if ( config->dynamic_load_flag == true && ( dynamic_line_count >= config->dynamic_load_sample_rate ) ) {
 
-                if ( syslog_program == NULL ) {
+                    pthread_mutex_lock(&SaganDynamicFlag);
+                    dynamic_rule_flag = DYNAMIC_RULE;
+                    pthread_mutex_unlock(&SaganDynamicFlag);
 
-                    syslog_program = "SAGAN: PROGRAM ERROR";
-
-                    pthread_mutex_lock(&SaganMalformedCounter);
-                    counters->malformed_program++;
-                    pthread_mutex_unlock(&SaganMalformedCounter);
-
-                    if ( debug->debugmalformed ) {
-                        Sagan_Log(S_WARN, "Sagan received a malformed 'program'");
-                    }
+                    dynamic_line_count = 0;
                 }
 
-                syslog_msg=strtok_r(NULL, "", &tok);		/* In case the message has | in it,  we delimit on "" */
-
-                if ( syslog_msg == NULL ) {
-
-                    syslog_msg = "SAGAN: MESSAGE ERROR";
-
-                    pthread_mutex_lock(&SaganMalformedCounter);
-                    counters->malformed_message++;
-                    pthread_mutex_unlock(&SaganMalformedCounter);
 
-                    if ( debug->debugmalformed ) {
-                        Sagan_Log(S_WARN, "Sagan received a malformed 'message' [Syslog Host: %s]", syslog_host);
-                    }
-
-                    /* If the message is lost,  all is lost.  Typically,  you don't lose part of the message,
-                     * it's more likely to lose all  - Champ Clark III 11/17/2011 */
-
-                    counters->sagan_log_drop++;
-
-                }
+                /* Thread holds here if rule load is in progress */
 
+                if ( config->dynamic_load_flag == true ) {
 
-                /* Strip any \n or \r from the syslog_msg */
+                    pthread_mutex_lock(&SaganRulesLoadedMutex);
+                    reload_rules = true;
+                    pthread_mutex_unlock(&SaganRulesLoadedMutex);
 
-                if ( strcspn ( syslog_msg, "\n" ) < strlen(syslog_msg) ) {
-                    syslog_msg[strcspn ( syslog_msg, "\n" )] = '\0';
                 }
 
-
-                if ( proc_msgslot < config->max_processor_threads ) {
-
-                    pthread_mutex_lock(&SaganProcWorkMutex);
-
-                    strlcpy(SaganProcSyslog[proc_msgslot].syslog_host, syslog_host, sizeof(SaganProcSyslog[proc_msgslot].syslog_host));
-                    strlcpy(SaganProcSyslog[proc_msgslot].syslog_facility, syslog_facility, sizeof(SaganProcSyslog[proc_msgslot].syslog_facility));
-                    strlcpy(SaganProcSyslog[proc_msgslot].syslog_priority, syslog_priority, sizeof(SaganProcSyslog[proc_msgslot].syslog_priority));
-                    strlcpy(SaganProcSyslog[proc_msgslot].syslog_level, syslog_level, sizeof(SaganProcSyslog[proc_msgslot].syslog_level));
-                    strlcpy(SaganProcSyslog[proc_msgslot].syslog_tag, syslog_tag, sizeof(SaganProcSyslog[proc_msgslot].syslog_tag));
-                    strlcpy(SaganProcSyslog[proc_msgslot].syslog_date, syslog_date, sizeof(SaganProcSyslog[proc_msgslot].syslog_date));
-                    strlcpy(SaganProcSyslog[proc_msgslot].syslog_time, syslog_time, sizeof(SaganProcSyslog[proc_msgslot].syslog_time));
-                    strlcpy(SaganProcSyslog[proc_msgslot].syslog_program, syslog_program, sizeof(SaganProcSyslog[proc_msgslot].syslog_program));
-                    strlcpy(SaganProcSyslog[proc_msgslot].syslog_message, syslog_msg, sizeof(SaganProcSyslog[proc_msgslot].syslog_message));
-
-                    if ( config->dynamic_load_flag == true && ( dynamic_line_count >= config->dynamic_load_sample_rate ) ) {
-
-                        pthread_mutex_lock(&SaganDynamicFlag);
-                        dynamic_rule_flag = DYNAMIC_RULE;
-                        pthread_mutex_unlock(&SaganDynamicFlag);
-
-                        dynamic_line_count = 0;
-                    }
-
-
-                    /* Thread holds here if rule load is in progress */
-
-                    if ( config->dynamic_load_flag == true ) {
-
-                        pthread_mutex_lock(&SaganRulesLoadedMutex);
-                        reload_rules = true;
-                        pthread_mutex_unlock(&SaganRulesLoadedMutex);
-
-                    }
-
-                    proc_msgslot++;
-
-                    pthread_cond_signal(&SaganProcDoWork);
-                    pthread_mutex_unlock(&SaganProcWorkMutex);
-                } else {
-                    counters->worker_thread_exhaustion++;
-                    counters->sagan_log_drop++;
-                }
+                Sagan_Queue_Push(SaganProcQueue, &SaganProcSyslog_MSG);
 
                 if (debug->debugthreads) {
-                    Sagan_Log(S_DEBUG, "Current \"proc_msgslot\": %d", proc_msgslot);
-                }
-
-                if (debug->debugsyslog) {
-
-                    Sagan_Log(S_DEBUG, "[%s, line %d] **[RAW Syslog]*********************************", __FILE__, __LINE__);
-                    Sagan_Log(S_DEBUG, "[%s, line %d] Host: %s | Program: %s | Facility: %s | Priority: %s | Level: %s | Tag: %s", __FILE__, __LINE__, syslog_host, syslog_program, syslog_facility, syslog_priority, syslog_level, syslog_tag);
-                    Sagan_Log(S_DEBUG, "[%s, line %d] Raw message: %s", __FILE__, __LINE__, syslog_msg);
-
+                    Sagan_Log(S_DEBUG, "Current work queue depth: %" PRIu64 "", Sagan_Queue_Count(SaganProcQueue));
                 }
 
 
-            } /* while(fgets) */
+            } /* while(Sagan_Framer_Next) */
 
-            /* fgets() has returned a error,  likely due to the FIFO writer leaving */
+            /* read() has returned EOF/error,  likely due to the FIFO writer leaving */
 
             /* DEBUG : set a kill flag and join */
             /* RMEOVE LOCK */
@@ -1121,12 +994,12 @@ int main(int argc, char **argv)
                     Sagan_Log(S_NORMAL, "EOF reached. Waiting for threads to catch up....");
                     Sagan_Log(S_NORMAL, "");
 
-                    while(proc_msgslot != 0) {
-                        Sagan_Log(S_NORMAL, "Waiting on %d threads....", proc_msgslot);
+                    while(Sagan_Queue_Count(SaganProcQueue) != 0) {
+                        Sagan_Log(S_NORMAL, "Waiting on %" PRIu64 " queued events....", Sagan_Queue_Count(SaganProcQueue));
                         sleep(1);
                     }
 
-                    fclose(fd);
+                    close(fd);
                     Sagan_Statistics();
                     Remove_Lock_File();
 
@@ -1136,14 +1009,14 @@ int main(int argc, char **argv)
                 } else {
 
                     Sagan_Log(S_WARN, "FIFO writer closed.  Waiting for FIFO writer to restart....");
-                    fifoerr = true; 			/* Set flag so our wile(fgets) knows */
+                    fifoerr = true; 			/* Set flag so our while(Sagan_Framer_Next) knows */
                 }
             }
             sleep(1);		/* So we don't eat 100% CPU */
 
         } /* while(fd != NULL)  */
 
-        fclose(fd); 			/* ???? */
+        close(fd); 			/* ???? */
 
     } /* End of while(1) */
 
@@ -67,32 +67,22 @@ char   *Get_Filename(char *);
 
 uintmax_t Sagan_Value_To_Seconds (char *, uintmax_t);
 
-typedef struct _SaganDNSCache _SaganDNSCache;
-struct _SaganDNSCache {
-
-    char hostname[64];
-    char src_ip[20];
-};
-
 typedef struct _Sagan_IPC_Counters _Sagan_IPC_Counters;
 struct _Sagan_IPC_Counters {
 
     int  xbit_count;
-    int	 thresh_count_by_src;
-    int	 thresh_count_by_dst;
-    int	 thresh_count_by_dstport;
-    int  thresh_count_by_srcport;
-    int	 thresh_count_by_username;
-    int	 after_count_by_src;
-    int	 after_count_by_dst;
-    int  after_count_by_srcport;
-    int	 after_count_by_dstport;
-    int	 after_count_by_username;
+    int	 reserved[10];		/* Old threshold/after counts,  now in sagan-tracker.shared */
 
     int	 track_client_count;
     int  track_clients_client_count;
     int  track_clients_down;
 
+    /* Sagan_IPC_Lock()s for adding xbit names and appending to the client
+     * tracking array.  Kept last so older counter files are zero filled */
+
+    uint32_t xbit_lock;
+    uint32_t track_clients_lock;
+
 };
 
 
@@ -166,6 +156,11 @@ struct _SaganCounters {
     uintmax_t follow_flow_total;			/* This will only be needed if follow_flow is an option */
     uintmax_t follow_flow_drop;	     		        /* Amount of flows that did not match and were dropped */
 
+    uintmax_t tracker_total;				/* Threshold/after lookups */
+    uintmax_t tracker_new;				/* Lookups that added an entry */
+    uintmax_t tracker_expired;				/* Entries dropped to make room */
+    uintmax_t tracker_full;				/* Lookups not tracked,  table full */
+
 #ifdef HAVE_LIBMAXMINDDB
     uintmax_t geoip2_hit;				/* GeoIP2 hit count */
     uintmax_t geoip2_lookup;				/* Total lookups */
@@ -254,15 +249,26 @@ struct _SaganDebug {
 
 typedef struct _Sagan_Proc_Syslog _Sagan_Proc_Syslog;
 struct _Sagan_Proc_Syslog {
-    char syslog_host[50];
-    char syslog_facility[50];
-    char syslog_priority[50];
-    char syslog_level[50];
-    char syslog_tag[50];
-    char syslog_date[50];
-    char syslog_time[50];
-    char syslog_program[50];
-    char syslog_message[MAX_SYSLOGMSG];
+
+    /* Views into "buf" (or static strings).  Each is NUL terminated so it
+     * can be used as a normal string.  Messages come from the pool in
+     * sagan-message.c and are passed through the work queue by pointer */
+
+    char *syslog_host;
+    char *syslog_facility;
+    char *syslog_priority;
+    char *syslog_level;
+    char *syslog_tag;
+    char *syslog_date;
+    char *syslog_time;
+    char *syslog_program;
+    char *syslog_message;
+    size_t syslog_message_len;
+
+    sbool syslog_raw;			/* Unsplit FIFO line,  see Sagan_Processor_Parse() */
+
+    size_t buf_len;
+    char buf[MAX_SYSLOGMSG + MESSAGE_HEADER_SIZE];
 
 };
 
@@ -313,108 +319,59 @@ struct _Sagan_Event {
 };
 
 
-/* Thresholding structure by source */
-typedef struct thresh_by_src_ipc thresh_by_src_ipc;
-struct thresh_by_src_ipc {
-    uint32_t ipsrc;
-    int  count;
-    uintmax_t utime;
-    char sid[20];
-    int expire;
+/* Header of an IPC hash table.  The table lives at the start of its mmap
+ * file and is followed by "capacity" fixed size entries.  Every entry
+ * starts with a _Sagan_IPC_Hash_Slot.  sagan-peek reads this layout
+ * directly,  so bump IPC_HASH_VERSION whenever it changes. */
+
+typedef struct _Sagan_IPC_Hash _Sagan_IPC_Hash;
+struct _Sagan_IPC_Hash {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entry_size;
+    uint32_t capacity;			/* Slots,  all shards */
+    uint32_t max_entries;		/* Configured limit */
+    uint32_t count;			/* Slots in use,  all shards (atomic) */
+    uint32_t shards;			/* Power of 2 */
+    uint32_t shard_capacity;		/* Slots per shard (power of 2) */
+    uint32_t slots_offset;		/* Bytes from the header to slot 0 */
+    unsigned char pad[IPC_HASH_HEADER_SIZE - ( 9 * sizeof(uint32_t) )];
 };
 
+/* Each shard is an independent table with its own lock,  so updates to
+ * unrelated keys don't contend.  One cache line each. */
 
-/* Thresholding structure by destination */
-typedef struct thresh_by_dst_ipc thresh_by_dst_ipc;
-struct thresh_by_dst_ipc {
-    uint32_t ipdst;
-    int  count;
-    uintmax_t utime;
-    char sid[20];
-    int expire;
+typedef struct _Sagan_IPC_Hash_Shard _Sagan_IPC_Hash_Shard;
+struct _Sagan_IPC_Hash_Shard {
+    uint32_t lock;			/* Sagan_IPC_Lock() */
+    uint32_t count;
+    uint32_t max_entries;
+    unsigned char pad[IPC_HASH_SHARD_SIZE - ( 3 * sizeof(uint32_t) )];
 };
 
-
-/* Thresholding structure by source port */
-typedef struct thresh_by_srcport_ipc thresh_by_srcport_ipc;
-struct thresh_by_srcport_ipc {
-    uint32_t ipsrcport;
-    int  count;
-    uintmax_t utime;
-    char sid[20];
-    int expire;
+typedef struct _Sagan_IPC_Hash_Slot _Sagan_IPC_Hash_Slot;
+struct _Sagan_IPC_Hash_Slot {
+    uint32_t used;
+    uint32_t sid;			/* Numeric rule "sid" */
+    uint64_t key;			/* Caller defined */
+    uintmax_t utime;			/* Last modified */
+    int expire;				/* Seconds after "utime" the entry can be dropped */
 };
 
-/* Thresholding structure by destination port */
-typedef struct thresh_by_dstport_ipc thresh_by_dstport_ipc;
-struct thresh_by_dstport_ipc {
-    uint32_t ipdstport;
-    int  count;
-    uintmax_t utime;
-    char sid[20];
-    int expire;
-};
-
-
-/* Thesholding structure by username */
-typedef struct thresh_by_username_ipc thresh_by_username_ipc;
-struct thresh_by_username_ipc {
-    char username[128];
-    int  count;
-    uintmax_t utime;
-    char sid[20];
-    int expire;
-};
-
-/* After structure by source */
-typedef struct after_by_src_ipc after_by_src_ipc;
-struct after_by_src_ipc {
-    uint32_t ipsrc;
-    int  count;
-    uintmax_t utime;
-    char sid[20];
-    int expire;
-};
-
-/* After structure by destination */
-typedef struct after_by_dst_ipc after_by_dst_ipc;
-struct after_by_dst_ipc {
-    uint32_t ipdst;
-    int  count;
-    uintmax_t utime;
-    char sid[20];
-    int expire;
-};
-
-/* After structure by source port */
-typedef struct after_by_srcport_ipc after_by_srcport_ipc;
-struct after_by_srcport_ipc {
-    uint32_t ipsrcport;
-    int  count;
-    uintmax_t utime;
-    char sid[20];
-    int expire;
-};
-
-/* After structure by destination port */
-typedef struct after_by_dstport_ipc after_by_dstport_ipc;
-struct after_by_dstport_ipc {
-    uint32_t ipdstport;
-    int  count;
-    uintmax_t utime;
-    char sid[20];
-    int expire;
-};
+/* Threshold/after entry (see sagan-tracker.c).  The slot "key" is a hash
+ * of the kind,  method and key bytes.  Keys whose hashes collide share a
+ * slot "key" and are told apart by the bytes kept here. */
 
+#define TRACKER_KEY_SIZE	64
 
-/* After structure by username */
-typedef struct after_by_username_ipc after_by_username_ipc;
-struct after_by_username_ipc {
-    char username[128];
-    int  count;
-    uintmax_t utime;
-    char sid[20];
-    int expire;
+typedef struct _Sagan_IPC_Tracker _Sagan_IPC_Tracker;
+struct _Sagan_IPC_Tracker {
+    _Sagan_IPC_Hash_Slot slot;
+    int count;
+    uint8_t kind;			/* TRACK_THRESHOLD or TRACK_AFTER */
+    uint8_t method;			/* TRACK_BY_SRC,  TRACK_BY_USERNAME,  etc */
+    uint16_t key_len;			/* All of it,  only TRACKER_KEY_SIZE bytes are kept */
+    unsigned char key[TRACKER_KEY_SIZE];
 };
 
 typedef struct _SaganVar _SaganVar;
@@ -483,6 +440,6 @@ int PageSupportsRWX(void);
 #endif
 
 #if defined(F_GETPIPE_SZ) && defined(F_SETPIPE_SZ)
-void Sagan_Set_Pipe_Size( FILE * );
+void Sagan_Set_Pipe_Size( int );
 #endif
 
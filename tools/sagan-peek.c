@@ -26,9 +26,6 @@
  *
  */
 
-/* DEBUG: need to add dstport, srcport for threshold/after */
-
-
 #include <stdio.h>
 #include <sys/mman.h>
 #include <fcntl.h>
@@ -45,6 +42,7 @@
 #include "../src/sagan.h"
 #include "../src/sagan-defs.h"
 #include "../src/sagan-xbit.h"
+#include "../src/sagan-tracker.h"
 
 #include "../src/processors/sagan-track-clients.h"
 
@@ -102,118 +100,61 @@ char *u32_time_to_human( uint64_t utime )
 }
 
 /****************************************************************************
- * main - Pull data from shared memory and display it!
+ * tracker_value - Printable form of a tracker entry's key
  ****************************************************************************/
 
-int main(int argc, char **argv)
+void tracker_value( _Sagan_IPC_Tracker *entry, char *str, size_t size )
 {
 
-    struct _Sagan_IPC_Counters *counters_ipc;
-
-    struct _Sagan_IPC_Xbit *xbit_ipc;
-    struct _Sagan_Track_Clients_IPC *SaganTrackClients_ipc;
-
-    struct thresh_by_src_ipc *threshbysrc_ipc;
-    struct thresh_by_dst_ipc *threshbydst_ipc;
-    struct thresh_by_username_ipc *threshbyusername_ipc;
-
-    struct after_by_src_ipc *afterbysrc_ipc;
-    struct after_by_dst_ipc *afterbydst_ipc;
-    struct after_by_username_ipc *afterbyusername_ipc;
-
-    /* For convert 32 bit IP to octet */
-
-    struct in_addr ip_addr_src;
-    struct in_addr ip_addr_dst;
-
-    /* Shared memory descriptors */
-
-    int shm_counters;
-    int shm;
-
-    int i;
-    int file_check;
-
-    char tmp_object_check[255];
-    char tmp[64];
-
-    char *ipc_directory = IPC_DIRECTORY;
-
-    /* So users can point at the proper IPC location */
-
-    if ( argc == 2 ) {
-        ipc_directory = argv[1];
-    }
-
-    /* Load the "counters" first.  The "counters" keep track of the number of elements on the
-     * other arrays */
-
-    snprintf(tmp_object_check, sizeof(tmp_object_check) - 1, "%s/%s", ipc_directory, COUNTERS_IPC_FILE);
-
-    if ( object_check(tmp_object_check) == false ) {
-        fprintf(stderr, "Error.  Can't locate %s. Abort!\n", tmp_object_check);
-        usage();
-        exit(1);
-    }
-
-    if ( ( shm_counters = open(tmp_object_check, O_RDONLY ) ) == -1 )
-
-    {
-        fprintf(stderr, "[%s, line %d] Cannot open() for counters (%s)\n", __FILE__, __LINE__, strerror(errno));
-        exit(1);
-    }
-
-    if (( counters_ipc = mmap(0, sizeof(_Sagan_IPC_Counters) , PROT_READ, MAP_SHARED, shm_counters, 0)) == MAP_FAILED )
+    struct in_addr ip_addr;
+    uint32_t u32;
 
-    {
-        fprintf(stderr, "[%s, line %d] Error allocating memory for counters object! [%s]\n", __FILE__, __LINE__, strerror(errno));
-        exit(1);
-    }
+    int len = entry->key_len < TRACKER_KEY_SIZE ? entry->key_len : TRACKER_KEY_SIZE;
 
-    close(shm_counters);
+    memcpy(&u32, entry->key, sizeof(u32));
 
-    /*** Get "threshold by source" data ****/
+    if ( entry->method == TRACK_BY_SRC || entry->method == TRACK_BY_DST ) {
 
-    snprintf(tmp_object_check, sizeof(tmp_object_check) - 1, "%s/%s", ipc_directory, THRESH_BY_SRC_IPC_FILE);
+        ip_addr.s_addr = htonl(u32);
 
-    if ( object_check(tmp_object_check) == false ) {
-        fprintf(stderr, "Error.  Can't locate %s. Abort!\n", tmp_object_check);
-        usage();
-        exit(1);
+        if ( inet_ntop(AF_INET, &ip_addr, str, size) == NULL ) {
+            str[0] = '\0';
+        }
     }
 
-    if ( (shm = open(tmp_object_check, O_RDONLY ) ) == -1 ) {
-        fprintf(stderr, "[%s, line %d] Cannot open() for thresh_by_src (%s)\n", __FILE__, __LINE__, strerror(errno));
-        exit(1);
+    else if ( entry->method == TRACK_BY_SRCPORT || entry->method == TRACK_BY_DSTPORT ) {
+        snprintf(str, size, "%" PRIu32, u32);
     }
 
-    if (( threshbysrc_ipc = mmap(0, sizeof(thresh_by_src_ipc) + (sizeof(thresh_by_src_ipc) * counters_ipc->thresh_count_by_src), PROT_READ, MAP_SHARED, shm, 0)) == MAP_FAILED ) {
-        fprintf(stderr, "[%s, line %d] Error allocating memory for thresh_by_src object! [%s]\n", __FILE__, __LINE__, strerror(errno));
-        exit(1);
+    else {
+        snprintf(str, size, "%.*s", len, entry->key);
     }
 
-    close(shm);
-
-    if ( counters_ipc->thresh_count_by_src >= 1 ) {
+}
 
+/****************************************************************************
+ * peek_tracker - Display the threshold/after tracker.  It is an open
+ * addressing hash table (see _Sagan_IPC_Hash),  so walk every slot and
+ * print the ones in use.
+ ****************************************************************************/
 
-        printf("\n***  Threshold by source (%d) ***\n", counters_ipc->thresh_count_by_src);
-        printf("---------------------------------------------------------------------------------\n");
-        printf("%-16s| %-15s| %-21s| %-11s| %s\n", "SRC IP", "Counter","Date added/modified", "SID", "Expire" );
-        printf("---------------------------------------------------------------------------------\n");
+void peek_tracker( char *ipc_directory )
+{
 
-        for ( i = 0; i < counters_ipc->thresh_count_by_src; i++) {
+    static const char *methods[TRACK_METHODS] = TRACK_METHOD_NAMES;
 
-            ip_addr_src.s_addr = htonl(threshbysrc_ipc[i].ipsrc);
+    struct stat shm_stat;
 
-            printf("%-16s| %-15d| %-21s| %-11s| %d\n", inet_ntoa(ip_addr_src), threshbysrc_ipc[i].count, u32_time_to_human(threshbysrc_ipc[i].utime), threshbysrc_ipc[i].sid, threshbysrc_ipc[i].expire);
+    _Sagan_IPC_Hash *hash;
+    _Sagan_IPC_Tracker *entry;
 
-        }
-    }
+    char tmp_object_check[255];
+    char value[TRACKER_KEY_SIZE + 1];
 
-    /*** Get "threshold by destination" data ***/
+    int shm;
+    uint32_t i;
 
-    snprintf(tmp_object_check, sizeof(tmp_object_check) - 1, "%s/%s", ipc_directory, THRESH_BY_DST_IPC_FILE);
+    snprintf(tmp_object_check, sizeof(tmp_object_check) - 1, "%s/%s", ipc_directory, TRACKER_IPC_FILE);
 
     if ( object_check(tmp_object_check) == false ) {
         fprintf(stderr, "Error.  Can't locate %s. Abort!\n", tmp_object_check);
@@ -226,70 +167,78 @@ int main(int argc, char **argv)
         exit(1);
     }
 
-    if (( threshbydst_ipc = mmap(0, sizeof(thresh_by_dst_ipc) + (sizeof(thresh_by_dst_ipc) * counters_ipc->thresh_count_by_dst) , PROT_READ, MAP_SHARED, shm, 0)) == MAP_FAILED ) {
+    if ( fstat(shm, &shm_stat) == -1 || shm_stat.st_size < IPC_HASH_HEADER_SIZE ) {
+        fprintf(stderr, "[%s, line %d] %s is too small to be a Sagan table.\n", __FILE__, __LINE__, tmp_object_check);
+        exit(1);
+    }
+
+    if (( hash = mmap(0, shm_stat.st_size, PROT_READ, MAP_SHARED, shm, 0)) == MAP_FAILED ) {
         fprintf(stderr, "[%s, line %d] Error allocating memory object! [%s]\n", __FILE__, __LINE__, strerror(errno));
         exit(1);
     }
 
     close(shm);
 
+    if ( hash->magic != IPC_HASH_MAGIC || hash->version != IPC_HASH_VERSION ||
+            hash->entry_size != sizeof(_Sagan_IPC_Tracker) ||
+            (uint64_t)hash->slots_offset + ( (uint64_t)hash->capacity * hash->entry_size ) > (uint64_t)shm_stat.st_size ) {
+        fprintf(stderr, "Warning: %s is from a different version of Sagan. Skipping.\n", tmp_object_check);
+        munmap(hash, shm_stat.st_size);
+        return;
+    }
 
-    if ( counters_ipc->thresh_count_by_dst >= 1 ) {
-
+    if ( hash->count >= 1 ) {
 
-        printf("\n***  Threshold by destination (%d)***\n", counters_ipc->thresh_count_by_dst );
-        printf("---------------------------------------------------------------------------------\n");
-        printf("%-16s| %-15s| %-21s| %-11s| %s\n", "DST IP", "Counter","Date added/modified", "SID", "Expire" );
-        printf("---------------------------------------------------------------------------------\n");
+        printf("\n***  Threshold/After (%u) ***\n", hash->count);
+        printf("------------------------------------------------------------------------------------------------------------------------\n");
+        printf("%-10s| %-17s| %-26s| %-11s| %-21s| %-11s| %s\n", "Kind", "Method", "Key", "Counter", "Date added/modified", "SID", "Expire" );
+        printf("------------------------------------------------------------------------------------------------------------------------\n");
 
-        for ( i = 0; i < counters_ipc->thresh_count_by_dst; i++) {
-            ip_addr_dst.s_addr = htonl(threshbydst_ipc[i].ipdst);
+        for ( i = 0; i < hash->capacity; i++ ) {
 
-            printf("%-16s| %-15d| %-21s| %-11s| %d\n", inet_ntoa(ip_addr_dst), threshbydst_ipc[i].count, u32_time_to_human(threshbydst_ipc[i].utime), threshbydst_ipc[i].sid, threshbydst_ipc[i].expire);
-        }
+            entry = (_Sagan_IPC_Tracker *)((unsigned char *)hash + hash->slots_offset + ((size_t)i * hash->entry_size));
 
-    }
-
-    /*** Get "threshold by username" data ***/
+            if ( entry->slot.used == false || entry->method >= TRACK_METHODS ) {
+                continue;
+            }
 
-    snprintf(tmp_object_check, sizeof(tmp_object_check) - 1, "%s/%s", ipc_directory, THRESH_BY_USERNAME_IPC_FILE);
+            tracker_value(entry, value, sizeof(value));
 
-    if ( object_check(tmp_object_check) == false ) {
-        fprintf(stderr, "Error.  Can't locate %s. Abort!\n", tmp_object_check);
-        usage();
-        exit(1);
+            printf("%-10s| %-17s| %-26s| %-11d| %-21s| %-11u| %d\n", entry->kind == TRACK_AFTER ? "After" : "Threshold", methods[entry->method], value, entry->count, u32_time_to_human(entry->slot.utime), entry->slot.sid, entry->slot.expire);
+        }
     }
 
-    if ((shm = open(tmp_object_check, O_RDONLY ) ) == -1 ) {
-        fprintf(stderr, "[%s, line %d] Cannot open() (%s)\n", __FILE__, __LINE__, strerror(errno));
-        exit(1);
-    }
+    munmap(hash, shm_stat.st_size);
 
-    if (( threshbyusername_ipc = mmap(0, sizeof(thresh_by_username_ipc) + (sizeof(thresh_by_username_ipc) *  counters_ipc->thresh_count_by_username ), PROT_READ, MAP_SHARED, shm, 0)) == MAP_FAILED ) {
-        fprintf(stderr, "[%s, line %d] Error allocating memory object! [%s]\n", __FILE__, __LINE__, strerror(errno));
-        exit(1);
-    }
+}
 
-    close(shm);
+/****************************************************************************
+ * peek_xbit - Display the xbits.  The xbit file is the shared name table
+ * followed by an _Sagan_IPC_Hash of xbits and their roll ups;  only the
+ * xbits themselves are printed.
+ ****************************************************************************/
 
+void peek_xbit( char *ipc_directory )
+{
 
-    if ( counters_ipc->thresh_count_by_username >= 1 ) {
+    struct stat shm_stat;
 
+    _Sagan_IPC_Xbit_Names *names;
+    _Sagan_IPC_Hash *hash;
+    _Sagan_IPC_Xbit *entry;
 
-        printf("\n***  Threshold by username (%d) ***\n", counters_ipc->thresh_count_by_username);
-        printf("---------------------------------------------------------------------------------\n");
-        printf("%-16s| %-15s| %-21s| %-11s| %s\n", "Username", "Counter","Date added/modified", "SID", "Expire" );
-        printf("---------------------------------------------------------------------------------\n");
+    /* For convert 32 bit IP to octet */
 
+    struct in_addr ip_addr_src;
+    struct in_addr ip_addr_dst;
 
-        for ( i = 0; i < counters_ipc->thresh_count_by_username; i++) {
-            printf("%-16s| %-15d| %-21s| %-11s| %d\n", inet_ntoa(ip_addr_src), threshbyusername_ipc[i].count, u32_time_to_human(threshbyusername_ipc[i].utime), threshbyusername_ipc[i].sid, threshbyusername_ipc[i].expire);
-        }
-    }
+    char tmp_object_check[255];
 
-    /*** Get "after by source" data ***/
+    int shm;
+    uint32_t i;
+    uint32_t id;
 
-    snprintf(tmp_object_check, sizeof(tmp_object_check) - 1, "%s/%s", ipc_directory, AFTER_BY_SRC_IPC_FILE);
+    snprintf(tmp_object_check, sizeof(tmp_object_check) - 1, "%s/%s", ipc_directory, XBIT_IPC_FILE);
 
     if ( object_check(tmp_object_check) == false ) {
         fprintf(stderr, "Error.  Can't locate %s. Abort!\n", tmp_object_check);
@@ -302,103 +251,98 @@ int main(int argc, char **argv)
         exit(1);
     }
 
-    if (( afterbysrc_ipc = mmap(0, sizeof(after_by_src_ipc) + (sizeof(after_by_src_ipc) * counters_ipc->after_count_by_src ),  PROT_READ, MAP_SHARED, shm, 0)) == MAP_FAILED ) {
+    if ( fstat(shm, &shm_stat) == -1 || shm_stat.st_size < (off_t)( sizeof(_Sagan_IPC_Xbit_Names) + IPC_HASH_HEADER_SIZE ) ) {
+        fprintf(stderr, "[%s, line %d] %s is too small to be a Sagan table.\n", __FILE__, __LINE__, tmp_object_check);
+        exit(1);
+    }
+
+    if (( names = mmap(0, shm_stat.st_size, PROT_READ, MAP_SHARED, shm, 0)) == MAP_FAILED ) {
         fprintf(stderr, "[%s, line %d] Error allocating memory object! [%s]\n", __FILE__, __LINE__, strerror(errno));
         exit(1);
     }
 
     close(shm);
 
-    if ( counters_ipc->after_count_by_src >= 1 ) {
-
-        printf("\n***  After by source (%d) ***\n", counters_ipc->after_count_by_src);
-        printf("---------------------------------------------------------------------------------\n");
-        printf("%-16s| %-15s| %-21s| %-11s| %s\n", "SRC IP", "Counter","Date added/modified", "SID", "Expire" );
-        printf("---------------------------------------------------------------------------------\n");
+    hash = (_Sagan_IPC_Hash *)((unsigned char *)names + sizeof(_Sagan_IPC_Xbit_Names));
 
-        for ( i = 0; i < counters_ipc->after_count_by_src; i++) {
-            ip_addr_src.s_addr = htonl(afterbysrc_ipc[i].ipsrc);
-            printf("%-16s| %-15d| %-21s| %-11s| %d\n", inet_ntoa(ip_addr_src), afterbysrc_ipc[i].count, u32_time_to_human(afterbysrc_ipc[i].utime), afterbysrc_ipc[i].sid, afterbysrc_ipc[i].expire);
-        }
+    if ( hash->magic != IPC_HASH_MAGIC || hash->version != IPC_HASH_VERSION ||
+            hash->entry_size != sizeof(_Sagan_IPC_Xbit) || names->count > XBIT_NAMES_MAX ||
+            sizeof(_Sagan_IPC_Xbit_Names) + (uint64_t)hash->slots_offset + ( (uint64_t)hash->capacity * hash->entry_size ) > (uint64_t)shm_stat.st_size ) {
+        fprintf(stderr, "Warning: %s is from a different version of Sagan. Skipping.\n", tmp_object_check);
+        munmap(names, shm_stat.st_size);
+        return;
     }
 
+    if ( hash->count >= 1 ) {
 
-    /*** Get "After by destination" data ***/
+        printf("\n*** Xbits ****\n");
+        printf("-----------------------------------------------------------------------------------------------------------------------------\n");
+        printf("%-25s| %-16s| %-16s| %-21s| %s\n", "Xbit name", "SRC IP", "DST IP", "Date added/modified", "Expire");
+        printf("-----------------------------------------------------------------------------------------------------------------------------\n");
 
-    snprintf(tmp_object_check, sizeof(tmp_object_check) - 1, "%s/%s", ipc_directory, AFTER_BY_DST_IPC_FILE);
+        for ( i = 0; i < hash->capacity; i++ ) {
 
-    if ( object_check(tmp_object_check) == false ) {
-        fprintf(stderr, "Error.  Can't locate %s. Abort!\n", tmp_object_check);
-        usage();
-        exit(1);
-    }
+            entry = (_Sagan_IPC_Xbit *)((unsigned char *)hash + hash->slots_offset + ((size_t)i * hash->entry_size));
 
-    if ((shm = open(tmp_object_check, O_RDONLY ) ) == -1 ) {
-        fprintf(stderr, "[%s, line %d] Cannot open() (%s)\n", __FILE__, __LINE__, strerror(errno));
-        exit(1);
-    }
+            if ( entry->slot.used == false || XBIT_SID_KIND(entry->slot.sid) != XBIT_EXACT ) {
+                continue;
+            }
 
-    if (( afterbydst_ipc = mmap(0, sizeof(after_by_dst_ipc) + (sizeof(after_by_dst_ipc) * counters_ipc->after_count_by_dst ) , PROT_READ, MAP_SHARED, shm, 0)) == MAP_FAILED ) {
-        fprintf(stderr, "[%s, line %d] Error allocating memory object! [%s]\n", __FILE__, __LINE__, strerror(errno));
-        exit(1);
-    }
+            id = XBIT_SID_ID(entry->slot.sid);
 
-    close(shm);
+            ip_addr_src.s_addr = htonl(entry->ip_src);
+            ip_addr_dst.s_addr = htonl(entry->ip_dst);
 
-    if ( counters_ipc->after_count_by_dst >= 1 ) {
+            printf("%-25.*s| ", XBIT_NAME_SIZE, id >= 1 && id <= names->count ? names->name[id - 1] : "(unknown)");
+            printf("%-16s| ", inet_ntoa(ip_addr_src));
+            printf("%-16s| ", inet_ntoa(ip_addr_dst));
+            printf("%-21s| ", u32_time_to_human(entry->slot.utime));
+            printf("%d (%s)\n", entry->slot.expire, u32_time_to_human(entry->xbit_expire));
+        }
+    }
 
-        printf("\n***  After by destination (%d)***\n", counters_ipc->after_count_by_dst);
-        printf("---------------------------------------------------------------------------------\n");
-        printf("%-16s| %-15s| %-21s| %-11s| %s\n", "DST IP", "Counter","Date added/modified", "SID", "Expire" );
-        printf("---------------------------------------------------------------------------------\n");
+    munmap(names, shm_stat.st_size);
 
-        for ( i = 0; i < counters_ipc->after_count_by_dst; i++) {
-            ip_addr_dst.s_addr = htonl(afterbydst_ipc[i].ipdst);
+}
 
-            printf("%-16s| %-15d| %-21s| %-11s| %d\n", inet_ntoa(ip_addr_dst), afterbydst_ipc[i].count, u32_time_to_human(afterbydst_ipc[i].utime), afterbydst_ipc[i].sid, afterbydst_ipc[i].expire);
-        }
-    }
+/****************************************************************************
+ * main - Pull data from shared memory and display it!
+ ****************************************************************************/
 
-    /*** Get "after by username" data ***/
+int main(int argc, char **argv)
+{
 
-    snprintf(tmp_object_check, sizeof(tmp_object_check) - 1, "%s/%s", ipc_directory, AFTER_BY_USERNAME_IPC_FILE);
+    struct _Sagan_IPC_Counters *counters_ipc;
 
-    if ( object_check(tmp_object_check) == false ) {
-        fprintf(stderr, "Error.  Can't locate %s. Abort!\n", tmp_object_check);
-        usage();
-        exit(1);
-    }
+    struct _Sagan_Track_Clients_IPC *SaganTrackClients_ipc;
 
-    if ((shm = open(tmp_object_check, O_RDONLY ) ) == -1 ) {
-        fprintf(stderr, "[%s, line %d] Cannot open() (%s)\n", __FILE__, __LINE__, strerror(errno));
-        exit(1);
-    }
+    /* For convert 32 bit IP to octet */
 
-    if (( afterbyusername_ipc = mmap(0, sizeof(after_by_username_ipc) + (sizeof(after_by_username_ipc) * counters_ipc->after_count_by_username ) , PROT_READ, MAP_SHARED, shm, 0)) == MAP_FAILED ) {
-        fprintf(stderr, "[%s, line %d] Error allocating memory object! [%s]\n", __FILE__, __LINE__, strerror(errno));
-        exit(1);
-    }
+    struct in_addr ip_addr_src;
 
-    close(shm);
+    /* Shared memory descriptors */
 
+    int shm_counters;
+    int shm;
 
-    if ( counters_ipc->after_count_by_username >= 1 ) {
+    int i;
+    int file_check;
 
-        printf("\n***  After by username ***(%d)\n", counters_ipc->after_count_by_username);
-        printf("---------------------------------------------------------------------------------\n");
-        printf("%-16s| %-15s| %-21s| %-11s| %s\n", "Username", "Counter","Date added/modified", "SID", "Expire" );
-        printf("---------------------------------------------------------------------------------\n");
+    char tmp_object_check[255];
+    char tmp[64];
 
+    char *ipc_directory = IPC_DIRECTORY;
 
+    /* So users can point at the proper IPC location */
 
-        for ( i = 0; i < counters_ipc->after_count_by_username; i++) {
-            printf("%-16s| %-15d| %-21s| %-11s| %d\n", afterbyusername_ipc[i].username, afterbyusername_ipc[i].count, u32_time_to_human(afterbyusername_ipc[i].utime), afterbyusername_ipc[i].sid, afterbyusername_ipc[i].expire);
-        }
+    if ( argc == 2 ) {
+        ipc_directory = argv[1];
     }
 
-    /*** Get "xbit" data ***/
+    /* Load the "counters" first.  The "counters" keep track of the number of elements on the
+     * other arrays */
 
-    snprintf(tmp_object_check, sizeof(tmp_object_check) - 1, "%s/%s", ipc_directory, XBIT_IPC_FILE);
+    snprintf(tmp_object_check, sizeof(tmp_object_check) - 1, "%s/%s", ipc_directory, COUNTERS_IPC_FILE);
 
     if ( object_check(tmp_object_check) == false ) {
         fprintf(stderr, "Error.  Can't locate %s. Abort!\n", tmp_object_check);
@@ -406,45 +350,29 @@ int main(int argc, char **argv)
         exit(1);
     }
 
-    if ((shm = open(tmp_object_check, O_RDONLY ) ) == -1 ) {
-        fprintf(stderr, "[%s, line %d] Cannot open() (%s)\n", __FILE__, __LINE__, strerror(errno));
-        exit(1);
-    }
+    if ( ( shm_counters = open(tmp_object_check, O_RDONLY ) ) == -1 )
 
-    if (( xbit_ipc = mmap(0, sizeof(_Sagan_IPC_Xbit) + (sizeof(_Sagan_IPC_Xbit) * counters_ipc->xbit_count ) , PROT_READ, MAP_SHARED, shm, 0)) == MAP_FAILED ) {
-        fprintf(stderr, "[%s, line %d] Error allocating memory object! [%s]\n", __FILE__, __LINE__, strerror(errno));
+    {
+        fprintf(stderr, "[%s, line %d] Cannot open() for counters (%s)\n", __FILE__, __LINE__, strerror(errno));
         exit(1);
     }
 
-    close(shm);
-
-
-    if ( counters_ipc->xbit_count >= 1 ) {
-
-        printf("\n*** Xbits (%d) ****\n", counters_ipc->xbit_count);
-        printf("-----------------------------------------------------------------------------------------------------------------------------\n");
-        printf("%-9s| %-25s| %-16s| %-16s| %-21s| %s\n", "S", "Xbit name", "SRC IP", "DST IP", "Date added/modified", "Expire");
-        printf("-----------------------------------------------------------------------------------------------------------------------------\n");
+    if (( counters_ipc = mmap(0, sizeof(_Sagan_IPC_Counters) , PROT_READ, MAP_SHARED, shm_counters, 0)) == MAP_FAILED )
 
-        for ( i = 0; i < counters_ipc->xbit_count; i++) {
+    {
+        fprintf(stderr, "[%s, line %d] Error allocating memory for counters object! [%s]\n", __FILE__, __LINE__, strerror(errno));
+        exit(1);
+    }
 
-            ip_addr_src.s_addr = htonl(xbit_ipc[i].ip_src);
-            ip_addr_dst.s_addr = htonl(xbit_ipc[i].ip_dst);
+    close(shm_counters);
 
-            if ( xbit_ipc[i].xbit_state == 1 ) {
+    /*** Threshold and after ***/
 
-                printf("ACTIVE   | %-25s| ", xbit_ipc[i].xbit_name);
-            } else {
-                printf("INACTIVE | %-25s| ", xbit_ipc[i].xbit_name);
-            }
+    peek_tracker(ipc_directory);
 
-            printf("%-16s| ", inet_ntoa(ip_addr_src));
-            printf("%-16s| ", inet_ntoa(ip_addr_dst));
-            printf("%-21s| ", u32_time_to_human(xbit_ipc[i].xbit_date));
-            printf("%d (%s)\n", xbit_ipc[i].expire, u32_time_to_human(xbit_ipc[i].xbit_date + xbit_ipc[i].expire));
+    /*** Xbits ***/
 
-        }
-    }
+    peek_xbit(ipc_directory);
 
     /**** Get "Tracking" data (if enabled) ****/
 
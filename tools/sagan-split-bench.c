@@ -0,0 +1,281 @@
+/*
+** Copyright (C) 2009-2017 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2017 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* sagan-split-bench.c
+ *
+ * Microbenchmark for the "|" field splitter (src/sagan-split.c).  Times
+ * the old strtok_r() split against every splitter the CPU can run
+ * over a corpus of FIFO lines.  The corpus is either a file of lines in
+ * the rsyslog "sagan" template format or,  by default,  a generated one.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <time.h>
+
+#include "../src/sagan-split.h"
+
+#define BENCH_LINES		100000
+#define BENCH_ROUNDS		20
+#define BENCH_LINE_SIZE		10240
+
+/****************************************************************************
+ * usage - Give the user some hints about how to use this utility!
+ ****************************************************************************/
+
+void usage( void )
+{
+
+    fprintf(stderr, "\nsagan-split-bench [corpus file]\n");
+
+}
+
+/****************************************************************************
+ * now - Monotonic time in nanoseconds
+ ****************************************************************************/
+
+uint64_t now( void )
+{
+
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return( (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec );
+
+}
+
+/****************************************************************************
+ * generate - Builds a corpus that looks like what rsyslog hands Sagan.
+ * Message lengths vary and some messages contain "|".
+ ****************************************************************************/
+
+int generate( char **lines, size_t *lens, int count )
+{
+
+    static const char *programs[] = { "sshd", "kernel", "postfix/smtpd", "CRON", "sudo", "named", "httpd" };
+    static const char *messages[] = {
+        "Accepted publickey for root from 10.1.2.3 port 51122 ssh2: RSA SHA256:Yp2r0k1lE0zZ8nJ9tQWQ5c3xY8bQ2d1sT0c6a7u9v0w",
+        "Failed password for invalid user admin from 192.168.100.4 port 40112 ssh2",
+        "[UFW BLOCK] IN=eth0 OUT= MAC=00:16:3e:5e:6c:00:00:16:3e:11:22:33:08:00 SRC=203.0.113.9 DST=198.51.100.7 LEN=60 TOS=0x00 PREC=0x00 TTL=52 ID=40422 DF PROTO=TCP SPT=44522 DPT=23 WINDOW=29200 RES=0x00 SYN URGP=0",
+        "connect from unknown[198.51.100.23]",
+        "(root) CMD (run-parts /etc/cron.hourly)",
+        "pam_unix(sudo:session): session opened for user root by champ(uid=0)",
+        "client 10.0.0.5#53211 (example.com): query (cache) 'example.com/A/IN' denied",
+        "GET /index.php?a=1|b=2|c=3 HTTP/1.1 200 5120 \"-\" \"Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/58.0 Safari/537.36\""
+    };
+
+    char buf[BENCH_LINE_SIZE];
+    int i;
+    int n;
+
+    for ( i = 0; i < count; i++ ) {
+
+        n = snprintf(buf, sizeof(buf), "10.%d.%d.%d|auth|info|info|%02x|2017-06-%02d|%02d:%02d:%02d|%s|%s",
+                     i & 0xff, (i >> 8) & 0xff, (i >> 16) & 0xff, i % 200,
+                     1 + i % 28, i % 24, i % 60, (i * 7) % 60,
+                     programs[i % 7], messages[(i * 13) % 8]);
+
+        lens[i] = n;
+        lines[i] = strdup(buf);
+
+    }
+
+    return(count);
+}
+
+/****************************************************************************
+ * load - Reads a corpus file,  one FIFO line per line
+ ****************************************************************************/
+
+int load( const char *file, char **lines, size_t *lens, int count )
+{
+
+    FILE *fd;
+    char buf[BENCH_LINE_SIZE];
+    int i = 0;
+
+    if (( fd = fopen(file, "r")) == NULL ) {
+        fprintf(stderr, "Cannot open %s\n", file);
+        exit(1);
+    }
+
+    while ( i < count && fgets(buf, sizeof(buf), fd) != NULL ) {
+
+        buf[strcspn(buf, "\n")] = '\0';
+        lens[i] = strlen(buf);
+        lines[i] = strdup(buf);
+        i++;
+
+    }
+
+    fclose(fd);
+    return(i);
+}
+
+/****************************************************************************
+ * split_strtok - The split sagan.c used to do before handing a line off
+ ****************************************************************************/
+
+uint64_t split_strtok( char *buf, const char *line, size_t len )
+{
+
+    char *tok = NULL;
+    char *field;
+    uint64_t sum = 0;
+    int i;
+
+    memcpy(buf, line, len + 1);
+
+    field = strtok_r(buf, "|", &tok);
+
+    for ( i = 1; field != NULL && i < SPLIT_FIELDS; i++ ) {
+        sum += field - buf;
+        field = strtok_r(NULL, i == SPLIT_FIELDS - 1 ? "" : "|", &tok);
+    }
+
+    if ( field != NULL ) {
+        sum += field - buf;
+    }
+
+    return(sum);
+}
+
+/****************************************************************************
+ * split_view - Same work through one of the Sagan_Split_Fields versions.
+ * The line is copied and the fields terminated so the comparison with
+ * strtok_r() is fair.
+ ****************************************************************************/
+
+uint64_t split_view( int (*fn)( const char *, size_t, _Sagan_Split * ), char *buf, const char *line, size_t len )
+{
+
+    _Sagan_Split split;
+    uint64_t sum = 0;
+    int count;
+    int i;
+
+    memcpy(buf, line, len + 1);
+
+    count = fn(buf, len, &split);
+
+    for ( i = 0; i < count; i++ ) {
+        buf[split.offset[i] + split.len[i]] = '\0';
+        sum += split.offset[i];
+    }
+
+    return(sum);
+}
+
+int main(int argc, char **argv)
+{
+
+    char **lines;
+    size_t *lens;
+    char *buf;
+
+    const _Sagan_Split_Kernel *kernels;
+
+    uint64_t start;
+    uint64_t elapsed;
+    uint64_t bytes = 0;
+    uint64_t check_strtok = 0;
+    uint64_t check_scalar = 0;
+    uint64_t check;
+
+    int kernel_count;
+    int count;
+    int round;
+    int k;
+    int i;
+
+    if ( argc > 2 ) {
+        usage();
+        exit(1);
+    }
+
+    lines = malloc(BENCH_LINES * sizeof(char *));
+    lens = malloc(BENCH_LINES * sizeof(size_t));
+    buf = malloc(BENCH_LINE_SIZE);
+
+    if ( lines == NULL || lens == NULL || buf == NULL ) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+
+    count = argc == 2 ? load(argv[1], lines, lens, BENCH_LINES) : generate(lines, lens, BENCH_LINES);
+
+    for ( i = 0; i < count; i++ ) {
+        bytes += lens[i];
+    }
+
+    printf("Corpus: %d lines,  %" PRIu64 " bytes,  %d rounds,  run time splitter: %s\n\n", count, bytes, BENCH_ROUNDS, Sagan_Split_Init());
+
+    start = now();
+
+    for ( round = 0; round < BENCH_ROUNDS; round++ ) {
+        for ( i = 0; i < count; i++ ) {
+            check_strtok += split_strtok(buf, lines[i], lens[i]);
+        }
+    }
+
+    elapsed = now() - start;
+    printf("%-10s %8.1f ns/line  %8.1f MB/s\n", "strtok_r", (double)elapsed / ((uint64_t)count * BENCH_ROUNDS), (double)bytes * BENCH_ROUNDS * 1000 / elapsed);
+
+    /* Every splitter this CPU can run,  scalar first */
+
+    kernels = Sagan_Split_Kernels(&kernel_count);
+
+    for ( k = 0; k < kernel_count; k++ ) {
+
+        check = 0;
+        start = now();
+
+        for ( round = 0; round < BENCH_ROUNDS; round++ ) {
+            for ( i = 0; i < count; i++ ) {
+                check += split_view(kernels[k].split, buf, lines[i], lens[i]);
+            }
+        }
+
+        elapsed = now() - start;
+        printf("%-10s %8.1f ns/line  %8.1f MB/s\n", kernels[k].name, (double)elapsed / ((uint64_t)count * BENCH_ROUNDS), (double)bytes * BENCH_ROUNDS * 1000 / elapsed);
+
+        /* Lines with empty fields split differently under strtok_r(),  so
+         * only the splitters are required to agree */
+
+        if ( k == 0 ) {
+            check_scalar = check;
+        }
+
+        else if ( check != check_scalar ) {
+            fprintf(stderr, "\nMismatch between scalar and %s splitters!\n", kernels[k].name);
+            exit(1);
+        }
+    }
+
+    if ( check_strtok != check_scalar ) {
+        printf("\nNote: strtok_r() and the splitters disagree on some (empty field) lines.\n");
+    }
+
+    return(0);
+}
@@ -0,0 +1,296 @@
+/*
+** Copyright (C) 2009-2017 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2017 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* sagan-strstr-bench.c
+ *
+ * Microbenchmark for the substring search kernels
+ * (src/parsers/sagan-strstr/sagan-strstr-simd.c).  Times libc strstr()
+ * and memmem() against every kernel this CPU can run,  over a range of
+ * needle lengths.  Needles are cut from the corpus lines themselves,  so
+ * there is a realistic mix of hits and misses.  The corpus is either a
+ * file of syslog lines or,  by default,  a generated one.
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <time.h>
+
+#include "../src/parsers/sagan-strstr/sagan-strstr-simd.h"
+
+#define BENCH_LINES		100000
+#define BENCH_ROUNDS		10
+#define BENCH_LINE_SIZE		10240
+#define BENCH_MAX_NEEDLE	32
+
+static const size_t needle_lens[] = { 2, 4, 8, 16, 32 };
+
+/****************************************************************************
+ * usage - Give the user some hints about how to use this utility!
+ ****************************************************************************/
+
+void usage( void )
+{
+
+    fprintf(stderr, "\nsagan-strstr-bench [corpus file]\n");
+
+}
+
+/****************************************************************************
+ * now - Monotonic time in nanoseconds
+ ****************************************************************************/
+
+uint64_t now( void )
+{
+
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return( (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec );
+
+}
+
+/****************************************************************************
+ * generate - Builds a corpus that looks like what rsyslog hands Sagan.
+ * Message lengths vary and some messages contain "|".
+ ****************************************************************************/
+
+int generate( char **lines, size_t *lens, int count )
+{
+
+    static const char *programs[] = { "sshd", "kernel", "postfix/smtpd", "CRON", "sudo", "named", "httpd" };
+    static const char *messages[] = {
+        "Accepted publickey for root from 10.1.2.3 port 51122 ssh2: RSA SHA256:Yp2r0k1lE0zZ8nJ9tQWQ5c3xY8bQ2d1sT0c6a7u9v0w",
+        "Failed password for invalid user admin from 192.168.100.4 port 40112 ssh2",
+        "[UFW BLOCK] IN=eth0 OUT= MAC=00:16:3e:5e:6c:00:00:16:3e:11:22:33:08:00 SRC=203.0.113.9 DST=198.51.100.7 LEN=60 TOS=0x00 PREC=0x00 TTL=52 ID=40422 DF PROTO=TCP SPT=44522 DPT=23 WINDOW=29200 RES=0x00 SYN URGP=0",
+        "connect from unknown[198.51.100.23]",
+        "(root) CMD (run-parts /etc/cron.hourly)",
+        "pam_unix(sudo:session): session opened for user root by champ(uid=0)",
+        "client 10.0.0.5#53211 (example.com): query (cache) 'example.com/A/IN' denied",
+        "GET /index.php?a=1|b=2|c=3 HTTP/1.1 200 5120 \"-\" \"Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/58.0 Safari/537.36\""
+    };
+
+    char buf[BENCH_LINE_SIZE];
+    int i;
+    int n;
+
+    for ( i = 0; i < count; i++ ) {
+
+        n = snprintf(buf, sizeof(buf), "10.%d.%d.%d|auth|info|info|%02x|2017-06-%02d|%02d:%02d:%02d|%s|%s",
+                     i & 0xff, (i >> 8) & 0xff, (i >> 16) & 0xff, i % 200,
+                     1 + i % 28, i % 24, i % 60, (i * 7) % 60,
+                     programs[i % 7], messages[(i * 13) % 8]);
+
+        lens[i] = n;
+        lines[i] = strdup(buf);
+
+    }
+
+    return(count);
+}
+
+/****************************************************************************
+ * load - Reads a corpus file,  one FIFO line per line
+ ****************************************************************************/
+
+int load( const char *file, char **lines, size_t *lens, int count )
+{
+
+    FILE *fd;
+    char buf[BENCH_LINE_SIZE];
+    int i = 0;
+
+    if (( fd = fopen(file, "r")) == NULL ) {
+        fprintf(stderr, "Cannot open %s\n", file);
+        exit(1);
+    }
+
+    while ( i < count && fgets(buf, sizeof(buf), fd) != NULL ) {
+
+        buf[strcspn(buf, "\n")] = '\0';
+        lens[i] = strlen(buf);
+        lines[i] = strdup(buf);
+        i++;
+
+    }
+
+    fclose(fd);
+    return(i);
+}
+
+/****************************************************************************
+ * needles - Cuts one needle of "len" bytes per line,  taken from a
+ * different line than the one it will be searched for in.
+ ****************************************************************************/
+
+void needles( char **lines, size_t *lens, int count, size_t len, char (*needle)[BENCH_MAX_NEEDLE+1], _Sagan_Needle *compiled )
+{
+
+    size_t offset;
+    int src;
+    int i;
+
+    for ( i = 0; i < count; i++ ) {
+
+        src = (int)(( (uint64_t)i * 7919 + 13 ) % count);
+        offset = lens[src] > len ? ( (size_t)i * 31 ) % ( lens[src] - len ) : 0;
+
+        memset(needle[i], 0, BENCH_MAX_NEEDLE+1);
+        memcpy(needle[i], lines[src] + offset, lens[src] < len ? lens[src] : len);
+
+        Sagan_Needle_Compile(&compiled[i], needle[i], strlen(needle[i]));
+
+    }
+}
+
+/****************************************************************************
+ * report - Prints one result line
+ ****************************************************************************/
+
+void report( const char *name, size_t len, uint64_t elapsed, int count, uint64_t bytes )
+{
+
+    printf("%-8s %4zu %10.1f ns/line  %8.1f MB/s\n", name, len, (double)elapsed / ((uint64_t)count * BENCH_ROUNDS), (double)bytes * BENCH_ROUNDS * 1000 / elapsed);
+
+}
+
+int main(int argc, char **argv)
+{
+
+    char **lines;
+    size_t *lens;
+    char (*needle)[BENCH_MAX_NEEDLE+1];
+    _Sagan_Needle *compiled;
+
+    const _Sagan_Find_Kernel *kernels;
+    const char *found;
+
+    uint64_t start;
+    uint64_t bytes = 0;
+    uint64_t check_libc;
+    uint64_t check;
+    uint64_t hits;
+
+    int kernel_count;
+    int count;
+    int round;
+    int mismatch = 0;
+    int n;
+    int k;
+    int i;
+
+    if ( argc > 2 ) {
+        usage();
+        exit(1);
+    }
+
+    lines = malloc(BENCH_LINES * sizeof(char *));
+    lens = malloc(BENCH_LINES * sizeof(size_t));
+    needle = malloc(BENCH_LINES * sizeof(*needle));
+    compiled = malloc(BENCH_LINES * sizeof(_Sagan_Needle));
+
+    if ( lines == NULL || lens == NULL || needle == NULL || compiled == NULL ) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+
+    count = argc == 2 ? load(argv[1], lines, lens, BENCH_LINES) : generate(lines, lens, BENCH_LINES);
+
+    if ( count == 0 ) {
+        fprintf(stderr, "Empty corpus\n");
+        exit(1);
+    }
+
+    for ( i = 0; i < count; i++ ) {
+        bytes += lens[i];
+    }
+
+    printf("Corpus: %d lines,  %" PRIu64 " bytes,  %d rounds,  run time kernel: %s\n", count, bytes, BENCH_ROUNDS, Sagan_Find_Init());
+
+    kernels = Sagan_Find_Kernels(&kernel_count);
+
+    for ( n = 0; n < (int)(sizeof(needle_lens) / sizeof(needle_lens[0])); n++ ) {
+
+        needles(lines, lens, count, needle_lens[n], needle, compiled);
+
+        printf("\n");
+
+        check_libc = 0;
+        hits = 0;
+        start = now();
+
+        for ( round = 0; round < BENCH_ROUNDS; round++ ) {
+            for ( i = 0; i < count; i++ ) {
+                found = strstr(lines[i], needle[i]);
+                check_libc += found == NULL ? 0 : (uint64_t)(found - lines[i]) + 1;
+                hits += found != NULL;
+            }
+        }
+
+        report("strstr", needle_lens[n], now() - start, count, bytes);
+
+        check = 0;
+        start = now();
+
+        for ( round = 0; round < BENCH_ROUNDS; round++ ) {
+            for ( i = 0; i < count; i++ ) {
+                found = memmem(lines[i], lens[i], needle[i], compiled[i].len);
+                check += found == NULL ? 0 : (uint64_t)(found - lines[i]) + 1;
+            }
+        }
+
+        report("memmem", needle_lens[n], now() - start, count, bytes);
+
+        if ( check != check_libc ) {
+            fprintf(stderr, "Mismatch between strstr and memmem!\n");
+            mismatch = 1;
+        }
+
+        for ( k = 0; k < kernel_count; k++ ) {
+
+            check = 0;
+            start = now();
+
+            for ( round = 0; round < BENCH_ROUNDS; round++ ) {
+                for ( i = 0; i < count; i++ ) {
+                    found = kernels[k].find(lines[i], lens[i], needle[i], &compiled[i]);
+                    check += found == NULL ? 0 : (uint64_t)(found - lines[i]) + 1;
+                }
+            }
+
+            report(kernels[k].name, needle_lens[n], now() - start, count, bytes);
+
+            if ( check != check_libc ) {
+                fprintf(stderr, "Mismatch between strstr and the %s kernel!\n", kernels[k].name);
+                mismatch = 1;
+            }
+        }
+
+        printf("(%.1f%% of searches matched)\n", (double)hits * 100 / ((uint64_t)count * BENCH_ROUNDS));
+
+    }
+
+    return(mismatch);
+}